@@ -11,10 +11,17 @@
 #include <iostream>
 #include <string>
 
-void DXApp::Initialize(std::shared_ptr<MessageQueue> messageQueue, HWND hwnd, std::string filename, bool isTownscaper) {
+void DXApp::Initialize(std::shared_ptr<MessageQueue> messageQueue,
+                       HWND hwnd,
+                       std::vector<std::string> filenames,
+                       size_t numInstances,
+                       bool isTownscaper,
+                       bool useQuantizedVertices,
+                       bool printCullingStatistics,
+                       bool printLoadStatistics) {
   m_messageQueue = std::move(messageQueue);
-  m_renderer.Initialize(hwnd, isTownscaper);
-  m_scene.Initialize(filename, &m_renderer);
+  m_renderer.Initialize(hwnd, isTownscaper, useQuantizedVertices, printCullingStatistics);
+  m_scene.Initialize(filenames, numInstances, printLoadStatistics, &m_renderer);
   m_isInitialized = true;
 }
 
@@ -6,6 +6,8 @@
 #include <Windows.h>
 
 #include <memory>
+#include <string>
+#include <vector>
 
 class MessageQueue;
 
@@ -29,7 +31,14 @@ class DXApp {
   bool m_isInitialized = false;
 
  public:
-  void Initialize(std::shared_ptr<MessageQueue> messageQueue, HWND hwnd, std::string filename, bool isTownscaper);
+  void Initialize(std::shared_ptr<MessageQueue> messageQueue,
+                  HWND hwnd,
+                  std::vector<std::string> filenames,
+                  size_t numInstances,
+                  bool isTownscaper,
+                  bool useQuantizedVertices,
+                  bool printCullingStatistics,
+                  bool printLoadStatistics);
   bool IsInitialized() const;
 
   bool HandleMessages();
@@ -127,13 +127,19 @@ void ShowDXWindow(HWND hwnd) {
 
 }  // namespace
 
-void Window::Initialize(std::string filename, bool isTownscaper) {
+void Window::Initialize(std::vector<std::string> filenames,
+                        size_t numInstances,
+                        bool isTownscaper,
+                        bool useQuantizedVertices,
+                        bool printCullingStatistics,
+                        bool printLoadStatistics) {
   m_messageQueue = std::make_shared<MessageQueue>();
 
   HWND hwnd = CreateDXWindow(this, L"mvw", 640, 480);
 
   std::unique_ptr<DXApp> app = std::make_unique<DXApp>();
-  app->Initialize(m_messageQueue, hwnd, std::move(filename), isTownscaper);
+  app->Initialize(m_messageQueue, hwnd, std::move(filenames), numInstances, isTownscaper, useQuantizedVertices,
+                  printCullingStatistics, printLoadStatistics);
 
   ShowDXWindow(hwnd);
 
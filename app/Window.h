@@ -3,6 +3,7 @@
 #include <memory>
 #include <string>
 #include <thread>
+#include <vector>
 
 #include "app/DXApp.h"
 #include "utils/MessageQueue.h"
@@ -15,7 +16,12 @@ class Window {
  public:
   Window() = default;
 
-  void Initialize(std::string filename, bool isTownscaper);
+  void Initialize(std::vector<std::string> filenames,
+                  size_t numInstances,
+                  bool isTownscaper,
+                  bool useQuantizedVertices,
+                  bool printCullingStatistics,
+                  bool printLoadStatistics);
   void PushMessage(MSG msg);
   void WaitForRenderThreadToFinish();
 };
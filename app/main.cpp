@@ -1,10 +1,12 @@
 #include <Windows.h>
 
 #include <cassert>
+#include <cstdlib>
 #include <filesystem>
 #include <iostream>
 #include <string>
 #include <thread>
+#include <vector>
 
 #include "app/DXApp.h"
 #include "app/Window.h"
@@ -27,7 +29,9 @@ void RunMessageLoop() {
 #ifdef USE_CONSOLE_SUBSYSTEM
 
 void EmitUsageMessage(const char* exeName) {
-  std::cerr << "Usage: " << exeName << " [-townscaper] <obj file>" << std::endl;
+  std::cerr << "Usage: " << exeName
+            << " [-townscaper] [-quantized] [-cullingstats] [-loadstats] [-instances <count>] <obj file>..."
+            << std::endl;
 }
 
 int main(int argc, char** argv) {
@@ -46,29 +50,51 @@ int main(int argc, char** argv) {
     return 1;
   }
 
-  std::string objFilename;
+  // The instances are laid out on a grid, going through the obj files in turn. Without -instances, each file gets one.
+  std::vector<std::string> objFilenames;
+  size_t numInstances = 0;
   bool isTownscaper = false;
+  bool useQuantizedVertices = false;
+  bool printCullingStatistics = false;
+  bool printLoadStatistics = false;
   for (size_t i = 1; i < argc; ++i) {
     std::string arg(argv[i]);
     if (arg == "-townscaper") {
       isTownscaper = true;
-    } else if (objFilename.empty()) {
-      objFilename = std::move(arg);
+    } else if (arg == "-quantized") {
+      useQuantizedVertices = true;
+    } else if (arg == "-cullingstats") {
+      printCullingStatistics = true;
+    } else if (arg == "-loadstats") {
+      printLoadStatistics = true;
+    } else if (arg == "-instances" && i + 1 < argc) {
+      numInstances = strtoul(argv[++i], nullptr, 10);
     } else {
-      EmitUsageMessage(argv[0]);
-      return 1;
+      objFilenames.push_back(std::move(arg));
     }
   }
 
-  if (!std::filesystem::exists(objFilename)) {
-    std::cerr << "File '" << objFilename << "' not found." << std::endl;
+  if (numInstances == 0)
+    numInstances = objFilenames.size();
+
+  // Townscaper models are drawn on their own, without instancing.
+  if (objFilenames.empty() || (isTownscaper && (objFilenames.size() > 1 || numInstances > 1))) {
+    EmitUsageMessage(argv[0]);
     return 1;
   }
 
+  for (const std::string& objFilename : objFilenames) {
+    if (!std::filesystem::exists(objFilename)) {
+      std::cerr << "File '" << objFilename << "' not found." << std::endl;
+      return 1;
+    }
+  }
+
   if (SUCCEEDED(CoInitialize(NULL))) {
     {
       Window appWindow;
-      appWindow.Initialize(std::move(objFilename), isTownscaper);
+      appWindow.Initialize(std::move(objFilenames), numInstances, isTownscaper, useQuantizedVertices,
+                           printCullingStatistics, printLoadStatistics);
       RunMessageLoop();
     }
     CoUninitialize();
@@ -1,16 +1,28 @@
 #include "d3d12/Camera.h"
 
+#include <float.h>
+#include <string.h>
+
 #include <algorithm>
 #include <cmath>
 
-DirectX::XMMATRIX PinholeCamera::GenerateViewPerspectiveTransform(float aspectRatio) const {
+namespace {
+bool IsSameCamera(const OrthographicCamera& a, const OrthographicCamera& b) {
+  return memcmp(&a, &b, sizeof(OrthographicCamera)) == 0;
+}
+}  // namespace
+
+DirectX::XMMATRIX PinholeCamera::GenerateViewTransform() const {
   DirectX::XMVECTOR pos = DirectX::XMLoadFloat4(&this->position_);
   DirectX::XMVECTOR look_at = DirectX::XMLoadFloat4(&this->look_at_);
   DirectX::XMVECTOR up = DirectX::XMVectorSet(0.0f, 1.0f, 0.0f, 1.0f);
+  return DirectX::XMMatrixLookAtLH(pos, look_at, up);
+}
 
-  DirectX::XMMATRIX viewMatrix = DirectX::XMMatrixLookAtLH(pos, look_at, up);
+DirectX::XMMATRIX PinholeCamera::GenerateViewPerspectiveTransform(float aspectRatio, float nearZ, float farZ) const {
+  DirectX::XMMATRIX viewMatrix = GenerateViewTransform();
   DirectX::XMMATRIX perspectiveMatrix =
-      DirectX::XMMatrixPerspectiveFovLH(0.25f * DirectX::XM_PI, aspectRatio, 0.1f, 1000.f);
+      DirectX::XMMatrixPerspectiveFovLH(kVerticalFieldOfView, aspectRatio, nearZ, farZ);
 
   // Future note: DirectXMath uses row-vector matrices and row-major order for the matrices.
   // This means that matrix multplication with the DirectXMath Library should be done as
@@ -37,7 +49,8 @@ DirectX::XMMATRIX OrthographicCamera::GenerateViewPerspectiveTransform() const {
 
   DirectX::XMMATRIX viewMatrix = DirectX::XMMatrixLookAtLH(pos, look_at, up);
   DirectX::XMMATRIX orthographicMatrix =
-      DirectX::XMMatrixOrthographicLH(this->widthInWorldCoordinates, this->heightInWorldCoordinates, 0.f, 5.f);
+      DirectX::XMMatrixOrthographicLH(this->widthInWorldCoordinates, this->heightInWorldCoordinates, 0.f,
+                                      this->depthInWorldCoordinates);
 
   // Future note: DirectXMath uses row-vector matrices and row-major order for the matrices.
   // This means that matrix multplication with the DirectXMath Library should be done as
@@ -72,6 +85,142 @@ DirectX::XMFLOAT4 OrthographicCamera::GetLightDirection() const {
   return result;
 }
 
+void OrthographicCamera::FitToView(const DirectX::XMMATRIX& viewProjection,
+                                   const DirectX::XMFLOAT3 sceneCorners[8],
+                                   unsigned int shadowMapSize,
+                                   bool keepIfCovered) {
+  // The light's view, turned the same way as in GenerateViewPerspectiveTransform but from the origin, so that the
+  // camera's position across the light direction is the same as the view's offset.
+  const DirectX::XMVECTOR position = DirectX::XMLoadFloat4(&position_);
+  const DirectX::XMVECTOR lightToScene = DirectX::XMVectorSubtract(DirectX::XMLoadFloat4(&look_at_), position);
+  const DirectX::XMVECTOR up = DirectX::XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
+  const DirectX::XMMATRIX lightView = DirectX::XMMatrixLookToLH(DirectX::XMVectorZero(), lightToScene, up);
+
+  // The scene's size is taken across its bounding sphere rather than its box, so that it doesn't change as the scene
+  // turns.
+  DirectX::XMVECTOR sceneMin = DirectX::XMVectorReplicate(FLT_MAX);
+  DirectX::XMVECTOR sceneMax = DirectX::XMVectorReplicate(-FLT_MAX);
+  float sceneDiameter = 0.f;
+  for (size_t i = 0; i < 8; ++i) {
+    const DirectX::XMVECTOR corner = DirectX::XMLoadFloat3(&sceneCorners[i]);
+    const DirectX::XMVECTOR lightCorner = DirectX::XMVector3TransformCoord(corner, lightView);
+    sceneMin = DirectX::XMVectorMin(sceneMin, lightCorner);
+    sceneMax = DirectX::XMVectorMax(sceneMax, lightCorner);
+    for (size_t j = 0; j < i; ++j) {
+      const DirectX::XMVECTOR diagonal = DirectX::XMVectorSubtract(corner, DirectX::XMLoadFloat3(&sceneCorners[j]));
+      sceneDiameter = std::max(sceneDiameter, DirectX::XMVectorGetX(DirectX::XMVector3Length(diagonal)));
+    }
+  }
+  if (!(sceneDiameter > 0.f) || shadowMapSize < 3)
+    return;
+
+  // The corners of the view frustum, from clip space to the light's view.
+  const DirectX::XMMATRIX clipToLight =
+      DirectX::XMMatrixMultiply(DirectX::XMMatrixInverse(nullptr, viewProjection), lightView);
+  DirectX::XMVECTOR viewMin = DirectX::XMVectorReplicate(FLT_MAX);
+  DirectX::XMVECTOR viewMax = DirectX::XMVectorReplicate(-FLT_MAX);
+  for (size_t i = 0; i < 8; ++i) {
+    const DirectX::XMVECTOR clipCorner =
+        DirectX::XMVectorSet((i & 1) ? 1.f : -1.f, (i & 2) ? 1.f : -1.f, (i & 4) ? 1.f : 0.f, 1.f);
+    const DirectX::XMVECTOR lightCorner = DirectX::XMVector3TransformCoord(clipCorner, clipToLight);
+    viewMin = DirectX::XMVectorMin(viewMin, lightCorner);
+    viewMax = DirectX::XMVectorMax(viewMax, lightCorner);
+  }
+
+  // Across the light direction, the shadows only have to cover the part of the scene that's in view. Along it, they
+  // also have to take in everything from the side of the scene that's nearest the light, and they take in the rest of
+  // the scene too, so that the view doesn't have to move as the part in view moves along the light direction.
+  DirectX::XMFLOAT3 fitMin;
+  DirectX::XMFLOAT3 fitMax;
+  DirectX::XMStoreFloat3(&fitMin, DirectX::XMVectorMax(viewMin, sceneMin));
+  DirectX::XMStoreFloat3(&fitMax, DirectX::XMVectorMin(viewMax, sceneMax));
+  if (fitMin.x > fitMax.x || fitMin.y > fitMax.y || fitMin.z > fitMax.z) {
+    // Nothing in view; the whole scene is as good as anything.
+    DirectX::XMStoreFloat3(&fitMin, sceneMin);
+    DirectX::XMStoreFloat3(&fitMax, sceneMax);
+  }
+  fitMin.z = DirectX::XMVectorGetZ(sceneMin);
+  fitMax.z = DirectX::XMVectorGetZ(sceneMax);
+  // A little slack, so that the surfaces right on the scene's bounds aren't clipped.
+  fitMin.z -= sceneDiameter / 100;
+  fitMax.z += sceneDiameter / 100;
+
+  // The view is centered on the part it covers, and snapping it to the texels can move it by up to a texel either way,
+  // so it needs to be two texels bigger than that part. Its size is the scene's, halved every four steps, so that it
+  // only changes once in a while as the view moves.
+  const float texelsPerSize = static_cast<float>(shadowMapSize - 2) / shadowMapSize;
+  const float maxSize = sceneDiameter / texelsPerSize;
+  const float neededSize = std::max(fitMax.x - fitMin.x, fitMax.y - fitMin.y) / texelsPerSize;
+  const float numSteps = std::max(0.f, std::floor(-4.f * std::log2(std::max(neededSize, FLT_MIN) / maxSize)));
+  const float size = maxSize * std::exp2(-numSteps / 4);
+
+  if (keepIfCovered) {
+    // The middle of the near side of the current view, in the light's view. The sizes all come in the same steps, so
+    // anything less than two steps up from |size| is one step up at most.
+    DirectX::XMFLOAT3 current;
+    DirectX::XMStoreFloat3(&current, DirectX::XMVector3TransformCoord(position, lightView));
+    const float halfWidth = widthInWorldCoordinates / 2;
+    const float halfHeight = heightInWorldCoordinates / 2;
+    const bool isCovered = current.x - halfWidth <= fitMin.x && fitMax.x <= current.x + halfWidth &&
+                           current.y - halfHeight <= fitMin.y && fitMax.y <= current.y + halfHeight &&
+                           current.z <= fitMin.z && fitMax.z <= current.z + depthInWorldCoordinates;
+    const bool isFineEnough = std::max(widthInWorldCoordinates, heightInWorldCoordinates) < size * std::exp2(0.5f);
+    if (isCovered && isFineEnough)
+      return;
+  }
+
+  const float texelSize = size / shadowMapSize;
+  const float left = std::floor(((fitMin.x + fitMax.x) / 2 - size / 2) / texelSize) * texelSize;
+  const float bottom = std::floor(((fitMin.y + fitMax.y) / 2 - size / 2) / texelSize) * texelSize;
+
+  // The camera sits in the middle of the near side of its view, and looks the same way as before.
+  const DirectX::XMVECTOR lightPosition = DirectX::XMVectorSet(left + size / 2, bottom + size / 2, fitMin.z, 1.f);
+  const DirectX::XMVECTOR newPosition =
+      DirectX::XMVector3TransformCoord(lightPosition, DirectX::XMMatrixTranspose(lightView));
+  DirectX::XMStoreFloat4(&position_, DirectX::XMVectorSetW(newPosition, 1.f));
+  DirectX::XMStoreFloat4(&look_at_, DirectX::XMVectorSetW(DirectX::XMVectorAdd(newPosition, lightToScene), 1.f));
+  widthInWorldCoordinates = size;
+  heightInWorldCoordinates = size;
+  depthInWorldCoordinates = fitMax.z - fitMin.z;
+}
+
+void ShadowCascades::FitToView(const PinholeCamera& camera,
+                               float aspectRatio,
+                               const OrthographicCamera& lightCamera,
+                               const DirectX::XMFLOAT3 sceneCorners[8],
+                               unsigned int shadowMapSize,
+                               bool haveCastersChanged) {
+  // Only the depths that the scene covers need shadows.
+  const DirectX::XMMATRIX view = camera.GenerateViewTransform();
+  float sceneNearZ = FLT_MAX;
+  float sceneFarZ = -FLT_MAX;
+  for (size_t i = 0; i < 8; ++i) {
+    const float depth =
+        DirectX::XMVectorGetZ(DirectX::XMVector3TransformCoord(DirectX::XMLoadFloat3(&sceneCorners[i]), view));
+    sceneNearZ = std::min(sceneNearZ, depth);
+    sceneFarZ = std::max(sceneFarZ, depth);
+  }
+  const float nearZ = std::clamp(sceneNearZ, PinholeCamera::kNearZ, PinholeCamera::kFarZ);
+  // With the scene entirely behind the camera, nothing's in view; any slices will do.
+  const float farZ = std::max(std::min(sceneFarZ, PinholeCamera::kFarZ), 2 * nearZ);
+
+  float sliceNearZ = nearZ;
+  for (unsigned int i = 0; i < kNumCascades; ++i) {
+    const float t = static_cast<float>(i + 1) / kNumCascades;
+    const float logarithmicSplit = nearZ * std::pow(farZ / nearZ, t);
+    const float evenSplit = nearZ + (farZ - nearZ) * t;
+    splitDepths[i] = kLogarithmicSplitWeight * logarithmicSplit + (1.f - kLogarithmicSplitWeight) * evenSplit;
+
+    OrthographicCamera fitted = haveCastersChanged ? lightCamera : cameras[i];
+    fitted.FitToView(camera.GenerateViewPerspectiveTransform(aspectRatio, sliceNearZ, splitDepths[i]), sceneCorners,
+                     shadowMapSize, /*keepIfCovered*/ !haveCastersChanged);
+    if (haveCastersChanged || !IsSameCamera(fitted, cameras[i]))
+      isUpToDate[i] = false;
+    cameras[i] = fitted;
+    sliceNearZ = splitDepths[i];
+  }
+}
+
 void ArcballCameraController::OnMouseDrag(int deltaX, int deltaY) {
   m_rotationXInDegrees += -(float)deltaX / 2.f;
   m_rotationYInDegrees += -(float)deltaY / 2.f;
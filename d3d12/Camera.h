@@ -3,10 +3,16 @@
 #include <DirectXMath.h>
 
 struct PinholeCamera {
+  static constexpr float kVerticalFieldOfView = 0.25f * DirectX::XM_PI;
+  static constexpr float kNearZ = 0.1f;
+  static constexpr float kFarZ = 1000.f;
+
   DirectX::XMFLOAT4 position_;
   DirectX::XMFLOAT4 look_at_;
 
-  DirectX::XMMATRIX GenerateViewPerspectiveTransform(float aspectRatio) const;
+  DirectX::XMMATRIX GenerateViewTransform() const;
+  // |nearZ| and |farZ| can be narrowed down to get the transform for a slice of the view.
+  DirectX::XMMATRIX GenerateViewPerspectiveTransform(float aspectRatio, float nearZ = kNearZ, float farZ = kFarZ) const;
   DirectX::XMFLOAT4X4 GenerateViewPerspectiveTransform4x4(float aspectRatio) const;
 };
 
@@ -16,10 +22,62 @@ struct OrthographicCamera {
   DirectX::XMFLOAT4 look_at_;
   float widthInWorldCoordinates;
   float heightInWorldCoordinates;
+  // How far the view reaches from |position_|, towards |look_at_|.
+  float depthInWorldCoordinates = 5.f;
 
   DirectX::XMMATRIX GenerateViewPerspectiveTransform() const;
   DirectX::XMFLOAT4X4 GenerateViewPerspectiveTransform4x4() const;
   DirectX::XMFLOAT4 GetLightDirection() const;
+
+  // Moves the camera, and sizes its view, to fit the part of the scene's bounding box (given by its corners, in world
+  // space) that |viewProjection| can see, and everything between that and the light that could cast a shadow onto
+  // it. The light direction stays the same.
+  //
+  // So that the shadows don't shimmer as the view moves, the view's size only ever changes in steps, and it only ever
+  // moves by whole texels of a |shadowMapSize|-texel shadow map. Leaves the camera alone for an empty scene.
+  //
+  // With |keepIfCovered|, the camera is also left alone if its current view still covers everything that it has to,
+  // and is no more than a step bigger than it needs to be, so that what has already been drawn from it can be reused.
+  void FitToView(const DirectX::XMMATRIX& viewProjection,
+                 const DirectX::XMFLOAT3 sceneCorners[8],
+                 unsigned int shadowMapSize,
+                 bool keepIfCovered = false);
+};
+
+// Cascaded shadow maps: the view is split by distance into slices, each with a shadow map camera of its own fitted to
+// it, so that the nearby shadows (which cover the most pixels) get the most shadow map texels.
+//
+// The slices end at a blend of logarithmic and even spacing across the part of the view that the scene is in; the
+// logarithmic spacing keeps the ratio of texels to pixels about the same from one slice to the next, but on its own it
+// makes the nearest slices tiny.
+//
+// The shadow maps are kept from one frame to the next. As long as the shadow casters stay put, the cameras only move
+// once the view has moved out from under them, and only the cascades whose cameras have moved have to be drawn again.
+struct ShadowCascades {
+  static constexpr unsigned int kNumCascades = 4;  // Has to match ColorPassShaders.hlsl.
+  // How much of the logarithmic spacing goes into the blend.
+  static constexpr float kLogarithmicSplitWeight = 0.75f;
+
+  OrthographicCamera cameras[kNumCascades];
+  // The view depth (distance along the view direction) that each slice reaches out to. Anything beyond the last split
+  // is in the last slice.
+  float splitDepths[kNumCascades];
+  // Whether each cascade's shadow map has been drawn from its camera, with the shadow casters where they are now. Set
+  // by the renderer once it has drawn the cascade.
+  bool isUpToDate[kNumCascades] = {};
+
+  // Fits each cascade's camera to its slice of what |camera| can see on a viewport with |aspectRatio|, for a square
+  // shadow map that's |shadowMapSize| texels across (see OrthographicCamera::FitToView). The cameras all get
+  // |lightCamera|'s light direction.
+  //
+  // |haveCastersChanged| is for when the light, or anything that casts a shadow, has changed since the last call (and
+  // for the first call); all of the cascades are fitted from scratch then, and have to be drawn again.
+  void FitToView(const PinholeCamera& camera,
+                 float aspectRatio,
+                 const OrthographicCamera& lightCamera,
+                 const DirectX::XMFLOAT3 sceneCorners[8],
+                 unsigned int shadowMapSize,
+                 bool haveCastersChanged);
 };
 
 struct ArcballCameraController {
@@ -4,9 +4,27 @@
 #include "d3d12/ResourceHelper.h"
 #include "utils/comhelper.h"
 
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <iterator>
+#include <limits>
+
 using Microsoft::WRL::ComPtr;
 
 namespace {
+// Levels of detail are drawn as long as they don't move the surface by more than this many pixels (or shadow map
+// texels).
+constexpr float kMaxLodPixelError = 1.f;
+
+// How often the culling statistics are printed.
+constexpr size_t kFramesPerCullingReport = 600;
+
+// Enough for the shadow and color passes of a few thousand instances, to begin with; the buffer grows if need be.
+constexpr size_t kInitialInstanceDataBufferSize = 1024 * 1024;
+// Vertex buffer views only need 4-byte alignment, but 16 keeps each instance's rows aligned as well.
+constexpr size_t kInstanceDataAlignment = 16;
+
 void EnableDebugLayer() {
   ComPtr<ID3D12Debug> debugController;
   if (SUCCEEDED(D3D12GetDebugInterface(IID_PPV_ARGS(&debugController))))
@@ -30,8 +48,10 @@ ComPtr<IDXGIAdapter> FindAdapter(IDXGIFactory4* factory) {
 
 }  // namespace
 
-void D3D12Renderer::Initialize(HWND hwnd, bool isTownscaper) {
+void D3D12Renderer::Initialize(HWND hwnd, bool isTownscaper, bool useQuantizedVertices, bool printCullingStatistics) {
   m_isTownscaper = isTownscaper;
+  m_useQuantizedVertices = useQuantizedVertices;
+  m_printCullingStatistics = printCullingStatistics;
   EnableDebugLayer();
 
   InitializePerDeviceObjects();
@@ -59,8 +79,10 @@ void D3D12Renderer::InitializePerDeviceObjects() {
 
   // Command lists automatically start out as open.
   HR(m_cl->Close());
+  m_shadowPassTimer.Initialize(m_device.Get(), m_directCommandQueue.Get());
 
   m_constantBufferAllocator.Initialize(m_device.Get());
+  m_instanceDataBuffer.Initialize(m_device.Get(), kInitialInstanceDataBufferSize);
   m_linearSRVDescriptorAllocator.Initialize(m_device.Get(), D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
   m_linearDSVDescriptorAllocator.Initialize(m_device.Get(), D3D12_DESCRIPTOR_HEAP_TYPE_DSV);
   m_linearRTVDescriptorAllocator.Initialize(m_device.Get(), D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
@@ -80,7 +102,7 @@ void D3D12Renderer::InitializePerWindowObjects(HWND hwnd) {
 void D3D12Renderer::InitializePerPassObjects() {
   m_colorPass.Initialize(m_device.Get());
   m_shadowMapPass.Initialize(m_device.Get());
-  m_townscaperPSOs.Initialize(m_device.Get());
+  m_townscaperPSOs.Initialize(m_device.Get(), m_useQuantizedVertices);
 }
 
 void D3D12Renderer::InitializeFenceObjects() {
@@ -92,10 +114,15 @@ void D3D12Renderer::InitializeFenceObjects() {
 
 void D3D12Renderer::InitializeShadowMapObjects() {
   DXGI_FORMAT shadowMapFormat = (m_isTownscaper) ? DXGI_FORMAT_D32_FLOAT_S8X24_UINT : DXGI_FORMAT_D32_FLOAT;
-  m_shadowMap.InitializeWithSRV(m_device.Get(), m_linearDSVDescriptorAllocator.AllocateSingleDescriptor(),
-                                m_linearSRVDescriptorAllocator.AllocateSingleDescriptor(), shadowMapFormat,
-                                /*width*/ 2000,
-                                /*height*/ 2000);
+  // A slice for each of the cascades. Townscaper models only have the one shadow map.
+  const unsigned int numShadowMaps = (m_isTownscaper) ? 1 : ShadowCascades::kNumCascades;
+  std::vector<DescriptorAllocation> dsvDescriptors;
+  for (unsigned int i = 0; i < numShadowMaps; ++i)
+    dsvDescriptors.push_back(m_linearDSVDescriptorAllocator.AllocateSingleDescriptor());
+  m_shadowMap.InitializeArrayWithSRV(m_device.Get(), dsvDescriptors,
+                                     m_linearSRVDescriptorAllocator.AllocateSingleDescriptor(), shadowMapFormat,
+                                     /*width*/ 2000,
+                                     /*height*/ 2000);
 }
 
 void D3D12Renderer::HandleResize(unsigned int width, unsigned int height) {
@@ -111,12 +138,26 @@ void D3D12Renderer::DrawScene(Scene& scene) {
   HR(m_directCommandAllocator->Reset());
   HR(m_cl->Reset(m_directCommandAllocator.Get(), nullptr));
 
+  // Anything that has been loaded since the last frame is uploaded before the passes that read it.
+  scene.UploadStreamedData(this);
+  scene.UpdateInstances();
+  scene.FitShadowMapCameras(m_window.GetAspectRatio(), m_shadowMap.GetWidth());
+
   if (m_isTownscaper) {
-    Townscaper_RunShadowPass(scene.m_shadowMapCamera, scene.m_object);
-    Townscaper_RunColorPass(scene.m_camera.GetPinholeCamera(), scene.m_shadowMapCamera, scene.m_object);
+    // The townscaper passes expect all of the mesh parts to be there, so there's nothing to draw until then. Townscaper
+    // scenes have a single object, which isn't instanced.
+    if (scene.IsModelLoaded()) {
+      const Object& object = *scene.m_objects[0];
+      Townscaper_RunShadowPass(scene.m_shadowMapCamera, object);
+      Townscaper_RunColorPass(scene.m_camera.GetPinholeCamera(), scene.m_shadowMapCamera, object);
+    } else {
+      ClearRenderTarget();
+    }
   } else {
-    RunShadowPass(scene.m_shadowMapCamera, scene.m_object);
-    RunColorPass(scene.m_camera.GetPinholeCamera(), scene.m_shadowMapCamera, scene.m_object);
+    RunShadowPass(&scene.m_shadowCascades, scene);
+    RunColorPass(scene.m_camera.GetPinholeCamera(), scene.m_shadowCascades, scene);
+    if (m_printCullingStatistics && ++m_numCulledFrames == kFramesPerCullingReport)
+      PrintCullingStatistics();
   }
 
   CD3DX12_RESOURCE_BARRIER preCopyResourceBarriers[] = {
@@ -140,13 +181,8 @@ void D3D12Renderer::DrawScene(Scene& scene) {
   m_cl->Close();
   ID3D12CommandList* cl[] = {m_cl.Get()};
   m_directCommandQueue->ExecuteCommandLists(1, cl);
-}
-
-namespace {
-void DrawMeshPart(ID3D12GraphicsCommandList* cl, const ObjFileData::MeshPart& meshPart) {
-  cl->DrawIndexedInstanced(meshPart.numIndices, /*instanceCount*/ 1, meshPart.indexStart, /*baseVertexLocation*/ 0,
-                           /*startInstanceLocation*/ 0);
-}
+  // The frame's fence value is signaled by SignalAndPresent.
+  m_shadowPassTimer.EndFrame(m_nextFenceValue);
 }
 
 void D3D12Renderer::Townscaper_RunShadowPass(const OrthographicCamera& shadowMapCamera, const Object& object) {
@@ -160,10 +196,10 @@ void D3D12Renderer::Townscaper_RunShadowPass(const OrthographicCamera& shadowMap
   m_cl->SetGraphicsRootConstantBufferView(/*rootParameterIndex*/ 0, shadowMapPerFrameBuffer);
 
   // Set up the constant buffer for the per-object data.
-  ShadowMapPass::PerObjectData perObjectData;
-  perObjectData.worldTransform = object.GenerateModelTransform4x4();
+  TownscaperPSOs::ShadowMapPerObjectData perObjectData;
+  perObjectData.worldTransform = object.GenerateVertexTransform4x4();
   D3D12_GPU_VIRTUAL_ADDRESS shadowMapPerObjectBuffer = m_constantBufferAllocator.AllocateAndUpload(
-      sizeof(ShadowMapPass::PerObjectData), &perObjectData, m_nextFenceValue);
+      sizeof(TownscaperPSOs::ShadowMapPerObjectData), &perObjectData, m_nextFenceValue);
   m_cl->SetGraphicsRootConstantBufferView(/*rootParameterIndex*/ 1, shadowMapPerObjectBuffer);
 
   unsigned int shadowMapWidth = m_shadowMap.GetWidth();
@@ -181,7 +217,6 @@ void D3D12Renderer::Townscaper_RunShadowPass(const OrthographicCamera& shadowMap
   m_cl->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
   m_cl->IASetVertexBuffers(0, 1, &object.model.m_vertexBufferView);
-  m_cl->IASetIndexBuffer(&object.model.m_indexBufferView);
 
   // Set the descriptor heap.
   ID3D12DescriptorHeap* circularBufferSRVDescriptorHeap[] = {m_circularSRVDescriptorAllocator.GetDescriptorHeap()};
@@ -195,24 +230,24 @@ void D3D12Renderer::Townscaper_RunShadowPass(const OrthographicCamera& shadowMap
   m_cl->SetGraphicsRootDescriptorTable(2, textureSRVDescriptor.gpuStart);
 
   m_cl->SetPipelineState(m_townscaperPSOs.m_psoShadowMap_Generic.Get());
-  DrawMeshPart(m_cl.Get(), object.model.m_meshParts[TownscaperMeshID::Buildings]);
+  object.model.DrawMeshPart(m_cl.Get(), TownscaperMeshID::Buildings);
 
   m_cl->SetPipelineState(m_townscaperPSOs.m_psoShadowMap_Windows_Stencil.Get());
-  DrawMeshPart(m_cl.Get(), object.model.m_meshParts[TownscaperMeshID::Windows]);
+  object.model.DrawMeshPart(m_cl.Get(), TownscaperMeshID::Windows);
 
   m_cl->OMSetStencilRef(1);
   m_cl->SetPipelineState(m_townscaperPSOs.m_psoShadowMap_Windows_MaxDepth.Get());
-  DrawMeshPart(m_cl.Get(), object.model.m_meshParts[TownscaperMeshID::Windows]);
+  object.model.DrawMeshPart(m_cl.Get(), TownscaperMeshID::Windows);
   m_cl->SetPipelineState(m_townscaperPSOs.m_psoShadowMap_Windows_MinDepth.Get());
-  DrawMeshPart(m_cl.Get(), object.model.m_meshParts[TownscaperMeshID::Windows]);
+  object.model.DrawMeshPart(m_cl.Get(), TownscaperMeshID::Windows);
 
   m_cl->SetPipelineState(m_townscaperPSOs.m_psoShadowMap_Generic.Get());
-  DrawMeshPart(m_cl.Get(), object.model.m_meshParts[TownscaperMeshID::Birds]);
-  DrawMeshPart(m_cl.Get(), object.model.m_meshParts[TownscaperMeshID::Fencing]);
-  DrawMeshPart(m_cl.Get(), object.model.m_meshParts[TownscaperMeshID::Plants]);
-  DrawMeshPart(m_cl.Get(), object.model.m_meshParts[TownscaperMeshID::Props]);
-  DrawMeshPart(m_cl.Get(), object.model.m_meshParts[TownscaperMeshID::Sand]);
-  DrawMeshPart(m_cl.Get(), object.model.m_meshParts[TownscaperMeshID::Water]);
+  object.model.DrawMeshPart(m_cl.Get(), TownscaperMeshID::Birds);
+  object.model.DrawMeshPart(m_cl.Get(), TownscaperMeshID::Fencing);
+  object.model.DrawMeshPart(m_cl.Get(), TownscaperMeshID::Plants);
+  object.model.DrawMeshPart(m_cl.Get(), TownscaperMeshID::Props);
+  object.model.DrawMeshPart(m_cl.Get(), TownscaperMeshID::Sand);
+  object.model.DrawMeshPart(m_cl.Get(), TownscaperMeshID::Water);
 }
 
 void D3D12Renderer::Townscaper_RunColorPass(const PinholeCamera& camera,
@@ -234,12 +269,12 @@ void D3D12Renderer::Townscaper_RunColorPass(const PinholeCamera& camera,
   m_cl->OMSetRenderTargets(1, &rtvHandle, FALSE, &dsvHandle);
 
   // Set up the constant buffer for the per-frame data.
-  ColorPass::PerFrameData perFrameData;
+  TownscaperPSOs::PerFrameData perFrameData;
   perFrameData.projectionViewTransform = camera.GenerateViewPerspectiveTransform4x4(m_window.GetAspectRatio());
   perFrameData.shadowMapProjectionViewTransform = shadowMapCamera.GenerateViewPerspectiveTransform4x4();
   perFrameData.lightDirection = shadowMapCamera.GetLightDirection();
-  D3D12_GPU_VIRTUAL_ADDRESS colorPassPerFrameConstantBuffer =
-      m_constantBufferAllocator.AllocateAndUpload(sizeof(ColorPass::PerFrameData), &perFrameData, m_nextFenceValue);
+  D3D12_GPU_VIRTUAL_ADDRESS colorPassPerFrameConstantBuffer = m_constantBufferAllocator.AllocateAndUpload(
+      sizeof(TownscaperPSOs::PerFrameData), &perFrameData, m_nextFenceValue);
   m_cl->SetGraphicsRootConstantBufferView(/*rootParameterIndex*/ 0, colorPassPerFrameConstantBuffer);
 
   // Set up the constant buffer for the per-object data.
@@ -250,11 +285,11 @@ void D3D12Renderer::Townscaper_RunColorPass(const PinholeCamera& camera,
   DirectX::XMMATRIX modelTransformInverseTranspose =
       DirectX::XMMatrixTranspose(DirectX::XMMatrixInverse(nullptr, modelTransformModified));
 
-  ColorPass::PerObjectData perObjectData;
-  DirectX::XMStoreFloat4x4(&perObjectData.modelTransform, modelTransform);
+  TownscaperPSOs::PerObjectData perObjectData;
+  DirectX::XMStoreFloat4x4(&perObjectData.modelTransform, object.GenerateVertexTransform());
   DirectX::XMStoreFloat4x4(&perObjectData.modelTransformInverseTranspose, modelTransformInverseTranspose);
-  D3D12_GPU_VIRTUAL_ADDRESS colorPassPerObjectBuffer =
-      m_constantBufferAllocator.AllocateAndUpload(sizeof(ColorPass::PerObjectData), &perObjectData, m_nextFenceValue);
+  D3D12_GPU_VIRTUAL_ADDRESS colorPassPerObjectBuffer = m_constantBufferAllocator.AllocateAndUpload(
+      sizeof(TownscaperPSOs::PerObjectData), &perObjectData, m_nextFenceValue);
   m_cl->SetGraphicsRootConstantBufferView(/*rootParameterIndex*/ 1, colorPassPerObjectBuffer);
 
   float clearColor[4] = {0.1f, 0.2f, 0.3f, 1.0f};
@@ -263,7 +298,6 @@ void D3D12Renderer::Townscaper_RunColorPass(const PinholeCamera& camera,
   m_cl->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
   m_cl->IASetVertexBuffers(0, 1, &object.model.m_vertexBufferView);
-  m_cl->IASetIndexBuffer(&object.model.m_indexBufferView);
 
   CD3DX12_RESOURCE_BARRIER shadowMapResourceBarrier = CD3DX12_RESOURCE_BARRIER::Transition(
       m_shadowMap.GetResource(), D3D12_RESOURCE_STATE_DEPTH_WRITE, D3D12_RESOURCE_STATE_GENERIC_READ);
@@ -288,24 +322,24 @@ void D3D12Renderer::Townscaper_RunColorPass(const PinholeCamera& camera,
   m_cl->SetGraphicsRootDescriptorTable(3, textureSRVDescriptor.gpuStart);
 
   m_cl->SetPipelineState(m_townscaperPSOs.m_psoBuildings.Get());
-  DrawMeshPart(m_cl.Get(), object.model.m_meshParts[TownscaperMeshID::Buildings]);
+  object.model.DrawMeshPart(m_cl.Get(), TownscaperMeshID::Buildings);
 
   m_cl->SetPipelineState(m_townscaperPSOs.m_psoWindows_Stencil.Get());
-  DrawMeshPart(m_cl.Get(), object.model.m_meshParts[TownscaperMeshID::Windows]);
+  object.model.DrawMeshPart(m_cl.Get(), TownscaperMeshID::Windows);
 
   m_cl->OMSetStencilRef(1);
   m_cl->SetPipelineState(m_townscaperPSOs.m_psoWindows_MaxDepth.Get());
-  DrawMeshPart(m_cl.Get(), object.model.m_meshParts[TownscaperMeshID::Windows]);
+  object.model.DrawMeshPart(m_cl.Get(), TownscaperMeshID::Windows);
   m_cl->SetPipelineState(m_townscaperPSOs.m_psoWindows_MinDepth_Color.Get());
-  DrawMeshPart(m_cl.Get(), object.model.m_meshParts[TownscaperMeshID::Windows]);
+  object.model.DrawMeshPart(m_cl.Get(), TownscaperMeshID::Windows);
 
   m_cl->SetPipelineState(m_townscaperPSOs.m_psoGenericColor.Get());
-  DrawMeshPart(m_cl.Get(), object.model.m_meshParts[TownscaperMeshID::Birds]);
-  DrawMeshPart(m_cl.Get(), object.model.m_meshParts[TownscaperMeshID::Fencing]);
-  DrawMeshPart(m_cl.Get(), object.model.m_meshParts[TownscaperMeshID::Plants]);
-  DrawMeshPart(m_cl.Get(), object.model.m_meshParts[TownscaperMeshID::Props]);
-  DrawMeshPart(m_cl.Get(), object.model.m_meshParts[TownscaperMeshID::Sand]);
-  DrawMeshPart(m_cl.Get(), object.model.m_meshParts[TownscaperMeshID::Water]);
+  object.model.DrawMeshPart(m_cl.Get(), TownscaperMeshID::Birds);
+  object.model.DrawMeshPart(m_cl.Get(), TownscaperMeshID::Fencing);
+  object.model.DrawMeshPart(m_cl.Get(), TownscaperMeshID::Plants);
+  object.model.DrawMeshPart(m_cl.Get(), TownscaperMeshID::Props);
+  object.model.DrawMeshPart(m_cl.Get(), TownscaperMeshID::Sand);
+  object.model.DrawMeshPart(m_cl.Get(), TownscaperMeshID::Water);
 
   shadowMapResourceBarrier = CD3DX12_RESOURCE_BARRIER::Transition(
       m_shadowMap.GetResource(), D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_RESOURCE_STATE_DEPTH_WRITE);
@@ -313,23 +347,12 @@ void D3D12Renderer::Townscaper_RunColorPass(const PinholeCamera& camera,
 }
 
 // Expects that the shadow map resource is in D3D12_RESOURCE_STATE_DEPTH_WRITE.
-void D3D12Renderer::RunShadowPass(const OrthographicCamera& shadowMapCamera, const Object& object) {
-  m_cl->SetPipelineState(m_shadowMapPass.GetPipelineState());
-  m_cl->SetGraphicsRootSignature(m_shadowMapPass.GetRootSignature());
-
-  // Set up the constant buffer for the per-frame data.
-  ShadowMapPass::PerFrameData perFrameData;
-  perFrameData.projectionViewTransform = shadowMapCamera.GenerateViewPerspectiveTransform4x4();
-  D3D12_GPU_VIRTUAL_ADDRESS shadowMapPerFrameBuffer =
-      m_constantBufferAllocator.AllocateAndUpload(sizeof(ShadowMapPass::PerFrameData), &perFrameData, m_nextFenceValue);
-  m_cl->SetGraphicsRootConstantBufferView(/*rootParameterIndex*/ 0, shadowMapPerFrameBuffer);
+void D3D12Renderer::RunShadowPass(ShadowCascades* cascades, const Scene& scene) {
+  if (std::all_of(std::begin(cascades->isUpToDate), std::end(cascades->isUpToDate), [](bool b) { return b; }))
+    return;
 
-  // Set up the constant buffer for the per-object data.
-  ShadowMapPass::PerObjectData perObjectData;
-  perObjectData.worldTransform = object.GenerateModelTransform4x4();
-  D3D12_GPU_VIRTUAL_ADDRESS shadowMapPerObjectBuffer = m_constantBufferAllocator.AllocateAndUpload(
-      sizeof(ShadowMapPass::PerObjectData), &perObjectData, m_nextFenceValue);
-  m_cl->SetGraphicsRootConstantBufferView(/*rootParameterIndex*/ 1, shadowMapPerObjectBuffer);
+  m_shadowPassTimer.Start(m_cl.Get());
+  m_cl->SetGraphicsRootSignature(m_shadowMapPass.GetRootSignature());
 
   unsigned int shadowMapWidth = m_shadowMap.GetWidth();
   unsigned int shadowMapHeight = m_shadowMap.GetHeight();
@@ -338,57 +361,202 @@ void D3D12Renderer::RunShadowPass(const OrthographicCamera& shadowMapCamera, con
   CD3DX12_RECT shadowMapScissorRect(0, 0, shadowMapWidth, shadowMapHeight);
   m_cl->RSSetViewports(1, &shadowMapClientAreaViewport);
   m_cl->RSSetScissorRects(1, &shadowMapScissorRect);
-
-  D3D12_CPU_DESCRIPTOR_HANDLE shadowMapDSVHandle = m_shadowMap.GetDSVDescriptorHandle();
-  m_cl->OMSetRenderTargets(0, nullptr, FALSE, &shadowMapDSVHandle);
-  m_cl->ClearDepthStencilView(shadowMapDSVHandle, D3D12_CLEAR_FLAG_DEPTH, 1.f, 0, 0, nullptr);
   m_cl->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
-  m_cl->IASetVertexBuffers(0, 1, &object.model.m_vertexBufferView);
-  m_cl->IASetIndexBuffer(&object.model.m_indexBufferView);
+  const SceneInstances& instances = scene.m_instances;
+  for (unsigned int cascade = 0; cascade < ShadowCascades::kNumCascades; ++cascade) {
+    // The cascade's shadow map is kept from the last time it was drawn.
+    if (cascades->isUpToDate[cascade])
+      continue;
+    cascades->isUpToDate[cascade] = true;
+    ++m_numShadowCascadesDrawn;
+
+    // Set up the constant buffer for the per-frame data.
+    const OrthographicCamera& shadowMapCamera = cascades->cameras[cascade];
+    ShadowMapPass::PerFrameData perFrameData;
+    perFrameData.projectionViewTransform = shadowMapCamera.GenerateViewPerspectiveTransform4x4();
+    D3D12_GPU_VIRTUAL_ADDRESS shadowMapPerFrameBuffer = m_constantBufferAllocator.AllocateAndUpload(
+        sizeof(ShadowMapPass::PerFrameData), &perFrameData, m_nextFenceValue);
+    m_cl->SetGraphicsRootConstantBufferView(/*rootParameterIndex*/ 0, shadowMapPerFrameBuffer);
+
+    D3D12_CPU_DESCRIPTOR_HANDLE shadowMapDSVHandle = m_shadowMap.GetDSVDescriptorHandle(cascade);
+    m_cl->OMSetRenderTargets(0, nullptr, FALSE, &shadowMapDSVHandle);
+    m_cl->ClearDepthStencilView(shadowMapDSVHandle, D3D12_CLEAR_FLAG_DEPTH, 1.f, 0, 0, nullptr);
+
+    auto getMaxLodError = [&](const Object& object, size_t instance) {
+      return object.GetMaxLodError(shadowMapCamera, instances.scales[instance], static_cast<float>(shadowMapHeight),
+                                   kMaxLodPixelError);
+    };
+    BatchInstances(shadowMapCamera.GenerateViewPerspectiveTransform(), scene, getMaxLodError, &m_shadowPassCulling);
+    BindInstanceData();
+
+    ID3D12PipelineState* boundPipelineState = nullptr;
+    for (const InstanceBatch& batch : m_instanceBatches) {
+      const Model& model = scene.m_objects[batch.objectIndex]->model;
+      ID3D12PipelineState* pipelineState = m_shadowMapPass.GetPipelineState(model.m_hasQuantizedVertices);
+      if (pipelineState != boundPipelineState) {
+        m_cl->SetPipelineState(pipelineState);
+        boundPipelineState = pipelineState;
+      }
+      m_cl->IASetVertexBuffers(0, 1, &model.m_vertexBufferView);
+
+      for (uint32_t i = batch.firstMeshPart; i < batch.firstMeshPart + batch.numMeshParts; ++i) {
+        // TODO: Eventually we will want to reference the texture in the shadow pass, so that we can
+        //       accurately clip pixels that are fully transparent.
+        model.DrawMeshPart(m_cl.Get(), m_drawList[i], batch.maxLodError, batch.numInstances, batch.firstInstance);
+      }
+    }
+  }
+  m_shadowPassTimer.Stop(m_cl.Get());
+}
+
+void D3D12Renderer::BatchInstances(const DirectX::XMMATRIX& viewProjection,
+                                   const Scene& scene,
+                                   const std::function<float(const Object&, size_t)>& getMaxLodError,
+                                   CullingStatistics* statistics) {
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  const SceneInstances& instances = scene.m_instances;
+
+  // The instances' bounds are in world space. Sorting the ones in view by object puts each batch's together.
+  DirectX::XMFLOAT4X4 transform;
+  DirectX::XMStoreFloat4x4(&transform, viewProjection);
+  m_batchedInstances.clear();
+  instances.hierarchy.Cull(FrustumCulling::ExtractFrustum(transform.m), &m_batchedInstances);
+  std::sort(m_batchedInstances.begin(), m_batchedInstances.end(), [&instances](uint32_t a, uint32_t b) {
+    const uint32_t objectA = instances.objectIndices[a];
+    const uint32_t objectB = instances.objectIndices[b];
+    return (objectA != objectB) ? objectA < objectB : a < b;
+  });
+
+  m_instanceBatches.clear();
+  m_drawList.clear();
+  for (size_t first = 0; first < m_batchedInstances.size();) {
+    const uint32_t objectIndex = instances.objectIndices[m_batchedInstances[first]];
+    size_t end = first + 1;
+    while (end < m_batchedInstances.size() && instances.objectIndices[m_batchedInstances[end]] == objectIndex)
+      ++end;
+
+    const Object& object = *scene.m_objects[objectIndex];
+    const Model& model = object.model;
+    InstanceBatch batch = {};
+    batch.objectIndex = objectIndex;
+    batch.firstInstance = static_cast<uint32_t>(first);
+    batch.numInstances = static_cast<uint32_t>(end - first);
+    batch.firstMeshPart = static_cast<uint32_t>(m_drawList.size());
+    batch.maxLodError = std::numeric_limits<float>::infinity();
+
+    // The parts' bounds are in the model's own space, before its positions were quantized, so they're culled once for
+    // each instance. A part is drawn for all of the batch's instances as soon as any one of them can see it.
+    const DirectX::XMMATRIX modelTransform = object.GenerateModelTransform();
+    m_isMeshPartBatched.assign(model.m_meshParts.size(), 0);
+    size_t numBatchedMeshParts = 0;
+    for (size_t i = first; i < end; ++i) {
+      const uint32_t instance = m_batchedInstances[i];
+      batch.maxLodError = (std::min)(batch.maxLodError, getMaxLodError(object, instance));
+      if (numBatchedMeshParts == model.m_meshParts.size())
+        continue;
+
+      DirectX::XMStoreFloat4x4(&transform,
+                               modelTransform * instances.GeneratePlacementTransform(instance) * viewProjection);
+      model.CullMeshParts(FrustumCulling::ExtractFrustum(transform.m), &m_culledMeshParts);
+      for (uint32_t meshPartIndex : m_culledMeshParts) {
+        if (!m_isMeshPartBatched[meshPartIndex]) {
+          m_isMeshPartBatched[meshPartIndex] = 1;
+          ++numBatchedMeshParts;
+        }
+      }
+    }
+
+    for (uint32_t meshPartIndex : model.m_meshPartDrawOrder) {
+      if (m_isMeshPartBatched[meshPartIndex])
+        m_drawList.push_back(meshPartIndex);
+    }
+    batch.numMeshParts = static_cast<uint32_t>(m_drawList.size()) - batch.firstMeshPart;
+    m_instanceBatches.push_back(batch);
+    first = end;
+  }
 
-  for (const auto& meshPart : object.model.m_meshParts) {
-    // TODO: Eventually we will want to reference the texture in the shadow pass, so that we can
-    //       accurately clip pixels that are fully transparent.
-    m_cl->DrawIndexedInstanced(meshPart.numIndices, /*instanceCount*/ 1, meshPart.indexStart, /*baseVertexLocation*/ 0,
-                               /*startInstanceLocation*/ 0);
+  // In the same order as m_batchedInstances, so that each batch's instances are next to each other.
+  m_instanceData.resize(m_batchedInstances.size());
+  for (size_t i = 0; i < m_batchedInstances.size(); ++i)
+    m_instanceData[i] = instances.drawTransforms[m_batchedInstances[i]];
+
+  if (!m_printCullingStatistics)
+    return;
+
+  statistics->seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  statistics->numInstances += instances.GetCount();
+  statistics->numVisibleInstances += m_batchedInstances.size();
+  for (const InstanceBatch& batch : m_instanceBatches) {
+    const Model& model = scene.m_objects[batch.objectIndex]->model;
+    statistics->numMeshParts += batch.numInstances * model.m_meshParts.size();
+    statistics->numVisibleMeshParts += batch.numInstances * batch.numMeshParts;
+    for (const ObjFileData::MeshPart& meshPart : model.m_meshParts)
+      statistics->numTriangles += batch.numInstances * (meshPart.numIndices / 3);
+    for (uint32_t i = batch.firstMeshPart; i < batch.firstMeshPart + batch.numMeshParts; ++i)
+      statistics->numVisibleTriangles += batch.numInstances * (model.m_meshParts[m_drawList[i]].numIndices / 3);
+    statistics->numDraws += batch.numMeshParts;
   }
 }
 
+void D3D12Renderer::BindInstanceData() {
+  if (m_instanceData.empty())
+    return;
+
+  // Buffers on the upload heap can be read by the GPU directly, so the data isn't copied anywhere else.
+  const size_t sizeInBytes = m_instanceData.size() * sizeof(SceneInstances::DrawTransforms);
+  D3D12_VERTEX_BUFFER_VIEW instanceBufferView = {
+      m_instanceDataBuffer.AllocateAndUpload(sizeInBytes, m_instanceData.data(), kInstanceDataAlignment,
+                                             m_nextFenceValue),
+      static_cast<UINT>(sizeInBytes), sizeof(SceneInstances::DrawTransforms)};
+  m_cl->IASetVertexBuffers(GraphicsPass::kInstanceInputSlot, 1, &instanceBufferView);
+}
+
+void D3D12Renderer::PrintCullingStatistics() {
+  const double frames = static_cast<double>(m_numCulledFrames);
+  auto print = [frames](const char* passName, const CullingStatistics& statistics) {
+    std::cout << "  " << passName << " pass: drew "
+              << 100.0 * statistics.numVisibleInstances / std::max<size_t>(statistics.numInstances, 1)
+              << "% of the instances, and "
+              << 100.0 * statistics.numVisibleMeshParts / std::max<size_t>(statistics.numMeshParts, 1)
+              << "% of their mesh parts ("
+              << 100.0 * statistics.numVisibleTriangles / std::max<size_t>(statistics.numTriangles, 1)
+              << "% of their triangles) in " << statistics.numDraws / frames << " draws per frame, culled in "
+              << 1e6 * statistics.seconds / frames << " us per frame" << std::endl;
+  };
+
+  std::cout << "Culling over the last " << m_numCulledFrames << " frames:" << std::endl;
+  print("Shadow", m_shadowPassCulling);
+  print("Color", m_colorPassCulling);
+  std::cout << "  Drew " << m_numShadowCascadesDrawn << " of " << m_numCulledFrames * ShadowCascades::kNumCascades
+            << " shadow cascades (the rest hadn't changed), in " << 1e6 * m_shadowPassTimer.GetTotalSeconds() / frames
+            << " us of GPU time per frame" << std::endl;
+  m_shadowPassCulling = {};
+  m_colorPassCulling = {};
+  m_numShadowCascadesDrawn = 0;
+  m_shadowPassTimer.ResetTotal();
+  m_numCulledFrames = 0;
+}
+
 // Expects that the shadow map resouce is in D3D12_RESOURCE_STATE_DEPTH_WRITE.
-void D3D12Renderer::RunColorPass(const PinholeCamera& camera,
-                                 const OrthographicCamera& shadowMapCamera,
-                                 const Object& object) {
+void D3D12Renderer::RunColorPass(const PinholeCamera& camera, const ShadowCascades& cascades, const Scene& scene) {
   D3D12_CPU_DESCRIPTOR_HANDLE rtvHandle = m_renderTarget.GetRTVDescriptorHandle();
   D3D12_CPU_DESCRIPTOR_HANDLE dsvHandle = m_depthBuffer.GetDSVDescriptorHandle();
 
-  m_cl->SetPipelineState(m_colorPass.GetPipelineState());
   m_cl->SetGraphicsRootSignature(m_colorPass.GetRootSignature());
 
   // Set up the constant buffer for the per-frame data.
   ColorPass::PerFrameData perFrameData;
   perFrameData.projectionViewTransform = camera.GenerateViewPerspectiveTransform4x4(m_window.GetAspectRatio());
-  perFrameData.shadowMapProjectionViewTransform = shadowMapCamera.GenerateViewPerspectiveTransform4x4();
-  perFrameData.lightDirection = shadowMapCamera.GetLightDirection();
+  for (unsigned int i = 0; i < ShadowCascades::kNumCascades; ++i)
+    perFrameData.shadowMapProjectionViewTransforms[i] = cascades.cameras[i].GenerateViewPerspectiveTransform4x4();
+  perFrameData.cascadeSplitDepths = DirectX::XMFLOAT4(cascades.splitDepths);
+  // The cascades all have the same light direction.
+  perFrameData.lightDirection = cascades.cameras[0].GetLightDirection();
   D3D12_GPU_VIRTUAL_ADDRESS colorPassPerFrameConstantBuffer =
       m_constantBufferAllocator.AllocateAndUpload(sizeof(ColorPass::PerFrameData), &perFrameData, m_nextFenceValue);
   m_cl->SetGraphicsRootConstantBufferView(/*rootParameterIndex*/ 0, colorPassPerFrameConstantBuffer);
 
-  DirectX::XMMATRIX modelTransform = object.GenerateModelTransform();
-  DirectX::XMMATRIX modelTransformModified = modelTransform;
-  modelTransformModified.r[3] = DirectX::XMVectorSet(0.f, 0.f, 0.f, 1.f);
-  DirectX::XMMATRIX modelTransformInverseTranspose =
-      DirectX::XMMatrixTranspose(DirectX::XMMatrixInverse(nullptr, modelTransformModified));
-
-  // Set up the constant buffer for the per-object data.
-  // TODO: we only need 3x3 for the inverse transpose matrix; we should use XMStoreFloat3x3 instead.
-  ColorPass::PerObjectData perObjectData;
-  DirectX::XMStoreFloat4x4(&perObjectData.modelTransform, modelTransform);
-  DirectX::XMStoreFloat4x4(&perObjectData.modelTransformInverseTranspose, modelTransformInverseTranspose);
-  D3D12_GPU_VIRTUAL_ADDRESS colorPassPerObjectBuffer =
-      m_constantBufferAllocator.AllocateAndUpload(sizeof(ColorPass::PerObjectData), &perObjectData, m_nextFenceValue);
-  m_cl->SetGraphicsRootConstantBufferView(/*rootParameterIndex*/ 1, colorPassPerObjectBuffer);
-
   // Set up other necessary state.
   unsigned int width = m_window.GetWidth();
   unsigned int height = m_window.GetHeight();
@@ -403,9 +571,6 @@ void D3D12Renderer::RunColorPass(const PinholeCamera& camera,
   m_cl->ClearDepthStencilView(dsvHandle, D3D12_CLEAR_FLAG_DEPTH, 1.f, 0, 0, nullptr);
   m_cl->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
-  m_cl->IASetVertexBuffers(0, 1, &object.model.m_vertexBufferView);
-  m_cl->IASetIndexBuffer(&object.model.m_indexBufferView);
-
   CD3DX12_RESOURCE_BARRIER shadowMapResourceBarrier = CD3DX12_RESOURCE_BARRIER::Transition(
       m_shadowMap.GetResource(), D3D12_RESOURCE_STATE_DEPTH_WRITE, D3D12_RESOURCE_STATE_GENERIC_READ);
   m_cl->ResourceBarrier(1, &shadowMapResourceBarrier);
@@ -419,18 +584,47 @@ void D3D12Renderer::RunColorPass(const PinholeCamera& camera,
   m_device->CopyDescriptorsSimple(1, shadowMapSRVDescriptor.cpuStart, m_shadowMap.GetSRVDescriptorHandle(),
                                   D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
 
-  m_cl->SetGraphicsRootDescriptorTable(2, shadowMapSRVDescriptor.gpuStart);
+  m_cl->SetGraphicsRootDescriptorTable(1, shadowMapSRVDescriptor.gpuStart);
 
-  for (const auto& meshPart : object.model.m_meshParts) {
-    DescriptorAllocation textureSRVDescriptor =
-        m_circularSRVDescriptorAllocator.AllocateSingleDescriptor(m_nextFenceValue);
-
-    const Model::Material& material = object.model.m_materials[meshPart.materialIndex];
-    m_device->CopyDescriptorsSimple(1, textureSRVDescriptor.cpuStart, material.m_srvDescriptor.cpuStart,
-                                    D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
-    m_cl->SetGraphicsRootDescriptorTable(3, textureSRVDescriptor.gpuStart);
-    m_cl->DrawIndexedInstanced(meshPart.numIndices, /*instanceCount*/ 1, meshPart.indexStart, /*baseVertexLocation*/ 0,
-                               /*startInstanceLocation*/ 0);
+  const SceneInstances& instances = scene.m_instances;
+  auto getMaxLodError = [&](const Object& object, size_t instance) {
+    return object.GetMaxLodError(camera, instances.GeneratePlacementTransform(instance), instances.scales[instance],
+                                 static_cast<float>(height), kMaxLodPixelError);
+  };
+  BatchInstances(camera.GenerateViewPerspectiveTransform(m_window.GetAspectRatio()), scene, getMaxLodError,
+                 &m_colorPassCulling);
+  BindInstanceData();
+
+  // Each batch's parts are drawn grouped by texture, so the texture only has to be bound again when it changes.
+  ID3D12PipelineState* boundPipelineState = nullptr;
+  const Model::Material* boundMaterial = nullptr;
+  for (const InstanceBatch& batch : m_instanceBatches) {
+    const Model& model = scene.m_objects[batch.objectIndex]->model;
+    ID3D12PipelineState* pipelineState = m_colorPass.GetPipelineState(model.m_hasQuantizedVertices);
+    if (pipelineState != boundPipelineState) {
+      m_cl->SetPipelineState(pipelineState);
+      boundPipelineState = pipelineState;
+    }
+    m_cl->IASetVertexBuffers(0, 1, &model.m_vertexBufferView);
+
+    for (uint32_t i = batch.firstMeshPart; i < batch.firstMeshPart + batch.numMeshParts; ++i) {
+      // The part shows up once its texture has finished loading.
+      const uint32_t meshPartIndex = m_drawList[i];
+      const Model::Material& material = model.m_materials[model.m_meshParts[meshPartIndex].materialIndex];
+      if (material.m_isPending)
+        continue;
+
+      if (!boundMaterial || boundMaterial->m_srvDescriptor.cpuStart.ptr != material.m_srvDescriptor.cpuStart.ptr) {
+        DescriptorAllocation textureSRVDescriptor =
+            m_circularSRVDescriptorAllocator.AllocateSingleDescriptor(m_nextFenceValue);
+
+        m_device->CopyDescriptorsSimple(1, textureSRVDescriptor.cpuStart, material.m_srvDescriptor.cpuStart,
+                                        D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+        m_cl->SetGraphicsRootDescriptorTable(2, textureSRVDescriptor.gpuStart);
+        boundMaterial = &material;
+      }
+      model.DrawMeshPart(m_cl.Get(), meshPartIndex, batch.maxLodError, batch.numInstances, batch.firstInstance);
+    }
   }
 
   shadowMapResourceBarrier = CD3DX12_RESOURCE_BARRIER::Transition(
@@ -438,6 +632,11 @@ void D3D12Renderer::RunColorPass(const PinholeCamera& camera,
   m_cl->ResourceBarrier(1, &shadowMapResourceBarrier);
 }
 
+void D3D12Renderer::ClearRenderTarget() {
+  float clearColor[4] = {0.1f, 0.2f, 0.3f, 1.0f};
+  m_cl->ClearRenderTargetView(m_renderTarget.GetRTVDescriptorHandle(), clearColor, 0, nullptr);
+}
+
 void D3D12Renderer::SignalAndPresent() {
   HR(m_directCommandQueue->Signal(m_fence.Get(), m_nextFenceValue));
   ++m_nextFenceValue;
@@ -449,7 +648,9 @@ void D3D12Renderer::WaitForNextFrame() {
   m_window.WaitForNextFrame();
   m_garbageCollector.Cleanup(m_fence->GetCompletedValue());
   m_constantBufferAllocator.Cleanup(m_fence->GetCompletedValue());
+  m_instanceDataBuffer.Cleanup(m_fence->GetCompletedValue());
   m_circularSRVDescriptorAllocator.Cleanup(m_fence->GetCompletedValue());
+  m_shadowPassTimer.Collect(m_fence->GetCompletedValue());
 }
 
 void D3D12Renderer::FlushGPUWork() {
@@ -464,6 +665,7 @@ void D3D12Renderer::FlushGPUWork() {
 
   m_garbageCollector.Cleanup(m_fence->GetCompletedValue());
   m_constantBufferAllocator.Cleanup(m_fence->GetCompletedValue());
+  m_instanceDataBuffer.Cleanup(m_fence->GetCompletedValue());
 }
 
 ComPtr<ID3D12Resource> D3D12Renderer::AllocateAndUploadBufferData(const void* data, size_t sizeInBytes) {
@@ -487,17 +689,17 @@ ComPtr<ID3D12Resource> D3D12Renderer::AllocateAndUploadBufferData(const void* da
 }
 
 Microsoft::WRL::ComPtr<ID3D12Resource> D3D12Renderer::AllocateAndUploadTextureData(
-    const void* textureData,
     DXGI_FORMAT format,
-    size_t bytesPerPixel,
     size_t width,
     size_t height,
+    size_t numMips,
+    const D3D12_SUBRESOURCE_DATA* mips,
     /*out*/ DescriptorAllocation* srvDescriptor) {
   ComPtr<ID3D12Resource> texture;
 
   CD3DX12_HEAP_PROPERTIES defaultHeapProperties(D3D12_HEAP_TYPE_DEFAULT);
-  CD3DX12_RESOURCE_DESC textureResourceDesc =
-      CD3DX12_RESOURCE_DESC::Tex2D(format, width, height, /*arraySize*/ 1, /*mipLevels*/ 1);
+  CD3DX12_RESOURCE_DESC textureResourceDesc = CD3DX12_RESOURCE_DESC::Tex2D(
+      format, width, height, /*arraySize*/ 1, /*mipLevels*/ static_cast<UINT16>(numMips));
 
   HR(m_device->CreateCommittedResource(&defaultHeapProperties, D3D12_HEAP_FLAG_NONE, &textureResourceDesc,
                                        D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&texture)));
@@ -505,17 +707,14 @@ Microsoft::WRL::ComPtr<ID3D12Resource> D3D12Renderer::AllocateAndUploadTextureDa
   ComPtr<ID3D12Resource> intermediateTextureBuffer =
       ResourceHelper::AllocateIntermediateBuffer(m_device.Get(), texture.Get(), m_garbageCollector, m_nextFenceValue);
 
-  D3D12_SUBRESOURCE_DATA textureSubresourceData;
-  textureSubresourceData.pData = textureData;
-  textureSubresourceData.RowPitch = bytesPerPixel * width;
-  textureSubresourceData.SlicePitch = bytesPerPixel * width * height;
-  UpdateSubresources(m_cl.Get(), texture.Get(), intermediateTextureBuffer.Get(), 0, 0, 1, &textureSubresourceData);
+  UpdateSubresources(m_cl.Get(), texture.Get(), intermediateTextureBuffer.Get(), 0, 0, static_cast<UINT>(numMips),
+                     mips);
 
   D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc;
   srvDesc.Format = format;
   srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
   srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-  srvDesc.Texture2D.MipLevels = 1;
+  srvDesc.Texture2D.MipLevels = static_cast<UINT>(numMips);
   srvDesc.Texture2D.MostDetailedMip = 0;
   srvDesc.Texture2D.PlaneSlice = 0;
   srvDesc.Texture2D.ResourceMinLODClamp = 0;
@@ -542,3 +741,32 @@ void D3D12Renderer::FinalizeResourceUpload() {
 
   FlushGPUWork();
 }
+
+ComPtr<ID3D12Resource> D3D12Renderer::AllocateBuffer(size_t sizeInBytes) {
+  ComPtr<ID3D12Resource> buffer;
+
+  CD3DX12_HEAP_PROPERTIES defaultHeapProperties(D3D12_HEAP_TYPE_DEFAULT);
+  CD3DX12_RESOURCE_DESC bufferResourceDesc = CD3DX12_RESOURCE_DESC::Buffer(sizeInBytes);
+  HR(m_device->CreateCommittedResource(&defaultHeapProperties, D3D12_HEAP_FLAG_NONE, &bufferResourceDesc,
+                                       D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&buffer)));
+
+  return buffer;
+}
+
+// Expects that |buffer| is in D3D12_RESOURCE_STATE_COPY_DEST.
+void D3D12Renderer::UploadBufferRegion(ID3D12Resource* buffer, size_t offset, const void* data, size_t sizeInBytes) {
+  ComPtr<ID3D12Resource> uploadBuffer = ResourceHelper::AllocateBuffer(m_device.Get(), sizeInBytes);
+  ResourceHelper::UpdateBuffer(uploadBuffer.Get(), const_cast<void*>(data), sizeInBytes);
+  m_garbageCollector.MarkAsGarbage(uploadBuffer, m_nextFenceValue);
+
+  m_cl->CopyBufferRegion(buffer, offset, uploadBuffer.Get(), 0, sizeInBytes);
+}
+
+// Expects that |destination| is in D3D12_RESOURCE_STATE_COPY_DEST, and |source| in D3D12_RESOURCE_STATE_COPY_SOURCE.
+void D3D12Renderer::CopyBufferRegion(ID3D12Resource* destination, ID3D12Resource* source, size_t sizeInBytes) {
+  m_cl->CopyBufferRegion(destination, 0, source, 0, sizeInBytes);
+}
+
+void D3D12Renderer::ReleaseAfterCurrentFrame(ComPtr<ID3D12Resource> resource) {
+  m_garbageCollector.MarkAsGarbage(std::move(resource), m_nextFenceValue);
+}
@@ -8,12 +8,17 @@
 #include "d3d12/Camera.h"
 #include "d3d12/ConstantBufferAllocator.h"
 #include "d3d12/DescriptorHeapManagers.h"
+#include "d3d12/GpuTimer.h"
 #include "d3d12/Pass.h"
 #include "d3d12/ResourceGarbageCollector.h"
 #include "d3d12/Scene.h"
 #include "d3d12/TextureResources.h"
+#include "d3d12/UploadRingBuffer.h"
 #include "d3d12/WindowSwapChain.h"
 
+#include <functional>
+#include <vector>
+
 class D3D12Renderer {
   // Per-device data.
   Microsoft::WRL::ComPtr<IDXGIFactory4> m_factory;
@@ -29,6 +34,9 @@ class D3D12Renderer {
   LinearDescriptorAllocator m_linearRTVDescriptorAllocator;
   CircularBufferDescriptorAllocator m_circularSRVDescriptorAllocator;
 
+  // The passes' per-instance vertex data (see BindInstanceData).
+  UploadRingBuffer m_instanceDataBuffer;
+
   // Window-size dependent resources.
   WindowSwapChain m_window;
   RenderTargetTexture m_renderTarget;
@@ -50,6 +58,53 @@ class D3D12Renderer {
 
   // Rendering controls.
   bool m_isTownscaper;
+  bool m_useQuantizedVertices;
+  bool m_printCullingStatistics;
+
+  // The instances that survive culling, for the pass that's being recorded, batched by object (see BatchInstances).
+  // Each of a batch's mesh parts is drawn for all of its instances at once, with a single instanced draw.
+  struct InstanceBatch {
+    uint32_t objectIndex;
+    // Into m_batchedInstances and m_instanceData.
+    uint32_t firstInstance;
+    uint32_t numInstances;
+    // Into m_drawList.
+    uint32_t firstMeshPart;
+    uint32_t numMeshParts;
+    // For the nearest of the instances.
+    float maxLodError;
+  };
+
+  // Kept around so that they don't have to be allocated every frame.
+  std::vector<InstanceBatch> m_instanceBatches;
+  std::vector<uint32_t> m_batchedInstances;
+  std::vector<SceneInstances::DrawTransforms> m_instanceData;
+  // The batches' mesh parts, each batch's in the order they're to be drawn in.
+  std::vector<uint32_t> m_drawList;
+  std::vector<uint32_t> m_culledMeshParts;
+  std::vector<uint8_t> m_isMeshPartBatched;
+
+  // Summed up over the frames since they were last printed (see PrintCullingStatistics), and only gathered at all with
+  // m_printCullingStatistics. The mesh parts and triangles are those of the instances that are in view, counted once
+  // for each instance; the triangles at full detail.
+  struct CullingStatistics {
+    size_t numInstances = 0;
+    size_t numVisibleInstances = 0;
+    size_t numMeshParts = 0;
+    size_t numVisibleMeshParts = 0;
+    size_t numTriangles = 0;
+    size_t numVisibleTriangles = 0;
+    size_t numDraws = 0;  // One for each mesh part of each batch.
+    double seconds = 0.0;
+  };
+  CullingStatistics m_colorPassCulling;
+  CullingStatistics m_shadowPassCulling;
+  size_t m_numShadowCascadesDrawn = 0;
+  size_t m_numCulledFrames = 0;
+
+  // Times the shadow pass on the GPU. Frames on which all of the cascades are up to date don't have a shadow pass at
+  // all, so they count as taking no time.
+  GpuTimer m_shadowPassTimer;
 
   // Note: InitializePerDeviceObjects must be called before the others.
   void InitializePerDeviceObjects();
@@ -74,14 +129,35 @@ class D3D12Renderer {
                                const OrthographicCamera& shadowMapCamera,
                                const Object& object);
 
-  void RunShadowPass(const OrthographicCamera& shadowCamera, const Object& object);
-  void RunColorPass(const PinholeCamera& camera, const OrthographicCamera& shadowCamera, const Object& object);
+  // Fills m_instanceBatches (and everything they refer to) with the scene's instances that are in view of
+  // |viewProjection|, and the mesh parts that are in view of any of them; the level of detail is picked by
+  // |getMaxLodError|, given an object and one of its instances.
+  void BatchInstances(const DirectX::XMMATRIX& viewProjection,
+                      const Scene& scene,
+                      const std::function<float(const Object&, size_t)>& getMaxLodError,
+                      CullingStatistics* statistics);
+  // Uploads m_instanceData into m_instanceDataBuffer, and binds it for the batches' draws.
+  void BindInstanceData();
+  void PrintCullingStatistics();
+
+  // Draws each cascade that isn't up to date into its slice of the shadow map, and marks it as up to date.
+  void RunShadowPass(ShadowCascades* cascades, const Scene& scene);
+  void RunColorPass(const PinholeCamera& camera, const ShadowCascades& cascades, const Scene& scene);
+  void ClearRenderTarget();
 
 public:
-  void Initialize(HWND hwnd, bool isTownscaper);
+  // With |useQuantizedVertices|, models are drawn from packed vertices once they've been fully loaded (see
+  // VertexQuantization). With |printCullingStatistics|, how much culling saved is printed every so many frames.
+  void Initialize(HWND hwnd, bool isTownscaper, bool useQuantizedVertices, bool printCullingStatistics);
+  bool UsesQuantizedVertices() const { return m_useQuantizedVertices; }
+  // Townscaper models are drawn part by part, by the parts' order in the file (see TownscaperMeshID).
+  bool IsTownscaper() const { return m_isTownscaper; }
   void HandleResize(unsigned int width, unsigned int height);
 
   void DrawScene(Scene& scene);
+  // How long the shadow pass took on the GPU, on the latest frame that the GPU has finished. It's zero as long as
+  // nothing that the shadows depend on changes.
+  double GetShadowPassGpuSeconds() const { return m_shadowPassTimer.GetLastSeconds(); }
   void WaitForNextFrame();
   void SignalAndPresent();
   void FlushGPUWork();
@@ -89,13 +165,22 @@ public:
   // Used for scene initialization.
   // TODO: This is all still pretty sloppy. Need to clean it up somehow.
   Microsoft::WRL::ComPtr<ID3D12Resource> AllocateAndUploadBufferData(const void* data, size_t sizeInBytes);
-  Microsoft::WRL::ComPtr<ID3D12Resource> AllocateAndUploadTextureData(const void* textureData,
-                                                                      DXGI_FORMAT format,
-                                                                      size_t bytesPerPixel,
+  // |mips| holds |numMips| levels, largest first. Their rows are rows of pixels, or rows of 4x4 blocks for
+  // block-compressed formats.
+  Microsoft::WRL::ComPtr<ID3D12Resource> AllocateAndUploadTextureData(DXGI_FORMAT format,
                                                                       size_t width,
                                                                       size_t height,
+                                                                      size_t numMips,
+                                                                      const D3D12_SUBRESOURCE_DATA* mips,
                                                                       /*out*/ DescriptorAllocation* srvDescriptor);
   void ExecuteBarriers(size_t numBarriers, const D3D12_RESOURCE_BARRIER* barriers);
   void BeginResourceUpload();
   void FinalizeResourceUpload();
+
+  // Used for streaming data into the scene while it's being drawn. Unlike the functions above, these don't flush; the
+  // commands are recorded onto the current frame's command list, so they may only be called from within DrawScene.
+  Microsoft::WRL::ComPtr<ID3D12Resource> AllocateBuffer(size_t sizeInBytes);  // Starts out in the COPY_DEST state.
+  void UploadBufferRegion(ID3D12Resource* buffer, size_t offset, const void* data, size_t sizeInBytes);
+  void CopyBufferRegion(ID3D12Resource* destination, ID3D12Resource* source, size_t sizeInBytes);
+  void ReleaseAfterCurrentFrame(Microsoft::WRL::ComPtr<ID3D12Resource> resource);
 };
@@ -0,0 +1,284 @@
+#include "d3d12/FrustumCulling.h"
+
+#include "utils/ThreadPool.h"
+
+#include <assert.h>
+
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FRUSTUM_CULLING_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace FrustumCulling {
+
+namespace {
+// Mesh parts are split into chunks of this many triangles for computing their bounds, so that a model that's all one
+// part still gets done in parallel.
+constexpr size_t kTrianglesPerChunk = 16 * 1024;
+
+// Each node has up to four children, and the items are split evenly between them, so the hierarchy is at most
+// log4(2^32) = 16 levels deep. Each level leaves at most three nodes on the stack while the fourth is visited.
+constexpr size_t kMaxStackSize = 3 * 17 + 1;
+
+ObjFileData::AxisAlignedBounds GetEmptyBounds() {
+  ObjFileData::AxisAlignedBounds bounds;
+  for (size_t i = 0; i < 3; ++i) {
+    bounds.max[i] = -std::numeric_limits<float>::max();
+    bounds.min[i] = std::numeric_limits<float>::max();
+  }
+  return bounds;
+}
+
+void ExtendBounds(const ObjFileData::AxisAlignedBounds& other, ObjFileData::AxisAlignedBounds* bounds) {
+  for (size_t i = 0; i < 3; ++i) {
+    bounds->max[i] = std::max(bounds->max[i], other.max[i]);
+    bounds->min[i] = std::min(bounds->min[i], other.min[i]);
+  }
+}
+
+// Sets a bit for each of the node's children whose box is entirely outside (behind any of the planes), and for those
+// whose box is entirely inside (in front of all of them).
+void TestNode(const float* minX,
+              const float* minY,
+              const float* minZ,
+              const float* maxX,
+              const float* maxY,
+              const float* maxZ,
+              const Frustum& frustum,
+              /*out*/ uint32_t* outsideMask,
+              /*out*/ uint32_t* insideMask) {
+#if defined(FRUSTUM_CULLING_USE_SSE2)
+  const __m128 zero = _mm_setzero_ps();
+  __m128 outside = zero;
+  __m128 inside = _mm_cmpeq_ps(zero, zero);
+  for (const float* plane : frustum.planes) {
+    // The corners furthest along the plane's normal, and those furthest against it.
+    const __m128 farX = _mm_loadu_ps(plane[0] >= 0.f ? maxX : minX);
+    const __m128 farY = _mm_loadu_ps(plane[1] >= 0.f ? maxY : minY);
+    const __m128 farZ = _mm_loadu_ps(plane[2] >= 0.f ? maxZ : minZ);
+    const __m128 nearX = _mm_loadu_ps(plane[0] >= 0.f ? minX : maxX);
+    const __m128 nearY = _mm_loadu_ps(plane[1] >= 0.f ? minY : maxY);
+    const __m128 nearZ = _mm_loadu_ps(plane[2] >= 0.f ? minZ : maxZ);
+
+    const __m128 a = _mm_set1_ps(plane[0]);
+    const __m128 b = _mm_set1_ps(plane[1]);
+    const __m128 c = _mm_set1_ps(plane[2]);
+    const __m128 d = _mm_set1_ps(plane[3]);
+    const __m128 farDistance =
+        _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, farX), _mm_mul_ps(b, farY)), _mm_add_ps(_mm_mul_ps(c, farZ), d));
+    const __m128 nearDistance =
+        _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, nearX), _mm_mul_ps(b, nearY)), _mm_add_ps(_mm_mul_ps(c, nearZ), d));
+
+    outside = _mm_or_ps(outside, _mm_cmplt_ps(farDistance, zero));
+    inside = _mm_and_ps(inside, _mm_cmpge_ps(nearDistance, zero));
+  }
+  *outsideMask = static_cast<uint32_t>(_mm_movemask_ps(outside));
+  *insideMask = static_cast<uint32_t>(_mm_movemask_ps(inside));
+#else
+  *outsideMask = 0;
+  *insideMask = 0xf;
+  for (const float* plane : frustum.planes) {
+    for (uint32_t lane = 0; lane < 4; ++lane) {
+      const float farDistance = plane[0] * (plane[0] >= 0.f ? maxX : minX)[lane] +
+                                plane[1] * (plane[1] >= 0.f ? maxY : minY)[lane] +
+                                plane[2] * (plane[2] >= 0.f ? maxZ : minZ)[lane] + plane[3];
+      const float nearDistance = plane[0] * (plane[0] >= 0.f ? minX : maxX)[lane] +
+                                 plane[1] * (plane[1] >= 0.f ? minY : maxY)[lane] +
+                                 plane[2] * (plane[2] >= 0.f ? minZ : maxZ)[lane] + plane[3];
+      if (farDistance < 0.f)
+        *outsideMask |= 1u << lane;
+      if (!(nearDistance >= 0.f))
+        *insideMask &= ~(1u << lane);
+    }
+  }
+#endif
+}
+}  // namespace
+
+Frustum ExtractFrustum(const float transform[4][4]) {
+  // The clip-space position's coordinates are the dot products of the position with the transform's columns, and the
+  // inside of the frustum is where -w <= x <= w, -w <= y <= w and 0 <= z <= w.
+  auto column = [&](size_t c, float sign, /*out*/ float plane[4]) {
+    for (size_t i = 0; i < 4; ++i)
+      plane[i] += sign * transform[i][c];
+  };
+
+  Frustum frustum = {};
+  column(3, 1.f, frustum.planes[0]);  // Left.
+  column(0, 1.f, frustum.planes[0]);
+  column(3, 1.f, frustum.planes[1]);  // Right.
+  column(0, -1.f, frustum.planes[1]);
+  column(3, 1.f, frustum.planes[2]);  // Bottom.
+  column(1, 1.f, frustum.planes[2]);
+  column(3, 1.f, frustum.planes[3]);  // Top.
+  column(1, -1.f, frustum.planes[3]);
+  column(2, 1.f, frustum.planes[4]);  // Near.
+  column(3, 1.f, frustum.planes[5]);  // Far.
+  column(2, -1.f, frustum.planes[5]);
+  return frustum;
+}
+
+void ComputeMeshPartBounds(ObjFileData* data) {
+  const std::vector<ObjFileData::Vertex>& vertices = data->m_vertices;
+  const std::vector<uint32_t>& indices = data->m_indices;
+  std::vector<ObjFileData::MeshPart>& meshParts = data->m_meshParts;
+
+  struct Chunk {
+    size_t meshPartIndex;
+    uint32_t indexStart;
+    uint32_t numIndices;
+    ObjFileData::AxisAlignedBounds bounds;
+  };
+  std::vector<Chunk> chunks;
+  for (size_t p = 0; p < meshParts.size(); ++p) {
+    const ObjFileData::MeshPart& meshPart = meshParts[p];
+    for (uint32_t offset = 0; offset < meshPart.numIndices; offset += 3 * kTrianglesPerChunk) {
+      const uint32_t numIndices = std::min<uint32_t>(3 * kTrianglesPerChunk, meshPart.numIndices - offset);
+      chunks.push_back({p, meshPart.indexStart + offset, numIndices, GetEmptyBounds()});
+    }
+  }
+
+  ThreadPool::GetShared().ParallelFor(chunks.size(), [&](size_t c) {
+    Chunk& chunk = chunks[c];
+    for (uint32_t i = chunk.indexStart; i < chunk.indexStart + chunk.numIndices; ++i) {
+      const float* pos = vertices[indices[i]].pos;
+      for (size_t axis = 0; axis < 3; ++axis) {
+        chunk.bounds.max[axis] = std::max(chunk.bounds.max[axis], pos[axis]);
+        chunk.bounds.min[axis] = std::min(chunk.bounds.min[axis], pos[axis]);
+      }
+    }
+  });
+
+  // Parts without any triangles are left with empty (zero) bounds.
+  for (ObjFileData::MeshPart& meshPart : meshParts)
+    meshPart.bounds = (meshPart.numIndices > 0) ? GetEmptyBounds() : ObjFileData::AxisAlignedBounds{};
+  for (const Chunk& chunk : chunks)
+    ExtendBounds(chunk.bounds, &meshParts[chunk.meshPartIndex].bounds);
+}
+
+void BoundingVolumeHierarchy::Build(const ObjFileData::AxisAlignedBounds* bounds, size_t count) {
+  Clear();
+  if (count == 0)
+    return;
+
+  std::vector<float> centers(3 * count);
+  m_items.resize(count);
+  for (size_t i = 0; i < count; ++i) {
+    for (size_t axis = 0; axis < 3; ++axis)
+      centers[3 * i + axis] = (bounds[i].min[axis] + bounds[i].max[axis]) / 2;
+    m_items[i] = static_cast<uint32_t>(i);
+  }
+
+  m_nodes.reserve(count / 2 + 1);
+  BuildNode(bounds, centers.data(), 0, count);
+}
+
+uint32_t BoundingVolumeHierarchy::BuildNode(const ObjFileData::AxisAlignedBounds* bounds,
+                                            const float* centers,
+                                            size_t first,
+                                            size_t count) {
+  // Splits the items in half along the axis that their centers are most spread out along, and returns the middle.
+  auto split = [&](size_t splitFirst, size_t splitCount) {
+    float minCenter[3];
+    float maxCenter[3];
+    for (size_t axis = 0; axis < 3; ++axis) {
+      minCenter[axis] = std::numeric_limits<float>::max();
+      maxCenter[axis] = -std::numeric_limits<float>::max();
+    }
+    for (size_t i = splitFirst; i < splitFirst + splitCount; ++i) {
+      for (size_t axis = 0; axis < 3; ++axis) {
+        minCenter[axis] = std::min(minCenter[axis], centers[3 * m_items[i] + axis]);
+        maxCenter[axis] = std::max(maxCenter[axis], centers[3 * m_items[i] + axis]);
+      }
+    }
+    size_t splitAxis = 0;
+    for (size_t axis = 1; axis < 3; ++axis) {
+      if (maxCenter[axis] - minCenter[axis] > maxCenter[splitAxis] - minCenter[splitAxis])
+        splitAxis = axis;
+    }
+
+    const auto begin = m_items.begin() + splitFirst;
+    std::nth_element(begin, begin + splitCount / 2, begin + splitCount, [&](uint32_t a, uint32_t b) {
+      return centers[3 * a + splitAxis] < centers[3 * b + splitAxis];
+    });
+    return splitFirst + splitCount / 2;
+  };
+
+  // The children's ranges of items: up to four single items, or the items split in quarters.
+  size_t childFirsts[5];
+  size_t numChildren = 0;
+  if (count <= 4) {
+    for (size_t i = 0; i <= count; ++i)
+      childFirsts[i] = first + i;
+    numChildren = count;
+  } else {
+    const size_t middle = split(first, count);
+    childFirsts[0] = first;
+    childFirsts[1] = split(first, middle - first);
+    childFirsts[2] = middle;
+    childFirsts[3] = split(middle, first + count - middle);
+    childFirsts[4] = first + count;
+    numChildren = 4;
+  }
+
+  const uint32_t nodeIndex = static_cast<uint32_t>(m_nodes.size());
+  m_nodes.emplace_back();
+  Node node = {};
+  node.numChildren = static_cast<uint32_t>(numChildren);
+  for (size_t c = 0; c < numChildren; ++c) {
+    const size_t childFirst = childFirsts[c];
+    const size_t childCount = childFirsts[c + 1] - childFirst;
+    ObjFileData::AxisAlignedBounds childBounds = GetEmptyBounds();
+    for (size_t i = childFirst; i < childFirst + childCount; ++i)
+      ExtendBounds(bounds[m_items[i]], &childBounds);
+
+    node.minX[c] = childBounds.min[0];
+    node.minY[c] = childBounds.min[1];
+    node.minZ[c] = childBounds.min[2];
+    node.maxX[c] = childBounds.max[0];
+    node.maxY[c] = childBounds.max[1];
+    node.maxZ[c] = childBounds.max[2];
+    node.firstItems[c] = static_cast<uint32_t>(childFirst);
+    node.numItems[c] = static_cast<uint32_t>(childCount);
+    node.childNodes[c] = (childCount == 1) ? kLeaf : BuildNode(bounds, centers, childFirst, childCount);
+  }
+  m_nodes[nodeIndex] = node;
+  return nodeIndex;
+}
+
+void BoundingVolumeHierarchy::Clear() {
+  m_nodes.clear();
+  m_items.clear();
+}
+
+void BoundingVolumeHierarchy::Cull(const Frustum& frustum, /*out*/ std::vector<uint32_t>* visibleItems) const {
+  if (m_nodes.empty())
+    return;
+
+  uint32_t stack[kMaxStackSize];
+  size_t stackSize = 0;
+  stack[stackSize++] = 0;
+  while (stackSize > 0) {
+    const Node& node = m_nodes[stack[--stackSize]];
+    uint32_t outsideMask;
+    uint32_t insideMask;
+    TestNode(node.minX, node.minY, node.minZ, node.maxX, node.maxY, node.maxZ, frustum, &outsideMask, &insideMask);
+
+    for (uint32_t c = 0; c < node.numChildren; ++c) {
+      if (outsideMask & (1u << c))
+        continue;
+
+      if (node.childNodes[c] == kLeaf || (insideMask & (1u << c))) {
+        const auto childItems = m_items.begin() + node.firstItems[c];
+        visibleItems->insert(visibleItems->end(), childItems, childItems + node.numItems[c]);
+      } else {
+        assert(stackSize < kMaxStackSize);
+        stack[stackSize++] = node.childNodes[c];
+      }
+    }
+  }
+}
+
+}  // namespace FrustumCulling
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "d3d12/ObjFileLoader.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <limits>
+#include <vector>
+
+// Culls a model's mesh parts against a camera's view frustum on the CPU, so that the parts that are out of view aren't
+// drawn at all.
+//
+// The parts' bounding boxes go into a bounding volume hierarchy with four children to a node, each node storing its
+// children's boxes coordinate by coordinate, so that all four are tested against a plane at once with SSE. A box is
+// out of view if even its corner furthest along one of the frustum planes' normals is behind that plane. Children
+// whose boxes are entirely in view are taken whole, without testing anything below them.
+//
+// None of this touches the GPU, so it can be run (and timed) without a device.
+namespace FrustumCulling {
+
+// Each plane is (a, b, c, d), with the inside where a * x + b * y + c * z + d >= 0. The planes aren't normalized.
+struct Frustum {
+  float planes[6][4];
+};
+
+// |transform| maps positions to clip space, as a row-vector matrix like DirectX::XMFLOAT4X4::m (i.e. the clip-space
+// position is (x, y, z, 1) * transform). The frustum is in the space of the positions, e.g. the model's own space for
+// a model-view-projection transform.
+Frustum ExtractFrustum(const float transform[4][4]);
+
+// Sets the bounds of each of the data's mesh parts, in parallel on the shared thread pool.
+void ComputeMeshPartBounds(ObjFileData* data);
+
+class BoundingVolumeHierarchy {
+ private:
+  struct Node {
+    // The children's boxes, one in each lane.
+    float minX[4];
+    float minY[4];
+    float minZ[4];
+    float maxX[4];
+    float maxY[4];
+    float maxZ[4];
+
+    // Each child covers a contiguous range of m_items, so that a subtree that's entirely in view can be taken whole.
+    uint32_t firstItems[4];
+    uint32_t numItems[4];
+    // Into m_nodes, or kLeaf for children that are a single item.
+    uint32_t childNodes[4];
+    uint32_t numChildren;
+  };
+
+  static constexpr uint32_t kLeaf = std::numeric_limits<uint32_t>::max();
+
+  std::vector<Node> m_nodes;  // The root comes first.
+  std::vector<uint32_t> m_items;
+
+  uint32_t BuildNode(const ObjFileData::AxisAlignedBounds* bounds, const float* centers, size_t first, size_t count);
+
+ public:
+  // The items are numbered by their position in |bounds|. Replaces anything that was built before.
+  void Build(const ObjFileData::AxisAlignedBounds* bounds, size_t count);
+  void Clear();
+  bool IsEmpty() const { return m_items.empty(); }
+
+  // Appends the items whose boxes are at least partly inside the frustum, in no particular order.
+  void Cull(const Frustum& frustum, /*out*/ std::vector<uint32_t>* visibleItems) const;
+};
+
+}  // namespace FrustumCulling
@@ -0,0 +1,79 @@
+#include "d3d12/GpuTimer.h"
+
+#include "d3d12/d3dx12.h"
+#include "utils/comhelper.h"
+
+#include <assert.h>
+
+void GpuTimer::Initialize(ID3D12Device* device, ID3D12CommandQueue* commandQueue) {
+  D3D12_QUERY_HEAP_DESC queryHeapDesc = {};
+  queryHeapDesc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+  queryHeapDesc.Count = 2 * kNumSlots;
+  HR(device->CreateQueryHeap(&queryHeapDesc, IID_PPV_ARGS(&m_queryHeap)));
+
+  D3D12_HEAP_PROPERTIES heapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_READBACK);
+  D3D12_RESOURCE_DESC resourceDesc = CD3DX12_RESOURCE_DESC::Buffer(2 * kNumSlots * sizeof(uint64_t));
+  HR(device->CreateCommittedResource(&heapProperties, D3D12_HEAP_FLAG_NONE, &resourceDesc,
+                                     D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&m_readbackBuffer)));
+
+  HR(commandQueue->GetTimestampFrequency(&m_timestampFrequency));
+}
+
+void GpuTimer::Start(ID3D12GraphicsCommandList* cl) {
+  assert(!m_isTiming);
+  Slot& slot = m_slots[m_currentSlot];
+  if (slot.isInFlight)
+    return;
+
+  cl->EndQuery(m_queryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, static_cast<UINT>(2 * m_currentSlot));
+  m_isTiming = true;
+}
+
+void GpuTimer::Stop(ID3D12GraphicsCommandList* cl) {
+  if (!m_isTiming)
+    return;
+
+  const UINT firstQuery = static_cast<UINT>(2 * m_currentSlot);
+  cl->EndQuery(m_queryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, firstQuery + 1);
+  cl->ResolveQueryData(m_queryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, firstQuery, /*NumQueries*/ 2,
+                       m_readbackBuffer.Get(), firstQuery * sizeof(uint64_t));
+  m_slots[m_currentSlot].isTimed = true;
+  m_isTiming = false;
+}
+
+void GpuTimer::EndFrame(uint64_t signalValue) {
+  assert(!m_isTiming);
+  Slot& slot = m_slots[m_currentSlot];
+  if (slot.isInFlight)
+    return;
+
+  slot.signalValue = signalValue;
+  slot.isInFlight = true;
+  m_currentSlot = (m_currentSlot + 1) % kNumSlots;
+}
+
+void GpuTimer::Collect(uint64_t completedSignalValue) {
+  for (size_t i = 0; i < kNumSlots; ++i) {
+    Slot& slot = m_slots[i];
+    if (!slot.isInFlight || slot.signalValue > completedSignalValue)
+      continue;
+
+    double seconds = 0.0;
+    if (slot.isTimed) {
+      CD3DX12_RANGE readRange(/*begin*/ 2 * i * sizeof(uint64_t), /*end*/ 2 * (i + 1) * sizeof(uint64_t));
+      uint64_t* timestamps = nullptr;
+      HR(m_readbackBuffer->Map(/*subresource*/ 0, &readRange, reinterpret_cast<void**>(&timestamps)));
+      seconds = static_cast<double>(timestamps[2 * i + 1] - timestamps[2 * i]) / m_timestampFrequency;
+      CD3DX12_RANGE writtenRange(/*begin*/ 0, /*end*/ 0);
+      m_readbackBuffer->Unmap(/*subresource*/ 0, &writtenRange);
+    }
+
+    m_totalSeconds += seconds;
+    if (slot.signalValue >= m_lastSignalValue) {
+      m_lastSeconds = seconds;
+      m_lastSignalValue = slot.signalValue;
+    }
+    slot.isInFlight = false;
+    slot.isTimed = false;
+  }
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <d3d12.h>
+#include <wrl/client.h>  // For ComPtr
+
+#include <stdint.h>
+
+// Measures how long a stretch of each frame's command list takes on the GPU, with a pair of timestamp queries. The
+// timestamps are resolved into a readback buffer, and are only read once the GPU has finished the frame, so the
+// measurements come in a few frames late.
+class GpuTimer {
+ private:
+  // Each frame that's still in flight takes up a slot, with a pair of queries and their place in the readback buffer.
+  // Frames that come along while they're all still taken go unmeasured.
+  static constexpr size_t kNumSlots = 4;
+
+  struct Slot {
+    uint64_t signalValue = 0;
+    bool isInFlight = false;
+    bool isTimed = false;  // Whether the frame had anything to time.
+  };
+
+  Microsoft::WRL::ComPtr<ID3D12QueryHeap> m_queryHeap;
+  Microsoft::WRL::ComPtr<ID3D12Resource> m_readbackBuffer;
+  uint64_t m_timestampFrequency = 1;
+  Slot m_slots[kNumSlots];
+  size_t m_currentSlot = 0;
+  bool m_isTiming = false;
+  uint64_t m_lastSignalValue = 0;  // Of the frame that m_lastSeconds is for.
+
+  double m_totalSeconds = 0.0;
+  double m_lastSeconds = 0.0;
+
+ public:
+  void Initialize(ID3D12Device* device, ID3D12CommandQueue* commandQueue);
+
+  // Brackets the stretch of the frame that's measured; at most once per frame. Frames on which they aren't called
+  // count as taking no time at all.
+  void Start(ID3D12GraphicsCommandList* cl);
+  void Stop(ID3D12GraphicsCommandList* cl);
+
+  // Has to be called once per frame; |signalValue| is the fence value that's signaled once the GPU has finished with
+  // the frame.
+  void EndFrame(uint64_t signalValue);
+
+  // Reads back the frames that the GPU has finished with.
+  void Collect(uint64_t completedSignalValue);
+
+  // The time of the latest frame that has been read back, and the total over all the frames that have been read back
+  // since the last call to ResetTotal.
+  double GetLastSeconds() const { return m_lastSeconds; }
+  double GetTotalSeconds() const { return m_totalSeconds; }
+  void ResetTotal() { m_totalSeconds = 0.0; }
+};
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+
+// Decodes one (or a few related) image file formats from memory, always into 8-bit RGBA.
+//
+// Decoders are registered with Register, and Image::LoadImageFile picks the first one that recognizes the file, so
+// that e.g. a platform-specific decoder can be added to pick up formats that the portable ones don't handle.
+// Implementations must be safe to call from several threads at once.
+class ImageDecoder {
+ public:
+  struct Info {
+    uint32_t width;
+    uint32_t height;
+  };
+
+  virtual ~ImageDecoder() = default;
+
+  // Reads only as much of the file as is needed to get its dimensions. Returns false if the data isn't in a format
+  // (or a variant of the format) that this decoder supports.
+  virtual bool ReadInfo(const unsigned char* data, size_t size, Info* info) const = 0;
+
+  // Decodes into |pixels|, which has to hold |info.height| rows that are |rowPitch| bytes apart (at least 4 bytes
+  // per pixel). This is what allows decoding straight into e.g. a mapped upload buffer.
+  virtual bool Decode(const unsigned char* data, size_t size, unsigned char* pixels, size_t rowPitch) const = 0;
+
+  // Decoders that are registered later are only tried once the earlier ones have all turned the file down.
+  static void Register(std::unique_ptr<ImageDecoder> decoder);
+
+  // Returns nullptr (and leaves |info| untouched) if none of the registered decoders recognize the data.
+  static const ImageDecoder* Find(const unsigned char* data, size_t size, Info* info);
+};
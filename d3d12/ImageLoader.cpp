@@ -1,59 +1,113 @@
 #include "d3d12/ImageLoader.h"
 
-#include "utils/comhelper.h"
-
-#include <wincodec.h>
-#include <wrl/client.h>  // For ComPtr
-
-using namespace Microsoft::WRL;
-
-HRESULT Image::LoadImageFile(const std::wstring& file, Image* img) {
-  ComPtr<IWICImagingFactory> factory = nullptr;
-  HRESULT hr = S_OK;
-
-  RETURN_IF_FAILED(CoCreateInstance(CLSID_WICImagingFactory, NULL, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&factory)));
-
-  ComPtr<IWICBitmapDecoder> decoder = nullptr;
-  RETURN_IF_FAILED(factory->CreateDecoderFromFilename(file.c_str(),  // Image to be decoded
-                                                      NULL,          // Do not prefer a particular vendor
-                                                      GENERIC_READ,  // Desired read access to the file
-                                                      WICDecodeMetadataCacheOnDemand,  // Cache metadata when needed
-                                                      &decoder                         // Pointer to the decoder
-                                                      ));
-
-  // Retrieve the first frame of the image from the decoder
-  ComPtr<IWICBitmapFrameDecode> frame = nullptr;
-  RETURN_IF_FAILED(decoder->GetFrame(0, &frame));
-
-  // Make sure the image is in (or can be converted to) R8G8B8A format.
-  ComPtr<IWICFormatConverter> converter;
-  RETURN_IF_FAILED(factory->CreateFormatConverter(&converter));
-
-  WICPixelFormatGUID format;
-  RETURN_IF_FAILED(frame->GetPixelFormat(&format));
-
-  BOOL canConvert;
-  RETURN_IF_FAILED(converter->CanConvert(format, GUID_WICPixelFormat32bppRGBA, &canConvert));
+#include "d3d12/ImageDecoder.h"
+#include "d3d12/JpegDecoder.h"
+#include "d3d12/PngDecoder.h"
+#include "d3d12/TgaDecoder.h"
+#include "utils/MappedFile.h"
+#include "utils/MipGeneration.h"
+
+#ifdef _WIN32
+#include "d3d12/WicImageDecoder.h"
+#endif
+
+#include <mutex>
+
+namespace {
+struct DecoderRegistry {
+  std::mutex mutex;
+  std::vector<std::unique_ptr<ImageDecoder>> decoders;
+
+  DecoderRegistry() {
+    // Tga comes last among the portable decoders, since it has to guess from the header alone.
+    decoders.push_back(std::make_unique<PngDecoder>());
+    decoders.push_back(std::make_unique<JpegDecoder>());
+    decoders.push_back(std::make_unique<TgaDecoder>());
+#ifdef _WIN32
+    // Picks up everything else that the OS knows about (progressive jpegs, bmp, tiff, ...).
+    decoders.push_back(std::make_unique<WicImageDecoder>());
+#endif
+  }
+};
+
+DecoderRegistry& GetRegistry() {
+  static DecoderRegistry registry;
+  return registry;
+}
+}  // namespace
 
-  if (!canConvert)
-    return E_FAIL;
+/*static*/ void ImageDecoder::Register(std::unique_ptr<ImageDecoder> decoder) {
+  DecoderRegistry& registry = GetRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  registry.decoders.push_back(std::move(decoder));
+}
 
-  RETURN_IF_FAILED(converter->Initialize(frame.Get(), GUID_WICPixelFormat32bppRGBA, WICBitmapDitherTypeErrorDiffusion,
-                                         nullptr, 0, WICBitmapPaletteTypeMedianCut));
+/*static*/ const ImageDecoder* ImageDecoder::Find(const unsigned char* data, size_t size, Info* info) {
+  // Decoders are never removed, so the lock only has to cover taking a snapshot of the list. That way threads don't
+  // wait for each other while sniffing files.
+  std::vector<const ImageDecoder*> decoders;
+  {
+    DecoderRegistry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    for (const std::unique_ptr<ImageDecoder>& decoder : registry.decoders) {
+      decoders.push_back(decoder.get());
+    }
+  }
+
+  for (const ImageDecoder* decoder : decoders) {
+    if (decoder->ReadInfo(data, size, info))
+      return decoder;
+  }
+  return nullptr;
+}
 
-  UINT width;
-  UINT height;
-  RETURN_IF_FAILED(converter->GetSize(&width, &height));
+/*static*/ bool Image::LoadImageFile(const std::filesystem::path& file, Image* img) {
+  MappedFile mappedFile;
+  if (!mappedFile.Open(file.string()))
+    return false;
+
+  const unsigned char* data = reinterpret_cast<const unsigned char*>(mappedFile.GetData());
+  const size_t size = mappedFile.GetSize();
+
+  ImageDecoder::Info info;
+  const ImageDecoder* decoder = ImageDecoder::Find(data, size, &info);
+  if (!decoder)
+    return false;
+
+  const size_t bytesPerPixel = 4;
+  std::vector<unsigned char> pixels((size_t)info.width * info.height * bytesPerPixel);
+  if (!decoder->Decode(data, size, pixels.data(), info.width * bytesPerPixel))
+    return false;
+
+  img->data = std::move(pixels);
+  img->format = ImageFormat::R8G8B8A8;
+  img->width = info.width;
+  img->height = info.height;
+  img->numMips = 1;
+  return true;
+}
 
-  const UINT bytesPerPixel = 4;  // 32bpp / 8.
-  std::vector<unsigned char> data(width * height * bytesPerPixel);
-  RETURN_IF_FAILED(converter->CopyPixels(nullptr, width * bytesPerPixel, data.size(), data.data()));
+size_t Image::GetRowPitch(size_t mip) const {
+  const size_t mipWidth = MipGeneration::GetMipSize(width, mip);
+  switch (format) {
+    case ImageFormat::BC1:
+      return (mipWidth + 3) / 4 * 8;
+    case ImageFormat::BC3:
+    case ImageFormat::BC7:
+      return (mipWidth + 3) / 4 * 16;
+    default:
+      return mipWidth * 4;
+  }
+}
 
-  img->data = std::move(data);
-  img->format = DXGI_FORMAT_R8G8B8A8_UNORM;
-  img->width = width;
-  img->height = height;
-  img->bytesPerPixel = bytesPerPixel;
+size_t Image::GetNumRows(size_t mip) const {
+  const size_t mipHeight = MipGeneration::GetMipSize(height, mip);
+  return IsBlockCompressed() ? (mipHeight + 3) / 4 : mipHeight;
+}
 
-  return S_OK;
+size_t Image::GetMipOffset(size_t mip) const {
+  size_t offset = 0;
+  for (size_t i = 0; i < mip; ++i)
+    offset += GetRowPitch(i) * GetNumRows(i);
+  return offset;
 }
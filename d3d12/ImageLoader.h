@@ -1,18 +1,37 @@
 #pragma once
 
-#include <string>
+#include <stdint.h>
+
+#include <filesystem>
 #include <vector>
 
-#include <Windows.h>
-#include <dxgiformat.h>
+// How an Image's pixels are stored. The block-compressed formats store 4x4 blocks of pixels, one row of blocks after
+// another.
+enum class ImageFormat : uint32_t {
+  R8G8B8A8,
+  BC1,
+  BC3,
+  BC7,
+};
 
+// Decoded by whichever registered ImageDecoder recognizes the file, always to R8G8B8A8. Mip levels may be added, and
+// the image block-compressed, afterwards.
 struct Image {
-  static HRESULT LoadImageFile(const std::wstring& file, Image* img);
+  static bool LoadImageFile(const std::filesystem::path& file, Image* img);
 
+  // All of the mip levels, largest first, one right after the other.
   std::vector<unsigned char> data;
-  DXGI_FORMAT format;
-  size_t width;
+  ImageFormat format = ImageFormat::R8G8B8A8;
+  size_t width;  // Of mip 0.
   size_t height;
+  size_t numMips = 1;
+
+  bool IsBlockCompressed() const { return format != ImageFormat::R8G8B8A8; }
+
+  // The size of a row of pixels (or of blocks) in |mip|, and the number of those rows.
+  size_t GetRowPitch(size_t mip = 0) const;
+  size_t GetNumRows(size_t mip = 0) const;
 
-  size_t bytesPerPixel;  // TODO: Doing it this way does not support bc-packed textures.
+  // Where |mip| starts in |data|. GetMipOffset(numMips) is the size of the whole chain.
+  size_t GetMipOffset(size_t mip) const;
 };
@@ -0,0 +1,140 @@
+#include "d3d12/IndexPacking.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+namespace IndexPacking {
+
+namespace {
+constexpr uint32_t kMaxShortIndex = 0xffff;
+
+// Every draw has a fixed cost on the CPU and GPU, so parts are only split into draws that are at least this big (on
+// average); beyond that, the index bandwidth isn't worth it.
+constexpr size_t kMinTrianglesPerSplitDraw = 1024;
+
+struct Run {
+  size_t start;  // Offsets into the part's indices.
+  size_t end;
+  uint32_t minVertex;
+  uint32_t maxVertex;
+  bool hasShortIndices;
+};
+
+// Splits the part's triangles into runs whose vertices fit into 16-bit indices, in order. Triangles that don't fit
+// even on their own are gathered into 32-bit runs.
+std::vector<Run> SplitIntoRuns(const uint32_t* indices, size_t numIndices) {
+  std::vector<Run> runs;
+  for (size_t t = 0; t + 3 <= numIndices; t += 3) {
+    const uint32_t triangleMin = std::min({indices[t], indices[t + 1], indices[t + 2]});
+    const uint32_t triangleMax = std::max({indices[t], indices[t + 1], indices[t + 2]});
+    const bool fitsOnItsOwn = triangleMax - triangleMin <= kMaxShortIndex;
+
+    if (!runs.empty() && runs.back().hasShortIndices == fitsOnItsOwn) {
+      Run& run = runs.back();
+      if (!run.hasShortIndices) {
+        run.end = t + 3;
+        continue;
+      }
+
+      const uint32_t newMin = std::min(run.minVertex, triangleMin);
+      const uint32_t newMax = std::max(run.maxVertex, triangleMax);
+      if (newMax - newMin <= kMaxShortIndex) {
+        run.minVertex = newMin;
+        run.maxVertex = newMax;
+        run.end = t + 3;
+        continue;
+      }
+    }
+
+    runs.push_back({t, t + 3, triangleMin, triangleMax, fitsOnItsOwn});
+  }
+  return runs;
+}
+
+void AppendDraw(const uint32_t* indices, const Run& run, PackedIndices* packed) {
+  Draw draw;
+  draw.numIndices = static_cast<uint32_t>(run.end - run.start);
+  if (run.hasShortIndices) {
+    draw.indexSize = 2;
+    draw.indexStart = static_cast<uint32_t>(packed->pool.size());
+    draw.baseVertex = static_cast<int32_t>(run.minVertex);
+    for (size_t i = run.start; i < run.end; ++i)
+      packed->pool.push_back(static_cast<uint16_t>(indices[i] - run.minVertex));
+  } else {
+    if (packed->pool.size() % 2 != 0)
+      packed->pool.push_back(0);
+    draw.indexSize = 4;
+    draw.indexStart = static_cast<uint32_t>(packed->pool.size() / 2);
+    draw.baseVertex = 0;
+    const size_t poolStart = packed->pool.size();
+    packed->pool.resize(poolStart + 2 * draw.numIndices);
+    memcpy(&packed->pool[poolStart], indices + run.start, draw.numIndices * sizeof(uint32_t));
+  }
+  packed->draws.push_back(draw);
+}
+
+// Appends the draws for a mesh part's (or a level of detail's) range of indices.
+void AppendDraws(const uint32_t* indices, uint32_t indexStart, uint32_t numIndices, PackedIndices* packed) {
+  packed->firstDraws.push_back(static_cast<uint32_t>(packed->draws.size()));
+  if (numIndices == 0)
+    return;
+
+  const uint32_t* rangeIndices = indices + indexStart;
+  std::vector<Run> runs = SplitIntoRuns(rangeIndices, numIndices);
+  const size_t maxRuns = 1 + numIndices / (3 * kMinTrianglesPerSplitDraw);
+  if (runs.size() > maxRuns)
+    runs = {{0, numIndices, 0, 0, /*hasShortIndices*/ false}};
+
+  for (const Run& run : runs)
+    AppendDraw(rangeIndices, run, packed);
+}
+}  // namespace
+
+PackedIndices Pack(const uint32_t* indices,
+                   const ObjFileData::MeshPart* meshParts,
+                   size_t numMeshParts,
+                   const ObjFileData::MeshLod* lods,
+                   size_t numLods) {
+  PackedIndices packed;
+  packed.firstDraws.reserve(numMeshParts + numLods + 1);
+
+  size_t numIndices = 0;
+  for (size_t p = 0; p < numMeshParts; ++p)
+    numIndices += meshParts[p].numIndices;
+  for (size_t l = 0; l < numLods; ++l)
+    numIndices += lods[l].numIndices;
+  packed.pool.reserve(numIndices);
+
+  for (size_t p = 0; p < numMeshParts; ++p)
+    AppendDraws(indices, meshParts[p].indexStart, meshParts[p].numIndices, &packed);
+  for (size_t l = 0; l < numLods; ++l)
+    AppendDraws(indices, lods[l].indexStart, lods[l].numIndices, &packed);
+  packed.firstDraws.push_back(static_cast<uint32_t>(packed.draws.size()));
+
+  // Keep the pool a whole number of 32-bit indices, so that a 32-bit view of it covers all of it.
+  if (packed.pool.size() % 2 != 0)
+    packed.pool.push_back(0);
+  return packed;
+}
+
+PackedIndices GetUnpackedLayout(const ObjFileData::MeshPart* meshParts,
+                                size_t numMeshParts,
+                                const ObjFileData::MeshLod* lods,
+                                size_t numLods) {
+  PackedIndices layout;
+  layout.draws.reserve(numMeshParts + numLods);
+  layout.firstDraws.reserve(numMeshParts + numLods + 1);
+  for (size_t p = 0; p < numMeshParts; ++p) {
+    layout.firstDraws.push_back(static_cast<uint32_t>(layout.draws.size()));
+    layout.draws.push_back({meshParts[p].indexStart, meshParts[p].numIndices, /*baseVertex*/ 0, /*indexSize*/ 4});
+  }
+  for (size_t l = 0; l < numLods; ++l) {
+    layout.firstDraws.push_back(static_cast<uint32_t>(layout.draws.size()));
+    layout.draws.push_back({lods[l].indexStart, lods[l].numIndices, /*baseVertex*/ 0, /*indexSize*/ 4});
+  }
+  layout.firstDraws.push_back(static_cast<uint32_t>(layout.draws.size()));
+  return layout;
+}
+
+}  // namespace IndexPacking
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "d3d12/ObjFileLoader.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+// Packs a model's 32-bit indices into a pool of mixed 16- and 32-bit indices, so that mesh parts can be drawn with
+// half the index bandwidth whenever they can be.
+//
+// A mesh part whose vertices all lie within 65536 of each other is rebased onto its lowest vertex, and drawn with
+// 16-bit indices and that vertex as its base vertex. Larger parts are split into runs of triangles that each fit, as
+// long as that doesn't leave them split into lots of small draws; otherwise they keep their 32-bit indices. Since
+// MeshOptimizer numbers the vertices in the order that the triangles use them, most parts fit in one or a few runs.
+//
+// The mesh parts themselves are left alone (and in order); each one just maps to a range of draws. So do their levels
+// of detail, which are packed the same way.
+namespace IndexPacking {
+
+struct Draw {
+  // In units of |indexSize|, from the start of the pool; i.e. the StartIndexLocation for a view of the pool with the
+  // matching format.
+  uint32_t indexStart;
+  uint32_t numIndices;
+  int32_t baseVertex;
+  // 2 or 4 bytes.
+  uint32_t indexSize;
+};
+
+struct PackedIndices {
+  // 16-bit indices take up one element, 32-bit ones two (and always start at an even element, so that they're 4-byte
+  // aligned).
+  std::vector<uint16_t> pool;
+  std::vector<Draw> draws;
+
+  // The draws of mesh part i are [firstDraws[i], firstDraws[i + 1]). Those of level of detail j come after all of the
+  // mesh parts, at [firstDraws[numMeshParts + j], firstDraws[numMeshParts + j + 1]).
+  std::vector<uint32_t> firstDraws;
+};
+
+PackedIndices Pack(const uint32_t* indices,
+                   const ObjFileData::MeshPart* meshParts,
+                   size_t numMeshParts,
+                   const ObjFileData::MeshLod* lods = nullptr,
+                   size_t numLods = 0);
+
+// The layout of indices that haven't been packed: each mesh part (and level of detail) is a single 32-bit draw. The
+// pool is left empty.
+PackedIndices GetUnpackedLayout(const ObjFileData::MeshPart* meshParts,
+                                size_t numMeshParts,
+                                const ObjFileData::MeshLod* lods = nullptr,
+                                size_t numLods = 0);
+
+}  // namespace IndexPacking
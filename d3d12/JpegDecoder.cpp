@@ -0,0 +1,891 @@
+#include "d3d12/JpegDecoder.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace {
+enum Marker : uint8_t {
+  StartOfFrameBaseline = 0xC0,
+  StartOfFrameExtended = 0xC1,
+  DefineHuffmanTables = 0xC4,
+  Restart0 = 0xD0,
+  Restart7 = 0xD7,
+  StartOfImage = 0xD8,
+  EndOfImage = 0xD9,
+  StartOfScan = 0xDA,
+  DefineQuantizationTables = 0xDB,
+  DefineRestartInterval = 0xDD,
+  App0 = 0xE0,
+  App14 = 0xEE,
+};
+
+// Maps the zigzag order that coefficients are stored in to their position in the 8x8 block.
+constexpr uint8_t kZigzagToNatural[64] = {
+  0,  1,  8,  16, 9,  2,  3,  10, 17, 24, 32, 25, 18, 11, 4,  5,  12, 19, 26, 33, 40, 48,
+  41, 34, 27, 20, 13, 6,  7,  14, 21, 28, 35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23,
+  30, 37, 44, 51, 58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63,
+};
+
+constexpr int kMaxComponents = 3;
+
+uint16_t ReadBigEndian16(const unsigned char* data) {
+  return (uint16_t)((data[0] << 8) | data[1]);
+}
+
+// Canonical Huffman table as defined by a DHT segment. Codes of up to kLookupBits bits are decoded with a single
+// table lookup; longer ones fall back to comparing against the largest code of each length.
+class HuffmanTable {
+ private:
+  static constexpr int kLookupBits = 9;
+
+  // Each entry is (length << 8) | value, or 0 if the code is longer than kLookupBits.
+  uint16_t m_lookup[1 << kLookupBits] = {};
+  int32_t m_maxCode[18];
+  int32_t m_valueOffset[17];
+  uint8_t m_values[256] = {};
+
+ public:
+  bool isDefined = false;
+
+  bool Build(const uint8_t counts[16], const uint8_t* values, size_t numValues);
+
+  // |bits| holds the next 16 bits of the stream. Returns the decoded value and sets |length| to the size of its
+  // code, or returns 0 with a |length| of 16 if the bits don't form a valid code.
+  uint8_t Decode(uint32_t bits, int* length) const;
+};
+
+bool HuffmanTable::Build(const uint8_t counts[16], const uint8_t* values, size_t numValues) {
+  memcpy(m_values, values, numValues);
+  memset(m_lookup, 0, sizeof(m_lookup));
+
+  int32_t code = 0;
+  size_t index = 0;
+  for (int length = 1; length <= 16; ++length) {
+    m_valueOffset[length] = (int32_t)index - code;
+    for (int i = 0; i < counts[length - 1]; ++i, ++index, ++code) {
+      // The codes of each length must fit in that many bits.
+      if (code >= (1 << length))
+        return false;
+      if (length <= kLookupBits) {
+        const int shift = kLookupBits - length;
+        for (int fill = 0; fill < (1 << shift); ++fill) {
+          m_lookup[(code << shift) | fill] = (uint16_t)((length << 8) | m_values[index]);
+        }
+      }
+    }
+    m_maxCode[length] = (counts[length - 1] > 0) ? code - 1 : -1;
+    code <<= 1;
+  }
+  m_maxCode[17] = INT32_MAX;
+
+  isDefined = true;
+  return true;
+}
+
+uint8_t HuffmanTable::Decode(uint32_t bits, int* length) const {
+  const uint16_t entry = m_lookup[bits >> (16 - kLookupBits)];
+  if (entry != 0) {
+    *length = entry >> 8;
+    return (uint8_t)entry;
+  }
+
+  for (int codeLength = kLookupBits + 1; codeLength <= 16; ++codeLength) {
+    const int32_t code = (int32_t)(bits >> (16 - codeLength));
+    if (code <= m_maxCode[codeLength]) {
+      *length = codeLength;
+      return m_values[code + m_valueOffset[codeLength]];
+    }
+  }
+
+  *length = 16;
+  return 0;
+}
+
+// Reads the entropy-coded data of a scan, MSB first, removing the stuffed zero bytes after each 0xFF. Once a marker
+// is reached, the reader keeps returning zero bits (like libjpeg does) rather than running into the marker.
+class BitReader {
+ private:
+  const unsigned char* m_data;
+  const unsigned char* m_end;
+  uint64_t m_bits = 0;  // Left-aligned.
+  int m_numBits = 0;
+  bool m_hasReachedMarker = false;
+
+  void Refill() {
+    while (m_numBits <= 56) {
+      uint64_t byte = 0;
+      if (!m_hasReachedMarker && m_data < m_end) {
+        if (*m_data != 0xFF) {
+          byte = *m_data++;
+        } else if (m_end - m_data >= 2 && m_data[1] == 0x00) {
+          byte = 0xFF;
+          m_data += 2;
+        } else {
+          m_hasReachedMarker = true;
+        }
+      }
+      m_bits |= byte << (56 - m_numBits);
+      m_numBits += 8;
+    }
+  }
+
+ public:
+  BitReader(const unsigned char* data, const unsigned char* end) : m_data(data), m_end(end) {}
+
+  uint32_t PeekBits16() {
+    if (m_numBits < 16)
+      Refill();
+    return (uint32_t)(m_bits >> 48);
+  }
+
+  void SkipBits(int numBits) {
+    m_bits <<= numBits;
+    m_numBits -= numBits;
+  }
+
+  int ReadBits(int numBits) {
+    if (numBits == 0)
+      return 0;
+    if (m_numBits < numBits)
+      Refill();
+    const int value = (int)(m_bits >> (64 - numBits));
+    SkipBits(numBits);
+    return value;
+  }
+
+  // Reads an |numBits|-bit value and sign-extends it the way jpeg stores coefficients (and DC differences).
+  int ReceiveExtend(int numBits) {
+    const int value = ReadBits(numBits);
+    return (numBits > 0 && value < (1 << (numBits - 1))) ? value - (1 << numBits) + 1 : value;
+  }
+
+  uint8_t DecodeHuffman(const HuffmanTable& table) {
+    int length;
+    const uint8_t value = table.Decode(PeekBits16(), &length);
+    SkipBits(length);
+    return value;
+  }
+
+  // Throws away the rest of the current byte and consumes the next restart marker, if there is one.
+  void Restart() {
+    m_bits = 0;
+    m_numBits = 0;
+    while (m_data < m_end && !m_hasReachedMarker) {
+      if (m_data[0] == 0xFF && m_end - m_data >= 2 && m_data[1] != 0x00)
+        m_hasReachedMarker = true;
+      else
+        ++m_data;
+    }
+    if (m_hasReachedMarker && m_end - m_data >= 2 && m_data[1] >= Restart0 && m_data[1] <= Restart7) {
+      m_data += 2;
+      m_hasReachedMarker = false;
+    }
+  }
+
+  // Where the marker parsing should continue after the scan.
+  const unsigned char* GetPosition() const { return m_data; }
+};
+
+// The "islow" IDCT from the IJG's jidctint.c, so that the output matches libjpeg bit for bit. The math is done in 64
+// bits (like libjpeg does on most 64-bit platforms) so that corrupt coefficients can't overflow.
+namespace idct {
+constexpr int kConstBits = 13;
+constexpr int kPass1Bits = 2;
+
+constexpr int32_t Fix(double x) {
+  return (int32_t)(x * (1 << kConstBits) + 0.5);
+}
+
+constexpr int32_t k0_298631336 = Fix(0.298631336);
+constexpr int32_t k0_390180644 = Fix(0.390180644);
+constexpr int32_t k0_541196100 = Fix(0.541196100);
+constexpr int32_t k0_765366865 = Fix(0.765366865);
+constexpr int32_t k0_899976223 = Fix(0.899976223);
+constexpr int32_t k1_175875602 = Fix(1.175875602);
+constexpr int32_t k1_501321110 = Fix(1.501321110);
+constexpr int32_t k1_847759065 = Fix(1.847759065);
+constexpr int32_t k1_961570560 = Fix(1.961570560);
+constexpr int32_t k2_053119869 = Fix(2.053119869);
+constexpr int32_t k2_562915447 = Fix(2.562915447);
+constexpr int32_t k3_072711026 = Fix(3.072711026);
+
+int64_t Descale(int64_t x, int numBits) {
+  return (x + (1 << (numBits - 1))) >> numBits;
+}
+
+uint8_t RangeLimit(int64_t x) {
+  return (uint8_t)std::clamp<int64_t>(x + 128, 0, 255);
+}
+
+// One 1D pass over a column or row. The even and odd parts follow jidctint.c exactly.
+template <typename Output>
+void Transform(int64_t in0,
+               int64_t in1,
+               int64_t in2,
+               int64_t in3,
+               int64_t in4,
+               int64_t in5,
+               int64_t in6,
+               int64_t in7,
+               Output&& output) {
+  int64_t z1 = (in2 + in6) * k0_541196100;
+  int64_t tmp2 = z1 + in6 * -k1_847759065;
+  int64_t tmp3 = z1 + in2 * k0_765366865;
+
+  int64_t tmp0 = (in0 + in4) * (1 << kConstBits);
+  int64_t tmp1 = (in0 - in4) * (1 << kConstBits);
+
+  const int64_t tmp10 = tmp0 + tmp3;
+  const int64_t tmp13 = tmp0 - tmp3;
+  const int64_t tmp11 = tmp1 + tmp2;
+  const int64_t tmp12 = tmp1 - tmp2;
+
+  tmp0 = in7;
+  tmp1 = in5;
+  tmp2 = in3;
+  tmp3 = in1;
+
+  z1 = tmp0 + tmp3;
+  int64_t z2 = tmp1 + tmp2;
+  int64_t z3 = tmp0 + tmp2;
+  int64_t z4 = tmp1 + tmp3;
+  const int64_t z5 = (z3 + z4) * k1_175875602;
+
+  tmp0 *= k0_298631336;
+  tmp1 *= k2_053119869;
+  tmp2 *= k3_072711026;
+  tmp3 *= k1_501321110;
+  z1 *= -k0_899976223;
+  z2 *= -k2_562915447;
+  z3 *= -k1_961570560;
+  z4 *= -k0_390180644;
+
+  z3 += z5;
+  z4 += z5;
+
+  tmp0 += z1 + z3;
+  tmp1 += z2 + z4;
+  tmp2 += z2 + z3;
+  tmp3 += z1 + z4;
+
+  output(0, tmp10 + tmp3);
+  output(7, tmp10 - tmp3);
+  output(1, tmp11 + tmp2);
+  output(6, tmp11 - tmp2);
+  output(2, tmp12 + tmp1);
+  output(5, tmp12 - tmp1);
+  output(3, tmp13 + tmp0);
+  output(4, tmp13 - tmp0);
+}
+
+void InverseDct(const int16_t coefficients[64], const uint16_t quantization[64], uint8_t* out, size_t outStride) {
+  int64_t workspace[64];
+
+  // Columns. Columns that only have a DC coefficient (which is most of them) are just a constant.
+  for (int column = 0; column < 8; ++column) {
+    const int16_t* in = coefficients + column;
+    const uint16_t* q = quantization + column;
+    int64_t* ws = workspace + column;
+
+    if (in[8] == 0 && in[16] == 0 && in[24] == 0 && in[32] == 0 && in[40] == 0 && in[48] == 0 && in[56] == 0) {
+      const int64_t dc = (int64_t)(in[0] * q[0]) * (1 << kPass1Bits);
+      for (int row = 0; row < 8; ++row) {
+        ws[row * 8] = dc;
+      }
+      continue;
+    }
+
+    Transform(in[0] * q[0], in[8] * q[8], in[16] * q[16], in[24] * q[24], in[32] * q[32], in[40] * q[40],
+              in[48] * q[48], in[56] * q[56], [ws](int row, int64_t value) {
+                ws[row * 8] = Descale(value, kConstBits - kPass1Bits);
+              });
+  }
+
+  // Rows. The final descale also removes the factor of 8 that the two passes add.
+  for (int row = 0; row < 8; ++row) {
+    const int64_t* ws = workspace + row * 8;
+    uint8_t* outRow = out + row * outStride;
+
+    if (ws[1] == 0 && ws[2] == 0 && ws[3] == 0 && ws[4] == 0 && ws[5] == 0 && ws[6] == 0 && ws[7] == 0) {
+      memset(outRow, RangeLimit(Descale(ws[0], kPass1Bits + 3)), 8);
+      continue;
+    }
+
+    Transform(ws[0], ws[1], ws[2], ws[3], ws[4], ws[5], ws[6], ws[7], [outRow](int column, int64_t value) {
+      outRow[column] = RangeLimit(Descale(value, kConstBits + kPass1Bits + 3));
+    });
+  }
+}
+}  // namespace idct
+
+struct Component {
+  uint8_t id;
+  uint8_t horizontalSampling;
+  uint8_t verticalSampling;
+  uint8_t quantizationTable;
+  uint8_t dcTable = 0;
+  uint8_t acTable = 0;
+  int dcPredictor = 0;
+
+  // The size of the component itself (after subsampling), rounded up.
+  size_t width;
+  size_t height;
+
+  // Decoded samples. The plane is padded to whole MCUs, so it's |stride| bytes wide.
+  std::vector<uint8_t> samples;
+  size_t stride;
+};
+
+enum class ColorTransform {
+  None,   // Grayscale.
+  YCbCr,  // The usual case.
+  Rgb,    // The samples are already RGB.
+};
+
+class JpegReader {
+ private:
+  const unsigned char* const m_data;
+  const unsigned char* const m_end;
+  const unsigned char* m_position;
+
+  uint32_t m_width = 0;
+  uint32_t m_height = 0;
+  Component m_components[kMaxComponents];
+  int m_numComponents = 0;
+  int m_maxHorizontalSampling = 1;
+  int m_maxVerticalSampling = 1;
+  size_t m_numMcusX = 0;
+  size_t m_numMcusY = 0;
+
+  uint16_t m_quantizationTables[4][64] = {};
+  bool m_hasQuantizationTable[4] = {};
+  HuffmanTable m_dcTables[4];
+  HuffmanTable m_acTables[4];
+  uint32_t m_restartInterval = 0;
+
+  bool m_hasJfifMarker = false;
+  bool m_hasAdobeMarker = false;
+  uint8_t m_adobeTransform = 0;
+
+  bool ReadMarker(uint8_t* marker);
+  bool ReadSegment(const unsigned char** segment, size_t* size);
+
+  bool ReadFrameHeader(const unsigned char* segment, size_t size);
+  bool ReadQuantizationTables(const unsigned char* segment, size_t size);
+  bool ReadHuffmanTables(const unsigned char* segment, size_t size);
+  bool ReadScan(const unsigned char* segment, size_t size);
+
+  void DecodeBlock(BitReader* reader, Component* component, size_t blockX, size_t blockY);
+
+  ColorTransform GetColorTransform() const;
+  void Upsample(const Component& component, std::vector<uint8_t>* plane) const;
+
+ public:
+  JpegReader(const unsigned char* data, size_t size) : m_data(data), m_end(data + size), m_position(data) {}
+
+  // With |stopAtFrame| only the headers up to the frame header are read.
+  bool Read(bool stopAtFrame);
+  void Output(unsigned char* pixels, size_t rowPitch) const;
+
+  uint32_t GetWidth() const { return m_width; }
+  uint32_t GetHeight() const { return m_height; }
+};
+
+bool JpegReader::ReadMarker(uint8_t* marker) {
+  // Skips anything that isn't a marker, including fill bytes.
+  while (m_position < m_end) {
+    if (*m_position++ != 0xFF)
+      continue;
+    while (m_position < m_end && *m_position == 0xFF) {
+      ++m_position;
+    }
+    if (m_position == m_end)
+      return false;
+    const uint8_t value = *m_position++;
+    if (value != 0x00) {
+      *marker = value;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool JpegReader::ReadSegment(const unsigned char** segment, size_t* size) {
+  if (m_end - m_position < 2)
+    return false;
+
+  const uint16_t length = ReadBigEndian16(m_position);
+  if (length < 2 || length > m_end - m_position)
+    return false;
+
+  *segment = m_position + 2;
+  *size = length - 2;
+  m_position += length;
+  return true;
+}
+
+bool JpegReader::ReadFrameHeader(const unsigned char* segment, size_t size) {
+  if (size < 6)
+    return false;
+
+  const uint8_t precision = segment[0];
+  m_height = ReadBigEndian16(segment + 1);
+  m_width = ReadBigEndian16(segment + 3);
+  m_numComponents = segment[5];
+
+  // A height of 0 means that it's defined by a DNL marker after the first scan, which nobody uses.
+  if (precision != 8 || m_width == 0 || m_height == 0 || (m_numComponents != 1 && m_numComponents != 3) ||
+      size < 6 + 3 * (size_t)m_numComponents)
+    return false;
+
+  for (int i = 0; i < m_numComponents; ++i) {
+    Component& component = m_components[i];
+    const unsigned char* spec = segment + 6 + 3 * i;
+    component.id = spec[0];
+    component.horizontalSampling = spec[1] >> 4;
+    component.verticalSampling = spec[1] & 0xF;
+    component.quantizationTable = spec[2];
+    if (component.horizontalSampling < 1 || component.horizontalSampling > 4 || component.verticalSampling < 1 ||
+        component.verticalSampling > 4 || component.quantizationTable > 3)
+      return false;
+
+    m_maxHorizontalSampling = std::max<int>(m_maxHorizontalSampling, component.horizontalSampling);
+    m_maxVerticalSampling = std::max<int>(m_maxVerticalSampling, component.verticalSampling);
+  }
+
+  m_numMcusX = (m_width + 8 * m_maxHorizontalSampling - 1) / (8 * m_maxHorizontalSampling);
+  m_numMcusY = (m_height + 8 * m_maxVerticalSampling - 1) / (8 * m_maxVerticalSampling);
+
+  for (int i = 0; i < m_numComponents; ++i) {
+    Component& component = m_components[i];
+    // Like libjpeg, only integral subsampling ratios are supported.
+    if (m_maxHorizontalSampling % component.horizontalSampling != 0 ||
+        m_maxVerticalSampling % component.verticalSampling != 0)
+      return false;
+
+    component.width = ((size_t)m_width * component.horizontalSampling + m_maxHorizontalSampling - 1) /
+                      m_maxHorizontalSampling;
+    component.height = ((size_t)m_height * component.verticalSampling + m_maxVerticalSampling - 1) /
+                       m_maxVerticalSampling;
+  }
+
+  return true;
+}
+
+bool JpegReader::ReadQuantizationTables(const unsigned char* segment, size_t size) {
+  while (size > 0) {
+    const int precision = segment[0] >> 4;
+    const int index = segment[0] & 0xF;
+    const size_t tableSize = 1 + 64 * (precision + 1);
+    if (precision > 1 || index > 3 || size < tableSize)
+      return false;
+
+    for (int i = 0; i < 64; ++i) {
+      const uint16_t value = (precision == 0) ? segment[1 + i] : ReadBigEndian16(segment + 1 + 2 * i);
+      m_quantizationTables[index][kZigzagToNatural[i]] = value;
+    }
+    m_hasQuantizationTable[index] = true;
+
+    segment += tableSize;
+    size -= tableSize;
+  }
+  return true;
+}
+
+bool JpegReader::ReadHuffmanTables(const unsigned char* segment, size_t size) {
+  while (size > 0) {
+    if (size < 17)
+      return false;
+
+    const int tableClass = segment[0] >> 4;
+    const int index = segment[0] & 0xF;
+    if (tableClass > 1 || index > 3)
+      return false;
+
+    const uint8_t* counts = segment + 1;
+    size_t numValues = 0;
+    for (int i = 0; i < 16; ++i) {
+      numValues += counts[i];
+    }
+    if (numValues > 256 || size < 17 + numValues)
+      return false;
+
+    HuffmanTable& table = (tableClass == 0) ? m_dcTables[index] : m_acTables[index];
+    if (!table.Build(counts, segment + 17, numValues))
+      return false;
+
+    segment += 17 + numValues;
+    size -= 17 + numValues;
+  }
+  return true;
+}
+
+void JpegReader::DecodeBlock(BitReader* reader, Component* component, size_t blockX, size_t blockY) {
+  int16_t coefficients[64] = {};
+
+  const HuffmanTable& dcTable = m_dcTables[component->dcTable];
+  const int dcSize = reader->DecodeHuffman(dcTable);
+  // Coefficients are 16 bits, so wrapping the predictor around only makes a difference for corrupt files.
+  component->dcPredictor = (int16_t)(component->dcPredictor + reader->ReceiveExtend(std::min(dcSize, 15)));
+  coefficients[0] = (int16_t)component->dcPredictor;
+
+  const HuffmanTable& acTable = m_acTables[component->acTable];
+  for (int k = 1; k < 64;) {
+    const uint8_t symbol = reader->DecodeHuffman(acTable);
+    const int run = symbol >> 4;
+    const int acSize = symbol & 0xF;
+    if (acSize == 0) {
+      // Either a run of 16 zeros, or the end of the block.
+      if (run != 15)
+        break;
+      k += 16;
+      continue;
+    }
+
+    k += run;
+    if (k > 63)
+      break;
+    coefficients[kZigzagToNatural[k++]] = (int16_t)reader->ReceiveExtend(acSize);
+  }
+
+  uint8_t* out = component->samples.data() + blockY * 8 * component->stride + blockX * 8;
+  idct::InverseDct(coefficients, m_quantizationTables[component->quantizationTable], out, component->stride);
+}
+
+bool JpegReader::ReadScan(const unsigned char* segment, size_t size) {
+  if (size < 1)
+    return false;
+
+  const int numScanComponents = segment[0];
+  if (numScanComponents < 1 || numScanComponents > m_numComponents || size < 4 + 2 * (size_t)numScanComponents)
+    return false;
+
+  Component* scanComponents[kMaxComponents];
+  for (int i = 0; i < numScanComponents; ++i) {
+    const uint8_t id = segment[1 + 2 * i];
+    const uint8_t tables = segment[2 + 2 * i];
+
+    Component* component = std::find_if(m_components, m_components + m_numComponents,
+                                         [id](const Component& c) { return c.id == id; });
+    if (component == m_components + m_numComponents)
+      return false;
+
+    component->dcTable = tables >> 4;
+    component->acTable = tables & 0xF;
+    if (component->dcTable > 3 || component->acTable > 3 || !m_dcTables[component->dcTable].isDefined ||
+        !m_acTables[component->acTable].isDefined || !m_hasQuantizationTable[component->quantizationTable])
+      return false;
+
+    component->dcPredictor = 0;
+    scanComponents[i] = component;
+  }
+
+  // Spectral selection and successive approximation are only meaningful for progressive files; sequential files have
+  // to cover all coefficients in one go.
+  const unsigned char* selection = segment + 1 + 2 * numScanComponents;
+  if (selection[0] != 0 || selection[1] != 63 || selection[2] != 0)
+    return false;
+
+  BitReader reader(m_position, m_end);
+  uint32_t restartsToGo = m_restartInterval;
+  auto handleRestart = [&]() {
+    if (m_restartInterval == 0)
+      return;
+    if (restartsToGo == 0) {
+      reader.Restart();
+      for (int i = 0; i < numScanComponents; ++i) {
+        scanComponents[i]->dcPredictor = 0;
+      }
+      restartsToGo = m_restartInterval;
+    }
+    --restartsToGo;
+  };
+
+  if (numScanComponents == 1) {
+    // Non-interleaved scans cover only the blocks that overlap the component, not all of the MCU padding.
+    Component* component = scanComponents[0];
+    const size_t numBlocksX = (component->width + 7) / 8;
+    const size_t numBlocksY = (component->height + 7) / 8;
+    for (size_t blockY = 0; blockY < numBlocksY; ++blockY) {
+      for (size_t blockX = 0; blockX < numBlocksX; ++blockX) {
+        handleRestart();
+        DecodeBlock(&reader, component, blockX, blockY);
+      }
+    }
+  } else {
+    for (size_t mcuY = 0; mcuY < m_numMcusY; ++mcuY) {
+      for (size_t mcuX = 0; mcuX < m_numMcusX; ++mcuX) {
+        handleRestart();
+        for (int i = 0; i < numScanComponents; ++i) {
+          Component* component = scanComponents[i];
+          for (size_t y = 0; y < component->verticalSampling; ++y) {
+            for (size_t x = 0; x < component->horizontalSampling; ++x) {
+              DecodeBlock(&reader, component, mcuX * component->horizontalSampling + x,
+                          mcuY * component->verticalSampling + y);
+            }
+          }
+        }
+      }
+    }
+  }
+
+  m_position = reader.GetPosition();
+  return true;
+}
+
+bool JpegReader::Read(bool stopAtFrame) {
+  if (m_end - m_data < 2 || m_data[0] != 0xFF || m_data[1] != StartOfImage)
+    return false;
+  m_position = m_data + 2;
+
+  bool hasFrame = false;
+  bool hasScan = false;
+  uint8_t marker;
+  while (ReadMarker(&marker)) {
+    // These markers don't have a segment.
+    if (marker == EndOfImage)
+      break;
+    if ((marker >= Restart0 && marker <= Restart7) || marker == 0x01)
+      continue;
+
+    const unsigned char* segment;
+    size_t size;
+    if (!ReadSegment(&segment, &size))
+      return false;
+
+    switch (marker) {
+      case StartOfFrameBaseline:
+      case StartOfFrameExtended: {
+        if (hasFrame || !ReadFrameHeader(segment, size))
+          return false;
+        hasFrame = true;
+        if (stopAtFrame)
+          return true;
+
+        for (int i = 0; i < m_numComponents; ++i) {
+          Component& component = m_components[i];
+          component.stride = m_numMcusX * component.horizontalSampling * 8;
+          component.samples.assign(component.stride * m_numMcusY * component.verticalSampling * 8, 0);
+        }
+      } break;
+
+      case DefineHuffmanTables:
+        if (!ReadHuffmanTables(segment, size))
+          return false;
+        break;
+
+      case DefineQuantizationTables:
+        if (!ReadQuantizationTables(segment, size))
+          return false;
+        break;
+
+      case DefineRestartInterval:
+        if (size < 2)
+          return false;
+        m_restartInterval = ReadBigEndian16(segment);
+        break;
+
+      case StartOfScan:
+        if (!hasFrame || !ReadScan(segment, size))
+          return false;
+        hasScan = true;
+        break;
+
+      case App0:
+        if (size >= 5 && memcmp(segment, "JFIF\0", 5) == 0)
+          m_hasJfifMarker = true;
+        break;
+
+      case App14:
+        if (size >= 12 && memcmp(segment, "Adobe", 5) == 0) {
+          m_hasAdobeMarker = true;
+          m_adobeTransform = segment[11];
+        }
+        break;
+
+      default:
+        // Any other kind of frame (progressive, lossless, arithmetic-coded, ...) isn't supported. Everything else
+        // (comments, other app segments) can be skipped.
+        if (marker >= 0xC0 && marker <= 0xCF)
+          return false;
+        break;
+    }
+  }
+
+  // Files that are cut off after the first scan still get decoded as far as they go.
+  return hasFrame && hasScan;
+}
+
+ColorTransform JpegReader::GetColorTransform() const {
+  if (m_numComponents == 1)
+    return ColorTransform::None;
+
+  // The same guesswork that libjpeg does.
+  if (m_hasJfifMarker)
+    return ColorTransform::YCbCr;
+  if (m_hasAdobeMarker)
+    return (m_adobeTransform == 0) ? ColorTransform::Rgb : ColorTransform::YCbCr;
+  if (m_components[0].id == 'R' && m_components[1].id == 'G' && m_components[2].id == 'B')
+    return ColorTransform::Rgb;
+  return ColorTransform::YCbCr;
+}
+
+// Scales a component up to the full image size in |plane| (m_width * m_height bytes). The 2x cases use the same
+// triangle filters as libjpeg's "fancy" upsampling; other ratios just replicate samples.
+void JpegReader::Upsample(const Component& component, std::vector<uint8_t>* plane) const {
+  plane->resize((size_t)m_width * m_height);
+
+  const int horizontalRatio = m_maxHorizontalSampling / component.horizontalSampling;
+  const int verticalRatio = m_maxVerticalSampling / component.verticalSampling;
+  const size_t width = component.width;
+  const size_t lastRow = component.height - 1;
+
+  // libjpeg falls back to replicating samples for very narrow components.
+  const bool useHorizontalFilter = (horizontalRatio == 2 && width > 2);
+  const bool useVerticalFilter = (verticalRatio == 2) && (horizontalRatio == 1 || useHorizontalFilter);
+
+  // Output rows are up to one sample wider than the image (for odd widths), so they're built in a scratch row.
+  std::vector<uint8_t> row(width * horizontalRatio);
+
+  for (size_t y = 0; y < m_height; ++y) {
+    const size_t sourceY = y / verticalRatio;
+    const uint8_t* input = component.samples.data() + sourceY * component.stride;
+    uint8_t* out = row.data();
+
+    if (useVerticalFilter) {
+      // Blends in the nearest row above (for even output rows) or below (for odd ones).
+      const bool isUpperRow = (y % 2 == 0);
+      const size_t neighborY = isUpperRow ? (sourceY > 0 ? sourceY - 1 : 0) : std::min(sourceY + 1, lastRow);
+      const uint8_t* neighbor = component.samples.data() + neighborY * component.stride;
+
+      if (horizontalRatio == 1) {
+        const int bias = isUpperRow ? 1 : 2;
+        for (size_t x = 0; x < width; ++x) {
+          out[x] = (uint8_t)((input[x] * 3 + neighbor[x] + bias) >> 2);
+        }
+      } else {
+        int thisColumnSum = input[0] * 3 + neighbor[0];
+        int nextColumnSum = input[1] * 3 + neighbor[1];
+        *out++ = (uint8_t)((thisColumnSum * 4 + 8) >> 4);
+        *out++ = (uint8_t)((thisColumnSum * 3 + nextColumnSum + 7) >> 4);
+        int lastColumnSum = thisColumnSum;
+        thisColumnSum = nextColumnSum;
+        for (size_t x = 1; x < width - 1; ++x) {
+          nextColumnSum = input[x + 1] * 3 + neighbor[x + 1];
+          *out++ = (uint8_t)((thisColumnSum * 3 + lastColumnSum + 8) >> 4);
+          *out++ = (uint8_t)((thisColumnSum * 3 + nextColumnSum + 7) >> 4);
+          lastColumnSum = thisColumnSum;
+          thisColumnSum = nextColumnSum;
+        }
+        *out++ = (uint8_t)((thisColumnSum * 3 + lastColumnSum + 8) >> 4);
+        *out++ = (uint8_t)((thisColumnSum * 4 + 7) >> 4);
+      }
+    } else if (useHorizontalFilter) {
+      *out++ = input[0];
+      *out++ = (uint8_t)((input[0] * 3 + input[1] + 2) >> 2);
+      for (size_t x = 1; x < width - 1; ++x) {
+        const int value = input[x] * 3;
+        *out++ = (uint8_t)((value + input[x - 1] + 1) >> 2);
+        *out++ = (uint8_t)((value + input[x + 1] + 2) >> 2);
+      }
+      *out++ = (uint8_t)((input[width - 1] * 3 + input[width - 2] + 1) >> 2);
+      *out++ = input[width - 1];
+    } else {
+      for (size_t x = 0; x < width; ++x) {
+        for (int i = 0; i < horizontalRatio; ++i) {
+          *out++ = input[x];
+        }
+      }
+    }
+
+    memcpy(plane->data() + y * m_width, row.data(), m_width);
+  }
+}
+
+void JpegReader::Output(unsigned char* pixels, size_t rowPitch) const {
+  std::vector<uint8_t> planes[kMaxComponents];
+  for (int i = 0; i < m_numComponents; ++i) {
+    Upsample(m_components[i], &planes[i]);
+  }
+
+  const ColorTransform transform = GetColorTransform();
+  if (transform == ColorTransform::None) {
+    for (size_t y = 0; y < m_height; ++y) {
+      const uint8_t* gray = planes[0].data() + y * m_width;
+      unsigned char* out = pixels + y * rowPitch;
+      for (size_t x = 0; x < m_width; ++x, out += 4) {
+        out[0] = out[1] = out[2] = gray[x];
+        out[3] = 255;
+      }
+    }
+    return;
+  }
+
+  if (transform == ColorTransform::Rgb) {
+    for (size_t y = 0; y < m_height; ++y) {
+      const size_t offset = y * m_width;
+      unsigned char* out = pixels + y * rowPitch;
+      for (size_t x = 0; x < m_width; ++x, out += 4) {
+        out[0] = planes[0][offset + x];
+        out[1] = planes[1][offset + x];
+        out[2] = planes[2][offset + x];
+        out[3] = 255;
+      }
+    }
+    return;
+  }
+
+  // The fixed-point conversion from libjpeg's jdcolor.c.
+  constexpr int kScaleBits = 16;
+  constexpr int32_t kOneHalf = 1 << (kScaleBits - 1);
+  auto fix = [](double x) { return (int32_t)(x * (1 << kScaleBits) + 0.5); };
+
+  int crToR[256];
+  int cbToB[256];
+  int32_t crToG[256];
+  int32_t cbToG[256];
+  for (int i = 0; i < 256; ++i) {
+    const int32_t x = i - 128;
+    crToR[i] = (int)((fix(1.40200) * x + kOneHalf) >> kScaleBits);
+    cbToB[i] = (int)((fix(1.77200) * x + kOneHalf) >> kScaleBits);
+    crToG[i] = -fix(0.71414) * x;
+    cbToG[i] = -fix(0.34414) * x + kOneHalf;
+  }
+
+  auto clamp = [](int value) { return (unsigned char)std::clamp(value, 0, 255); };
+  for (size_t y = 0; y < m_height; ++y) {
+    const size_t offset = y * m_width;
+    unsigned char* out = pixels + y * rowPitch;
+    for (size_t x = 0; x < m_width; ++x, out += 4) {
+      const int luma = planes[0][offset + x];
+      const int cb = planes[1][offset + x];
+      const int cr = planes[2][offset + x];
+      out[0] = clamp(luma + crToR[cr]);
+      out[1] = clamp(luma + (int)((cbToG[cb] + crToG[cr]) >> kScaleBits));
+      out[2] = clamp(luma + cbToB[cb]);
+      out[3] = 255;
+    }
+  }
+}
+}  // namespace
+
+bool JpegDecoder::ReadInfo(const unsigned char* data, size_t size, Info* info) const {
+  JpegReader reader(data, size);
+  if (!reader.Read(/*stopAtFrame=*/true))
+    return false;
+
+  info->width = reader.GetWidth();
+  info->height = reader.GetHeight();
+  return true;
+}
+
+bool JpegDecoder::Decode(const unsigned char* data, size_t size, unsigned char* pixels, size_t rowPitch) const {
+  JpegReader reader(data, size);
+  if (!reader.Read(/*stopAtFrame=*/false))
+    return false;
+
+  reader.Output(pixels, rowPitch);
+  return true;
+}
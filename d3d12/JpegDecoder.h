@@ -0,0 +1,15 @@
+#pragma once
+
+#include "d3d12/ImageDecoder.h"
+
+// Supports baseline and extended sequential (8-bit, Huffman-coded) jpeg files with one (grayscale) or three (YCbCr
+// or RGB) components and any chroma subsampling. The output matches libjpeg's default settings: the integer IDCT and
+// "fancy" upsampling.
+//
+// Progressive, arithmetic-coded, lossless and CMYK files are turned down by ReadInfo, so that another decoder gets a
+// chance at them.
+class JpegDecoder : public ImageDecoder {
+ public:
+  bool ReadInfo(const unsigned char* data, size_t size, Info* info) const override;
+  bool Decode(const unsigned char* data, size_t size, unsigned char* pixels, size_t rowPitch) const override;
+};
@@ -0,0 +1,471 @@
+#include "d3d12/MeshCache.h"
+
+#include "utils/Checksum.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#include <atomic>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <system_error>
+#include <thread>
+
+namespace {
+constexpr char kMagic[8] = {'M', 'V', 'W', 'M', 'E', 'S', 'H', '\0'};
+
+// Bump this whenever the layout of the cache, or of any of the structs that are stored in it, changes; or when parsed
+// models are processed differently before they're cached.
+constexpr uint32_t kVersion = 15;
+
+constexpr uint64_t kSectionAlignment = 16;
+
+struct Section {
+  uint64_t offset;  // From the start of the file.
+  uint64_t count;
+};
+
+// Refers to a range of the string section. Strings are not null-terminated.
+struct StringRef {
+  uint64_t offset;
+  uint64_t length;
+};
+
+struct MaterialRecord {
+  StringRef name;
+  StringRef diffuseMap;  // Relative to the obj file's directory.
+  StringRef bumpMap;     // Likewise.
+  ObjFileData::Color ambientColor;
+  ObjFileData::Color diffuseColor;
+  ObjFileData::Color specularColor;
+  float specularExponent;
+};
+
+struct Header {
+  char magic[8];
+  uint32_t version;
+
+  // Sanity checks, in case the structs change without the version being bumped.
+  uint32_t vertexSize;
+  uint32_t tangentSize;
+  uint32_t indexSize;
+  uint32_t meshPartSize;
+  uint32_t meshletSize;
+  uint32_t lodSize;
+  uint32_t drawSize;
+  uint32_t materialRecordSize;
+
+  uint32_t mergeMeshParts;  // The ParseOptions::mergeMeshParts that the data was parsed with.
+
+  uint64_t fileSize;
+  uint64_t checksum;  // Of the whole file, with this field zeroed (see ComputeCacheChecksum).
+
+  Section vertices;
+  Section tangents;  // Empty, or one for each vertex.
+  Section indices;
+  Section meshParts;
+  Section meshlets;
+  Section lods;
+  Section packedIndexPool;    // uint16_ts.
+  Section draws;              // IndexPacking::Draws.
+  Section firstDraws;         // One for each mesh part and level of detail, and one past the end.
+  Section materials;          // MaterialRecords.
+  Section materialLibraries;  // StringRefs, relative to the obj file's directory.
+  Section strings;            // chars.
+
+  ObjFileData::AxisAlignedBounds bounds;
+};
+}  // namespace
+
+// The header is checksummed too, since a corrupt section table or bounds would go unnoticed otherwise. The body is
+// hashed on its own, so that its blocks are still hashed in parallel.
+static uint64_t ComputeCacheChecksum(const Header& header, const char* body, size_t bodySize) {
+  Header headerWithoutChecksum = header;
+  headerWithoutChecksum.checksum = 0;
+  const uint64_t checksums[2] = {ComputeChecksum(&headerWithoutChecksum, sizeof(Header)),
+                                 ComputeChecksum(body, bodySize)};
+  return ComputeChecksum(checksums, sizeof(checksums));
+}
+
+// Returns whether all of the indices, offset by |baseVertex|, refer to one of the |numVertices| vertices.
+template <class IndexType>
+static bool AreIndicesValid(const IndexType* indices, size_t numIndices, int64_t baseVertex, size_t numVertices) {
+  for (size_t i = 0; i < numIndices; ++i) {
+    const int64_t vertex = static_cast<int64_t>(indices[i]) + baseVertex;
+    if (vertex < 0 || static_cast<uint64_t>(vertex) >= numVertices)
+      return false;
+  }
+  return true;
+}
+
+// Several instances of the same model can be loading at once, and each of them writes the cache. Each write gets a
+// temporary file of its own, so that they don't overwrite each other's half-written ones.
+static std::filesystem::path GetTempPath(const std::filesystem::path& cachePath) {
+  static std::atomic<uint64_t> s_numWrites = 0;
+  std::filesystem::path tempPath = cachePath;
+  tempPath += "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + "." +
+              std::to_string(s_numWrites++) + ".tmp";
+  return tempPath;
+}
+
+static uint64_t AlignUp(uint64_t value, uint64_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+// Paths are stored relative to the obj file, so that the cache doesn't depend on the working directory (or on where
+// the models folder lives).
+static std::string MakeRelativePath(const std::filesystem::path& path, const std::filesystem::path& directory) {
+  if (path.empty())
+    return std::string();
+
+  std::filesystem::path relativePath = path.lexically_relative(directory);
+  return (relativePath.empty() ? path : relativePath).u8string();
+}
+
+static std::filesystem::path ResolveRelativePath(const std::string& path, const std::filesystem::path& directory) {
+  if (path.empty())
+    return std::filesystem::path();
+
+  return directory / std::filesystem::u8path(path);
+}
+
+/*static*/
+std::filesystem::path MeshCache::GetCachePath(const std::filesystem::path& objFilePath) {
+  std::filesystem::path cachePath = objFilePath;
+  cachePath += ".meshcache";
+  return cachePath;
+}
+
+/*static*/
+bool MeshCache::Write(const std::filesystem::path& cachePath,
+                      const std::filesystem::path& objFilePath,
+                      const ObjFileData& data,
+                      const IndexPacking::PackedIndices& packedIndices,
+                      bool mergeMeshParts) {
+  const std::filesystem::path objDirectory = objFilePath.parent_path();
+
+  std::string strings;
+  auto addString = [&strings](const std::string& str) {
+    StringRef ref = {strings.size(), str.size()};
+    strings += str;
+    return ref;
+  };
+
+  std::vector<MaterialRecord> materialRecords;
+  materialRecords.reserve(data.m_materials.size());
+  for (const ObjFileData::Material& material : data.m_materials) {
+    MaterialRecord record = {};
+    record.name = addString(material.name);
+    record.diffuseMap = addString(MakeRelativePath(material.diffuseMap.file, objDirectory));
+    record.bumpMap = addString(MakeRelativePath(material.bumpMap.file, objDirectory));
+    record.ambientColor = material.ambientColor;
+    record.diffuseColor = material.diffuseColor;
+    record.specularColor = material.specularColor;
+    record.specularExponent = material.specularExponent;
+    materialRecords.push_back(record);
+  }
+
+  std::vector<StringRef> materialLibraries;
+  materialLibraries.reserve(data.m_materialLibraries.size());
+  for (const std::filesystem::path& materialLibrary : data.m_materialLibraries) {
+    materialLibraries.push_back(addString(MakeRelativePath(materialLibrary, objDirectory)));
+  }
+
+  Header header = {};
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.vertexSize = sizeof(ObjFileData::Vertex);
+  header.tangentSize = sizeof(ObjFileData::Tangent);
+  header.indexSize = sizeof(uint32_t);
+  header.meshPartSize = sizeof(ObjFileData::MeshPart);
+  header.meshletSize = sizeof(ObjFileData::Meshlet);
+  header.lodSize = sizeof(ObjFileData::MeshLod);
+  header.drawSize = sizeof(IndexPacking::Draw);
+  header.materialRecordSize = sizeof(MaterialRecord);
+  header.mergeMeshParts = mergeMeshParts ? 1 : 0;
+  header.bounds = data.m_bounds;
+
+  struct SectionData {
+    Section* section;
+    const void* data;
+    uint64_t size;
+  };
+  const SectionData sections[] = {
+    {&header.vertices, data.m_vertices.data(), data.m_vertices.size() * sizeof(ObjFileData::Vertex)},
+    {&header.tangents, data.m_tangents.data(), data.m_tangents.size() * sizeof(ObjFileData::Tangent)},
+    {&header.indices, data.m_indices.data(), data.m_indices.size() * sizeof(uint32_t)},
+    {&header.meshParts, data.m_meshParts.data(), data.m_meshParts.size() * sizeof(ObjFileData::MeshPart)},
+    {&header.meshlets, data.m_meshlets.data(), data.m_meshlets.size() * sizeof(ObjFileData::Meshlet)},
+    {&header.lods, data.m_lods.data(), data.m_lods.size() * sizeof(ObjFileData::MeshLod)},
+    {&header.packedIndexPool, packedIndices.pool.data(), packedIndices.pool.size() * sizeof(uint16_t)},
+    {&header.draws, packedIndices.draws.data(), packedIndices.draws.size() * sizeof(IndexPacking::Draw)},
+    {&header.firstDraws, packedIndices.firstDraws.data(), packedIndices.firstDraws.size() * sizeof(uint32_t)},
+    {&header.materials, materialRecords.data(), materialRecords.size() * sizeof(MaterialRecord)},
+    {&header.materialLibraries, materialLibraries.data(), materialLibraries.size() * sizeof(StringRef)},
+    {&header.strings, strings.data(), strings.size()},
+  };
+  header.vertices.count = data.m_vertices.size();
+  header.tangents.count = data.m_tangents.size();
+  header.indices.count = data.m_indices.size();
+  header.meshParts.count = data.m_meshParts.size();
+  header.meshlets.count = data.m_meshlets.size();
+  header.lods.count = data.m_lods.size();
+  header.packedIndexPool.count = packedIndices.pool.size();
+  header.draws.count = packedIndices.draws.size();
+  header.firstDraws.count = packedIndices.firstDraws.size();
+  header.materials.count = materialRecords.size();
+  header.materialLibraries.count = materialLibraries.size();
+  header.strings.count = strings.size();
+
+  uint64_t offset = sizeof(Header);
+  for (const SectionData& sectionData : sections) {
+    offset = AlignUp(offset, kSectionAlignment);
+    sectionData.section->offset = offset;
+    offset += sectionData.size;
+  }
+  header.fileSize = offset;
+
+  // Write to a temporary file first, so that a crash halfway through can never leave a cache behind that looks valid.
+  const std::filesystem::path tempPath = GetTempPath(cachePath);
+  auto writeTempFile = [&]() {
+    {
+      std::ofstream file(tempPath, std::ios::out | std::ios::binary | std::ios::trunc);
+      if (!file.is_open())
+        return false;
+
+      // The checksum isn't known yet; it's patched in once everything else has been written.
+      file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+      const char padding[kSectionAlignment] = {};
+      uint64_t currentOffset = sizeof(Header);
+      for (const SectionData& sectionData : sections) {
+        file.write(padding, sectionData.section->offset - currentOffset);
+        file.write(static_cast<const char*>(sectionData.data), sectionData.size);
+        currentOffset = sectionData.section->offset + sectionData.size;
+      }
+
+      if (!file)
+        return false;
+    }
+
+    {
+      // Reading the file back is cheaper than holding a second copy of all of the data in memory.
+      MappedFile writtenFile;
+      if (!writtenFile.Open(tempPath.string()) || writtenFile.GetSize() != header.fileSize)
+        return false;
+
+      header.checksum =
+          ComputeCacheChecksum(header, writtenFile.GetData() + sizeof(Header), writtenFile.GetSize() - sizeof(Header));
+    }
+
+    {
+      std::fstream file(tempPath, std::ios::in | std::ios::out | std::ios::binary);
+      if (!file.is_open())
+        return false;
+
+      file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+      if (!file)
+        return false;
+    }
+
+    return true;
+  };
+
+  const bool isWritten = writeTempFile();
+  std::error_code error;
+  if (isWritten)
+    std::filesystem::rename(tempPath, cachePath, error);
+  if (!isWritten || error) {
+    std::filesystem::remove(tempPath, error);
+    return false;
+  }
+  return true;
+}
+
+// Returns whether the cache was written after |sourcePath| was last modified.
+static bool IsNewerThan(const std::filesystem::file_time_type& cacheTime, const std::filesystem::path& sourcePath) {
+  std::error_code error;
+  std::filesystem::file_time_type sourceTime = std::filesystem::last_write_time(sourcePath, error);
+  return !error && sourceTime <= cacheTime;
+}
+
+// Returns whether the section fits within the file, without overflowing along the way.
+static bool IsSectionValid(const Section& section, uint64_t elementSize, uint64_t fileSize) {
+  if (section.offset % kSectionAlignment != 0 || section.offset < sizeof(Header) || section.offset > fileSize)
+    return false;
+
+  return section.count <= (fileSize - section.offset) / elementSize;
+}
+
+bool MeshCache::Open(const std::filesystem::path& cachePath,
+                     const std::filesystem::path& objFilePath,
+                     bool mergeMeshParts) {
+  std::error_code error;
+  std::filesystem::file_time_type cacheTime = std::filesystem::last_write_time(cachePath, error);
+  if (error || !IsNewerThan(cacheTime, objFilePath))
+    return false;
+
+  if (!m_file.Open(cachePath.string()) || m_file.GetSize() < sizeof(Header))
+    return false;
+
+  const char* fileData = m_file.GetData();
+  const uint64_t fileSize = m_file.GetSize();
+
+  Header header;
+  memcpy(&header, fileData, sizeof(header));
+  if (memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion)
+    return false;
+
+  if (header.vertexSize != sizeof(ObjFileData::Vertex) || header.tangentSize != sizeof(ObjFileData::Tangent) ||
+      header.indexSize != sizeof(uint32_t) || header.meshPartSize != sizeof(ObjFileData::MeshPart) ||
+      header.meshletSize != sizeof(ObjFileData::Meshlet) || header.lodSize != sizeof(ObjFileData::MeshLod) ||
+      header.drawSize != sizeof(IndexPacking::Draw) || header.materialRecordSize != sizeof(MaterialRecord))
+    return false;
+
+  if (header.mergeMeshParts != (mergeMeshParts ? 1u : 0u))
+    return false;
+
+  if (header.fileSize != fileSize)
+    return false;
+
+  if (!IsSectionValid(header.vertices, sizeof(ObjFileData::Vertex), fileSize) ||
+      !IsSectionValid(header.tangents, sizeof(ObjFileData::Tangent), fileSize) ||
+      !IsSectionValid(header.indices, sizeof(uint32_t), fileSize) ||
+      !IsSectionValid(header.meshParts, sizeof(ObjFileData::MeshPart), fileSize) ||
+      !IsSectionValid(header.meshlets, sizeof(ObjFileData::Meshlet), fileSize) ||
+      !IsSectionValid(header.lods, sizeof(ObjFileData::MeshLod), fileSize) ||
+      !IsSectionValid(header.packedIndexPool, sizeof(uint16_t), fileSize) ||
+      !IsSectionValid(header.draws, sizeof(IndexPacking::Draw), fileSize) ||
+      !IsSectionValid(header.firstDraws, sizeof(uint32_t), fileSize) ||
+      !IsSectionValid(header.materials, sizeof(MaterialRecord), fileSize) ||
+      !IsSectionValid(header.materialLibraries, sizeof(StringRef), fileSize) ||
+      !IsSectionValid(header.strings, sizeof(char), fileSize))
+    return false;
+
+  const char* strings = fileData + header.strings.offset;
+  auto getString = [&](const StringRef& ref, std::string* str) {
+    if (ref.offset > header.strings.count || ref.length > header.strings.count - ref.offset)
+      return false;
+
+    str->assign(strings + ref.offset, ref.length);
+    return true;
+  };
+
+  // The dependencies are checked before the checksum, since that's by far the more common reason for the cache to be
+  // invalid and the checksum has to touch the entire file.
+  const std::filesystem::path objDirectory = objFilePath.parent_path();
+  const StringRef* materialLibraries = reinterpret_cast<const StringRef*>(fileData + header.materialLibraries.offset);
+  for (size_t i = 0; i < header.materialLibraries.count; ++i) {
+    std::string materialLibrary;
+    if (!getString(materialLibraries[i], &materialLibrary) ||
+        !IsNewerThan(cacheTime, ResolveRelativePath(materialLibrary, objDirectory)))
+      return false;
+  }
+
+  if (ComputeCacheChecksum(header, fileData + sizeof(Header), fileSize - sizeof(Header)) != header.checksum) {
+    std::cerr << "Warning: mesh cache " << cachePath.string() << " is corrupt." << std::endl;
+    return false;
+  }
+
+  m_materials.resize(header.materials.count);
+  const MaterialRecord* materialRecords = reinterpret_cast<const MaterialRecord*>(fileData + header.materials.offset);
+  for (size_t i = 0; i < header.materials.count; ++i) {
+    const MaterialRecord& record = materialRecords[i];
+    ObjFileData::Material& material = m_materials[i];
+
+    std::string diffuseMap;
+    std::string bumpMap;
+    if (!getString(record.name, &material.name) || !getString(record.diffuseMap, &diffuseMap) ||
+        !getString(record.bumpMap, &bumpMap))
+      return false;
+
+    material.diffuseMap.file = ResolveRelativePath(diffuseMap, objDirectory);
+    material.bumpMap.file = ResolveRelativePath(bumpMap, objDirectory);
+    material.ambientColor = record.ambientColor;
+    material.diffuseColor = record.diffuseColor;
+    material.specularColor = record.specularColor;
+    material.specularExponent = record.specularExponent;
+  }
+
+  m_vertices = reinterpret_cast<const ObjFileData::Vertex*>(fileData + header.vertices.offset);
+  m_numVertices = header.vertices.count;
+  m_tangents = reinterpret_cast<const ObjFileData::Tangent*>(fileData + header.tangents.offset);
+  m_numTangents = header.tangents.count;
+  m_indices = reinterpret_cast<const uint32_t*>(fileData + header.indices.offset);
+  m_numIndices = header.indices.count;
+  m_meshParts = reinterpret_cast<const ObjFileData::MeshPart*>(fileData + header.meshParts.offset);
+  m_numMeshParts = header.meshParts.count;
+  m_meshlets = reinterpret_cast<const ObjFileData::Meshlet*>(fileData + header.meshlets.offset);
+  m_numMeshlets = header.meshlets.count;
+  m_lods = reinterpret_cast<const ObjFileData::MeshLod*>(fileData + header.lods.offset);
+  m_numLods = header.lods.count;
+  m_packedIndexPool = reinterpret_cast<const uint16_t*>(fileData + header.packedIndexPool.offset);
+  m_packedIndexPoolSize = header.packedIndexPool.count;
+  m_draws = reinterpret_cast<const IndexPacking::Draw*>(fileData + header.draws.offset);
+  m_numDraws = header.draws.count;
+  m_firstDraws = reinterpret_cast<const uint32_t*>(fileData + header.firstDraws.offset);
+  m_numFirstDraws = header.firstDraws.count;
+  m_bounds = header.bounds;
+
+  if (m_numTangents != 0 && m_numTangents != m_numVertices)
+    return false;
+
+  // The checksum only catches accidents, so anything that the renderer would index with is checked as well, rather
+  // than letting a cache that was written wrongly have it read past the end of its buffers.
+  if (!AreIndicesValid(m_indices, m_numIndices, /*baseVertex*/ 0, m_numVertices))
+    return false;
+
+  for (size_t i = 0; i < m_numMeshParts; ++i) {
+    const ObjFileData::MeshPart& meshPart = m_meshParts[i];
+    if (meshPart.materialIndex != static_cast<uint32_t>(-1) && meshPart.materialIndex >= m_materials.size())
+      return false;
+    if (meshPart.indexStart > m_numIndices || meshPart.numIndices > m_numIndices - meshPart.indexStart)
+      return false;
+    if (meshPart.meshletStart > m_numMeshlets || meshPart.numMeshlets > m_numMeshlets - meshPart.meshletStart)
+      return false;
+    if (meshPart.lodStart > m_numLods || meshPart.numLods > m_numLods - meshPart.lodStart)
+      return false;
+  }
+
+  for (size_t i = 0; i < m_numMeshlets; ++i) {
+    const ObjFileData::Meshlet& meshlet = m_meshlets[i];
+    if (meshlet.indexStart > m_numIndices || meshlet.numIndices > m_numIndices - meshlet.indexStart)
+      return false;
+  }
+
+  for (size_t i = 0; i < m_numLods; ++i) {
+    const ObjFileData::MeshLod& lod = m_lods[i];
+    if (lod.indexStart > m_numIndices || lod.numIndices > m_numIndices - lod.indexStart)
+      return false;
+  }
+
+  if (m_numFirstDraws != m_numMeshParts + m_numLods + 1)
+    return false;
+  for (size_t i = 0; i < m_numFirstDraws; ++i) {
+    if (m_firstDraws[i] > m_numDraws || (i > 0 && m_firstDraws[i] < m_firstDraws[i - 1]))
+      return false;
+  }
+
+  // In pool elements, of which 32-bit indices take up two.
+  for (size_t i = 0; i < m_numDraws; ++i) {
+    const IndexPacking::Draw& draw = m_draws[i];
+    if (draw.indexSize != 2 && draw.indexSize != 4)
+      return false;
+    const uint64_t elementsPerIndex = draw.indexSize / 2;
+    const uint64_t start = draw.indexStart * elementsPerIndex;
+    if (start > m_packedIndexPoolSize || draw.numIndices * elementsPerIndex > m_packedIndexPoolSize - start)
+      return false;
+
+    // The pool's section is aligned, so the 32-bit indices in it are too.
+    const bool areIndicesValid =
+        (draw.indexSize == 2)
+            ? AreIndicesValid(m_packedIndexPool + start, draw.numIndices, draw.baseVertex, m_numVertices)
+            : AreIndicesValid(reinterpret_cast<const uint32_t*>(m_packedIndexPool) + draw.indexStart, draw.numIndices,
+                              draw.baseVertex, m_numVertices);
+    if (!areIndicesValid)
+      return false;
+  }
+
+  return true;
+}
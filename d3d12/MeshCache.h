@@ -0,0 +1,84 @@
+#pragma once
+
+#include "d3d12/IndexPacking.h"
+#include "d3d12/ObjFileLoader.h"
+#include "utils/MappedFile.h"
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// A binary snapshot of a parsed obj file (and the mtl files that it references), stored next to the obj file so that
+// later loads can skip parsing entirely.
+//
+// The cache is laid out so that it can be memory-mapped and used as-is: the vertices (and their tangents), indices,
+// mesh parts, meshlets and levels of detail are stored exactly as they are laid out in memory, each section aligned to
+// 16 bytes. Only the materials (which contain variable-length strings) are unpacked when the cache is opened. The
+// indices are stored packed as well (see IndexPacking), so that they can be uploaded straight from the mapping.
+class MeshCache {
+ private:
+  MappedFile m_file;
+
+  const ObjFileData::Vertex* m_vertices = nullptr;
+  size_t m_numVertices = 0;
+  const ObjFileData::Tangent* m_tangents = nullptr;
+  size_t m_numTangents = 0;
+  const uint32_t* m_indices = nullptr;
+  size_t m_numIndices = 0;
+  const ObjFileData::MeshPart* m_meshParts = nullptr;
+  size_t m_numMeshParts = 0;
+  const ObjFileData::Meshlet* m_meshlets = nullptr;
+  size_t m_numMeshlets = 0;
+  const ObjFileData::MeshLod* m_lods = nullptr;
+  size_t m_numLods = 0;
+  const uint16_t* m_packedIndexPool = nullptr;
+  size_t m_packedIndexPoolSize = 0;
+  const IndexPacking::Draw* m_draws = nullptr;
+  size_t m_numDraws = 0;
+  const uint32_t* m_firstDraws = nullptr;
+  size_t m_numFirstDraws = 0;
+
+  std::vector<ObjFileData::Material> m_materials;
+  ObjFileData::AxisAlignedBounds m_bounds;
+
+ public:
+  // E.g. "models/house.obj" -> "models/house.obj.meshcache".
+  static std::filesystem::path GetCachePath(const std::filesystem::path& objFilePath);
+
+  // |packedIndices| are |data|'s indices, packed.
+  static bool Write(const std::filesystem::path& cachePath,
+                    const std::filesystem::path& objFilePath,
+                    const ObjFileData& data,
+                    const IndexPacking::PackedIndices& packedIndices,
+                    bool mergeMeshParts = true);
+
+  // Fails if the cache doesn't exist, is corrupt, was written by a different version of the format, or is older than
+  // the obj file or any of the mtl files that it was built from. |mergeMeshParts| is the ParseOptions one; a cache
+  // written with the other setting has different mesh parts, so it fails too.
+  bool Open(const std::filesystem::path& cachePath,
+            const std::filesystem::path& objFilePath,
+            bool mergeMeshParts = true);
+
+  const ObjFileData::Vertex* GetVertices() const { return m_vertices; }
+  size_t GetNumVertices() const { return m_numVertices; }
+  // Empty if the model has no tangents.
+  const ObjFileData::Tangent* GetTangents() const { return m_tangents; }
+  size_t GetNumTangents() const { return m_numTangents; }
+  const uint32_t* GetIndices() const { return m_indices; }
+  size_t GetNumIndices() const { return m_numIndices; }
+  const ObjFileData::MeshPart* GetMeshParts() const { return m_meshParts; }
+  size_t GetNumMeshParts() const { return m_numMeshParts; }
+  const ObjFileData::Meshlet* GetMeshlets() const { return m_meshlets; }
+  size_t GetNumMeshlets() const { return m_numMeshlets; }
+  const ObjFileData::MeshLod* GetLods() const { return m_lods; }
+  size_t GetNumLods() const { return m_numLods; }
+  // The parts of IndexPacking::PackedIndices. The pool's size is in uint16_t elements.
+  const uint16_t* GetPackedIndexPool() const { return m_packedIndexPool; }
+  size_t GetPackedIndexPoolSize() const { return m_packedIndexPoolSize; }
+  const IndexPacking::Draw* GetDraws() const { return m_draws; }
+  size_t GetNumDraws() const { return m_numDraws; }
+  const uint32_t* GetFirstDraws() const { return m_firstDraws; }
+  size_t GetNumFirstDraws() const { return m_numFirstDraws; }
+  const std::vector<ObjFileData::Material>& GetMaterials() const { return m_materials; }
+  const ObjFileData::AxisAlignedBounds& GetBounds() const { return m_bounds; }
+};
@@ -0,0 +1,338 @@
+#include "d3d12/MeshOptimizer.h"
+
+#include "utils/ThreadPool.h"
+
+#include <math.h>
+
+#include <algorithm>
+#include <limits>
+#include <unordered_map>
+
+namespace MeshOptimizer {
+
+namespace {
+constexpr uint32_t kNoVertex = std::numeric_limits<uint32_t>::max();
+
+// Tipsify, on a mesh part whose vertices have been renumbered to [0, numVertices). Returns the triangles in their new
+// order, and appends the position in that order at which each cluster starts to |clusterStarts|.
+std::vector<uint32_t> Tipsify(const std::vector<uint32_t>& indices,
+                              size_t numVertices,
+                              std::vector<size_t>* clusterStarts) {
+  const size_t numTriangles = indices.size() / 3;
+
+  // The triangles that use each vertex.
+  std::vector<uint32_t> adjacencyOffsets(numVertices + 1, 0);
+  for (uint32_t index : indices)
+    ++adjacencyOffsets[index + 1];
+  for (size_t v = 0; v < numVertices; ++v)
+    adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+
+  std::vector<uint32_t> adjacency(indices.size());
+  std::vector<uint32_t> numLiveTriangles(numVertices, 0);
+  for (size_t i = 0; i < indices.size(); ++i) {
+    const uint32_t v = indices[i];
+    adjacency[adjacencyOffsets[v] + numLiveTriangles[v]++] = static_cast<uint32_t>(i / 3);
+  }
+
+  // The time at which each vertex last entered the cache. Time advances with every cache miss, so a vertex is still
+  // cached as long as fewer than kCacheSize misses have happened since.
+  std::vector<size_t> cacheTimes(numVertices, 0);
+  size_t time = kCacheSize + 1;
+
+  std::vector<bool> isEmitted(numTriangles, false);
+  std::vector<uint32_t> deadEndStack;
+  std::vector<uint32_t> candidates;
+  size_t cursor = 0;
+
+  std::vector<uint32_t> order;
+  order.reserve(numTriangles);
+
+  // When none of the candidates are any use, continues with the most recently used vertex that still has triangles
+  // left, and failing that with the next such vertex in input order.
+  auto skipDeadEnd = [&]() -> uint32_t {
+    while (!deadEndStack.empty()) {
+      const uint32_t v = deadEndStack.back();
+      deadEndStack.pop_back();
+      if (numLiveTriangles[v] > 0)
+        return v;
+    }
+    for (; cursor < numVertices; ++cursor) {
+      if (numLiveTriangles[cursor] > 0)
+        return static_cast<uint32_t>(cursor);
+    }
+    return kNoVertex;
+  };
+
+  uint32_t fanningVertex = indices[0];
+  while (fanningVertex != kNoVertex) {
+    // Emit all of the remaining triangles around the fanning vertex.
+    candidates.clear();
+    for (uint32_t a = adjacencyOffsets[fanningVertex]; a < adjacencyOffsets[fanningVertex + 1]; ++a) {
+      const uint32_t triangle = adjacency[a];
+      if (isEmitted[triangle])
+        continue;
+
+      for (size_t corner = 0; corner < 3; ++corner) {
+        const uint32_t v = indices[triangle * 3 + corner];
+        deadEndStack.push_back(v);
+        candidates.push_back(v);
+        --numLiveTriangles[v];
+        if (time - cacheTimes[v] > kCacheSize)
+          cacheTimes[v] = time++;
+      }
+      isEmitted[triangle] = true;
+      order.push_back(triangle);
+    }
+
+    // Continue with the candidate that will still be in the cache once all of its triangles have been emitted, and
+    // that entered it the longest ago.
+    uint32_t nextVertex = kNoVertex;
+    ptrdiff_t bestPriority = -1;
+    for (uint32_t v : candidates) {
+      if (numLiveTriangles[v] == 0)
+        continue;
+
+      ptrdiff_t priority = 0;
+      if (time - cacheTimes[v] + 2 * numLiveTriangles[v] <= kCacheSize)
+        priority = static_cast<ptrdiff_t>(time - cacheTimes[v]);
+      if (priority > bestPriority) {
+        bestPriority = priority;
+        nextVertex = v;
+      }
+    }
+
+    if (nextVertex == kNoVertex) {
+      nextVertex = skipDeadEnd();
+      if (nextVertex != kNoVertex && clusterStarts->back() != order.size())
+        clusterStarts->push_back(order.size());
+    }
+    fanningVertex = nextVertex;
+  }
+
+  return order;
+}
+
+struct Cluster {
+  size_t start;
+  size_t end;
+  float occlusionPotential;
+};
+
+// Sorts the clusters so that the ones most likely to occlude the others come first: those that are furthest out from
+// the center of the part, in the direction that they face.
+void SortClustersForOverdraw(const ObjFileData::Vertex* vertices,
+                             const uint32_t* indices,
+                             std::vector<uint32_t>* order,
+                             const std::vector<size_t>& clusterStarts) {
+  std::vector<Cluster> clusters(clusterStarts.size());
+  std::vector<float> clusterCenters(clusterStarts.size() * 3, 0.f);
+  std::vector<float> clusterNormals(clusterStarts.size() * 3, 0.f);
+  float center[3] = {0.f, 0.f, 0.f};
+  float totalArea = 0.f;
+
+  for (size_t c = 0; c < clusters.size(); ++c) {
+    clusters[c].start = clusterStarts[c];
+    clusters[c].end = (c + 1 < clusterStarts.size()) ? clusterStarts[c + 1] : order->size();
+
+    // Area-weighted, so that slivers don't count for as much as the triangles that actually cover the screen.
+    float clusterArea = 0.f;
+    for (size_t t = clusters[c].start; t < clusters[c].end; ++t) {
+      const uint32_t triangle = (*order)[t];
+      const float* p0 = vertices[indices[triangle * 3 + 0]].pos;
+      const float* p1 = vertices[indices[triangle * 3 + 1]].pos;
+      const float* p2 = vertices[indices[triangle * 3 + 2]].pos;
+
+      const float e1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+      const float e2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+      const float normal[3] = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2],
+                               e1[0] * e2[1] - e1[1] * e2[0]};
+      const float area = 0.5f * sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+
+      for (size_t i = 0; i < 3; ++i) {
+        clusterCenters[c * 3 + i] += area * (p0[i] + p1[i] + p2[i]) / 3.f;
+        clusterNormals[c * 3 + i] += normal[i];
+      }
+      clusterArea += area;
+    }
+
+    for (size_t i = 0; i < 3; ++i)
+      center[i] += clusterCenters[c * 3 + i];
+    totalArea += clusterArea;
+    if (clusterArea > 0.f) {
+      for (size_t i = 0; i < 3; ++i)
+        clusterCenters[c * 3 + i] /= clusterArea;
+    }
+  }
+
+  // Degenerate parts have nothing to sort by.
+  if (totalArea <= 0.f)
+    return;
+
+  for (size_t i = 0; i < 3; ++i)
+    center[i] /= totalArea;
+
+  for (size_t c = 0; c < clusters.size(); ++c) {
+    const float* normal = &clusterNormals[c * 3];
+    const float length = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+    float potential = 0.f;
+    if (length > 0.f) {
+      for (size_t i = 0; i < 3; ++i)
+        potential += (clusterCenters[c * 3 + i] - center[i]) * normal[i] / length;
+    }
+    clusters[c].occlusionPotential = potential;
+  }
+
+  std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b) {
+    return a.occlusionPotential > b.occlusionPotential;
+  });
+
+  std::vector<uint32_t> sortedOrder;
+  sortedOrder.reserve(order->size());
+  for (const Cluster& cluster : clusters)
+    sortedOrder.insert(sortedOrder.end(), order->begin() + cluster.start, order->begin() + cluster.end);
+  *order = std::move(sortedOrder);
+}
+}  // namespace
+
+VertexCacheStatistics AnalyzeVertexCache(const uint32_t* indices, size_t numIndices, size_t numVertices) {
+  VertexCacheStatistics statistics;
+  if (numIndices == 0)
+    return statistics;
+
+  constexpr size_t kNotCached = std::numeric_limits<size_t>::max();
+  std::vector<size_t> cacheTimes(numVertices, kNotCached);
+  size_t numUsedVertices = 0;
+  for (size_t i = 0; i < numIndices; ++i) {
+    size_t& cacheTime = cacheTimes[indices[i]];
+    if (cacheTime == kNotCached)
+      ++numUsedVertices;
+    if (cacheTime == kNotCached || statistics.numTransformedVertices - cacheTime >= kCacheSize)
+      cacheTime = statistics.numTransformedVertices++;
+  }
+
+  statistics.acmr = static_cast<float>(statistics.numTransformedVertices) / (numIndices / 3);
+  statistics.atvr = static_cast<float>(statistics.numTransformedVertices) / numUsedVertices;
+  return statistics;
+}
+
+void OptimizeTriangleOrder(const ObjFileData::Vertex* vertices,
+                           size_t numVertices,
+                           uint32_t* indices,
+                           size_t numIndices) {
+  if (numIndices < 6)
+    return;
+
+  // Renumber the part's vertices densely, in the order they're first used, so that the rest of the per-vertex state
+  // only has to cover this part. The lookup table covers the whole model, so it's kept around for the thread's next
+  // part rather than being reallocated for each one.
+  thread_local std::vector<uint32_t> localVertexIds;
+  if (localVertexIds.size() < numVertices)
+    localVertexIds.assign(numVertices, kNoVertex);
+
+  std::vector<uint32_t> partVertices;
+  std::vector<uint32_t> localIndices(numIndices);
+  for (size_t i = 0; i < numIndices; ++i) {
+    uint32_t& localId = localVertexIds[indices[i]];
+    if (localId == kNoVertex) {
+      localId = static_cast<uint32_t>(partVertices.size());
+      partVertices.push_back(indices[i]);
+    }
+    localIndices[i] = localId;
+  }
+  for (uint32_t v : partVertices)
+    localVertexIds[v] = kNoVertex;
+
+  std::vector<size_t> clusterStarts = {0};
+  std::vector<uint32_t> order = Tipsify(localIndices, partVertices.size(), &clusterStarts);
+  SortClustersForOverdraw(vertices, indices, &order, clusterStarts);
+
+  for (size_t t = 0; t < order.size(); ++t) {
+    for (size_t corner = 0; corner < 3; ++corner)
+      indices[t * 3 + corner] = partVertices[localIndices[order[t] * 3 + corner]];
+  }
+}
+
+void OptimizeVertexOrder(std::vector<ObjFileData::Vertex>* vertices,
+                         std::vector<uint32_t>* indices,
+                         std::vector<ObjFileData::Tangent>* tangents) {
+  const bool hasTangents = tangents && !tangents->empty();
+  std::vector<uint32_t> newIndices(vertices->size(), kNoVertex);
+  std::vector<ObjFileData::Vertex> reorderedVertices;
+  reorderedVertices.reserve(vertices->size());
+  std::vector<ObjFileData::Tangent> reorderedTangents;
+  reorderedTangents.reserve(hasTangents ? vertices->size() : 0);
+
+  for (uint32_t& index : *indices) {
+    if (newIndices[index] == kNoVertex) {
+      newIndices[index] = static_cast<uint32_t>(reorderedVertices.size());
+      reorderedVertices.push_back((*vertices)[index]);
+      if (hasTangents)
+        reorderedTangents.push_back((*tangents)[index]);
+    }
+    index = newIndices[index];
+  }
+
+  *vertices = std::move(reorderedVertices);
+  if (hasTangents)
+    *tangents = std::move(reorderedTangents);
+}
+
+void MergeMeshParts(ObjFileData* data) {
+  std::vector<ObjFileData::MeshPart>& meshParts = data->m_meshParts;
+  std::vector<ObjFileData::MeshPart> mergedParts;
+  std::unordered_map<uint32_t, size_t> mergedPartsByMaterial;
+  for (const ObjFileData::MeshPart& meshPart : meshParts) {
+    if (meshPart.numIndices == 0)
+      continue;
+
+    auto [mergedPart, isNew] = mergedPartsByMaterial.emplace(meshPart.materialIndex, mergedParts.size());
+    if (isNew) {
+      ObjFileData::MeshPart& newPart = mergedParts.emplace_back();
+      newPart.materialIndex = meshPart.materialIndex;
+    }
+    mergedParts[mergedPart->second].numIndices += meshPart.numIndices;
+  }
+
+  if (mergedParts.size() == meshParts.size())
+    return;
+
+  uint32_t indexStart = 0;
+  for (ObjFileData::MeshPart& mergedPart : mergedParts) {
+    mergedPart.indexStart = indexStart;
+    indexStart += mergedPart.numIndices;
+  }
+
+  // Where each of the old parts' indices go. Working that out is serial, but then the copies can all be done at once.
+  std::vector<uint32_t> destinations(meshParts.size());
+  std::vector<uint32_t> mergedPartEnds(mergedParts.size());
+  for (size_t i = 0; i < mergedParts.size(); ++i)
+    mergedPartEnds[i] = mergedParts[i].indexStart;
+  for (size_t p = 0; p < meshParts.size(); ++p) {
+    if (meshParts[p].numIndices == 0)
+      continue;
+    uint32_t& end = mergedPartEnds[mergedPartsByMaterial[meshParts[p].materialIndex]];
+    destinations[p] = end;
+    end += meshParts[p].numIndices;
+  }
+
+  std::vector<uint32_t> mergedIndices(indexStart);
+  ThreadPool::GetShared().ParallelFor(meshParts.size(), [&](size_t p) {
+    const uint32_t* partIndices = data->m_indices.data() + meshParts[p].indexStart;
+    std::copy(partIndices, partIndices + meshParts[p].numIndices, mergedIndices.begin() + destinations[p]);
+  });
+
+  data->m_indices = std::move(mergedIndices);
+  meshParts = std::move(mergedParts);
+}
+
+void Optimize(ObjFileData* data) {
+  ThreadPool::GetShared().ParallelFor(data->m_meshParts.size(), [data](size_t i) {
+    const ObjFileData::MeshPart& meshPart = data->m_meshParts[i];
+    OptimizeTriangleOrder(data->m_vertices.data(), data->m_vertices.size(), data->m_indices.data() + meshPart.indexStart,
+                          meshPart.numIndices);
+  });
+
+  OptimizeVertexOrder(&data->m_vertices, &data->m_indices, &data->m_tangents);
+}
+
+}  // namespace MeshOptimizer
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "d3d12/ObjFileLoader.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+// Reorders a parsed model for the GPU. Obj files list their faces in whatever order the exporter wrote them, which for
+// scanned and CAD meshes tends to jump all over the mesh, and so keeps missing the post-transform vertex cache.
+//
+// The triangles of each mesh part are reordered with Tipsify (Sander et al., "Fast Triangle Reordering for Vertex
+// Locality and Reduced Overdraw", 2007). Tipsify also splits them into clusters wherever it has to jump to another part
+// of the mesh; those clusters are then sorted so that the ones facing away from the part's center come first, as they
+// are the most likely to occlude the rest. Finally, the vertices are renumbered in the order that the triangles first
+// use them, so that vertex fetches walk through the vertex buffer instead of jumping around it.
+//
+// The mesh parts keep their order, and each keeps its own triangles. Merging the parts that share a material is a
+// separate step (MergeMeshParts), which comes first.
+namespace MeshOptimizer {
+
+// The size of the FIFO cache that the triangles are ordered for, and that AnalyzeVertexCache simulates.
+constexpr size_t kCacheSize = 16;
+
+struct VertexCacheStatistics {
+  size_t numTransformedVertices = 0;
+
+  // Average cache miss ratio: vertices transformed per triangle. 0.5 at best (for large, regular meshes), 3 at worst.
+  float acmr = 0.f;
+
+  // Average transform to vertex ratio: how many times each vertex is transformed. 1 at best.
+  float atvr = 0.f;
+};
+
+// Simulates drawing the triangles in order through a FIFO cache of kCacheSize vertices, so that orderings can be
+// compared without a GPU.
+VertexCacheStatistics AnalyzeVertexCache(const uint32_t* indices, size_t numIndices, size_t numVertices);
+
+// Reorders the triangles of a single mesh part, in place.
+void OptimizeTriangleOrder(const ObjFileData::Vertex* vertices,
+                           size_t numVertices,
+                           uint32_t* indices,
+                           size_t numIndices);
+
+// Renumbers the vertices in the order in which the indices first refer to them. Vertices that no triangle uses are
+// dropped. The tangents, if there are any, are reordered along with the vertices.
+void OptimizeVertexOrder(std::vector<ObjFileData::Vertex>* vertices,
+                         std::vector<uint32_t>* indices,
+                         std::vector<ObjFileData::Tangent>* tangents = nullptr);
+
+// Obj files switch materials as often as they like, so the same material can end up spread over thousands of mesh
+// parts. This moves the indices of the parts that have the same material next to each other, and merges them into one
+// part per material, so that the number of draws depends on the number of materials rather than on the file. The
+// merged parts come in the order that their materials first appear, and parts without any indices are dropped. Has to
+// come before the meshlets and levels of detail are built, since those refer to the parts' index ranges.
+void MergeMeshParts(ObjFileData* data);
+
+// All of the above: the mesh parts are optimized in parallel on the shared thread pool, and then the vertices are
+// renumbered.
+void Optimize(ObjFileData* data);
+
+}  // namespace MeshOptimizer
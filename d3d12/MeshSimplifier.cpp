@@ -0,0 +1,607 @@
+#include "d3d12/MeshSimplifier.h"
+
+#include "d3d12/MeshOptimizer.h"
+#include "utils/ThreadPool.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
+namespace MeshSimplifier {
+
+namespace {
+constexpr uint32_t kNoVertex = std::numeric_limits<uint32_t>::max();
+
+// Borders and seams are held in place by planes through them (perpendicular to their triangles), weighted well above
+// the triangles' own planes, so that they keep their outline for as long as possible.
+constexpr double kEdgeWeight = 10.0;
+
+// A level that can't get rid of at least this fraction of the triangles of the one before it ends the chain; whatever
+// is left is mostly locked in place by seams.
+constexpr float kMinLodReduction = 0.15f;
+
+enum class VertexKind : uint8_t {
+  Manifold,  // Surrounded by triangles, and not split: can be moved onto any neighbor.
+  Border,    // On an open edge of the mesh: can only slide along it.
+  Seam,      // Split in two along a line of edges, with both sides moving together: can only slide along it.
+  Locked,    // Anything else, e.g. the corners where seams meet.
+};
+
+// The sum of the squared distances to a set of planes, each weighted by the area (or, for edges, the squared length)
+// that it came from.
+struct Quadric {
+  double a00 = 0.0, a11 = 0.0, a22 = 0.0;
+  double a10 = 0.0, a20 = 0.0, a21 = 0.0;
+  double b0 = 0.0, b1 = 0.0, b2 = 0.0;
+  double c = 0.0;
+  double weight = 0.0;
+
+  void AddPlane(const double normal[3], double distance, double planeWeight) {
+    a00 += planeWeight * normal[0] * normal[0];
+    a11 += planeWeight * normal[1] * normal[1];
+    a22 += planeWeight * normal[2] * normal[2];
+    a10 += planeWeight * normal[1] * normal[0];
+    a20 += planeWeight * normal[2] * normal[0];
+    a21 += planeWeight * normal[2] * normal[1];
+    b0 += planeWeight * normal[0] * distance;
+    b1 += planeWeight * normal[1] * distance;
+    b2 += planeWeight * normal[2] * distance;
+    c += planeWeight * distance * distance;
+    weight += planeWeight;
+  }
+
+  void Add(const Quadric& other) {
+    a00 += other.a00;
+    a11 += other.a11;
+    a22 += other.a22;
+    a10 += other.a10;
+    a20 += other.a20;
+    a21 += other.a21;
+    b0 += other.b0;
+    b1 += other.b1;
+    b2 += other.b2;
+    c += other.c;
+    weight += other.weight;
+  }
+
+  // The weighted mean of the squared distances, so that the cost of a collapse doesn't depend on how finely the
+  // surface around it happens to be tessellated.
+  double Evaluate(const float p[3]) const {
+    if (!(weight > 0.0))
+      return 0.0;
+
+    const double x = p[0], y = p[1], z = p[2];
+    const double rx = a00 * x + a10 * y + a20 * z;
+    const double ry = a10 * x + a11 * y + a21 * z;
+    const double rz = a20 * x + a21 * y + a22 * z;
+    const double squaredDistance = rx * x + ry * y + rz * z + 2.0 * (b0 * x + b1 * y + b2 * z) + c;
+    return fabs(squaredDistance) / weight;
+  }
+};
+
+void Subtract(const float a[3], const float b[3], /*out*/ double result[3]) {
+  for (size_t i = 0; i < 3; ++i)
+    result[i] = static_cast<double>(a[i]) - b[i];
+}
+
+void Cross(const double a[3], const double b[3], /*out*/ double result[3]) {
+  result[0] = a[1] * b[2] - a[2] * b[1];
+  result[1] = a[2] * b[0] - a[0] * b[2];
+  result[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+double Dot(const double a[3], const double b[3]) {
+  return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+// Returns the vector's length.
+double Normalize(double vector[3]) {
+  const double length = sqrt(Dot(vector, vector));
+  if (length > 0.0) {
+    for (size_t i = 0; i < 3; ++i)
+      vector[i] /= length;
+  }
+  return length;
+}
+
+// The normal of the triangle (p0, p1, p2), scaled by twice its area.
+void TriangleNormal(const float p0[3], const float p1[3], const float p2[3], /*out*/ double normal[3]) {
+  double e1[3], e2[3];
+  Subtract(p1, p0, e1);
+  Subtract(p2, p0, e2);
+  Cross(e1, e2, normal);
+}
+
+// A single mesh part, along with everything needed to simplify it. The part's vertices are renumbered densely, like
+// MeshOptimizer does, so that the per-vertex state only has to cover this part.
+class Simplifier {
+ public:
+  Simplifier(const ObjFileData::Vertex* vertices, size_t numVertices, const uint32_t* indices, size_t numIndices);
+
+  // Carries on simplifying the part from where the previous call left off. Returns the largest squared error of any
+  // collapse so far; since the quadrics of collapsed vertices are merged, that's measured against the original part.
+  double Simplify(size_t targetNumIndices, double maxCost);
+
+  size_t GetNumIndices() const { return m_indices.size(); }
+  // In terms of the original vertices.
+  std::vector<uint32_t> GetIndices() const;
+
+ private:
+  struct HalfEdge {
+    // The triangle is (vertex, next, prev), in its winding order.
+    uint32_t next;
+    uint32_t prev;
+  };
+
+  struct Collapse {
+    uint32_t from;
+    uint32_t to;
+    double cost;
+  };
+
+  std::vector<uint32_t> m_partVertices;
+  std::vector<const float*> m_positions;
+  std::vector<uint32_t> m_indices;
+  double m_largestCost = 0.0;
+
+  // Vertices with the same position are different copies of the same point on the surface (wedges). |m_remap| maps
+  // each to the first of them, which stands for all of them in |m_kinds| and |m_quadrics|; |m_nextWedge| links them
+  // into a circular list.
+  std::vector<uint32_t> m_remap;
+  std::vector<uint32_t> m_nextWedge;
+  std::vector<VertexKind> m_kinds;
+  std::vector<Quadric> m_quadrics;
+
+  // The half-edges that start at each vertex, one per triangle that uses it. Rebuilt for every pass.
+  std::vector<uint32_t> m_adjacencyOffsets;
+  std::vector<HalfEdge> m_adjacency;
+
+  // Per pass: where each vertex has been collapsed to (if anywhere), and whether it may still move.
+  std::vector<uint32_t> m_collapseTo;
+  std::vector<bool> m_isLocked;
+
+  void WeldPositions();
+  void BuildAdjacency();
+  void ClassifyVertices();
+  void ComputeQuadrics();
+
+  bool HasEdge(uint32_t from, uint32_t to) const;
+  // Whether any copy of |from| has an edge to any copy of |to|.
+  bool HasPositionEdge(uint32_t from, uint32_t to) const;
+  bool IsOpenEdge(uint32_t a, uint32_t b) const { return HasEdge(a, b) != HasEdge(b, a); }
+
+  bool CanCollapse(uint32_t from, uint32_t to) const;
+  // Finds where each copy of |from| goes when it's moved onto |to|: the copy of |to| on the same side of the seam.
+  bool FindWedgeTargets(uint32_t from, uint32_t to, /*out*/ std::vector<Collapse>* wedgeCollapses) const;
+  bool WouldFlipTriangles(uint32_t from, uint32_t to) const;
+};
+
+Simplifier::Simplifier(const ObjFileData::Vertex* vertices,
+                       size_t numVertices,
+                       const uint32_t* indices,
+                       size_t numIndices) {
+  // The lookup table covers the whole model, so it's kept around for the thread's next part.
+  thread_local std::vector<uint32_t> localVertexIds;
+  if (localVertexIds.size() < numVertices)
+    localVertexIds.assign(numVertices, kNoVertex);
+
+  m_indices.resize(numIndices - numIndices % 3);
+  for (size_t i = 0; i < m_indices.size(); ++i) {
+    uint32_t& localId = localVertexIds[indices[i]];
+    if (localId == kNoVertex) {
+      localId = static_cast<uint32_t>(m_partVertices.size());
+      m_partVertices.push_back(indices[i]);
+      m_positions.push_back(vertices[indices[i]].pos);
+    }
+    m_indices[i] = localId;
+  }
+  for (uint32_t v : m_partVertices)
+    localVertexIds[v] = kNoVertex;
+
+  WeldPositions();
+  BuildAdjacency();
+  ClassifyVertices();
+
+  m_quadrics.resize(m_positions.size());
+  ComputeQuadrics();
+  m_collapseTo.resize(m_positions.size());
+  m_isLocked.resize(m_positions.size());
+}
+
+std::vector<uint32_t> Simplifier::GetIndices() const {
+  std::vector<uint32_t> indices(m_indices.size());
+  for (size_t i = 0; i < m_indices.size(); ++i)
+    indices[i] = m_partVertices[m_indices[i]];
+  return indices;
+}
+
+void Simplifier::WeldPositions() {
+  const size_t numVertices = m_positions.size();
+
+  // Positions are compared bit for bit: the exporter wrote the copies of a vertex out from the same values.
+  auto positionBits = [this](uint32_t v, size_t i) {
+    uint32_t bits;
+    memcpy(&bits, &m_positions[v][i], sizeof(bits));
+    return bits;
+  };
+  auto isSamePosition = [&](uint32_t a, uint32_t b) {
+    return positionBits(a, 0) == positionBits(b, 0) && positionBits(a, 1) == positionBits(b, 1) &&
+           positionBits(a, 2) == positionBits(b, 2);
+  };
+
+  std::vector<uint32_t> order(numVertices);
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+    for (size_t i = 0; i < 3; ++i) {
+      if (positionBits(a, i) != positionBits(b, i))
+        return positionBits(a, i) < positionBits(b, i);
+    }
+    return a < b;
+  });
+
+  m_remap.resize(numVertices);
+  m_nextWedge.resize(numVertices);
+  for (size_t start = 0; start < numVertices;) {
+    size_t end = start + 1;
+    while (end < numVertices && isSamePosition(order[start], order[end]))
+      ++end;
+
+    for (size_t i = start; i < end; ++i) {
+      m_remap[order[i]] = order[start];
+      m_nextWedge[order[i]] = order[(i + 1 < end) ? i + 1 : start];
+    }
+    start = end;
+  }
+}
+
+void Simplifier::BuildAdjacency() {
+  const size_t numVertices = m_positions.size();
+  m_adjacencyOffsets.assign(numVertices + 1, 0);
+  for (uint32_t index : m_indices)
+    ++m_adjacencyOffsets[index + 1];
+  for (size_t v = 0; v < numVertices; ++v)
+    m_adjacencyOffsets[v + 1] += m_adjacencyOffsets[v];
+
+  m_adjacency.resize(m_indices.size());
+  std::vector<uint32_t> fill(m_adjacencyOffsets.begin(), m_adjacencyOffsets.end() - 1);
+  for (size_t i = 0; i < m_indices.size(); i += 3) {
+    for (size_t corner = 0; corner < 3; ++corner) {
+      const uint32_t v = m_indices[i + corner];
+      m_adjacency[fill[v]++] = {m_indices[i + (corner + 1) % 3], m_indices[i + (corner + 2) % 3]};
+    }
+  }
+}
+
+bool Simplifier::HasEdge(uint32_t from, uint32_t to) const {
+  for (uint32_t e = m_adjacencyOffsets[from]; e < m_adjacencyOffsets[from + 1]; ++e) {
+    if (m_adjacency[e].next == to)
+      return true;
+  }
+  return false;
+}
+
+bool Simplifier::HasPositionEdge(uint32_t from, uint32_t to) const {
+  uint32_t wedge = from;
+  do {
+    for (uint32_t e = m_adjacencyOffsets[wedge]; e < m_adjacencyOffsets[wedge + 1]; ++e) {
+      if (m_remap[m_adjacency[e].next] == m_remap[to])
+        return true;
+    }
+    wedge = m_nextWedge[wedge];
+  } while (wedge != from);
+  return false;
+}
+
+void Simplifier::ClassifyVertices() {
+  const size_t numVertices = m_positions.size();
+
+  // The open half-edges at each vertex: those whose opposite half-edge (between the same two copies) doesn't exist.
+  std::vector<uint32_t> openOut(numVertices, kNoVertex);
+  std::vector<uint32_t> openIn(numVertices, kNoVertex);
+  std::vector<uint32_t> numOpenOut(numVertices, 0);
+  std::vector<uint32_t> numOpenIn(numVertices, 0);
+  for (uint32_t v = 0; v < numVertices; ++v) {
+    for (uint32_t e = m_adjacencyOffsets[v]; e < m_adjacencyOffsets[v + 1]; ++e) {
+      const uint32_t w = m_adjacency[e].next;
+      if (HasEdge(w, v))
+        continue;
+      openOut[v] = w;
+      ++numOpenOut[v];
+      openIn[w] = v;
+      ++numOpenIn[w];
+    }
+  }
+
+  // A vertex whose only open edges are one in and one out lies on a single line of them.
+  auto isOnOneLine = [&](uint32_t v) { return numOpenOut[v] == 1 && numOpenIn[v] == 1; };
+
+  m_kinds.assign(numVertices, VertexKind::Locked);
+  for (uint32_t v = 0; v < numVertices; ++v) {
+    if (m_remap[v] != v)
+      continue;
+
+    const uint32_t otherWedge = m_nextWedge[v];
+    if (otherWedge == v) {
+      if (numOpenOut[v] == 0 && numOpenIn[v] == 0) {
+        m_kinds[v] = VertexKind::Manifold;
+      } else if (isOnOneLine(v) && !HasPositionEdge(openOut[v], v) && !HasPositionEdge(v, openIn[v])) {
+        // The edges are open at every copy of their vertices too, so this is the edge of the mesh rather than the end
+        // of a seam.
+        m_kinds[v] = VertexKind::Border;
+      }
+    } else if (m_nextWedge[otherWedge] == v && isOnOneLine(v) && isOnOneLine(otherWedge)) {
+      // Both copies have to run along the same line, with the other side of the seam across each of their open edges.
+      const bool isSeam = m_remap[openOut[v]] == m_remap[openIn[otherWedge]] &&
+                          m_remap[openIn[v]] == m_remap[openOut[otherWedge]] &&
+                          HasPositionEdge(openOut[v], v) && HasPositionEdge(v, openIn[v]);
+      if (isSeam)
+        m_kinds[v] = VertexKind::Seam;
+    }
+  }
+}
+
+void Simplifier::ComputeQuadrics() {
+  for (size_t i = 0; i < m_indices.size(); i += 3) {
+    const uint32_t triangle[3] = {m_indices[i], m_indices[i + 1], m_indices[i + 2]};
+    double normal[3];
+    TriangleNormal(m_positions[triangle[0]], m_positions[triangle[1]], m_positions[triangle[2]], normal);
+    const double area = Normalize(normal) * 0.5;
+    if (!(area > 0.0))
+      continue;
+
+    double p0[3];
+    for (size_t c = 0; c < 3; ++c)
+      p0[c] = m_positions[triangle[0]][c];
+    const double distance = -Dot(normal, p0);
+    for (uint32_t v : triangle)
+      m_quadrics[m_remap[v]].AddPlane(normal, distance, area);
+
+    for (size_t corner = 0; corner < 3; ++corner) {
+      const uint32_t a = triangle[corner];
+      const uint32_t b = triangle[(corner + 1) % 3];
+      if (HasEdge(b, a))
+        continue;
+
+      double edge[3];
+      Subtract(m_positions[b], m_positions[a], edge);
+      double edgeNormal[3];
+      Cross(edge, normal, edgeNormal);
+      const double length = Normalize(edgeNormal);
+      double pa[3];
+      for (size_t c = 0; c < 3; ++c)
+        pa[c] = m_positions[a][c];
+      const double edgeDistance = -Dot(edgeNormal, pa);
+      m_quadrics[m_remap[a]].AddPlane(edgeNormal, edgeDistance, length * length * kEdgeWeight);
+      m_quadrics[m_remap[b]].AddPlane(edgeNormal, edgeDistance, length * length * kEdgeWeight);
+    }
+  }
+}
+
+bool Simplifier::CanCollapse(uint32_t from, uint32_t to) const {
+  if (m_remap[from] == m_remap[to])
+    return false;
+
+  const VertexKind toKind = m_kinds[m_remap[to]];
+  switch (m_kinds[m_remap[from]]) {
+    case VertexKind::Manifold:
+      return true;
+    case VertexKind::Border:
+      return (toKind == VertexKind::Border || toKind == VertexKind::Locked) && IsOpenEdge(from, to);
+    case VertexKind::Seam:
+      return (toKind == VertexKind::Seam || toKind == VertexKind::Locked) && IsOpenEdge(from, to);
+    default:
+      return false;
+  }
+}
+
+bool Simplifier::FindWedgeTargets(uint32_t from, uint32_t to, /*out*/ std::vector<Collapse>* wedgeCollapses) const {
+  wedgeCollapses->clear();
+  wedgeCollapses->push_back({from, to, 0.0});
+  for (uint32_t wedge = m_nextWedge[from]; wedge != from; wedge = m_nextWedge[wedge]) {
+    uint32_t target = to;
+    do {
+      if (HasEdge(wedge, target) || HasEdge(target, wedge))
+        break;
+      target = m_nextWedge[target];
+    } while (target != to);
+
+    if (!HasEdge(wedge, target) && !HasEdge(target, wedge))
+      return false;
+    wedgeCollapses->push_back({wedge, target, 0.0});
+  }
+  return true;
+}
+
+bool Simplifier::WouldFlipTriangles(uint32_t from, uint32_t to) const {
+  const float* newPosition = m_positions[to];
+  uint32_t wedge = from;
+  do {
+    for (uint32_t e = m_adjacencyOffsets[wedge]; e < m_adjacencyOffsets[wedge + 1]; ++e) {
+      const HalfEdge& edge = m_adjacency[e];
+      // The triangles along the collapsed edge disappear.
+      if (m_remap[edge.next] == m_remap[to] || m_remap[edge.prev] == m_remap[to])
+        continue;
+
+      double before[3], after[3];
+      TriangleNormal(m_positions[wedge], m_positions[edge.next], m_positions[edge.prev], before);
+      TriangleNormal(newPosition, m_positions[edge.next], m_positions[edge.prev], after);
+      if (Dot(before, after) <= 0.0 && Dot(before, before) > 0.0)
+        return true;
+    }
+    wedge = m_nextWedge[wedge];
+  } while (wedge != from);
+  return false;
+}
+
+double Simplifier::Simplify(size_t targetNumIndices, double maxCost) {
+  std::vector<Collapse> candidates;
+  std::vector<Collapse> wedgeCollapses;
+
+  // Collapses are made in passes: each pass collapses the cheapest edges that don't touch one another, and then the
+  // triangles are rebuilt, which is far simpler (and faster) than keeping a priority queue of edges up to date.
+  while (m_indices.size() > targetNumIndices) {
+    // Every half-edge is a candidate for moving its start onto its end; so both directions of an interior edge are
+    // considered, each with its own cost. Only the vertices on borders and seams have neighbors that they don't have
+    // a half-edge to, across their incoming open edge. A vertex can only be moved once per pass anyway, so only its
+    // cheapest collapse is kept.
+    candidates.clear();
+    for (uint32_t from = 0; from < m_positions.size(); ++from) {
+      const Quadric& quadric = m_quadrics[m_remap[from]];
+      Collapse cheapest = {from, kNoVertex, maxCost};
+      auto consider = [&](uint32_t to) {
+        if (!CanCollapse(from, to))
+          return;
+        const double cost = quadric.Evaluate(m_positions[to]);
+        if (cost <= cheapest.cost)
+          cheapest = {from, to, cost};
+      };
+
+      const VertexKind kind = m_kinds[m_remap[from]];
+      const bool isOnOpenEdge = kind == VertexKind::Border || kind == VertexKind::Seam;
+      for (uint32_t e = m_adjacencyOffsets[from]; e < m_adjacencyOffsets[from + 1]; ++e) {
+        consider(m_adjacency[e].next);
+        if (isOnOpenEdge)
+          consider(m_adjacency[e].prev);
+      }
+      if (cheapest.to != kNoVertex)
+        candidates.push_back(cheapest);
+    }
+    if (candidates.empty())
+      break;
+
+    auto isCheaper = [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; };
+
+    // A collapse removes about two triangles. Only edges about as cheap as the ones that would get the part to its
+    // target are taken in one pass, so that expensive edges elsewhere aren't collapsed while the cheap ones are locked
+    // by their neighbors. (Some slack is left for the cheap ones that turn out to flip triangles over.) Only those
+    // edges need to be sorted; the rest are only sorted if none of them could be collapsed.
+    const size_t numTrianglesToRemove = (m_indices.size() - targetNumIndices + 2) / 3;
+    const size_t goal = std::min(std::max<size_t>(numTrianglesToRemove / 2, 1), candidates.size()) - 1;
+    std::nth_element(candidates.begin(), candidates.begin() + goal, candidates.end(), isCheaper);
+    const double passMaxCost = candidates[goal].cost * 1.5;
+    auto sortedEnd = std::partition(candidates.begin(), candidates.end(),
+                                    [passMaxCost](const Collapse& collapse) { return collapse.cost <= passMaxCost; });
+    std::sort(candidates.begin(), sortedEnd, isCheaper);
+
+    std::iota(m_collapseTo.begin(), m_collapseTo.end(), 0);
+    std::fill(m_isLocked.begin(), m_isLocked.end(), false);
+    size_t numCollapses = 0;
+    for (auto c = candidates.begin(); c != candidates.end() && 2 * numCollapses < numTrianglesToRemove; ++c) {
+      if (c == sortedEnd) {
+        if (numCollapses > 0)
+          break;
+        std::sort(sortedEnd, candidates.end(), isCheaper);
+        sortedEnd = candidates.end();
+      }
+
+      // Vertices may be collapsed onto more than once in a pass, but not once they've been collapsed themselves.
+      const Collapse& collapse = *c;
+      if (m_isLocked[m_remap[collapse.from]] || m_collapseTo[collapse.to] != collapse.to)
+        continue;
+      if (!FindWedgeTargets(collapse.from, collapse.to, &wedgeCollapses))
+        continue;
+      if (WouldFlipTriangles(collapse.from, collapse.to))
+        continue;
+
+      // Neither end may move again in this pass, and nor may the neighbors, so that the flip checks of later collapses
+      // see the triangles as they'll really be. (The vertices that don't move can still be collapsed onto.)
+      for (const Collapse& wedgeCollapse : wedgeCollapses) {
+        m_collapseTo[wedgeCollapse.from] = wedgeCollapse.to;
+        for (uint32_t e = m_adjacencyOffsets[wedgeCollapse.from]; e < m_adjacencyOffsets[wedgeCollapse.from + 1]; ++e) {
+          m_isLocked[m_remap[m_adjacency[e].next]] = true;
+          m_isLocked[m_remap[m_adjacency[e].prev]] = true;
+        }
+      }
+      m_isLocked[m_remap[collapse.from]] = true;
+      m_isLocked[m_remap[collapse.to]] = true;
+
+      m_quadrics[m_remap[collapse.to]].Add(m_quadrics[m_remap[collapse.from]]);
+      m_largestCost = std::max(m_largestCost, collapse.cost);
+      ++numCollapses;
+    }
+    if (numCollapses == 0)
+      break;
+
+    // Move the collapsed vertices, and drop the triangles that that leaves without any area.
+    size_t numIndices = 0;
+    for (size_t i = 0; i < m_indices.size(); i += 3) {
+      const uint32_t a = m_collapseTo[m_indices[i]];
+      const uint32_t b = m_collapseTo[m_indices[i + 1]];
+      const uint32_t c = m_collapseTo[m_indices[i + 2]];
+      if (m_remap[a] == m_remap[b] || m_remap[b] == m_remap[c] || m_remap[c] == m_remap[a])
+        continue;
+      m_indices[numIndices++] = a;
+      m_indices[numIndices++] = b;
+      m_indices[numIndices++] = c;
+    }
+    m_indices.resize(numIndices);
+    BuildAdjacency();
+  }
+
+  return m_largestCost;
+}
+}  // namespace
+
+std::vector<uint32_t> Simplify(const ObjFileData::Vertex* vertices,
+                               size_t numVertices,
+                               const uint32_t* indices,
+                               size_t numIndices,
+                               size_t targetNumIndices,
+                               float maxError,
+                               /*out*/ float* error) {
+  *error = 0.f;
+  if (numIndices - numIndices % 3 <= targetNumIndices)
+    return std::vector<uint32_t>(indices, indices + numIndices - numIndices % 3);
+
+  Simplifier simplifier(vertices, numVertices, indices, numIndices);
+  const double maxCost = static_cast<double>(maxError) * maxError;
+  *error = static_cast<float>(sqrt(simplifier.Simplify(targetNumIndices, maxCost)));
+  return simplifier.GetIndices();
+}
+
+void BuildLods(ObjFileData* data) {
+  struct Lod {
+    std::vector<uint32_t> indices;
+    float error;
+  };
+
+  const ObjFileData::Vertex* vertices = data->m_vertices.data();
+  const size_t numVertices = data->m_vertices.size();
+  std::vector<std::vector<Lod>> partLods(data->m_meshParts.size());
+  ThreadPool::GetShared().ParallelFor(data->m_meshParts.size(), [&](size_t p) {
+    const ObjFileData::MeshPart& meshPart = data->m_meshParts[p];
+    if (meshPart.numIndices / 3 <= kMinLodTriangles)
+      return;
+
+    // Each level carries on from where the one before it left off.
+    Simplifier simplifier(vertices, numVertices, data->m_indices.data() + meshPart.indexStart, meshPart.numIndices);
+    size_t numPreviousIndices = simplifier.GetNumIndices();
+    while (partLods[p].size() < kMaxLods && numPreviousIndices / 3 > kMinLodTriangles) {
+      const double cost = simplifier.Simplify(numPreviousIndices / 6 * 3, std::numeric_limits<double>::max());
+      if (simplifier.GetNumIndices() > numPreviousIndices * (1.f - kMinLodReduction))
+        break;
+
+      std::vector<uint32_t> indices = simplifier.GetIndices();
+      MeshOptimizer::OptimizeTriangleOrder(vertices, numVertices, indices.data(), indices.size());
+      numPreviousIndices = indices.size();
+      partLods[p].push_back({std::move(indices), static_cast<float>(sqrt(cost))});
+    }
+  });
+
+  data->m_lods.clear();
+  for (size_t p = 0; p < data->m_meshParts.size(); ++p) {
+    ObjFileData::MeshPart& meshPart = data->m_meshParts[p];
+    meshPart.lodStart = static_cast<uint32_t>(data->m_lods.size());
+    meshPart.numLods = static_cast<uint32_t>(partLods[p].size());
+    for (const Lod& lod : partLods[p]) {
+      data->m_lods.push_back(
+          {static_cast<uint32_t>(data->m_indices.size()), static_cast<uint32_t>(lod.indices.size()), lod.error});
+      data->m_indices.insert(data->m_indices.end(), lod.indices.begin(), lod.indices.end());
+    }
+  }
+}
+
+}  // namespace MeshSimplifier
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "d3d12/ObjFileLoader.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+// Builds the levels of detail of a parsed model, so that models that only cover a few pixels don't have to be drawn
+// with all of their triangles.
+//
+// Triangles are simplified by collapsing edges, cheapest first, where the cost of moving a vertex is its quadric error
+// (Garland and Heckbert, "Surface Simplification Using Quadric Error Metrics", 1997): the area-weighted squared
+// distance from the planes of the triangles that have been merged into it. A vertex is only ever moved onto one of its
+// neighbors, so the levels of detail need no new vertices; they're just more indices into the same vertex buffer.
+//
+// Vertices are split wherever the texture coordinates or normals change abruptly, so the split vertices (the seams) and
+// the open edges of the mesh (the borders) are kept in place: a vertex on one may only slide along it, all of its
+// copies together, and anything more complicated than that isn't moved at all.
+namespace MeshSimplifier {
+
+// Each level of detail aims for half of the triangles of the one before it, for at most this many levels.
+constexpr size_t kMaxLods = 8;
+
+// Parts (or levels) this small aren't worth simplifying any further.
+constexpr size_t kMinLodTriangles = 64;
+
+// Simplifies a single mesh part, until it has no more than |targetNumIndices| indices left or every remaining collapse
+// would move the surface by more than |maxError|. Returns the indices of the simplified triangles, which refer to the
+// same vertices as |indices|; |error| receives the largest distance that the surface was moved by, in the same units
+// as the vertices' positions.
+std::vector<uint32_t> Simplify(const ObjFileData::Vertex* vertices,
+                               size_t numVertices,
+                               const uint32_t* indices,
+                               size_t numIndices,
+                               size_t targetNumIndices,
+                               float maxError,
+                               /*out*/ float* error);
+
+// Builds the levels of detail of all of the data's mesh parts, in parallel on the shared thread pool. Each level
+// carries on simplifying from where the one before it left off, and has its triangles reordered for the vertex cache;
+// their indices are appended to the data's indices.
+void BuildLods(ObjFileData* data);
+
+}  // namespace MeshSimplifier
@@ -0,0 +1,258 @@
+#include "d3d12/MeshletBuilder.h"
+
+#include "utils/ThreadPool.h"
+
+#include <math.h>
+
+#include <algorithm>
+
+namespace MeshletBuilder {
+
+namespace {
+// A cone this wide (the triangles' normals up to about 84 degrees apart from its axis) would hardly ever cull anything,
+// so it isn't worth testing at all.
+constexpr float kMinConeDot = 0.1f;
+constexpr float kNoCone = 2.f;
+
+float Dot(const float a[3], const float b[3]) {
+  return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+float DistanceSquared(const float a[3], const float b[3]) {
+  const float d[3] = {a[0] - b[0], a[1] - b[1], a[2] - b[2]};
+  return Dot(d, d);
+}
+
+// Returns false for zero-length vectors, e.g. the normals of degenerate triangles.
+bool Normalize(float vector[3]) {
+  const float length = sqrtf(Dot(vector, vector));
+  if (!(length > 0.f))
+    return false;
+
+  for (size_t i = 0; i < 3; ++i)
+    vector[i] /= length;
+  return true;
+}
+
+// Ritter's bounding sphere: start from the two points that are furthest apart along one of the axes, then grow the
+// sphere to take in any points left outside. Within about 5-20% of the smallest sphere, in a single pass.
+void ComputeBoundingSphere(const std::vector<const float*>& points, /*out*/ ObjFileData::Meshlet* meshlet) {
+  size_t minPoints[3] = {0, 0, 0};
+  size_t maxPoints[3] = {0, 0, 0};
+  for (size_t p = 0; p < points.size(); ++p) {
+    for (size_t axis = 0; axis < 3; ++axis) {
+      if (points[p][axis] < points[minPoints[axis]][axis])
+        minPoints[axis] = p;
+      if (points[p][axis] > points[maxPoints[axis]][axis])
+        maxPoints[axis] = p;
+    }
+  }
+
+  size_t widestAxis = 0;
+  for (size_t axis = 1; axis < 3; ++axis) {
+    if (DistanceSquared(points[minPoints[axis]], points[maxPoints[axis]]) >
+        DistanceSquared(points[minPoints[widestAxis]], points[maxPoints[widestAxis]])) {
+      widestAxis = axis;
+    }
+  }
+
+  const float* a = points[minPoints[widestAxis]];
+  const float* b = points[maxPoints[widestAxis]];
+  float* center = meshlet->center;
+  for (size_t i = 0; i < 3; ++i)
+    center[i] = (a[i] + b[i]) * 0.5f;
+  float radius = sqrtf(DistanceSquared(a, b)) * 0.5f;
+
+  for (const float* point : points) {
+    const float distance = sqrtf(DistanceSquared(point, center));
+    if (distance <= radius)
+      continue;
+
+    // Move the center towards the point just far enough for the sphere to reach it, keeping the far side in place.
+    const float newRadius = (radius + distance) * 0.5f;
+    const float shift = (newRadius - radius) / distance;
+    for (size_t i = 0; i < 3; ++i)
+      center[i] += (point[i] - center[i]) * shift;
+    radius = newRadius;
+  }
+
+  // The updates above round, by more than the radius can allow for when the meshlet is small and far from the origin.
+  // So the radius is measured again from where the center ended up, and rounded up, so that the sphere really does
+  // hold every point.
+  double maxDistanceSquared = 0.0;
+  for (const float* point : points) {
+    double distanceSquared = 0.0;
+    for (size_t i = 0; i < 3; ++i) {
+      const double d = static_cast<double>(point[i]) - center[i];
+      distanceSquared += d * d;
+    }
+    maxDistanceSquared = std::max(maxDistanceSquared, distanceSquared);
+  }
+  meshlet->radius = nextafterf(static_cast<float>(sqrt(maxDistanceSquared)), INFINITY);
+}
+
+// The cone's axis is the average of the triangles' normals, and its cutoff the sine of the angle between the axis and
+// the normal furthest from it. The apex is placed behind every triangle's plane (along the axis), so that a point that
+// sees the apex from inside the cone's back half sees every triangle from behind too.
+void ComputeNormalCone(const ObjFileData::Vertex* vertices,
+                       const uint32_t* indices,
+                       size_t numIndices,
+                       /*out*/ ObjFileData::Meshlet* meshlet) {
+  struct Triangle {
+    const float* corner;
+    float normal[3];
+  };
+  thread_local std::vector<Triangle> triangles;
+  triangles.clear();
+
+  float* axis = meshlet->coneAxis;
+  axis[0] = axis[1] = axis[2] = 0.f;
+  for (size_t i = 0; i + 3 <= numIndices; i += 3) {
+    const float* p0 = vertices[indices[i]].pos;
+    const float* p1 = vertices[indices[i + 1]].pos;
+    const float* p2 = vertices[indices[i + 2]].pos;
+    const float e1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+    const float e2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+    Triangle triangle = {p0, {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2],
+                              e1[0] * e2[1] - e1[1] * e2[0]}};
+
+    // Degenerate triangles are never drawn, whichever way the cone points.
+    if (!Normalize(triangle.normal))
+      continue;
+
+    triangles.push_back(triangle);
+    for (size_t c = 0; c < 3; ++c)
+      axis[c] += triangle.normal[c];
+  }
+
+  for (size_t c = 0; c < 3; ++c)
+    meshlet->coneApex[c] = meshlet->center[c];
+  meshlet->coneCutoff = kNoCone;
+  if (!Normalize(axis))
+    return;
+
+  float minDot = 1.f;
+  for (const Triangle& triangle : triangles)
+    minDot = std::min(minDot, Dot(axis, triangle.normal));
+  if (minDot <= kMinConeDot)
+    return;
+
+  // How far the apex has to be moved back along the axis from the center to be behind every triangle's plane.
+  float maxDistance = 0.f;
+  for (const Triangle& triangle : triangles) {
+    const float* corner = triangle.corner;
+    const float toCenter[3] = {meshlet->center[0] - corner[0], meshlet->center[1] - corner[1],
+                               meshlet->center[2] - corner[2]};
+    maxDistance = std::max(maxDistance, Dot(toCenter, triangle.normal) / Dot(axis, triangle.normal));
+  }
+
+  for (size_t c = 0; c < 3; ++c)
+    meshlet->coneApex[c] = meshlet->center[c] - axis[c] * maxDistance;
+  meshlet->coneCutoff = sqrtf(1.f - minDot * minDot);
+}
+
+void ComputeBounds(const ObjFileData::Vertex* vertices,
+                   const uint32_t* indices,
+                   const std::vector<uint32_t>& meshletVertices,
+                   /*out*/ ObjFileData::Meshlet* meshlet) {
+  thread_local std::vector<const float*> points;
+  points.clear();
+  for (uint32_t v : meshletVertices)
+    points.push_back(vertices[v].pos);
+
+  ComputeBoundingSphere(points, meshlet);
+  ComputeNormalCone(vertices, indices + meshlet->indexStart, meshlet->numIndices, meshlet);
+}
+}  // namespace
+
+void BuildMeshlets(const ObjFileData::Vertex* vertices,
+                   size_t numVertices,
+                   const uint32_t* indices,
+                   uint32_t indexStart,
+                   uint32_t numIndices,
+                   /*out*/ std::vector<ObjFileData::Meshlet>* meshlets) {
+  // Marks the vertices that the current meshlet already uses. Like in MeshOptimizer, the table covers the whole model,
+  // so it's kept around for the thread's next part rather than being reallocated for each one.
+  thread_local std::vector<bool> isInMeshlet;
+  if (isInMeshlet.size() < numVertices)
+    isInMeshlet.resize(numVertices, false);
+
+  std::vector<uint32_t> meshletVertices;
+  meshletVertices.reserve(kMaxVertices);
+
+  auto finishMeshlet = [&](uint32_t start, uint32_t end) {
+    ObjFileData::Meshlet meshlet = {};
+    meshlet.indexStart = start;
+    meshlet.numIndices = end - start;
+    meshlet.numVertices = static_cast<uint32_t>(meshletVertices.size());
+    ComputeBounds(vertices, indices, meshletVertices, &meshlet);
+    meshlets->push_back(meshlet);
+
+    for (uint32_t v : meshletVertices)
+      isInMeshlet[v] = false;
+    meshletVertices.clear();
+  };
+
+  const uint32_t indexEnd = indexStart + numIndices - numIndices % 3;
+  uint32_t meshletStart = indexStart;
+  for (uint32_t i = indexStart; i < indexEnd; i += 3) {
+    size_t numNewVertices = 0;
+    for (uint32_t corner = 0; corner < 3; ++corner) {
+      const uint32_t v = indices[i + corner];
+      // A triangle may use the same vertex twice.
+      const bool isRepeated = (corner >= 1 && indices[i] == v) || (corner == 2 && indices[i + 1] == v);
+      if (!isInMeshlet[v] && !isRepeated)
+        ++numNewVertices;
+    }
+
+    const size_t numTriangles = (i - meshletStart) / 3;
+    if (meshletVertices.size() + numNewVertices > kMaxVertices || numTriangles == kMaxTriangles) {
+      finishMeshlet(meshletStart, i);
+      meshletStart = i;
+    }
+
+    for (uint32_t corner = 0; corner < 3; ++corner) {
+      const uint32_t v = indices[i + corner];
+      if (!isInMeshlet[v]) {
+        isInMeshlet[v] = true;
+        meshletVertices.push_back(v);
+      }
+    }
+  }
+  if (indexEnd > meshletStart)
+    finishMeshlet(meshletStart, indexEnd);
+}
+
+void Build(ObjFileData* data) {
+  std::vector<ObjFileData::MeshPart>& meshParts = data->m_meshParts;
+  std::vector<std::vector<ObjFileData::Meshlet>> partMeshlets(meshParts.size());
+  ThreadPool::GetShared().ParallelFor(meshParts.size(), [&](size_t p) {
+    BuildMeshlets(data->m_vertices.data(), data->m_vertices.size(), data->m_indices.data(), meshParts[p].indexStart,
+                  meshParts[p].numIndices, &partMeshlets[p]);
+  });
+
+  data->m_meshlets.clear();
+  for (size_t p = 0; p < meshParts.size(); ++p) {
+    meshParts[p].meshletStart = static_cast<uint32_t>(data->m_meshlets.size());
+    meshParts[p].numMeshlets = static_cast<uint32_t>(partMeshlets[p].size());
+    data->m_meshlets.insert(data->m_meshlets.end(), partMeshlets[p].begin(), partMeshlets[p].end());
+  }
+}
+
+bool IsOutsideFrustum(const ObjFileData::Meshlet& meshlet, const float planes[][4], size_t numPlanes) {
+  for (size_t p = 0; p < numPlanes; ++p) {
+    if (Dot(planes[p], meshlet.center) + planes[p][3] < -meshlet.radius)
+      return true;
+  }
+  return false;
+}
+
+bool IsBackfacing(const ObjFileData::Meshlet& meshlet, const float viewPosition[3]) {
+  float toApex[3] = {meshlet.coneApex[0] - viewPosition[0], meshlet.coneApex[1] - viewPosition[1],
+                     meshlet.coneApex[2] - viewPosition[2]};
+  if (!Normalize(toApex))
+    return false;
+  return Dot(toApex, meshlet.coneAxis) >= meshlet.coneCutoff;
+}
+
+}  // namespace MeshletBuilder
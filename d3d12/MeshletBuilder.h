@@ -0,0 +1,45 @@
+#pragma once
+
+#include "d3d12/ObjFileLoader.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+// Splits mesh parts into meshlets: clusters of up to kMaxVertices vertices and kMaxTriangles triangles, each with a
+// bounding sphere and a normal cone, so that they can be frustum and backface culled as a whole instead of drawing
+// every triangle of a large part.
+//
+// The triangles are taken in the order that they're in, which after MeshOptimizer has already grouped them by
+// locality; so a meshlet is just a contiguous range of its part's indices, and building them doesn't move any data.
+namespace MeshletBuilder {
+
+// The sizes recommended for mesh shaders; they keep a meshlet's vertices and primitives within a single thread group's
+// output limits (and 124 triangles leave room for a 4-byte primitive count in a 128-entry primitive buffer).
+constexpr size_t kMaxVertices = 64;
+constexpr size_t kMaxTriangles = 124;
+
+// Appends the meshlets for the given range of indices (a whole number of triangles) to |meshlets|.
+void BuildMeshlets(const ObjFileData::Vertex* vertices,
+                   size_t numVertices,
+                   const uint32_t* indices,
+                   uint32_t indexStart,
+                   uint32_t numIndices,
+                   /*out*/ std::vector<ObjFileData::Meshlet>* meshlets);
+
+// Replaces the data's meshlets with new ones for all of its mesh parts, built in parallel, and points the parts at
+// them.
+void Build(ObjFileData* data);
+
+// Both tests are in the space that the mesh's vertices are in; they're conservative, so a meshlet that they don't
+// reject may still turn out to be entirely invisible.
+
+// |planes| are (a, b, c, d), with a point p inside a plane when a * p.x + b * p.y + c * p.z + d >= 0.
+bool IsOutsideFrustum(const ObjFileData::Meshlet& meshlet, const float planes[][4], size_t numPlanes);
+
+// True if every triangle of the meshlet faces away from |viewPosition|. A triangle's front is the side that its
+// vertices wind counterclockwise around, as in obj files.
+bool IsBackfacing(const ObjFileData::Meshlet& meshlet, const float viewPosition[3]);
+
+}  // namespace MeshletBuilder
@@ -9,64 +9,311 @@
 #include <wrl/client.h>  // For ComPtr
 
 #include <assert.h>
+#include <algorithm>
 #include <filesystem>
-#include <iostream>
 #include <vector>
 
 using namespace Microsoft::WRL;
 
+static DXGI_FORMAT GetTextureFormat(ImageFormat format) {
+  switch (format) {
+    case ImageFormat::BC1:
+      return DXGI_FORMAT_BC1_UNORM;
+    case ImageFormat::BC3:
+      return DXGI_FORMAT_BC3_UNORM;
+    case ImageFormat::BC7:
+      return DXGI_FORMAT_BC7_UNORM;
+    default:
+      return DXGI_FORMAT_R8G8B8A8_UNORM;
+  }
+}
+
+// Appends |newData| to a buffer that currently holds |usedSize| bytes, reallocating it (and copying the existing data
+// over) if it doesn't have enough room. The capacity is doubled on each reallocation, so that appending a model batch
+// by batch only copies each byte a small number of times.
+//
+// Expects that |buffer| (if there is one) is in D3D12_RESOURCE_STATE_GENERIC_READ, and leaves it in that state.
+static void AppendToBuffer(D3D12Renderer* renderer,
+                           ComPtr<ID3D12Resource>* buffer,
+                           size_t* capacity,
+                           size_t usedSize,
+                           const void* newData,
+                           size_t newDataSize,
+                           bool shrinkToFit) {
+  const size_t requiredSize = usedSize + newDataSize;
+  const bool needsToGrow = requiredSize > *capacity;
+  const bool needsToShrink = shrinkToFit && requiredSize < *capacity;
+  if (requiredSize == 0 || (newDataSize == 0 && !needsToGrow && !needsToShrink))
+    return;
+
+  if (needsToGrow || needsToShrink) {
+    const size_t newCapacity = shrinkToFit ? requiredSize : (std::max)(requiredSize, 2 * *capacity);
+    ComPtr<ID3D12Resource> newBuffer = renderer->AllocateBuffer(newCapacity);
+
+    if (*buffer && usedSize > 0) {
+      CD3DX12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition(
+          buffer->Get(), D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_RESOURCE_STATE_COPY_SOURCE);
+      renderer->ExecuteBarriers(1, &barrier);
+      renderer->CopyBufferRegion(newBuffer.Get(), buffer->Get(), usedSize);
+    }
+
+    // The previous frame may still be reading from the old buffer.
+    if (*buffer)
+      renderer->ReleaseAfterCurrentFrame(std::move(*buffer));
+
+    *buffer = std::move(newBuffer);
+    *capacity = newCapacity;
+  } else {
+    CD3DX12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition(
+        buffer->Get(), D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_RESOURCE_STATE_COPY_DEST);
+    renderer->ExecuteBarriers(1, &barrier);
+  }
+
+  if (newDataSize > 0)
+    renderer->UploadBufferRegion(buffer->Get(), usedSize, newData, newDataSize);
+
+  CD3DX12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition(
+      buffer->Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_GENERIC_READ);
+  renderer->ExecuteBarriers(1, &barrier);
+}
+
 void Model::Init(D3D12Renderer* renderer,
-                 const std::vector<ObjFileData::Vertex>& vertices,
-                 const std::vector<uint32_t>& indices,
-                 const std::vector<ObjFileData::MeshPart>& meshParts,
+                 const ObjFileData::Vertex* vertices,
+                 size_t numVertices,
+                 const ObjFileData::Tangent* tangents,
+                 size_t numTangents,
+                 const uint32_t* indices,
+                 size_t numIndices,
+                 const ObjFileData::MeshPart* meshParts,
+                 size_t numMeshParts,
+                 const ObjFileData::MeshLod* lods,
+                 size_t numLods,
                  const std::vector<ObjFileData::Material>& materials) {
+  // Kick off the texture decodes first, so that they run (in parallel) while the buffers are being uploaded.
+  AddMaterials(materials);
+
   renderer->BeginResourceUpload();
 
   std::vector<CD3DX12_RESOURCE_BARRIER> barriers;
-  barriers.reserve(2 + materials.size());  // 1 for vertex buffer, 1 for index buffer, 1 for each of the materials.
+  barriers.reserve(3);  // 1 for vertex buffer, 1 for index buffer, 1 for tangent buffer.
 
   // Upload the vertex data.
-  const size_t vertexBufferSize = vertices.size() * sizeof(ObjFileData::Vertex);
-  m_vertexBuffer = renderer->AllocateAndUploadBufferData(vertices.data(), vertexBufferSize);
+  const size_t vertexBufferSize = numVertices * sizeof(ObjFileData::Vertex);
+  m_vertexBuffer = renderer->AllocateAndUploadBufferData(vertices, vertexBufferSize);
   barriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(m_vertexBuffer.Get(), D3D12_RESOURCE_STATE_COPY_DEST,
     D3D12_RESOURCE_STATE_GENERIC_READ));
 
   m_vertexBufferView.BufferLocation = m_vertexBuffer->GetGPUVirtualAddress();
   m_vertexBufferView.SizeInBytes = vertexBufferSize;
   m_vertexBufferView.StrideInBytes = sizeof(ObjFileData::Vertex);
+  m_vertexBufferCapacity = vertexBufferSize;
+
+  if (numTangents > 0) {
+    const size_t tangentBufferSize = numTangents * sizeof(ObjFileData::Tangent);
+    m_tangentBuffer = renderer->AllocateAndUploadBufferData(tangents, tangentBufferSize);
+    barriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(m_tangentBuffer.Get(), D3D12_RESOURCE_STATE_COPY_DEST,
+                                                            D3D12_RESOURCE_STATE_GENERIC_READ));
 
-  // Upload the index data.
-  const size_t indexBufferSize = indices.size() * sizeof(uint32_t);
-  m_indexBuffer = renderer->AllocateAndUploadBufferData(indices.data(), indexBufferSize);
+    m_tangentBufferView.BufferLocation = m_tangentBuffer->GetGPUVirtualAddress();
+    m_tangentBufferView.SizeInBytes = tangentBufferSize;
+    m_tangentBufferCapacity = tangentBufferSize;
+  }
+
+  // Upload the index data, packed into 16 bits where possible.
+  IndexPacking::PackedIndices packedIndices = IndexPacking::Pack(indices, meshParts, numMeshParts, lods, numLods);
+  const size_t indexBufferSize = packedIndices.pool.size() * sizeof(uint16_t);
+  m_indexBuffer = renderer->AllocateAndUploadBufferData(packedIndices.pool.data(), indexBufferSize);
   barriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(m_indexBuffer.Get(), D3D12_RESOURCE_STATE_COPY_DEST,
                                                           D3D12_RESOURCE_STATE_GENERIC_READ));
 
   m_indexBufferView.BufferLocation = m_indexBuffer->GetGPUVirtualAddress();
   m_indexBufferView.SizeInBytes = indexBufferSize;
   m_indexBufferView.Format = DXGI_FORMAT_R32_UINT;
+  m_indexBufferCapacity = indexBufferSize;
 
   // Just copy over the meshPart data.
-  m_meshParts = meshParts;
+  m_meshParts.assign(meshParts, meshParts + numMeshParts);
+  m_lods.assign(lods, lods + numLods);
+  m_draws = std::move(packedIndices.draws);
+  m_firstDraws = std::move(packedIndices.firstDraws);
+  SortMeshParts();
+  BuildMeshPartHierarchy();
+  ++m_geometryVersion;
+
+  renderer->ExecuteBarriers(barriers.size(), barriers.data());
 
   // Upload all of the texture data.
-  m_materials.resize(materials.size());
+  UploadDecodedTextures(renderer, /*waitForAll*/ true);
+
+  renderer->FinalizeResourceUpload();
+}
+
+void Model::AppendStreamedBatch(D3D12Renderer* renderer, const StreamingObjLoader::Batch& batch) {
+  // The new geometry is written over the old from the start of the buffers.
+  if (batch.replacesGeometry) {
+    m_vertexBufferView.SizeInBytes = 0;
+    m_indexBufferView.SizeInBytes = 0;
+    m_tangentBufferView.SizeInBytes = 0;
+  }
+
+  // Quantized vertices only ever come with all of the geometry, so the two formats are never mixed in one buffer.
+  m_hasQuantizedVertices = !batch.quantizedVertices.empty();
+  m_vertexBufferView.StrideInBytes = sizeof(ObjFileData::Vertex);
+  if (m_hasQuantizedVertices) {
+    m_vertexBufferView.StrideInBytes = sizeof(VertexQuantization::QuantizedVertex);
+    m_positionTransform = VertexQuantization::GetPositionTransform(batch.bounds);
+  }
+
+  const StreamingObjLoader::Batch::BufferData vertexData = batch.GetVertexData();
+  AppendToBuffer(renderer, &m_vertexBuffer, &m_vertexBufferCapacity, m_vertexBufferView.SizeInBytes, vertexData.data,
+                 vertexData.size, /*shrinkToFit*/ batch.isFinal);
+  if (m_vertexBuffer) {
+    m_vertexBufferView.BufferLocation = m_vertexBuffer->GetGPUVirtualAddress();
+    m_vertexBufferView.SizeInBytes += vertexData.size;
+  }
+
+  // The tangents only come with all of the geometry as well, and aren't ever quantized.
+  const StreamingObjLoader::Batch::BufferData tangentData = batch.GetTangentData();
+  AppendToBuffer(renderer, &m_tangentBuffer, &m_tangentBufferCapacity, m_tangentBufferView.SizeInBytes,
+                 tangentData.data, tangentData.size, /*shrinkToFit*/ batch.isFinal);
+  if (m_tangentBuffer) {
+    m_tangentBufferView.BufferLocation = m_tangentBuffer->GetGPUVirtualAddress();
+    m_tangentBufferView.SizeInBytes += tangentData.size;
+  }
+
+  // Likewise, packed indices only come with all of the geometry.
+  const bool hasPackedIndices = !batch.packedIndices.firstDraws.empty();
+  const StreamingObjLoader::Batch::BufferData indexData = batch.GetIndexData();
+  AppendToBuffer(renderer, &m_indexBuffer, &m_indexBufferCapacity, m_indexBufferView.SizeInBytes, indexData.data,
+                 indexData.size, /*shrinkToFit*/ batch.isFinal);
+  if (m_indexBuffer) {
+    m_indexBufferView.BufferLocation = m_indexBuffer->GetGPUVirtualAddress();
+    m_indexBufferView.SizeInBytes += indexData.size;
+  }
+
+  // Only the new materials are in the batch; the ones that have already been added don't change. Their textures are
+  // uploaded by UploadDecodedTextures once they've been decoded.
+  AddMaterials(batch.materials);
+
+  m_meshParts = batch.meshParts;
+  m_lods = batch.lods;
+  m_bounds = batch.bounds;
+
+  if (hasPackedIndices) {
+    m_draws = batch.packedIndices.draws;
+    m_firstDraws = batch.packedIndices.firstDraws;
+  } else {
+    IndexPacking::PackedIndices layout =
+        IndexPacking::GetUnpackedLayout(m_meshParts.data(), m_meshParts.size(), m_lods.data(), m_lods.size());
+    m_draws = std::move(layout.draws);
+    m_firstDraws = std::move(layout.firstDraws);
+  }
+  SortMeshParts();
+  if (batch.isFinal)
+    BuildMeshPartHierarchy();
+  else
+    m_meshPartHierarchy.Clear();
+  ++m_geometryVersion;
+}
+
+void Model::AddMaterials(const std::vector<ObjFileData::Material>& materials) {
+  const size_t firstMaterialIndex = m_materials.size();
+  m_materials.resize(firstMaterialIndex + materials.size());
   for (size_t i = 0; i < materials.size(); ++i) {
-    const ObjFileData::Material& material = materials[i];
-    if (std::filesystem::exists(material.diffuseMap.file)) {
-      Image img;
-      HR(Image::LoadImageFile(material.diffuseMap.file.wstring(), &img));
-
-      // Upload the texture.
-      m_materials[i].m_texture =
-          renderer->AllocateAndUploadTextureData(img.data.data(), img.format, img.bytesPerPixel, img.width, img.height,
-                                                 /*out*/ &m_materials[i].m_srvDescriptor);
-      barriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(
-          m_materials[i].m_texture.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
+    const std::filesystem::path& textureFile = materials[i].diffuseMap.file;
+    if (!std::filesystem::exists(textureFile))
+      continue;
+
+    Material& material = m_materials[firstMaterialIndex + i];
+    material.m_isPending = true;
+    material.m_textureId = m_textureLoader.Request(textureFile);
+    m_pendingMaterials.push_back({firstMaterialIndex + i, material.m_textureId});
+  }
+}
+
+void Model::SortMeshParts() {
+  auto getTextureId = [this](uint32_t meshPartIndex) {
+    const uint32_t materialIndex = m_meshParts[meshPartIndex].materialIndex;
+    return (materialIndex < m_materials.size()) ? m_materials[materialIndex].m_textureId : kNoTexture;
+  };
+
+  m_meshPartDrawOrder.resize(m_meshParts.size());
+  for (size_t i = 0; i < m_meshParts.size(); ++i)
+    m_meshPartDrawOrder[i] = static_cast<uint32_t>(i);
+  std::stable_sort(m_meshPartDrawOrder.begin(), m_meshPartDrawOrder.end(),
+                   [&](uint32_t a, uint32_t b) { return getTextureId(a) < getTextureId(b); });
+}
+
+void Model::BuildMeshPartHierarchy() {
+  std::vector<ObjFileData::AxisAlignedBounds> bounds(m_meshPartDrawOrder.size());
+  for (size_t i = 0; i < bounds.size(); ++i)
+    bounds[i] = m_meshParts[m_meshPartDrawOrder[i]].bounds;
+  m_meshPartHierarchy.Build(bounds.data(), bounds.size());
+}
+
+void Model::CullMeshParts(const FrustumCulling::Frustum& frustum, /*out*/ std::vector<uint32_t>* drawList) const {
+  if (m_meshPartHierarchy.IsEmpty()) {
+    *drawList = m_meshPartDrawOrder;
+    return;
+  }
+
+  // The hierarchy's items are places in the draw order, so sorting them puts the visible parts back in that order.
+  drawList->clear();
+  m_meshPartHierarchy.Cull(frustum, drawList);
+  std::sort(drawList->begin(), drawList->end());
+  for (uint32_t& meshPartIndex : *drawList)
+    meshPartIndex = m_meshPartDrawOrder[meshPartIndex];
+}
+
+void Model::UploadDecodedTextures(D3D12Renderer* renderer, bool waitForAll) {
+  std::vector<CD3DX12_RESOURCE_BARRIER> barriers;
+
+  size_t numStillPending = 0;
+  for (size_t i = 0; i < m_pendingMaterials.size(); ++i) {
+    const PendingMaterial pendingMaterial = m_pendingMaterials[i];
+    if (!waitForAll && !m_textureLoader.IsDecoded(pendingMaterial.textureId)) {
+      m_pendingMaterials[numStillPending++] = pendingMaterial;
+      continue;
     }
+
+    Material& material = m_materials[pendingMaterial.materialIndex];
+    material.m_isPending = false;
+
+    auto uploadedMaterial = m_materialIndicesByTexture.find(pendingMaterial.textureId);
+    if (uploadedMaterial != m_materialIndicesByTexture.end()) {
+      const Material& sharedMaterial = m_materials[uploadedMaterial->second];
+      material.m_texture = sharedMaterial.m_texture;
+      material.m_srvDescriptor = sharedMaterial.m_srvDescriptor;
+      continue;
+    }
+
+    // A warning has already been printed if the image couldn't be decoded.
+    std::unique_ptr<Image> img = m_textureLoader.TakeImage(pendingMaterial.textureId);
+    if (!img)
+      continue;
+
+    // Upload the texture, with all of its mips.
+    std::vector<D3D12_SUBRESOURCE_DATA> mips(img->numMips);
+    for (size_t mip = 0; mip < img->numMips; ++mip) {
+      mips[mip].pData = img->data.data() + img->GetMipOffset(mip);
+      mips[mip].RowPitch = img->GetRowPitch(mip);
+      mips[mip].SlicePitch = img->GetRowPitch(mip) * img->GetNumRows(mip);
+    }
+    material.m_texture = renderer->AllocateAndUploadTextureData(GetTextureFormat(img->format), img->width, img->height,
+                                                                mips.size(), mips.data(),
+                                                                /*out*/ &material.m_srvDescriptor);
+    barriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(
+        material.m_texture.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
+    m_materialIndicesByTexture.emplace(pendingMaterial.textureId, pendingMaterial.materialIndex);
   }
+  m_pendingMaterials.resize(numStillPending);
 
-  renderer->ExecuteBarriers(barriers.size(), barriers.data());
-  renderer->FinalizeResourceUpload();
+  if (!barriers.empty())
+    renderer->ExecuteBarriers(barriers.size(), barriers.data());
+}
+
+bool Model::HasPendingTextures() const {
+  return !m_pendingMaterials.empty();
 }
 
 void Model::InitCube(D3D12Renderer* renderer) {
@@ -130,28 +377,43 @@ void Model::InitCube(D3D12Renderer* renderer) {
   meshParts[0].indexStart = 0;
   meshParts[0].numIndices = indices.size();
   meshParts[0].materialIndex = -1;
+  meshParts[0].bounds = m_bounds;
 
   // TODO: Pretty sure this will crash without a material. Should probably generate a generic material.
   //       (Or handle the case better where we don't have a material).
   std::vector<ObjFileData::Material> materials;
-  Init(renderer, vertices, indices, meshParts, materials);
-}
-
-bool Model::InitFromObjFile(D3D12Renderer* renderer, const std::string& fileName) {
-  ObjFileData data;
-  if (!data.ParseObjFile(fileName)) {
-    return false;
-  }
-
-  m_bounds = data.m_bounds;
-  Init(renderer, data.m_vertices, data.m_indices, data.m_meshParts, data.m_materials);
-  return true;
+  Init(renderer, vertices.data(), vertices.size(), /*tangents*/ nullptr, /*numTangents*/ 0, indices.data(),
+       indices.size(), meshParts.data(), meshParts.size(), /*lods*/ nullptr, /*numLods*/ 0, materials);
 }
 
 D3D12_VERTEX_BUFFER_VIEW& Model::GetVertexBufferView() {
   return m_vertexBufferView;
 }
 
+bool Model::HasTangents() const {
+  return m_tangentBufferView.SizeInBytes > 0;
+}
+
 const ObjFileData::AxisAlignedBounds& Model::GetBounds() const {
   return m_bounds;
 }
+
+void Model::DrawMeshPart(ID3D12GraphicsCommandList* cl,
+                         size_t meshPartIndex,
+                         float maxLodError,
+                         unsigned int instanceCount,
+                         unsigned int startInstance) const {
+  // The levels get coarser (and their errors larger) as they go.
+  const ObjFileData::MeshPart& meshPart = m_meshParts[meshPartIndex];
+  size_t drawRange = meshPartIndex;
+  for (uint32_t l = 0; l < meshPart.numLods && m_lods[meshPart.lodStart + l].error <= maxLodError; ++l)
+    drawRange = m_meshParts.size() + meshPart.lodStart + l;
+
+  for (uint32_t d = m_firstDraws[drawRange]; d < m_firstDraws[drawRange + 1]; ++d) {
+    const IndexPacking::Draw& draw = m_draws[d];
+    D3D12_INDEX_BUFFER_VIEW indexBufferView = m_indexBufferView;
+    indexBufferView.Format = (draw.indexSize == 2) ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+    cl->IASetIndexBuffer(&indexBufferView);
+    cl->DrawIndexedInstanced(draw.numIndices, instanceCount, draw.indexStart, draw.baseVertex, startInstance);
+  }
+}
@@ -1,39 +1,138 @@
 #pragma once
 
 #include "d3d12/DescriptorHeapManagers.h"
+#include "d3d12/FrustumCulling.h"
+#include "d3d12/IndexPacking.h"
 #include "d3d12/ObjFileLoader.h"
+#include "d3d12/StreamingObjLoader.h"
+#include "d3d12/TextureLoader.h"
+#include "d3d12/VertexQuantization.h"
 
 #include <d3d12.h>
 #include <wrl/client.h>  // For ComPtr
 
+#include <limits>
+#include <unordered_map>
 #include <vector>
 
 class D3D12Renderer;
 
 struct Model {
+  static constexpr TextureLoader::TextureId kNoTexture = std::numeric_limits<TextureLoader::TextureId>::max();
+
   struct Material {
     Microsoft::WRL::ComPtr<ID3D12Resource> m_texture;
     DescriptorAllocation m_srvDescriptor;
+    // Materials with the same texture file have the same id, and end up sharing the texture once it's uploaded.
+    TextureLoader::TextureId m_textureId = kNoTexture;
+
+    // Set while the texture is still being decoded. The material can't be drawn with until it has been uploaded.
+    bool m_isPending = false;
+  };
+
+  struct PendingMaterial {
+    size_t materialIndex;
+    TextureLoader::TextureId textureId;
   };
 
   Microsoft::WRL::ComPtr<ID3D12Resource> m_indexBuffer;
   Microsoft::WRL::ComPtr<ID3D12Resource> m_vertexBuffer;
-  D3D12_VERTEX_BUFFER_VIEW m_vertexBufferView;
-  D3D12_INDEX_BUFFER_VIEW m_indexBufferView;
+  D3D12_VERTEX_BUFFER_VIEW m_vertexBufferView = {0, 0, sizeof(ObjFileData::Vertex)};
+  // The index buffer is a pool of mixed 16- and 32-bit indices (see IndexPacking), so the view's format is only a
+  // default; DrawMeshPart sets up a view with the right format for each draw.
+  D3D12_INDEX_BUFFER_VIEW m_indexBufferView = {0, 0, DXGI_FORMAT_R32_UINT};
+
+  // One for each vertex, for models with normal maps (see TangentGenerator); the view is empty otherwise. They're a
+  // separate stream, to be bound to the second input slot, so that the passes that don't need them don't fetch them.
+  Microsoft::WRL::ComPtr<ID3D12Resource> m_tangentBuffer;
+  D3D12_VERTEX_BUFFER_VIEW m_tangentBufferView = {0, 0, sizeof(ObjFileData::Tangent)};
+
+  // While streaming, the buffers are allocated with room to grow. The views only cover the part that's in use.
+  size_t m_vertexBufferCapacity = 0;
+  size_t m_indexBufferCapacity = 0;
+  size_t m_tangentBufferCapacity = 0;
+
+  // Set once the vertex buffer holds VertexQuantization::QuantizedVertex rather than ObjFileData::Vertex. The
+  // positions then have to be mapped back with m_positionTransform.
+  bool m_hasQuantizedVertices = false;
+  VertexQuantization::PositionTransform m_positionTransform = {};
 
   std::vector<ObjFileData::MeshPart> m_meshParts;
+  std::vector<ObjFileData::MeshLod> m_lods;
+  // The draws of mesh part i are [m_firstDraws[i], m_firstDraws[i + 1]), followed by those of the levels of detail
+  // (see IndexPacking::PackedIndices). The mesh parts' own index ranges refer to the indices before they were packed.
+  std::vector<IndexPacking::Draw> m_draws;
+  std::vector<uint32_t> m_firstDraws;
   std::vector<Material> m_materials;
+  // The mesh parts sorted by their materials' textures, so that drawing them in this order only switches textures once
+  // per texture. Kept up to date by SortMeshParts.
+  std::vector<uint32_t> m_meshPartDrawOrder;
+  // Over the mesh parts' bounds, with the parts numbered by their place in m_meshPartDrawOrder. Empty while the model
+  // is still streaming in, since the parts' bounds are only known once the whole file has been parsed.
+  FrustumCulling::BoundingVolumeHierarchy m_meshPartHierarchy;
   ObjFileData::AxisAlignedBounds m_bounds;
+  // Goes up every time the geometry changes (by Init or AppendStreamedBatch), so that whatever has been drawn from it
+  // can tell when it has to be drawn again.
+  uint64_t m_geometryVersion = 0;
 
+  TextureLoader m_textureLoader;
+  std::vector<PendingMaterial> m_pendingMaterials;
+  // Materials that share a texture also share the uploaded resource.
+  std::unordered_map<TextureLoader::TextureId, size_t> m_materialIndicesByTexture;
+
+  // The data only needs to stay alive for the duration of the call; it's copied into GPU resources (and, in the case
+  // of the mesh parts, into m_meshParts).
   void Init(D3D12Renderer* renderer,
-            const std::vector<ObjFileData::Vertex>& vertices,
-            const std::vector<uint32_t>& indices,
-            const std::vector<ObjFileData::MeshPart>& meshParts,
+            const ObjFileData::Vertex* vertices,
+            size_t numVertices,
+            const ObjFileData::Tangent* tangents,
+            size_t numTangents,
+            const uint32_t* indices,
+            size_t numIndices,
+            const ObjFileData::MeshPart* meshParts,
+            size_t numMeshParts,
+            const ObjFileData::MeshLod* lods,
+            size_t numLods,
             const std::vector<ObjFileData::Material>& materials);
 
+  // Appends the batch to the model, or swaps its geometry in for batches that replace it. Unlike Init, this doesn't
+  // wait for the GPU; the upload is recorded onto the renderer's current command list, so it may only be called while
+  // the renderer is drawing a frame. Once the final batch has been appended, the buffers are shrunk to fit.
+  void AppendStreamedBatch(D3D12Renderer* renderer, const StreamingObjLoader::Batch& batch);
+
+  // Starts decoding the materials' textures in the background. Until they've been uploaded by UploadDecodedTextures,
+  // the materials are left pending.
+  void AddMaterials(const std::vector<ObjFileData::Material>& materials);
+
+  // Uploads the textures that have finished decoding, or all of them if |waitForAll| is set. Like
+  // AppendStreamedBatch, the upload is recorded onto the renderer's current command list.
+  void UploadDecodedTextures(D3D12Renderer* renderer, bool waitForAll);
+  bool HasPendingTextures() const;
+
+  // Has to be called whenever the mesh parts or the materials change.
+  void SortMeshParts();
+  // Has to be called after SortMeshParts, once the mesh parts have their bounds.
+  void BuildMeshPartHierarchy();
+
+  // Replaces |drawList| with the mesh parts that are at least partly inside |frustum| (in the model's own space), in
+  // the order they're to be drawn in. That's all of them until the model has its hierarchy.
+  void CullMeshParts(const FrustumCulling::Frustum& frustum, /*out*/ std::vector<uint32_t>* drawList) const;
+
   void InitCube(D3D12Renderer* renderer);
-  bool InitFromObjFile(D3D12Renderer* renderer, const std::string& fileName);
 
   D3D12_VERTEX_BUFFER_VIEW& GetVertexBufferView();
+  bool HasTangents() const;
   const ObjFileData::AxisAlignedBounds& GetBounds() const;
+
+  // Expects the vertex buffer to be bound already. Binds the index buffer itself, since the draws of a mesh part may
+  // not all have the same index format.
+  //
+  // Draws the part's coarsest level of detail whose error is no more than |maxLodError| (in model units; see
+  // Object::GetMaxLodError), or the part itself if none of them are. The part is drawn for |instanceCount| instances
+  // at once, starting at |startInstance| in the per-instance vertex data.
+  void DrawMeshPart(ID3D12GraphicsCommandList* cl,
+                    size_t meshPartIndex,
+                    float maxLodError = 0.f,
+                    unsigned int instanceCount = 1,
+                    unsigned int startInstance = 0) const;
 };
@@ -0,0 +1,200 @@
+#include "d3d12/NormalGenerator.h"
+
+#include "utils/ThreadPool.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+#include <numeric>
+
+namespace NormalGenerator {
+
+namespace {
+// Each of the passes is split into chunks of this many triangles (or positions) on the thread pool.
+constexpr size_t kItemsPerChunk = 16 * 1024;
+
+// For corners with no faces to take a normal from, i.e. those of degenerate triangles that have no neighbors.
+constexpr float kFallbackNormal[3] = {0.f, 1.f, 0.f};
+
+struct Face {
+  float normal[3];  // Zero for degenerate triangles.
+  float cornerWeights[3];
+};
+
+float Dot(const float a[3], const float b[3]) {
+  return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+void Cross(const float a[3], const float b[3], /*out*/ float result[3]) {
+  result[0] = a[1] * b[2] - a[2] * b[1];
+  result[1] = a[2] * b[0] - a[0] * b[2];
+  result[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+// Returns the vector's length.
+float Normalize(float vector[3]) {
+  const float length = sqrtf(Dot(vector, vector));
+  if (length > 0.f) {
+    for (size_t i = 0; i < 3; ++i)
+      vector[i] /= length;
+  }
+  return length;
+}
+
+// The angle between two edges, which is more accurate from the cross product and dot product together than from
+// either on its own.
+float AngleBetween(const float a[3], const float b[3]) {
+  float cross[3];
+  Cross(a, b, cross);
+  return atan2f(sqrtf(Dot(cross, cross)), Dot(a, b));
+}
+
+Face ComputeFace(const ObjFileData::Vertex& v0, const ObjFileData::Vertex& v1, const ObjFileData::Vertex& v2) {
+  const float* corners[3] = {v0.pos, v1.pos, v2.pos};
+  float toNext[3][3];
+  float toPrevious[3][3];
+  for (size_t i = 0; i < 3; ++i) {
+    for (size_t c = 0; c < 3; ++c) {
+      toNext[i][c] = corners[(i + 1) % 3][c] - corners[i][c];
+      toPrevious[i][c] = corners[(i + 2) % 3][c] - corners[i][c];
+    }
+  }
+
+  Face face = {};
+  Cross(toNext[0], toPrevious[0], face.normal);
+  const float area = Normalize(face.normal) * 0.5f;
+  if (!(area > 0.f))
+    return Face{};
+
+  for (size_t i = 0; i < 3; ++i)
+    face.cornerWeights[i] = AngleBetween(toNext[i], toPrevious[i]) * area;
+  return face;
+}
+}  // namespace
+
+void GenerateNormals(const std::vector<Triangle>& triangles,
+                     size_t numPositions,
+                     float creaseAngleInDegrees,
+                     /*out*/ std::vector<ObjFileData::Vertex>* vertices,
+                     /*out*/ std::vector<uint32_t>* indices) {
+  if (triangles.empty())
+    return;
+
+  ThreadPool& threadPool = ThreadPool::GetShared();
+  std::vector<ObjFileData::Vertex>& vertexData = *vertices;
+  std::vector<uint32_t>& indexData = *indices;
+  auto vertexAt = [&](size_t corner) -> ObjFileData::Vertex& {
+    return vertexData[indexData[triangles[corner / 3].indexStart + corner % 3]];
+  };
+
+  const size_t numTriangleChunks = (triangles.size() + kItemsPerChunk - 1) / kItemsPerChunk;
+  auto forEachTriangleChunk = [&](const auto& func) {
+    threadPool.ParallelFor(numTriangleChunks, [&](size_t chunk) {
+      const size_t start = chunk * kItemsPerChunk;
+      func(start, std::min(start + kItemsPerChunk, triangles.size()));
+    });
+  };
+
+  std::vector<Face> faces(triangles.size());
+  forEachTriangleChunk([&](size_t start, size_t end) {
+    for (size_t t = start; t < end; ++t)
+      faces[t] = ComputeFace(vertexAt(3 * t), vertexAt(3 * t + 1), vertexAt(3 * t + 2));
+  });
+
+  // The corners at each position, as 3 * triangle + corner.
+  std::vector<uint32_t> cornerOffsets(numPositions + 1, 0);
+  for (const Triangle& triangle : triangles) {
+    for (uint32_t position : triangle.positions)
+      ++cornerOffsets[position + 1];
+  }
+  std::partial_sum(cornerOffsets.begin(), cornerOffsets.end(), cornerOffsets.begin());
+  std::vector<uint32_t> corners(cornerOffsets.back());
+  {
+    std::vector<uint32_t> fill(cornerOffsets.begin(), cornerOffsets.end() - 1);
+    for (size_t corner = 0; corner < 3 * triangles.size(); ++corner)
+      corners[fill[triangles[corner / 3].positions[corner % 3]]++] = static_cast<uint32_t>(corner);
+  }
+
+  // Each corner only writes to its own vertex, so they can all be done in parallel.
+  const float minCreaseDot = cosf(creaseAngleInDegrees * 3.14159265f / 180.f);
+  forEachTriangleChunk([&](size_t start, size_t end) {
+    for (size_t t = start; t < end; ++t) {
+      const Face& face = faces[t];
+      const uint32_t smoothingGroup = triangles[t].smoothingGroup;
+      const bool isDegenerate = Dot(face.normal, face.normal) == 0.f;
+      for (size_t c = 0; c < 3; ++c) {
+        float normal[3] = {face.normal[0], face.normal[1], face.normal[2]};
+        if (smoothingGroup != kNoSmoothingGroup) {
+          normal[0] = normal[1] = normal[2] = 0.f;
+          const uint32_t position = triangles[t].positions[c];
+          for (uint32_t i = cornerOffsets[position]; i < cornerOffsets[position + 1]; ++i) {
+            const uint32_t other = corners[i];
+            const Face& otherFace = faces[other / 3];
+            if (triangles[other / 3].smoothingGroup != smoothingGroup)
+              continue;
+            // Degenerate faces have no direction of their own to crease against, so they take on their neighbors'.
+            if (!isDegenerate && Dot(face.normal, otherFace.normal) < minCreaseDot)
+              continue;
+
+            for (size_t axis = 0; axis < 3; ++axis)
+              normal[axis] += otherFace.normal[axis] * otherFace.cornerWeights[other % 3];
+          }
+        }
+
+        if (!(Normalize(normal) > 0.f))
+          memcpy(normal, isDegenerate ? kFallbackNormal : face.normal, sizeof(normal));
+        // Faces in one of the coordinate planes can come out with -0 in their normals in some triangles and +0 in
+        // others, depending on the signs of their edges, and the merge below compares the vertices' bytes.
+        for (float& component : normal) {
+          if (component == 0.f)
+            component = 0.f;
+        }
+        memcpy(vertexAt(3 * t + c).normal, normal, sizeof(normal));
+      }
+    }
+  });
+
+  // Merge the vertices that came out the same. Only the corners at the same position can be, and each vertex belongs
+  // to just one of those, so the positions can be done in parallel too.
+  std::vector<uint32_t> mergedInto(vertexData.size());
+  std::iota(mergedInto.begin(), mergedInto.end(), 0);
+  const size_t numPositionChunks = (numPositions + kItemsPerChunk - 1) / kItemsPerChunk;
+  threadPool.ParallelFor(numPositionChunks, [&](size_t chunk) {
+    std::vector<uint32_t> distinctVertices;
+    const size_t end = std::min((chunk + 1) * kItemsPerChunk, numPositions);
+    for (size_t position = chunk * kItemsPerChunk; position < end; ++position) {
+      distinctVertices.clear();
+      for (uint32_t i = cornerOffsets[position]; i < cornerOffsets[position + 1]; ++i) {
+        const uint32_t vertex = indexData[triangles[corners[i] / 3].indexStart + corners[i] % 3];
+        auto same = std::find_if(distinctVertices.begin(), distinctVertices.end(), [&](uint32_t distinct) {
+          return memcmp(&vertexData[distinct], &vertexData[vertex], sizeof(ObjFileData::Vertex)) == 0;
+        });
+        if (same == distinctVertices.end()) {
+          distinctVertices.push_back(vertex);
+        } else {
+          mergedInto[vertex] = *same;
+        }
+      }
+    }
+  });
+
+  std::vector<uint32_t> newIndices(vertexData.size());
+  size_t numVertices = 0;
+  for (size_t v = 0; v < vertexData.size(); ++v) {
+    if (mergedInto[v] != v)
+      continue;
+    newIndices[v] = static_cast<uint32_t>(numVertices);
+    vertexData[numVertices++] = vertexData[v];
+  }
+  vertexData.resize(numVertices);
+
+  const size_t numIndexChunks = (indexData.size() + kItemsPerChunk - 1) / kItemsPerChunk;
+  threadPool.ParallelFor(numIndexChunks, [&](size_t chunk) {
+    const size_t end = std::min((chunk + 1) * kItemsPerChunk, indexData.size());
+    for (size_t i = chunk * kItemsPerChunk; i < end; ++i)
+      indexData[i] = newIndices[mergedInto[indexData[i]]];
+  });
+}
+
+}  // namespace NormalGenerator
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "d3d12/ObjFileLoader.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <limits>
+#include <vector>
+
+// Generates smooth normals for the faces of an obj file that don't come with any, once the whole file has been parsed.
+//
+// While parsing, each corner of such a face gets a vertex of its own (with the face's normal, so that progress reports
+// have something to show). Afterwards, each corner's normal becomes the average of the normals of the faces around its
+// position, weighted by their area and by their angle at that position, so that neither long thin triangles nor finely
+// tessellated areas pull the normal towards themselves. Only faces in the same smoothing group (the obj file's "s"
+// statements) are averaged, and only if they're within the crease angle of the corner's own face, so that hard edges
+// stay hard. Then the corners that ended up with identical vertices are merged again.
+namespace NormalGenerator {
+
+// Faces in this group ("s off" or "s 0") are flat shaded.
+constexpr uint32_t kNoSmoothingGroup = 0;
+
+// The group of the faces that come before any "s" statement, which for most files is all of them. They're smoothed
+// together, up to the crease angle.
+constexpr uint32_t kDefaultSmoothingGroup = std::numeric_limits<uint32_t>::max();
+
+struct Triangle {
+  // Into the indices. Each of the triangle's corners has to have a vertex of its own.
+  uint32_t indexStart;
+  // The corners' positions, as numbered in the obj file (but 0-based). Corners at the same position are smoothed
+  // together, even if they have different texture coordinates.
+  uint32_t positions[3];
+  uint32_t smoothingGroup;
+};
+
+// Sets the normals of the triangles' vertices, then merges the vertices that are identical and at the same position.
+// The remaining vertices keep their order, and the indices are renumbered to match. Runs on the shared thread pool.
+void GenerateNormals(const std::vector<Triangle>& triangles,
+                     size_t numPositions,
+                     float creaseAngleInDegrees,
+                     /*out*/ std::vector<ObjFileData::Vertex>* vertices,
+                     /*out*/ std::vector<uint32_t>* indices);
+
+}  // namespace NormalGenerator
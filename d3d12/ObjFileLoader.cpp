@@ -1,35 +1,29 @@
 #include "ObjFileLoader.h"
 
+#include "d3d12/FrustumCulling.h"
+#include "d3d12/MeshOptimizer.h"
+#include "d3d12/MeshSimplifier.h"
+#include "d3d12/MeshletBuilder.h"
+#include "d3d12/NormalGenerator.h"
+#include "d3d12/PolygonTriangulation.h"
+#include "d3d12/TangentGenerator.h"
+#include "d3d12/VertexDedupTable.h"
+#include "utils/MappedFile.h"
+#include "utils/TextScanning.h"
+#include "utils/ThreadPool.h"
+
 // Temporary.
 #include <iostream>
 
+#include <algorithm>
 #include <assert.h>
-#include <fstream>
+#include <cmath>
+#include <future>
+#include <limits>
 #include <optional>
 #include <string_view>
 #include <unordered_map>
 
-namespace {
-bool LoadFile(const char* fileName, std::vector<char>* fileContents) {
-  std::ifstream file(fileName, std::ios::in | std::ios::binary | std::ios::ate);
-  if (!file.is_open())
-    return false;
-
-  std::ifstream::pos_type fileSize = file.tellg();
-  file.seekg(0, std::ios::beg);
-
-  std::vector<char> contents(fileSize);
-  file.read(contents.data(), fileSize);
-  size_t bytesRead = file.gcount();
-  file.close();
-
-  if (bytesRead != fileSize)
-    return false;
-
-  *fileContents = std::move(contents);
-  return true;
-}
-}  // namespace
 
 // TODO: Texture options are not yet supported.
 // enum class TextureOption {
@@ -114,37 +108,18 @@ struct Indices {
   // If texCoordIndex or normalIndex are not specified, they will be set to 0.
   unsigned long long texCoordIndex;
   unsigned long long normalIndex;
-
-  struct Hash {
-    size_t operator()(const Indices& indices) const;
-  };
-
-  bool operator==(const Indices& other) const {
-    return (this->posIndex == other.posIndex && this->texCoordIndex == other.texCoordIndex &&
-            this->normalIndex == other.normalIndex);
-  }
 };
 
-template <class T>
-void hash_combine(std::size_t& s, const T& v);
-
-size_t Indices::Hash::operator()(const Indices& indices) const {
-  size_t hash = 0;
-  hash_combine(hash, indices.posIndex);
-  hash_combine(hash, indices.texCoordIndex);
-  hash_combine(hash, indices.normalIndex);
-  return hash;
-}
-
 // ------------------------------------------------------------------------------------------------
+// The tokenizer doesn't own the data that it scans; it's expected to be backed by a MappedFile that outlives it.
 class Tokenizer {
-  const std::vector<char> m_data;
+  const std::string_view m_data;
   size_t m_index;
 
   void ConsumeWhitespace();
 
  public:
-  Tokenizer(std::vector<char>&& file);
+  Tokenizer(std::string_view data);
 
   bool AcceptObjDeclaration(ObjDeclarationType* value);
   bool AcceptMtlDeclaration(MtlDeclarationType* value);
@@ -157,24 +132,14 @@ class Tokenizer {
   bool IsAtEnd();
 };
 
-Tokenizer::Tokenizer(std::vector<char>&& file) : m_data(std::move(file)), m_index(0) {}
-
-// NOTE: We don't consider a newline to be whitespace in this scenario, since it is used as a way to
-// denote a new statement.
-static bool IsWhitespace(char c) {
-  return (c == ' ' || c == '\t' || c == '\r' || c == '\v');
-}
+Tokenizer::Tokenizer(std::string_view data) : m_data(data), m_index(0) {}
 
 void Tokenizer::ConsumeWhitespace() {
-  while (m_index < m_data.size() && IsWhitespace(m_data[m_index])) {
-    m_index++;
-  }
+  m_index = TextScanning::SkipWhitespace(m_data.data(), m_data.size(), m_index);
 
   // Parse comments.
   if (m_index < m_data.size() && m_data[m_index] == '#') {
-    while (m_index < m_data.size() && m_data[m_index] != '\n') {
-      m_index++;
-    }
+    m_index = TextScanning::FindNewLine(m_data.data(), m_data.size(), m_index);
   }
 }
 
@@ -207,12 +172,9 @@ static bool ParseObjDeclarationType(const std::string_view& decl, ObjDeclaration
 bool Tokenizer::AcceptObjDeclaration(ObjDeclarationType* value) {
   ConsumeWhitespace();
   size_t start = m_index;
-  size_t end = m_index;
-  while (end < m_data.size() && !IsWhitespace(m_data[end]) && m_data[end] != '\n') {
-    end++;
-  }
+  size_t end = TextScanning::FindTokenEnd(m_data.data(), m_data.size(), m_index);
 
-  std::string_view declString(&m_data[start], end - start);
+  std::string_view declString = m_data.substr(start, end - start);
   if (ParseObjDeclarationType(declString, value)) {
     m_index = end;
     return true;
@@ -260,7 +222,7 @@ static bool ParseMtlDeclarationType(const std::string_view& decl, MtlDeclaration
     *type = MtlDeclarationType::Decal;
   } else if (decl == "disp") {
     *type = MtlDeclarationType::DisplacementMap;
-  } else if (decl == "bump") {
+  } else if (decl == "bump" || decl == "map_Bump" || decl == "map_bump") {
     *type = MtlDeclarationType::BumpMap;
   } else if (decl == "refl") {
     *type = MtlDeclarationType::ReflectionMap;
@@ -274,12 +236,9 @@ static bool ParseMtlDeclarationType(const std::string_view& decl, MtlDeclaration
 bool Tokenizer::AcceptMtlDeclaration(MtlDeclarationType* value) {
   ConsumeWhitespace();
   size_t start = m_index;
-  size_t end = m_index;
-  while (end < m_data.size() && !IsWhitespace(m_data[end]) && m_data[end] != '\n') {
-    end++;
-  }
+  size_t end = TextScanning::FindTokenEnd(m_data.data(), m_data.size(), m_index);
 
-  std::string_view declString(&m_data[start], end - start);
+  std::string_view declString = m_data.substr(start, end - start);
   if (ParseMtlDeclarationType(declString, value)) {
     m_index = end;
     return true;
@@ -291,35 +250,17 @@ bool Tokenizer::AcceptMtlDeclaration(MtlDeclarationType* value) {
 bool Tokenizer::AcceptInteger(long long* value) {
   ConsumeWhitespace();
 
-  const char* startPtr = &m_data[m_index];
-  char* endPtr;
-  long long parsedValue = strtoll(startPtr, &endPtr, /*radix*/ 10);
-
-  size_t lengthConsumed = endPtr - startPtr;
-  if (lengthConsumed > 0) {
-    m_index += lengthConsumed;
-    *value = parsedValue;
-    return true;
-  }
-
-  return false;
+  size_t lengthConsumed = TextScanning::ParseInteger(m_data.data() + m_index, m_data.size() - m_index, value);
+  m_index += lengthConsumed;
+  return lengthConsumed > 0;
 }
 
 bool Tokenizer::AcceptFloat(float* value) {
   ConsumeWhitespace();
 
-  const char* startPtr = &m_data[m_index];
-  char* endPtr;
-  float parsedValue = strtof(startPtr, &endPtr);
-
-  size_t lengthConsumed = endPtr - startPtr;
-  if (lengthConsumed > 0) {
-    m_index += lengthConsumed;
-    *value = parsedValue;
-    return true;
-  }
-
-  return false;
+  size_t lengthConsumed = TextScanning::ParseFloat(m_data.data() + m_index, m_data.size() - m_index, value);
+  m_index += lengthConsumed;
+  return lengthConsumed > 0;
 }
 
 bool Tokenizer::AcceptIndexSeparator() {
@@ -334,14 +275,11 @@ bool Tokenizer::AcceptIndexSeparator() {
 bool Tokenizer::AcceptString(std::string* str) {
   ConsumeWhitespace();
   size_t start = m_index;
-  size_t end = m_index;
-  while (end < m_data.size() && !IsWhitespace(m_data[end]) && m_data[end] != '\n') {
-    end++;
-  }
+  size_t end = TextScanning::FindTokenEnd(m_data.data(), m_data.size(), m_index);
 
   size_t length = end - start;
   if (length > 0) {
-    *str = std::string(m_data.data(), start, end - start);
+    *str = std::string(m_data.substr(start, length));
     m_index = end;
     return true;
   }
@@ -360,9 +298,7 @@ bool Tokenizer::AcceptNewLine() {
 }
 
 void Tokenizer::ForceAcceptNewLine() {
-  while (m_index < m_data.size() && m_data[m_index] != '\n') {
-    m_index++;
-  }
+  m_index = TextScanning::FindNewLine(m_data.data(), m_data.size(), m_index);
 }
 
 bool Tokenizer::IsAtEnd() {
@@ -439,13 +375,13 @@ static void EmitNotSupportedMessage(size_t lineNumber, const char* prop) {
 }
 
 bool MtlFileParser::Parse(const std::string& filePath) {
-  std::vector<char> fileContents;
-  if (!LoadFile(filePath.c_str(), &fileContents))
+  MappedFile file;
+  if (!file.Open(filePath))
     return false;
 
   std::filesystem::path containingPath = std::filesystem::path(filePath).parent_path();
 
-  Tokenizer tokenizer(std::move(fileContents));
+  Tokenizer tokenizer(file.GetView());
   size_t currentLineNumber = 0;
   while (!tokenizer.IsAtEnd()) {
     currentLineNumber++;
@@ -493,6 +429,9 @@ bool MtlFileParser::Parse(const std::string& filePath) {
       case MtlDeclarationType::DiffuseMap:
         parseSucceeded &= ParseTexture(tokenizer, containingPath, &m_currentMaterial->diffuseMap);
         break;
+      case MtlDeclarationType::BumpMap:
+        parseSucceeded &= ParseTexture(tokenizer, containingPath, &m_currentMaterial->bumpMap);
+        break;
 
       case MtlDeclarationType::Dissolve: {
         EmitNotSupportedMessage(currentLineNumber, "dissolve");
@@ -562,11 +501,6 @@ bool MtlFileParser::Parse(const std::string& filePath) {
         ObjFileData::Texture fakeTexture;
         parseSucceeded &= ParseTexture(tokenizer, containingPath, &fakeTexture);
       } break;
-      case MtlDeclarationType::BumpMap: {
-        EmitNotSupportedMessage(currentLineNumber, "bump map");
-        ObjFileData::Texture fakeTexture;
-        parseSucceeded &= ParseTexture(tokenizer, containingPath, &fakeTexture);
-      } break;
       case MtlDeclarationType::ReflectionMap: {
         EmitNotSupportedMessage(currentLineNumber, "reflection map");
         ObjFileData::Texture fakeTexture;
@@ -591,6 +525,246 @@ bool MtlFileParser::Parse(const std::string& filePath) {
   return true;
 }
 
+// ------------------------------------------------------------------------------------------------
+// Obj files are parsed in two phases, so that the expensive part (tokenizing the text) can be spread across threads:
+//   1) The file is split into newline-aligned chunks, and each chunk is tokenized independently into an
+//      ObjFileChunk. This only records what was declared; anything that depends on the rest of the file (relative
+//      indices, materials, vertex de-duplication) is left unresolved.
+//   2) The ObjFileParser then merges the chunks one at a time, in file order. Since the merge sees exactly the same
+//      sequence of declarations that a single pass over the file would, the output doesn't depend on how the file
+//      was split up.
+
+// A face's indices, as they appear in a chunk. Positive values are absolute (1-based) indices and 0 means that the
+// index wasn't specified. Relative (negative) indices can't be resolved until we know how many elements came before
+// the chunk, so they're stored relative to the start of the chunk and offset by kChunkRelativeIndexBias.
+struct ChunkIndices {
+  long long posIndex;
+  long long texCoordIndex;
+  long long normalIndex;
+};
+
+static constexpr long long kChunkRelativeIndexBias = 1ll << 62;
+
+class ObjFileChunk {
+ public:
+  enum class StatementType {
+    Face,
+    UseMTL,
+    MTLLib,
+    Smooth,
+  };
+
+  // The declarations that need to be handled in order during the merge.
+  struct Statement {
+    StatementType type;
+    size_t lineNumber;
+
+    // For faces, this is the index of the face's first entry in m_faces. For smoothing groups, it's the group's number
+    // (with "off" as NormalGenerator::kNoSmoothingGroup). Otherwise, it's an index into m_names.
+    size_t dataIndex;
+    // Only for faces.
+    uint32_t numFaceCorners = 0;
+  };
+
+  // Warnings are buffered, since line numbers aren't known until the merge (and so that the output from different
+  // threads doesn't get interleaved).
+  struct Message {
+    size_t lineNumber;
+    const char* prefix;
+    std::string suffix;
+  };
+
+  std::vector<Position> m_positions;
+  std::vector<TexCoord> m_texCoords;
+  std::vector<Normal> m_normals;
+  std::vector<ChunkIndices> m_faces;  // The corners of each face, one face after the other.
+  std::vector<std::string> m_names;
+  std::vector<Statement> m_statements;
+  std::vector<Message> m_messages;
+
+  // Line numbers within the chunk are 1-based; these need to be offset by the number of lines in preceding chunks.
+  size_t m_numLines = 0;
+  bool m_parseSucceeded = true;
+
+  void Parse(std::string_view data);
+};
+
+static long long ToChunkRelativeIndex(long long index, size_t chunkElementCount) {
+  // The element might be in a previous chunk, so we can't tell whether this is valid until the merge.
+  if (index < 0)
+    return (long long)chunkElementCount + index + 1 + kChunkRelativeIndexBias;
+
+  return index;
+}
+
+void ObjFileChunk::Parse(std::string_view data) {
+  Tokenizer tokenizer(data);
+  size_t& currentLineNumber = m_numLines;
+  while (!tokenizer.IsAtEnd()) {
+    currentLineNumber++;
+    if (tokenizer.AcceptNewLine())
+      continue;
+
+    ObjDeclarationType type;
+    bool parseSucceeded = tokenizer.AcceptObjDeclaration(&type);
+    if (!parseSucceeded) {
+      std::string unrecognizedDeclaration;
+      (void)tokenizer.AcceptString(&unrecognizedDeclaration);
+      m_messages.push_back({currentLineNumber, "Line ", ". Unrecognized declaration " + unrecognizedDeclaration});
+      tokenizer.ForceAcceptNewLine();
+      continue;
+    }
+
+    switch (type) {
+      case ObjDeclarationType::Position: {
+        Position pos = {};
+        parseSucceeded &= tokenizer.AcceptFloat(&pos.x);
+        parseSucceeded &= tokenizer.AcceptFloat(&pos.y);
+        parseSucceeded &= tokenizer.AcceptFloat(&pos.z);
+        // Always append a position even if parsing failed, so that future indices do not get off.
+        m_positions.push_back(pos);
+      } break;
+
+      case ObjDeclarationType::TextureCoord: {
+        TexCoord coord = {};
+        parseSucceeded &= tokenizer.AcceptFloat(&coord.u);
+        if (!tokenizer.AcceptFloat(&coord.v))  // Second value is optional.
+          coord.v = 0.;
+
+        float dummy;
+        (void)tokenizer.AcceptFloat(&dummy);  // Third value is allowed, but unused.
+
+        // Always append a texcoord even if parsing failed, so that future indices do not get off.
+        m_texCoords.push_back(coord);
+      } break;
+
+      case ObjDeclarationType::Normal: {
+        Normal normal = {};
+        parseSucceeded &= tokenizer.AcceptFloat(&normal.x);
+        parseSucceeded &= tokenizer.AcceptFloat(&normal.y);
+        parseSucceeded &= tokenizer.AcceptFloat(&normal.z);
+        // Always append a normal even if parsing failed, so that future indices do not get off.
+        m_normals.push_back(normal);
+      } break;
+
+      case ObjDeclarationType::Face: {
+        // The corners go straight into m_faces, and are taken back out again if the face turns out to be invalid.
+        const size_t faceStart = m_faces.size();
+        size_t numIndices = 0;
+        for (;; ++numIndices) {
+          long long posIndex = 0;
+          long long texCoordIndex = 0;
+          long long normalIndex = 0;
+
+          if (!tokenizer.AcceptInteger(&posIndex))
+            break;
+
+          if (tokenizer.AcceptIndexSeparator()) {
+            (void)tokenizer.AcceptInteger(&texCoordIndex);  // Can be unspecified.
+            if (tokenizer.AcceptIndexSeparator()) {
+              parseSucceeded &= tokenizer.AcceptInteger(&normalIndex);
+            }
+          }
+
+          m_faces.push_back({ToChunkRelativeIndex(posIndex, m_positions.size()),
+                             ToChunkRelativeIndex(texCoordIndex, m_texCoords.size()),
+                             ToChunkRelativeIndex(normalIndex, m_normals.size())});
+        }
+
+        parseSucceeded &= (numIndices >= 3 && numIndices <= std::numeric_limits<uint32_t>::max());
+        if (parseSucceeded) {
+          m_statements.push_back(
+              {StatementType::Face, currentLineNumber, faceStart, static_cast<uint32_t>(numIndices)});
+        } else {
+          m_faces.resize(faceStart);
+        }
+      } break;
+
+      case ObjDeclarationType::Group: {
+        // We don't actually care about the names of the groups, as they have no bearing on anything.
+        std::string currentName;
+        while (tokenizer.AcceptString(&currentName))
+          ;
+      } break;
+
+      case ObjDeclarationType::Smooth: {
+        // Only matters for the faces that we generate normals for.
+        long long group = 0;
+        std::string value;
+        if (tokenizer.AcceptInteger(&group) && group >= 0 && group < NormalGenerator::kDefaultSmoothingGroup) {
+          m_statements.push_back({StatementType::Smooth, currentLineNumber, static_cast<size_t>(group)});
+        } else if (tokenizer.AcceptString(&value) && value == "off") {
+          m_statements.push_back({StatementType::Smooth, currentLineNumber, NormalGenerator::kNoSmoothingGroup});
+        } else {
+          m_messages.push_back({currentLineNumber, "Line ", ". Warning: unrecognized smoothing group " + value});
+          tokenizer.ForceAcceptNewLine();
+          continue;
+        }
+      } break;
+
+      case ObjDeclarationType::MTLLib: {
+        std::string mtlLibFilename;
+        parseSucceeded = tokenizer.AcceptString(&mtlLibFilename);
+        if (parseSucceeded) {
+          m_statements.push_back({StatementType::MTLLib, currentLineNumber, m_names.size()});
+          m_names.push_back(std::move(mtlLibFilename));
+        }
+      } break;
+
+      case ObjDeclarationType::UseMTL: {
+        std::string materialName;
+        parseSucceeded &= tokenizer.AcceptString(&materialName);
+        if (parseSucceeded) {
+          m_statements.push_back({StatementType::UseMTL, currentLineNumber, m_names.size()});
+          m_names.push_back(std::move(materialName));
+        }
+      } break;
+
+      case ObjDeclarationType::Object: {
+        // Similar to a group declaration, we don't care about objects or their names; we just care about their
+        // vertices.
+        std::string objectName;
+        (void)tokenizer.AcceptString(&objectName);
+      } break;
+
+      default:
+        parseSucceeded = false;
+        break;
+    }
+
+    if (parseSucceeded) {
+      if (!tokenizer.AcceptNewLine()) {
+        tokenizer.ForceAcceptNewLine();
+        m_messages.push_back({currentLineNumber, "WARNING: Additional unparsed information on line ", ""});
+      }
+    } else {
+      // Anything after this point would be discarded anyways, so don't bother parsing it.
+      m_parseSucceeded = false;
+      return;
+    }
+  }
+}
+
+// Splits the data into roughly equally sized chunks, such that each one ends just after a newline.
+static std::vector<std::string_view> SplitIntoChunks(std::string_view data, size_t targetChunkSize) {
+  std::vector<std::string_view> chunks;
+  size_t chunkStart = 0;
+  while (chunkStart < data.size()) {
+    size_t chunkEnd = chunkStart + targetChunkSize;
+    if (chunkEnd >= data.size()) {
+      chunkEnd = data.size();
+    } else {
+      size_t newLine = data.find('\n', chunkEnd);
+      chunkEnd = (newLine == std::string_view::npos) ? data.size() : newLine + 1;
+    }
+
+    chunks.push_back(data.substr(chunkStart, chunkEnd - chunkStart));
+    chunkStart = chunkEnd;
+  }
+
+  return chunks;
+}
+
 // ------------------------------------------------------------------------------------------------
 class ObjFileParser {
   // Overall result.
@@ -598,33 +772,64 @@ class ObjFileParser {
   std::vector<uint32_t> m_indices;
   std::vector<ObjFileData::MeshPart> m_meshParts;
   std::vector<ObjFileData::Material> m_materials;
+  std::vector<std::filesystem::path> m_materialLibraries;
 
   // Only used for parsing.
+  std::string m_filePath;
   ObjFileData::MeshPart* m_currentMeshPart = nullptr;
+  // Filled in as the mtl files are loaded. Where materials share a name, the first one wins.
+  std::unordered_map<std::string, int> m_materialIndicesByName;
   std::vector<Position> m_positions;
   std::vector<TexCoord> m_texCoords;
   std::vector<Normal> m_normals;
-  std::unordered_map<Indices, uint32_t, Indices::Hash> m_mapIndicesToVertexIndex;
-
-  ObjFileData::AxisAlignedBounds m_bounds;
+  VertexDedupTable<uint32_t> m_vertexDedupTable;
+  // Only used once a count no longer fits into 32 bits (which would take an obj file of well over 100GB).
+  VertexDedupTable<unsigned long long> m_wideVertexDedupTable;
+  bool m_useWideVertexDedupTable = false;
+  size_t m_numLinesMerged = 0;
+  bool m_mergeMeshParts = true;
+
+  // The current smoothing group, and the faces that came without normals. Those only get flat normals while parsing;
+  // the smooth ones are generated afterwards (see NormalGenerator).
+  uint32_t m_smoothingGroup = NormalGenerator::kDefaultSmoothingGroup;
+  std::vector<NormalGenerator::Triangle> m_trianglesWithoutNormals;
+
+  // Scratch space for splitting faces with more than 3 corners into triangles, kept around between faces.
+  std::vector<Indices> m_faceCorners;
+  std::vector<float> m_facePositions;
+  std::vector<uint32_t> m_faceTriangles;
+  PolygonTriangulation::Workspace m_triangulationWorkspace;
+
+  ObjFileData::AxisAlignedBounds m_bounds = {};
   bool m_areBoundsInitialized = false;
 
   bool LoadMtlLib(const std::string& objFilename, const std::string& mtlLibFilename);
   int FindMaterialIndex(const std::string& materialName);
 
   void StartNewMeshPart(int materialIndex = -1);
+  void AddTriangle(Indices triangle[3]);
   void AddVerticesFromFace(Indices face[3]);
   void AddVerticesFromFace_GenerateNormals(Indices face[3]);
-  void CalculateAxisAlignedBounds();
+  void ExtendAxisAlignedBounds(size_t firstNewPosition);
+
+  bool ResolveFace(const ChunkIndices* chunkFace, uint32_t numCorners, const size_t chunkBases[3], Indices* face) const;
+  bool MergeStatement(const ObjFileChunk& chunk, const ObjFileChunk::Statement& statement, const size_t chunkBases[3]);
+  bool MergeChunk(ObjFileChunk&& chunk);
+  bool ReportProgress(const ObjFileData::ParseOptions& options) const;
 
  public:
-  bool Init(const std::string& filePath);
+  bool Init(const std::string& filePath, const ObjFileData::ParseOptions& options);
 
   std::vector<ObjFileData::Vertex>& GetVertices() { return m_vertices; }
   std::vector<uint32_t>& GetIndices() { return m_indices; }
   std::vector<ObjFileData::MeshPart>& GetMeshParts() { return m_meshParts; }
   std::vector<ObjFileData::Material>& GetMaterials() { return m_materials; }
+  std::vector<std::filesystem::path>& GetMaterialLibraries() { return m_materialLibraries; }
   ObjFileData::AxisAlignedBounds& GetBounds() { return m_bounds; }
+  const std::vector<NormalGenerator::Triangle>& GetTrianglesWithoutNormals() const {
+    return m_trianglesWithoutNormals;
+  }
+  size_t GetNumPositions() const { return m_positions.size(); }
 };
 
 bool ObjFileParser::LoadMtlLib(const std::string& objFilename, const std::string& mtlLibFilename) {
@@ -635,8 +840,11 @@ bool ObjFileParser::LoadMtlLib(const std::string& objFilename, const std::string
     MtlFileParser parser;
     if (parser.Parse(mtlFilePath.string())) {
       std::vector<ObjFileData::Material>& parsedMaterials = parser.GetMaterials();
+      for (size_t i = 0; i < parsedMaterials.size(); ++i)
+        m_materialIndicesByName.emplace(parsedMaterials[i].name, static_cast<int>(m_materials.size() + i));
       std::move(parsedMaterials.begin(), parsedMaterials.end(), std::back_inserter(m_materials));
       parsedMaterials.clear();
+      m_materialLibraries.push_back(mtlFilePath);
       return true;
     }
   }
@@ -645,13 +853,8 @@ bool ObjFileParser::LoadMtlLib(const std::string& objFilename, const std::string
 }
 
 int ObjFileParser::FindMaterialIndex(const std::string& materialName) {
-  // For now, just do a linear search. If this is a bottleneck, use an unordered map.
-  for (size_t i = 0; i < m_materials.size(); ++i) {
-    if (m_materials[i].name == materialName)
-      return (int)i;
-  }
-
-  return -1;
+  auto it = m_materialIndicesByName.find(materialName);
+  return (it != m_materialIndicesByName.end()) ? it->second : -1;
 }
 
 void ObjFileParser::StartNewMeshPart(int materialIndex) {
@@ -662,6 +865,14 @@ void ObjFileParser::StartNewMeshPart(int materialIndex) {
   m_currentMeshPart->numIndices = 0;
 }
 
+void ObjFileParser::AddTriangle(Indices triangle[3]) {
+  if (triangle[0].normalIndex == 0 || triangle[1].normalIndex == 0 || triangle[2].normalIndex == 0) {
+    AddVerticesFromFace_GenerateNormals(triangle);
+  } else {
+    AddVerticesFromFace(triangle);
+  }
+}
+
 void ObjFileParser::AddVerticesFromFace(Indices face[3]) {
   if (!m_currentMeshPart) {
     std::cerr << "Warning: file contains vertices that do not have a material assigned to them." << std::endl;
@@ -674,8 +885,14 @@ void ObjFileParser::AddVerticesFromFace(Indices face[3]) {
     assert(indices.texCoordIndex > 0);
     assert(indices.normalIndex > 0);
 
-    auto iter = m_mapIndicesToVertexIndex.find(indices);
-    if (iter == m_mapIndicesToVertexIndex.end()) {
+    const uint32_t newVertexIndex = (uint32_t)m_vertices.size();
+    const uint32_t vertexIndex =
+        m_useWideVertexDedupTable
+            ? m_wideVertexDedupTable.FindOrInsert(indices.posIndex, indices.texCoordIndex, indices.normalIndex,
+                                                  newVertexIndex)
+            : m_vertexDedupTable.FindOrInsert(indices.posIndex, indices.texCoordIndex, indices.normalIndex,
+                                              newVertexIndex);
+    if (vertexIndex == newVertexIndex) {
       const Position& pos = m_positions[indices.posIndex - 1];
       const TexCoord& texCoord = m_texCoords[indices.texCoordIndex - 1];
       const Normal& normal = m_normals[indices.normalIndex - 1];
@@ -690,13 +907,9 @@ void ObjFileParser::AddVerticesFromFace(Indices face[3]) {
       vertex.normal[1] = normal.y;
       vertex.normal[2] = normal.z;
       m_vertices.emplace_back(vertex);
-
-      size_t vertexIndex = m_vertices.size() - 1;
-      m_mapIndicesToVertexIndex[indices] = vertexIndex;
-      m_indices.push_back((uint32_t)vertexIndex);
-    } else {
-      m_indices.push_back(iter->second);
     }
+
+    m_indices.push_back(vertexIndex);
   }
 
   m_currentMeshPart->numIndices += 3;
@@ -725,6 +938,11 @@ void ObjFileParser::AddVerticesFromFace_GenerateNormals(Indices face[3]) {
                               crossProduct[2] * crossProduct[2]);
 
   float normal[3] = {crossProduct[0] / magnitude, crossProduct[1] / magnitude, crossProduct[2] / magnitude};
+  m_trianglesWithoutNormals.push_back(
+      {static_cast<uint32_t>(m_indices.size()),
+       {static_cast<uint32_t>(face[0].posIndex - 1), static_cast<uint32_t>(face[1].posIndex - 1),
+        static_cast<uint32_t>(face[2].posIndex - 1)},
+       m_smoothingGroup});
   for (size_t i = 0; i < 3; ++i) {
     const Indices& indices = face[i];
     assert(indices.posIndex > 0);
@@ -751,185 +969,240 @@ void ObjFileParser::AddVerticesFromFace_GenerateNormals(Indices face[3]) {
   m_currentMeshPart->numIndices += 3;
 }
 
-static bool ResolveRelativeIndex(long long index, size_t referenceSize, unsigned long long* resolvedIndex) {
-  if (index < 0) {
-    if (referenceSize < -index) {
+static bool ResolveIndex(long long index, size_t chunkBase, size_t referenceSize, unsigned long long* resolvedIndex) {
+  if (index >= kChunkRelativeIndexBias / 2) {
+    long long indexInFile = (long long)chunkBase + (index - kChunkRelativeIndexBias);
+    if (indexInFile <= 0) {
       return false;
     }
-    *resolvedIndex = (long long)referenceSize + index + 1;
+    *resolvedIndex = (unsigned long long)indexInFile;
   } else {
     *resolvedIndex = (unsigned long long)index;
   }
 
-  return true;
+  // Only elements that have already been declared can be referenced.
+  return *resolvedIndex <= referenceSize;
 }
 
-bool ObjFileParser::Init(const std::string& filePath) {
-  std::vector<char> fileContents;
-  if (!LoadFile(filePath.c_str(), &fileContents))
-    return false;
+bool ObjFileParser::ResolveFace(const ChunkIndices* chunkFace,
+                                uint32_t numCorners,
+                                const size_t chunkBases[3],
+                                Indices* face) const {
+  bool succeeded = true;
+  for (size_t i = 0; i < numCorners; ++i) {
+    succeeded &= ResolveIndex(chunkFace[i].posIndex, chunkBases[0], m_positions.size(), &face[i].posIndex);
+    succeeded &= (face[i].posIndex > 0);
+    succeeded &= ResolveIndex(chunkFace[i].texCoordIndex, chunkBases[1], m_texCoords.size(), &face[i].texCoordIndex);
+    succeeded &= ResolveIndex(chunkFace[i].normalIndex, chunkBases[2], m_normals.size(), &face[i].normalIndex);
+  }
 
-  Tokenizer tokenizer(std::move(fileContents));
-  size_t currentLineNumber = 0;
-  while (!tokenizer.IsAtEnd()) {
-    currentLineNumber++;
-    if (tokenizer.AcceptNewLine())
-      continue;
+  return succeeded;
+}
 
-    ObjDeclarationType type;
-    bool parseSucceeded = tokenizer.AcceptObjDeclaration(&type);
-    if (!parseSucceeded) {
-      std::string unrecognizedDeclaration;
-      (void)tokenizer.AcceptString(&unrecognizedDeclaration);
-      std::cerr << "Line " << currentLineNumber << ". Unrecognized declaration " << unrecognizedDeclaration
-                << std::endl;
-      tokenizer.ForceAcceptNewLine();
-      continue;
-    }
+bool ObjFileParser::MergeStatement(const ObjFileChunk& chunk,
+                                   const ObjFileChunk::Statement& statement,
+                                   const size_t chunkBases[3]) {
+  const size_t currentLineNumber = m_numLinesMerged + statement.lineNumber;
+  switch (statement.type) {
+    case ObjFileChunk::StatementType::Face: {
+      const uint32_t numCorners = statement.numFaceCorners;
+      m_faceCorners.resize(numCorners);
+      if (!ResolveFace(&chunk.m_faces[statement.dataIndex], numCorners, chunkBases, m_faceCorners.data()))
+        return false;
+
+      if (numCorners == 3) {
+        AddTriangle(m_faceCorners.data());
+        break;
+      }
 
-    switch (type) {
-      case ObjDeclarationType::Position: {
-        Position pos = {};
-        parseSucceeded &= tokenizer.AcceptFloat(&pos.x);
-        parseSucceeded &= tokenizer.AcceptFloat(&pos.y);
-        parseSucceeded &= tokenizer.AcceptFloat(&pos.z);
-        // Always append a position even if parsing failed, so that future indices do not get off.
-        m_positions.push_back(pos);
-      } break;
+      m_facePositions.resize(3 * numCorners);
+      for (uint32_t i = 0; i < numCorners; ++i) {
+        const Position& pos = m_positions[m_faceCorners[i].posIndex - 1];
+        m_facePositions[3 * i] = pos.x;
+        m_facePositions[3 * i + 1] = pos.y;
+        m_facePositions[3 * i + 2] = pos.z;
+      }
+      m_faceTriangles.resize(3 * (numCorners - 2));
+      PolygonTriangulation::Triangulate(m_facePositions.data(), numCorners, &m_triangulationWorkspace,
+                                        m_faceTriangles.data());
+
+      for (size_t t = 0; t < m_faceTriangles.size(); t += 3) {
+        Indices triangle[3] = {m_faceCorners[m_faceTriangles[t]], m_faceCorners[m_faceTriangles[t + 1]],
+                               m_faceCorners[m_faceTriangles[t + 2]]};
+        AddTriangle(triangle);
+      }
+    } break;
 
-      case ObjDeclarationType::TextureCoord: {
-        TexCoord coord = {};
-        parseSucceeded &= tokenizer.AcceptFloat(&coord.u);
-        if (!tokenizer.AcceptFloat(&coord.v))  // Second value is optional.
-          coord.v = 0.;
+    case ObjFileChunk::StatementType::MTLLib:
+      return LoadMtlLib(m_filePath, chunk.m_names[statement.dataIndex]);
 
-        float dummy;
-        (void)tokenizer.AcceptFloat(&dummy);  // Third value is allowed, but unused.
+    case ObjFileChunk::StatementType::Smooth:
+      m_smoothingGroup = static_cast<uint32_t>(statement.dataIndex);
+      break;
 
-        // Always append a texcoord even if parsing failed, so that future indices do not get off.
-        m_texCoords.push_back(coord);
-      } break;
+    case ObjFileChunk::StatementType::UseMTL: {
+      const std::string& materialName = chunk.m_names[statement.dataIndex];
+      int materialIndex = FindMaterialIndex(materialName);
+      if (materialIndex < 0) {
+        std::cerr << "Line " << currentLineNumber << ". Warning: could not find material name " << materialName << "."
+                  << std::endl;
+      }
 
-      case ObjDeclarationType::Normal: {
-        Normal normal = {};
-        parseSucceeded &= tokenizer.AcceptFloat(&normal.x);
-        parseSucceeded &= tokenizer.AcceptFloat(&normal.y);
-        parseSucceeded &= tokenizer.AcceptFloat(&normal.z);
-        // Always append a normal even if parsing failed, so that future indices do not get off.
-        m_normals.push_back(normal);
-      } break;
+      // Exporters often repeat the current material (e.g. at the start of every group), which carries on with the
+      // same mesh part. A part that hasn't got any faces yet can just switch materials.
+      if (m_mergeMeshParts && m_currentMeshPart) {
+        if (m_currentMeshPart->materialIndex == static_cast<uint32_t>(materialIndex))
+          break;
+        if (m_currentMeshPart->numIndices == 0) {
+          m_currentMeshPart->materialIndex = materialIndex;
+          break;
+        }
+      }
+      StartNewMeshPart(materialIndex);
+    } break;
 
-      case ObjDeclarationType::Face: {
-        Indices indices[3];
-        for (size_t i = 0;; ++i) {
-          long long posIndex = 0;
-          long long texCoordIndex = 0;
-          long long normalIndex = 0;
+    default:
+      assert(false);
+      return false;
+  }
 
-          if (!tokenizer.AcceptInteger(&posIndex))
-            break;
+  return true;
+}
 
-          if (tokenizer.AcceptIndexSeparator()) {
-            (void)tokenizer.AcceptInteger(&texCoordIndex);  // Can be unspecified.
-            if (tokenizer.AcceptIndexSeparator()) {
-              parseSucceeded &= tokenizer.AcceptInteger(&normalIndex);
-            }
-          }
+bool ObjFileParser::MergeChunk(ObjFileChunk&& chunk) {
+  // Relative indices in this chunk are relative to the number of elements declared before it.
+  const size_t chunkBases[3] = {m_positions.size(), m_texCoords.size(), m_normals.size()};
+  m_positions.insert(m_positions.end(), chunk.m_positions.begin(), chunk.m_positions.end());
+  m_texCoords.insert(m_texCoords.end(), chunk.m_texCoords.begin(), chunk.m_texCoords.end());
+  m_normals.insert(m_normals.end(), chunk.m_normals.begin(), chunk.m_normals.end());
+  ExtendAxisAlignedBounds(chunkBases[0]);
+
+  const size_t maxCount = std::max({m_positions.size(), m_texCoords.size(), m_normals.size()});
+  if (!m_useWideVertexDedupTable && maxCount > VertexDedupTable<uint32_t>::kMaxIndex) {
+    m_vertexDedupTable.MoveTo(&m_wideVertexDedupTable);
+    m_useWideVertexDedupTable = true;
+  }
 
-          if (i < 3) {
-            Indices& curr = indices[i];
-            parseSucceeded &= ResolveRelativeIndex(posIndex, m_positions.size(), &curr.posIndex);
-            parseSucceeded &= ResolveRelativeIndex(texCoordIndex, m_texCoords.size(), &curr.texCoordIndex);
-            parseSucceeded &= ResolveRelativeIndex(normalIndex, m_normals.size(), &curr.normalIndex);
-          } else {
-            std::cerr << "Line " << currentLineNumber
-                      << ": Warning: this parser doesn't support faces with 4+ vertices." << std::endl;
-          }
-        }
+  // Most meshes either share vertices between faces (roughly one unique vertex per position), or have about as many
+  // unique vertices as faces. Sizing up front avoids most of the rehashing as the table grows.
+  const size_t numFaces = m_indices.size() / 3 + chunk.m_faces.size() / 3;  // Roughly, for faces with 4+ corners.
+  const size_t expectedNumVertices = std::max(m_positions.size(), numFaces / 2);
+  if (m_useWideVertexDedupTable) {
+    m_wideVertexDedupTable.Reserve(expectedNumVertices);
+  } else {
+    m_vertexDedupTable.Reserve(expectedNumVertices);
+  }
 
-        if (indices[0].normalIndex == 0 || indices[1].normalIndex == 0 || indices[2].normalIndex == 0) {
-          AddVerticesFromFace_GenerateNormals(indices);
-        } else {
-          AddVerticesFromFace(indices);
-        }
-      } break;
+  // Interleave the buffered messages with the statements, so that the output reads in line order.
+  size_t messageIndex = 0;
+  auto emitMessagesUpToLine = [&](size_t lineNumber) {
+    for (; messageIndex < chunk.m_messages.size() && chunk.m_messages[messageIndex].lineNumber <= lineNumber;
+         ++messageIndex) {
+      const ObjFileChunk::Message& message = chunk.m_messages[messageIndex];
+      std::cerr << message.prefix << (m_numLinesMerged + message.lineNumber) << message.suffix << std::endl;
+    }
+  };
 
-      case ObjDeclarationType::Group: {
-        // We don't actually care about the names of the groups, as they have no bearing on anything.
-        std::string currentName;
-        while (tokenizer.AcceptString(&currentName))
-          ;
-      } break;
+  for (const ObjFileChunk::Statement& statement : chunk.m_statements) {
+    emitMessagesUpToLine(statement.lineNumber);
+    if (!MergeStatement(chunk, statement, chunkBases)) {
+      std::cerr << "Parsing failed on line " << (m_numLinesMerged + statement.lineNumber) << std::endl;
+      return false;
+    }
+  }
+  emitMessagesUpToLine(chunk.m_numLines);
 
-      case ObjDeclarationType::Smooth: {
-        // No intention to implement non-smooth shading, so we ignore this.
-        std::string dummy;
-        (void)tokenizer.AcceptString(&dummy);
-      } break;
+  if (!chunk.m_parseSucceeded) {
+    std::cerr << "Parsing failed on line " << (m_numLinesMerged + chunk.m_numLines) << std::endl;
+    return false;
+  }
 
-      case ObjDeclarationType::MTLLib: {
-        std::string mtlLibFilename;
-        parseSucceeded = tokenizer.AcceptString(&mtlLibFilename);
-        if (parseSucceeded) {
-          parseSucceeded = LoadMtlLib(filePath, mtlLibFilename);
-        }
-      } break;
+  m_numLinesMerged += chunk.m_numLines;
+  return true;
+}
 
-      case ObjDeclarationType::UseMTL: {
-        std::string materialName;
-        parseSucceeded &= tokenizer.AcceptString(&materialName);
-        if (parseSucceeded) {
-          int materialIndex = FindMaterialIndex(materialName);
-          if (materialIndex < 0) {
-            std::cerr << "Line " << currentLineNumber << ". Warning: could not find material name " << materialName
-                      << "." << std::endl;
-          }
+bool ObjFileParser::Init(const std::string& filePath, const ObjFileData::ParseOptions& options) {
+  MappedFile file;
+  if (!file.Open(filePath))
+    return false;
 
-          StartNewMeshPart(materialIndex);
-        }
-      } break;
+  m_filePath = filePath;
+  m_mergeMeshParts = options.mergeMeshParts;
 
-      case ObjDeclarationType::Object: {
-        // Similar to a group declaration, we don't care about objects or their names; we just care about their
-        // vertices.
-        std::string objectName;
-        (void)tokenizer.AcceptString(&objectName);
-      } break;
+  // Chunks are kept fairly small, so that the merge can start as soon as possible and so that only a bounded amount
+  // of tokenized-but-unmerged data is alive at once.
+  const size_t kTargetChunkSize = 4 * 1024 * 1024;
+  std::vector<std::string_view> chunkData = SplitIntoChunks(file.GetView(), kTargetChunkSize);
 
-      default:
-        parseSucceeded = false;
-        break;
+  if (!options.parseInParallel || chunkData.size() <= 1) {
+    for (std::string_view data : chunkData) {
+      ObjFileChunk chunk;
+      chunk.Parse(data);
+      if (!MergeChunk(std::move(chunk)) || !ReportProgress(options))
+        return false;
+    }
+  } else {
+    ThreadPool& threadPool = ThreadPool::GetShared();
+    const size_t maxChunksInFlight = 2 * threadPool.GetNumThreads();
+
+    std::vector<std::future<ObjFileChunk>> chunks(chunkData.size());
+    auto submitChunk = [&](size_t chunkIndex) {
+      std::string_view data = chunkData[chunkIndex];
+      chunks[chunkIndex] = threadPool.Submit([data]() {
+        ObjFileChunk chunk;
+        chunk.Parse(data);
+        return chunk;
+      });
+    };
+
+    size_t numChunksSubmitted = std::min(maxChunksInFlight, chunks.size());
+    for (size_t i = 0; i < numChunksSubmitted; ++i) {
+      submitChunk(i);
     }
 
-    if (parseSucceeded) {
-      if (!tokenizer.AcceptNewLine()) {
-        tokenizer.ForceAcceptNewLine();
-        std::cerr << "WARNING: Additional unparsed information on line " << currentLineNumber << std::endl;
+    for (size_t i = 0; i < chunks.size(); ++i) {
+      ObjFileChunk chunk = chunks[i].get();
+      if (numChunksSubmitted < chunks.size()) {
+        submitChunk(numChunksSubmitted++);
+      }
+
+      if (!MergeChunk(std::move(chunk)) || !ReportProgress(options)) {
+        // Make sure nothing is still referencing the file before it gets unmapped.
+        for (size_t j = i + 1; j < numChunksSubmitted; ++j) {
+          chunks[j].wait();
+        }
+        return false;
       }
-    } else {
-      std::cerr << "Parsing failed on line " << currentLineNumber << std::endl;
-      return false;
     }
   }
 
-  CalculateAxisAlignedBounds();
-
   return true;
 }
 
-void ObjFileParser::CalculateAxisAlignedBounds() {
-  if (m_positions.empty())
-    return;
+bool ObjFileParser::ReportProgress(const ObjFileData::ParseOptions& options) const {
+  if (!options.onProgress)
+    return true;
 
-  m_bounds.max[0] = m_positions[0].x;
-  m_bounds.max[1] = m_positions[0].y;
-  m_bounds.max[2] = m_positions[0].z;
+  // The levels of detail and the tangents are only built once everything has been parsed.
+  const std::vector<ObjFileData::MeshLod> lods;
+  const std::vector<ObjFileData::Tangent> tangents;
+  ObjFileData::PartialData data = {m_vertices, m_indices, m_meshParts, m_materials, m_bounds, lods, tangents};
+  return options.onProgress(data);
+}
 
-  m_bounds.min[0] = m_positions[0].x;
-  m_bounds.min[1] = m_positions[0].y;
-  m_bounds.min[2] = m_positions[0].z;
+void ObjFileParser::ExtendAxisAlignedBounds(size_t firstNewPosition) {
+  if (firstNewPosition >= m_positions.size())
+    return;
 
-  for (size_t i = 1; i < m_positions.size(); ++i) {
+  if (!m_areBoundsInitialized) {
+    const Position& pos = m_positions[firstNewPosition];
+    m_bounds.max[0] = m_bounds.min[0] = pos.x;
+    m_bounds.max[1] = m_bounds.min[1] = pos.y;
+    m_bounds.max[2] = m_bounds.min[2] = pos.z;
+    m_areBoundsInitialized = true;
+  }
+
+  for (size_t i = firstNewPosition; i < m_positions.size(); ++i) {
     const Position& pos = m_positions[i];
     m_bounds.max[0] = std::max(m_bounds.max[0], pos.x);
     m_bounds.max[1] = std::max(m_bounds.max[1], pos.y);
@@ -942,46 +1215,124 @@ void ObjFileParser::CalculateAxisAlignedBounds() {
 }
 
 bool ObjFileData::ParseObjFile(const std::string& fileName) {
+  return ParseObjFile(fileName, ParseOptions());
+}
+
+bool ObjFileData::ParseObjFile(const std::string& fileName, const ParseOptions& options) {
   ObjFileParser parser;
-  if (!parser.Init(fileName))
+  if (!parser.Init(fileName, options))
     return false;
 
   m_vertices = std::move(parser.GetVertices());
   m_indices = std::move(parser.GetIndices());
   m_meshParts = std::move(parser.GetMeshParts());
   m_materials = std::move(parser.GetMaterials());
+  m_materialLibraries = std::move(parser.GetMaterialLibraries());
   m_bounds = std::move(parser.GetBounds());
-  return true;
-}
+  m_tangents.clear();
+
+  // This comes first, since merging the vertices renumbers them.
+  const std::vector<NormalGenerator::Triangle>& trianglesWithoutNormals = parser.GetTrianglesWithoutNormals();
+  if (!trianglesWithoutNormals.empty()) {
+    const size_t numVerticesBefore = m_vertices.size();
+    NormalGenerator::GenerateNormals(trianglesWithoutNormals, parser.GetNumPositions(), options.creaseAngleInDegrees,
+                                     &m_vertices, &m_indices);
+    if (options.printStatistics) {
+      std::cout << "Generated normals for " << trianglesWithoutNormals.size() << " triangles of " << fileName << ": "
+                << numVerticesBefore << " -> " << m_vertices.size() << " vertices" << std::endl;
+    }
+  }
+
+  // This comes after the normals, which refer to the triangles by where they are in the indices.
+  const size_t numMeshPartsBefore = m_meshParts.size();
+  if (options.mergeMeshParts)
+    MeshOptimizer::MergeMeshParts(this);
+  if (options.printStatistics && m_meshParts.size() != numMeshPartsBefore) {
+    std::cout << "Merged the mesh parts of " << fileName << " by material: " << numMeshPartsBefore << " -> "
+              << m_meshParts.size() << std::endl;
+  }
+
+  // Only normal maps need tangents, so models without any don't pay another 16 bytes per vertex for them.
+  const bool hasBumpMaps = std::any_of(m_materials.begin(), m_materials.end(),
+                                       [](const Material& material) { return !material.bumpMap.file.empty(); });
+  if (options.generateTangents && hasBumpMaps) {
+    const size_t numSplitVertices = TangentGenerator::Generate(this);
+    if (options.printStatistics) {
+      std::cout << "Generated tangents for " << m_vertices.size() << " vertices of " << fileName << ", splitting "
+                << numSplitVertices << " where mirrored texture coordinates meet" << std::endl;
+    }
+  }
+
+  if (options.optimizeMesh) {
+    MeshOptimizer::VertexCacheStatistics before = {};
+    if (options.printStatistics)
+      before = MeshOptimizer::AnalyzeVertexCache(m_indices.data(), m_indices.size(), m_vertices.size());
+    MeshOptimizer::Optimize(this);
+
+    if (options.printStatistics) {
+      const MeshOptimizer::VertexCacheStatistics after =
+          MeshOptimizer::AnalyzeVertexCache(m_indices.data(), m_indices.size(), m_vertices.size());
+      std::cout << "Optimized " << fileName << " for a " << MeshOptimizer::kCacheSize << "-entry vertex cache: ACMR "
+                << before.acmr << " -> " << after.acmr << ", ATVR " << before.atvr << " -> " << after.atvr
+                << std::endl;
+    }
+  }
 
-// The source of hash_combine was taken from the boost library. Boost's license is as follow:
-/*
-Boost Software License - Version 1.0 - August 17th, 2003
-
-Permission is hereby granted, free of charge, to any person or organization
-obtaining a copy of the software and accompanying documentation covered by
-this license(the "Software") to use, reproduce, display, distribute,
-execute, and transmit the Software, and to prepare derivative works of the
-Software, and to permit third - parties to whom the Software is furnished to
-do so, all subject to the following :
-
-The copyright notices in the Software and this entire statement, including
-the above license grant, this restriction and the following disclaimer,
-must be included in all copies of the Software, in whole or in part, and
-all derivative works of the Software, unless such copies or derivative
-works are solely in the form of machine - executable object code generated by
-a source language processor.
-
-THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
-IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
-FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON - INFRINGEMENT.IN NO EVENT
-SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
-FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
-ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
-DEALINGS IN THE SOFTWARE.
-*/
-template <class T>
-inline void hash_combine(std::size_t& s, const T& v) {
-  std::hash<T> h;
-  s ^= h(v) + 0x9e3779b9 + (s << 6) + (s >> 2);
+  FrustumCulling::ComputeMeshPartBounds(this);
+
+  // The levels of detail are appended to the indices, so the parts' own triangles have to be counted separately.
+  size_t numTriangles = 0;
+  for (const MeshPart& meshPart : m_meshParts)
+    numTriangles += meshPart.numIndices / 3;
+
+  if (options.buildLods)
+    MeshSimplifier::BuildLods(this);
+
+  if (options.buildLods && options.printStatistics) {
+    // For each level, the triangles left over all of the parts (counting the parts that have run out of levels at
+    // their coarsest), against the largest error of any part at that level.
+    size_t numLevels = 0;
+    for (const MeshPart& meshPart : m_meshParts)
+      numLevels = std::max<size_t>(numLevels, meshPart.numLods);
+
+    float modelSize = 0.f;
+    for (size_t i = 0; i < 3; ++i)
+      modelSize += (m_bounds.max[i] - m_bounds.min[i]) * (m_bounds.max[i] - m_bounds.min[i]);
+    modelSize = sqrtf(modelSize);
+
+    if (numLevels > 0)
+      std::cout << "Built " << m_lods.size() << " levels of detail for " << fileName << ":" << std::endl;
+    for (size_t level = 1; level <= numLevels; ++level) {
+      size_t numLevelTriangles = 0;
+      float maxError = 0.f;
+      for (const MeshPart& meshPart : m_meshParts) {
+        if (meshPart.numLods == 0) {
+          numLevelTriangles += meshPart.numIndices / 3;
+          continue;
+        }
+        const MeshLod& lod = m_lods[meshPart.lodStart + std::min<size_t>(level, meshPart.numLods) - 1];
+        numLevelTriangles += lod.numIndices / 3;
+        maxError = std::max(maxError, lod.error);
+      }
+      std::cout << "  LOD " << level << ": " << numLevelTriangles << " triangles ("
+                << 100.f * numLevelTriangles / std::max<size_t>(numTriangles, 1) << "% of " << numTriangles
+                << "), error up to " << maxError << " (" << 100.f * maxError / std::max(modelSize, 1e-20f)
+                << "% of the model's size)" << std::endl;
+    }
+  }
+
+  if (options.buildMeshlets)
+    MeshletBuilder::Build(this);
+
+  if (options.buildMeshlets && options.printStatistics) {
+    size_t numMeshletVertices = 0;
+    for (const Meshlet& meshlet : m_meshlets)
+      numMeshletVertices += meshlet.numVertices;
+    if (!m_meshlets.empty()) {
+      std::cout << "Built " << m_meshlets.size() << " meshlets for " << fileName << ": "
+                << static_cast<float>(numMeshletVertices) / m_meshlets.size() << " vertices and "
+                << static_cast<float>(numTriangles) / m_meshlets.size() << " triangles each on average" << std::endl;
+    }
+  }
+  return true;
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <filesystem>
+#include <functional>
 #include <string>
 #include <vector>
 
@@ -83,13 +84,14 @@ class ObjFileData {
     //IlluminationModel illuminationModel;
 
     Texture diffuseMap;
+    // Read as a tangent-space normal map, which is what exporters write as "bump" or "map_Bump" nowadays.
+    Texture bumpMap;
     //Texture ambientMap;
     //Texture specularMap;
     //Texture specularExponentMap;
     //Texture dissolveMap;
     //Texture displacementMap;
     //Texture decalMap;
-    //Texture bumpMap;
     //Texture reflectionMap;
   };
 
@@ -99,22 +101,128 @@ class ObjFileData {
     float normal[3];
   };
 
+  // The direction of increasing u along the surface, orthogonal to the vertex's normal. The bitangent (the direction of
+  // increasing v) is cross(normal, tangent) * handedness, which is -1 where the texture is mirrored. See
+  // TangentGenerator.
+  struct Tangent {
+    float tangent[3];
+    float handedness;
+  };
+
+  struct AxisAlignedBounds {
+    float max[3];
+    float min[3];
+  };
+
   struct MeshPart {
     uint32_t indexStart;
     uint32_t numIndices;
     uint32_t materialIndex;
+
+    // Into m_meshlets. Empty until the meshlets have been built.
+    uint32_t meshletStart;
+    uint32_t numMeshlets;
+
+    // Into m_lods, from the most detailed level down; the part itself is level 0. Empty until they have been built.
+    uint32_t lodStart;
+    uint32_t numLods;
+
+    // Of the part's vertices, for culling it (see FrustumCulling). Zero until the whole file has been parsed.
+    AxisAlignedBounds bounds;
   };
 
-  struct AxisAlignedBounds {
-    float max[3];
-    float min[3];
+  // A simplified version of a mesh part (see MeshSimplifier), drawn with the same vertices but its own indices.
+  struct MeshLod {
+    uint32_t indexStart;
+    uint32_t numIndices;
+
+    // How far the simplified surface may be from the part's own, in the same units as the vertices' positions.
+    float error;
+  };
+
+  // A cluster of a mesh part's triangles, small enough to be culled as a whole (see MeshletBuilder). The meshlets of a
+  // part cover its indices in order, without gaps or overlaps.
+  struct Meshlet {
+    uint32_t indexStart;
+    uint32_t numIndices;
+    uint32_t numVertices;  // Distinct vertices.
+
+    // Bounding sphere.
+    float center[3];
+    float radius;
+
+    // Every triangle faces away from any point p for which dot(normalize(coneApex - p), coneAxis) >= coneCutoff. The
+    // cutoff is above 1 when the triangles face too many different ways for that to ever be true.
+    float coneApex[3];
+    float coneAxis[3];
+    float coneCutoff;
   };
 
   std::vector<Vertex> m_vertices;
+  // One for each vertex, or empty if the tangents weren't generated.
+  std::vector<Tangent> m_tangents;
   std::vector<uint32_t> m_indices;
   std::vector<MeshPart> m_meshParts;
+  std::vector<Meshlet> m_meshlets;
+  std::vector<MeshLod> m_lods;
   std::vector<Material> m_materials;
   AxisAlignedBounds m_bounds;
 
+  // The mtl files that the materials were loaded from.
+  std::vector<std::filesystem::path> m_materialLibraries;
+
+  // Everything that has been parsed so far. Only valid for the duration of the callback that it's passed to.
+  struct PartialData {
+    const std::vector<Vertex>& vertices;
+    const std::vector<uint32_t>& indices;
+    const std::vector<MeshPart>& meshParts;
+    const std::vector<Material>& materials;
+    const AxisAlignedBounds& bounds;
+    // Only built once the whole file has been parsed.
+    const std::vector<MeshLod>& lods;
+    const std::vector<Tangent>& tangents;
+  };
+
+  struct ParseOptions {
+    // Large files are split into chunks that are tokenized on the shared thread pool. The result is identical either
+    // way; this is mostly useful for debugging.
+    bool parseInParallel = true;
+
+    // Repeated usemtl statements for the current material carry on with the same mesh part, and once the whole file
+    // has been parsed, the parts that share a material are merged into one (see MeshOptimizer::MergeMeshParts). Turn
+    // this off to get a part for every usemtl statement, for models whose parts are told apart by their order in the
+    // file.
+    bool mergeMeshParts = true;
+
+    // Faces that don't come with normals get smooth ones once the whole file has been parsed (see NormalGenerator),
+    // except where they meet at more than this angle.
+    float creaseAngleInDegrees = 60.f;
+
+    // Reorders the triangles and vertices for the GPU once the whole file has been parsed (see MeshOptimizer).
+    // Progress reports still see the data in file order.
+    bool optimizeMesh = true;
+
+    // Generates the vertices' tangents once the whole file has been parsed, if any of the materials has a bump map.
+    // Vertices are split where mirrored texture coordinates meet. This happens before the mesh is optimized, so that
+    // the split vertices get reordered along with the rest.
+    bool generateTangents = true;
+
+    // Builds the mesh parts' levels of detail once the whole file has been parsed (and optimized).
+    bool buildLods = true;
+
+    // Splits the mesh parts into meshlets once the whole file has been parsed (and optimized).
+    bool buildMeshlets = true;
+
+    // Prints what each of the steps above did to the model: e.g. how much optimizing helped, and how many triangles
+    // each level of detail has left against how far it is from the full model.
+    bool printStatistics = false;
+
+    // Called on the parsing thread each time another chunk of the file has been parsed. Between calls, the vertices,
+    // indices and materials are only ever appended to, and only the last mesh part can grow. Returning false cancels
+    // the parse.
+    std::function<bool(const PartialData& data)> onProgress;
+  };
+
   bool ParseObjFile(const std::string& fileName);
+  bool ParseObjFile(const std::string& fileName, const ParseOptions& options);
 };
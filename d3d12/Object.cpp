@@ -1,5 +1,7 @@
 #include "d3d12/Object.h"
 
+#include <math.h>
+
 DirectX::XMMATRIX Object::GenerateModelTransform() const {
   const ObjFileData::AxisAlignedBounds bounds = this->model.GetBounds();
   float midpoint[3];
@@ -23,3 +25,61 @@ DirectX::XMFLOAT4X4 Object::GenerateModelTransform4x4() const {
   DirectX::XMStoreFloat4x4(&modelTransform4x4, modelTransform);
   return modelTransform4x4;
 }
+
+DirectX::XMMATRIX Object::GenerateVertexTransform() const {
+  DirectX::XMMATRIX modelTransform = GenerateModelTransform();
+  if (!this->model.m_hasQuantizedVertices)
+    return modelTransform;
+
+  const VertexQuantization::PositionTransform& positionTransform = this->model.m_positionTransform;
+  DirectX::XMMATRIX dequantization =
+      DirectX::XMMatrixScaling(positionTransform.scale[0], positionTransform.scale[1], positionTransform.scale[2]) *
+      DirectX::XMMatrixTranslation(positionTransform.offset[0], positionTransform.offset[1],
+                                   positionTransform.offset[2]);
+  return dequantization * modelTransform;
+}
+
+DirectX::XMFLOAT4X4 Object::GenerateVertexTransform4x4() const {
+  DirectX::XMFLOAT4X4 vertexTransform4x4;
+  DirectX::XMStoreFloat4x4(&vertexTransform4x4, GenerateVertexTransform());
+  return vertexTransform4x4;
+}
+
+float Object::GetMaxLodError(const PinholeCamera& camera,
+                             DirectX::FXMMATRIX placement,
+                             float placementScale,
+                             float viewportHeight,
+                             float maxPixelError) const {
+  const float worldScale = this->scale * placementScale;
+  const ObjFileData::AxisAlignedBounds bounds = this->model.GetBounds();
+  float diagonal = 0.f;
+  for (size_t i = 0; i < 3; ++i)
+    diagonal += (bounds.max[i] - bounds.min[i]) * (bounds.max[i] - bounds.min[i]);
+  const float radius = sqrtf(diagonal) / 2 * worldScale;
+
+  // The model's midpoint ends up at its position (see GenerateModelTransform), and from there wherever the placement
+  // puts it.
+  DirectX::XMFLOAT3 center;
+  DirectX::XMStoreFloat3(&center,
+                         DirectX::XMVector3TransformCoord(DirectX::XMLoadFloat4(&this->position), placement));
+  const float offset[3] = {center.x - camera.position_.x, center.y - camera.position_.y,
+                           center.z - camera.position_.z};
+  const float distance = sqrtf(offset[0] * offset[0] + offset[1] * offset[1] + offset[2] * offset[2]) - radius;
+  if (!(distance > 0.f) || !(viewportHeight > 0.f) || !(worldScale > 0.f))
+    return 0.f;
+
+  // The height of the view at |distance|, in world units.
+  const float viewHeight = 2.f * tanf(PinholeCamera::kVerticalFieldOfView / 2) * distance;
+  return maxPixelError * viewHeight / viewportHeight / worldScale;
+}
+
+float Object::GetMaxLodError(const OrthographicCamera& camera,
+                             float placementScale,
+                             float viewportHeight,
+                             float maxPixelError) const {
+  const float worldScale = this->scale * placementScale;
+  if (!(viewportHeight > 0.f) || !(worldScale > 0.f))
+    return 0.f;
+
+  return maxPixelError * camera.heightInWorldCoordinates / viewportHeight / worldScale;
+}
@@ -1,8 +1,10 @@
 #pragma once
 
+#include "d3d12/Camera.h"
 #include "d3d12/Model.h"
 
 #include <DirectXMath.h>
+#include <stdint.h>
 
 class Object {
  public:
@@ -15,6 +17,33 @@ class Object {
   float rotationY;
   float scale;
 
+  // Goes up with every call to MarkTransformChanged, which has to be made whenever the position, rotation or scale
+  // change, so that whatever has been drawn with the old transform (like the shadow maps) can tell that it's stale.
+  uint64_t transformVersion = 0;
+  void MarkTransformChanged() { ++transformVersion; }
+
   DirectX::XMMATRIX GenerateModelTransform() const;
   DirectX::XMFLOAT4X4 GenerateModelTransform4x4() const;
+
+  // The model transform, preceded by mapping the vertex positions back from the format they're stored in (see
+  // Model::m_hasQuantizedVertices). Normals aren't affected, so they still go through the model transform alone.
+  DirectX::XMMATRIX GenerateVertexTransform() const;
+  DirectX::XMFLOAT4X4 GenerateVertexTransform4x4() const;
+
+  // The largest error (in model units, like ObjFileData::MeshLod::error) that a level of detail may have for it to
+  // move the surface by no more than |maxPixelError| pixels on a viewport that's |viewportHeight| pixels high; to be
+  // passed on to Model::DrawMeshPart. For perspective cameras, it's measured at the nearest point of the model's
+  // bounding sphere.
+  //
+  // That's for a copy of the object that's placed by |placement| after the model transform, which scales uniformly by
+  // |placementScale| (see SceneInstances::GeneratePlacementTransform).
+  float GetMaxLodError(const PinholeCamera& camera,
+                       DirectX::FXMMATRIX placement,
+                       float placementScale,
+                       float viewportHeight,
+                       float maxPixelError) const;
+  float GetMaxLodError(const OrthographicCamera& camera,
+                       float placementScale,
+                       float viewportHeight,
+                       float maxPixelError) const;
 };
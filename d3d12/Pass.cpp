@@ -5,10 +5,12 @@
 #include "d3d12/d3dx12.h"
 #include "utils/comhelper.h"
 
+#include <vector>
+
 using namespace Microsoft::WRL;
 
-ID3D12PipelineState* GraphicsPass::GetPipelineState() {
-  return m_pipelineState.Get();
+ID3D12PipelineState* GraphicsPass::GetPipelineState(bool hasQuantizedVertices) {
+  return hasQuantizedVertices ? m_quantizedPipelineState.Get() : m_pipelineState.Get();
 }
 
 ID3D12RootSignature* GraphicsPass::GetRootSignature() {
@@ -16,10 +18,67 @@ ID3D12RootSignature* GraphicsPass::GetRootSignature() {
 }
 
 namespace {
+// The layouts of ObjFileData::Vertex and of VertexQuantization::QuantizedVertex. Passes that don't need the normals
+// only use the first two elements.
+const D3D12_INPUT_ELEMENT_DESC kVertexInputElements[] = {
+    {"POSITION", /*SemanticIndex*/ 0, DXGI_FORMAT_R32G32B32_FLOAT, /*InputSlot*/ 0,
+     /*AlignedByteOffset*/ 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA,
+     /*InstanceDataStepRate*/ 0},
+    {"TEXCOORD", /*SemanticIndex*/ 0, DXGI_FORMAT_R32G32_FLOAT, /*InputSlot*/ 0,
+     /*AlignedByteOffset*/ 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA,
+     /*InstanceDataStepRate*/ 0},
+    {"NORMAL", /*SemanticIndex*/ 0, DXGI_FORMAT_R32G32B32_FLOAT, /*InputSlot*/ 0,
+     /*AlignedByteOffset*/ 20, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA,
+     /*InstanceDataStepRate*/ 0},
+};
+
+const D3D12_INPUT_ELEMENT_DESC kQuantizedVertexInputElements[] = {
+    {"POSITION", /*SemanticIndex*/ 0, DXGI_FORMAT_R16G16B16A16_UNORM, /*InputSlot*/ 0,
+     /*AlignedByteOffset*/ 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA,
+     /*InstanceDataStepRate*/ 0},
+    {"TEXCOORD", /*SemanticIndex*/ 0, DXGI_FORMAT_R16G16_FLOAT, /*InputSlot*/ 0,
+     /*AlignedByteOffset*/ 8, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA,
+     /*InstanceDataStepRate*/ 0},
+    {"NORMAL", /*SemanticIndex*/ 0, DXGI_FORMAT_R16G16_SNORM, /*InputSlot*/ 0,
+     /*AlignedByteOffset*/ 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA,
+     /*InstanceDataStepRate*/ 0},
+};
+
+// The layout of SceneInstances::DrawTransforms, which is bound with one element for each instance. Passes that don't
+// need the normals only use the first three elements.
+const D3D12_INPUT_ELEMENT_DESC kInstanceInputElements[] = {
+    {"INSTANCE_VERTEX_TRANSFORM", /*SemanticIndex*/ 0, DXGI_FORMAT_R32G32B32A32_FLOAT, GraphicsPass::kInstanceInputSlot,
+     /*AlignedByteOffset*/ 0, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, /*InstanceDataStepRate*/ 1},
+    {"INSTANCE_VERTEX_TRANSFORM", /*SemanticIndex*/ 1, DXGI_FORMAT_R32G32B32A32_FLOAT, GraphicsPass::kInstanceInputSlot,
+     /*AlignedByteOffset*/ 16, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, /*InstanceDataStepRate*/ 1},
+    {"INSTANCE_VERTEX_TRANSFORM", /*SemanticIndex*/ 2, DXGI_FORMAT_R32G32B32A32_FLOAT, GraphicsPass::kInstanceInputSlot,
+     /*AlignedByteOffset*/ 32, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, /*InstanceDataStepRate*/ 1},
+    {"INSTANCE_NORMAL_TRANSFORM", /*SemanticIndex*/ 0, DXGI_FORMAT_R32G32B32_FLOAT, GraphicsPass::kInstanceInputSlot,
+     /*AlignedByteOffset*/ 48, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, /*InstanceDataStepRate*/ 1},
+    {"INSTANCE_NORMAL_TRANSFORM", /*SemanticIndex*/ 1, DXGI_FORMAT_R32G32B32_FLOAT, GraphicsPass::kInstanceInputSlot,
+     /*AlignedByteOffset*/ 60, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, /*InstanceDataStepRate*/ 1},
+    {"INSTANCE_NORMAL_TRANSFORM", /*SemanticIndex*/ 2, DXGI_FORMAT_R32G32B32_FLOAT, GraphicsPass::kInstanceInputSlot,
+     /*AlignedByteOffset*/ 72, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, /*InstanceDataStepRate*/ 1},
+};
+
+// The first |numVertexElements| of |vertexElements|, followed by the first |numInstanceElements| of
+// kInstanceInputElements.
+std::vector<D3D12_INPUT_ELEMENT_DESC> CombineInputElements(const D3D12_INPUT_ELEMENT_DESC* vertexElements,
+                                                           size_t numVertexElements,
+                                                           size_t numInstanceElements) {
+  std::vector<D3D12_INPUT_ELEMENT_DESC> elements(vertexElements, vertexElements + numVertexElements);
+  elements.insert(elements.end(), kInstanceInputElements, kInstanceInputElements + numInstanceElements);
+  return elements;
+}
+
+// The vertex shaders take the quantized layout when they're compiled with these.
+const D3D_SHADER_MACRO kQuantizedVertexDefines[] = {{"QUANTIZED_VERTICES", "1"}, {nullptr, nullptr}};
+
 HRESULT CompileShader(LPCWSTR srcFile,
                       LPCSTR entryPoint,
                       LPCSTR profile,
-                      /*out*/ Microsoft::WRL::ComPtr<ID3DBlob>& blob) {
+                      /*out*/ Microsoft::WRL::ComPtr<ID3DBlob>& blob,
+                      const D3D_SHADER_MACRO* defines = nullptr) {
   if (!srcFile || !entryPoint || !profile)
     return E_INVALIDARG;
 
@@ -30,8 +89,8 @@ HRESULT CompileShader(LPCWSTR srcFile,
 
   Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob = nullptr;
   Microsoft::WRL::ComPtr<ID3DBlob> errorBlob = nullptr;
-  HRESULT hr = D3DCompileFromFile(srcFile, /*defines*/ nullptr, /*include*/ nullptr, entryPoint, profile, flags, 0,
-                                  &shaderBlob, &errorBlob);
+  HRESULT hr = D3DCompileFromFile(srcFile, defines, /*include*/ nullptr, entryPoint, profile, flags, 0, &shaderBlob,
+                                  &errorBlob);
   if (FAILED(hr)) {
     if (errorBlob) {
       OutputDebugStringA((char*)errorBlob->GetBufferPointer());
@@ -79,18 +138,16 @@ void ColorPass::Initialize(ID3D12Device* device) {
   CD3DX12_DESCRIPTOR_RANGE texTable;
   texTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 1);
 
-  // CBV 0 is the per-frame data.
-  // CBV 1 is the per-object data.
-  CD3DX12_ROOT_PARAMETER parameters[4] = {};
+  // CBV 0 is the per-frame data. The objects' transforms come in with the per-instance vertex data.
+  CD3DX12_ROOT_PARAMETER parameters[3] = {};
   parameters[0].InitAsConstantBufferView(/*shaderRegister*/ 0, /*registerSpace*/ 0, D3D12_SHADER_VISIBILITY_ALL);
-  parameters[1].InitAsConstantBufferView(/*shaderRegister*/ 1, /*registerSpace*/ 0, D3D12_SHADER_VISIBILITY_VERTEX);
-  parameters[2].InitAsDescriptorTable(/*numDescriptorRanges*/ 1, /*pDescriptorRanges*/ &shadowMapTable,
+  parameters[1].InitAsDescriptorTable(/*numDescriptorRanges*/ 1, /*pDescriptorRanges*/ &shadowMapTable,
                                       D3D12_SHADER_VISIBILITY_PIXEL);
-  parameters[3].InitAsDescriptorTable(/*numDescriptorRanges*/ 1, /*pDescriptorRanges*/ &texTable,
+  parameters[2].InitAsDescriptorTable(/*numDescriptorRanges*/ 1, /*pDescriptorRanges*/ &texTable,
                                       D3D12_SHADER_VISIBILITY_PIXEL);
 
   D3D12_ROOT_SIGNATURE_DESC rootSignatureDesc;
-  rootSignatureDesc.NumParameters = 4;
+  rootSignatureDesc.NumParameters = 3;
   rootSignatureDesc.pParameters = parameters;
   rootSignatureDesc.Flags = D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT;
   rootSignatureDesc.NumStaticSamplers = 2;
@@ -98,24 +155,20 @@ void ColorPass::Initialize(ID3D12Device* device) {
   m_rootSignature = SerializeAndCreateRootSignature(device, &rootSignatureDesc);
 
   Microsoft::WRL::ComPtr<ID3DBlob> vertexShader;
+  Microsoft::WRL::ComPtr<ID3DBlob> quantizedVertexShader;
   Microsoft::WRL::ComPtr<ID3DBlob> pixelShader;
   HR(CompileShader(L"ColorPassShaders.hlsl", "VSMain", "vs_5_0", /*out*/ vertexShader));
+  HR(CompileShader(L"ColorPassShaders.hlsl", "VSMain", "vs_5_0", /*out*/ quantizedVertexShader,
+                   kQuantizedVertexDefines));
   HR(CompileShader(L"ColorPassShaders.hlsl", "PSMain", "ps_5_0", /*out*/ pixelShader));
 
-  D3D12_INPUT_ELEMENT_DESC inputElements[] = {
-      {"POSITION", /*SemanticIndex*/ 0, DXGI_FORMAT_R32G32B32_FLOAT, /*InputSlot*/ 0,
-       /*AlignedByteOffset*/ 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA,
-       /*InstanceDataStepRate*/ 0},
-      {"TEXCOORD", /*SemanticIndex*/ 0, DXGI_FORMAT_R32G32_FLOAT, /*InputSlot*/ 0,
-       /*AlignedByteOffset*/ 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA,
-       /*InstanceDataStepRate*/ 0},
-      {"NORMAL", /*SemanticIndex*/ 0, DXGI_FORMAT_R32G32B32_FLOAT, /*InputSlot*/ 0,
-       /*AlignedByteOffset*/ 20, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA,
-       /*InstanceDataStepRate*/ 0},
-  };
+  const std::vector<D3D12_INPUT_ELEMENT_DESC> inputElements = CombineInputElements(
+      kVertexInputElements, _countof(kVertexInputElements), _countof(kInstanceInputElements));
+  const std::vector<D3D12_INPUT_ELEMENT_DESC> quantizedInputElements = CombineInputElements(
+      kQuantizedVertexInputElements, _countof(kQuantizedVertexInputElements), _countof(kInstanceInputElements));
 
   D3D12_GRAPHICS_PIPELINE_STATE_DESC psoDesc = {};
-  psoDesc.InputLayout = {inputElements, _countof(inputElements)};
+  psoDesc.InputLayout = {inputElements.data(), static_cast<UINT>(inputElements.size())};
   psoDesc.pRootSignature = m_rootSignature.Get();
   psoDesc.VS = {vertexShader->GetBufferPointer(), vertexShader->GetBufferSize()};
   psoDesc.PS = {pixelShader->GetBufferPointer(), pixelShader->GetBufferSize()};
@@ -131,6 +184,10 @@ void ColorPass::Initialize(ID3D12Device* device) {
   psoDesc.DSVFormat = DXGI_FORMAT_D32_FLOAT;
 
   HR(device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&m_pipelineState)));
+
+  psoDesc.InputLayout = {quantizedInputElements.data(), static_cast<UINT>(quantizedInputElements.size())};
+  psoDesc.VS = {quantizedVertexShader->GetBufferPointer(), quantizedVertexShader->GetBufferSize()};
+  HR(device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&m_quantizedPipelineState)));
 }
 
 void ShadowMapPass::Initialize(ID3D12Device* device) {
@@ -140,12 +197,12 @@ void ShadowMapPass::Initialize(ID3D12Device* device) {
       /*shaderRegister*/ 0, /*D3D12_FILTER*/ D3D12_FILTER_MIN_MAG_MIP_POINT, D3D12_TEXTURE_ADDRESS_MODE_WRAP,
       D3D12_TEXTURE_ADDRESS_MODE_WRAP, D3D12_TEXTURE_ADDRESS_MODE_WRAP);
 
-  CD3DX12_ROOT_PARAMETER parameters[2] = {};
+  // CBV 0 is the per-frame data. The objects' transforms come in with the per-instance vertex data.
+  CD3DX12_ROOT_PARAMETER parameters[1] = {};
   parameters[0].InitAsConstantBufferView(/*shaderRegister*/ 0, /*registerSpace*/ 0, D3D12_SHADER_VISIBILITY_VERTEX);
-  parameters[1].InitAsConstantBufferView(/*shaderRegister*/ 1, /*registerSpace*/ 0, D3D12_SHADER_VISIBILITY_VERTEX);
 
   D3D12_ROOT_SIGNATURE_DESC rootSignatureDesc;
-  rootSignatureDesc.NumParameters = 2;
+  rootSignatureDesc.NumParameters = 1;
   rootSignatureDesc.pParameters = parameters;
   rootSignatureDesc.Flags = D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT;
   rootSignatureDesc.NumStaticSamplers = 1;
@@ -153,21 +210,21 @@ void ShadowMapPass::Initialize(ID3D12Device* device) {
   m_rootSignature = SerializeAndCreateRootSignature(device, &rootSignatureDesc);
 
   Microsoft::WRL::ComPtr<ID3DBlob> vertexShader;
+  Microsoft::WRL::ComPtr<ID3DBlob> quantizedVertexShader;
   Microsoft::WRL::ComPtr<ID3DBlob> pixelShader;
   HR(CompileShader(L"ShadowMapShaders.hlsl", "VSMain", "vs_5_0", /*out*/ vertexShader));
+  HR(CompileShader(L"ShadowMapShaders.hlsl", "VSMain", "vs_5_0", /*out*/ quantizedVertexShader,
+                   kQuantizedVertexDefines));
   HR(CompileShader(L"ShadowMapShaders.hlsl", "PSMain", "ps_5_0", /*out*/ pixelShader));
 
-  D3D12_INPUT_ELEMENT_DESC inputElements[] = {
-      {"POSITION", /*SemanticIndex*/ 0, DXGI_FORMAT_R32G32B32_FLOAT, /*InputSlot*/ 0,
-       /*AlignedByteOffset*/ 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA,
-       /*InstanceDataStepRate*/ 0},
-      {"TEXCOORD", /*SemanticIndex*/ 0, DXGI_FORMAT_R32G32_FLOAT, /*InputSlot*/ 0,
-       /*AlignedByteOffset*/ 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA,
-       /*InstanceDataStepRate*/ 0},
-  };
+  // Shadow maps don't need the normals.
+  const std::vector<D3D12_INPUT_ELEMENT_DESC> inputElements =
+      CombineInputElements(kVertexInputElements, 2, /*numInstanceElements*/ 3);
+  const std::vector<D3D12_INPUT_ELEMENT_DESC> quantizedInputElements =
+      CombineInputElements(kQuantizedVertexInputElements, 2, /*numInstanceElements*/ 3);
 
   D3D12_GRAPHICS_PIPELINE_STATE_DESC psoDesc = {};
-  psoDesc.InputLayout = {inputElements, _countof(inputElements)};
+  psoDesc.InputLayout = {inputElements.data(), static_cast<UINT>(inputElements.size())};
   psoDesc.pRootSignature = m_rootSignature.Get();
   psoDesc.VS = {vertexShader->GetBufferPointer(), vertexShader->GetBufferSize()};
   psoDesc.PS = {pixelShader->GetBufferPointer(), pixelShader->GetBufferSize()};
@@ -186,6 +243,10 @@ void ShadowMapPass::Initialize(ID3D12Device* device) {
   psoDesc.DSVFormat = DXGI_FORMAT_D32_FLOAT;
 
   HR(device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&m_pipelineState)));
+
+  psoDesc.InputLayout = {quantizedInputElements.data(), static_cast<UINT>(quantizedInputElements.size())};
+  psoDesc.VS = {quantizedVertexShader->GetBufferPointer(), quantizedVertexShader->GetBufferSize()};
+  HR(device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&m_quantizedPipelineState)));
 }
 
 namespace {
@@ -250,22 +311,13 @@ ComPtr<ID3D12RootSignature> CreateTownscaperShadowMapRootSignature(ID3D12Device*
 }
 }  // namespace
 
-void TownscaperPSOs::Initialize(ID3D12Device* device) {
+void TownscaperPSOs::Initialize(ID3D12Device* device, bool quantizedVertices) {
   m_rootSignature = CreateTownscaperRootSignature(device);
   m_shadowMapPassRootSignature = CreateTownscaperShadowMapRootSignature(device);
 
-  D3D12_INPUT_ELEMENT_DESC inputElements[] = {
-      {"POSITION", /*SemanticIndex*/ 0, DXGI_FORMAT_R32G32B32_FLOAT, /*InputSlot*/ 0,
-       /*AlignedByteOffset*/ 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA,
-       /*InstanceDataStepRate*/ 0},
-      {"TEXCOORD", /*SemanticIndex*/ 0, DXGI_FORMAT_R32G32_FLOAT, /*InputSlot*/ 0,
-       /*AlignedByteOffset*/ 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA,
-       /*InstanceDataStepRate*/ 0},
-      {"NORMAL", /*SemanticIndex*/ 0, DXGI_FORMAT_R32G32B32_FLOAT, /*InputSlot*/ 0,
-       /*AlignedByteOffset*/ 20, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA,
-       /*InstanceDataStepRate*/ 0},
-  };
-
+  const D3D12_INPUT_ELEMENT_DESC* inputElements =
+      quantizedVertices ? kQuantizedVertexInputElements : kVertexInputElements;
+  const D3D_SHADER_MACRO* vertexShaderDefines = quantizedVertices ? kQuantizedVertexDefines : nullptr;
 
   Microsoft::WRL::ComPtr<ID3DBlob> genericVS;
   Microsoft::WRL::ComPtr<ID3DBlob> buildingsPS;
@@ -273,15 +325,15 @@ void TownscaperPSOs::Initialize(ID3D12Device* device) {
   Microsoft::WRL::ComPtr<ID3DBlob> genericColorPS;
   Microsoft::WRL::ComPtr<ID3DBlob> shadowMapVS;
   Microsoft::WRL::ComPtr<ID3DBlob> shadowMapPS;
-  HR(CompileShader(L"Townscaper.hlsl", "VSMain", "vs_5_0", /*out*/ genericVS));
+  HR(CompileShader(L"Townscaper.hlsl", "VSMain", "vs_5_0", /*out*/ genericVS, vertexShaderDefines));
   HR(CompileShader(L"Townscaper.hlsl", "PSMain_Empty", "ps_5_0", /*out*/ emptyPS));
   HR(CompileShader(L"Townscaper.hlsl", "PSMain_Buildings", "ps_5_0", /*out*/ buildingsPS));
   HR(CompileShader(L"Townscaper.hlsl", "PSMain_NonBuildings", "ps_5_0", /*out*/ genericColorPS));
-  HR(CompileShader(L"Townscaper_ShadowMap.hlsl", "VSMain", "vs_5_0", /*out*/ shadowMapVS));
+  HR(CompileShader(L"Townscaper_ShadowMap.hlsl", "VSMain", "vs_5_0", /*out*/ shadowMapVS, vertexShaderDefines));
   HR(CompileShader(L"Townscaper_ShadowMap.hlsl", "PSMain", "ps_5_0", /*out*/ shadowMapPS));
 
   D3D12_GRAPHICS_PIPELINE_STATE_DESC basePSO = {};
-  basePSO.InputLayout = {inputElements, _countof(inputElements)};
+  basePSO.InputLayout = {inputElements, _countof(kVertexInputElements)};
   basePSO.pRootSignature = m_rootSignature.Get();
   basePSO.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
   basePSO.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "d3d12/Camera.h"
+
 #include <DirectXMath.h>
 #include <d3d12.h>
 #include <wrl/client.h>  // For ComPtr
@@ -7,10 +9,16 @@
 class GraphicsPass {
  protected:
   Microsoft::WRL::ComPtr<ID3D12PipelineState> m_pipelineState;
+  // The same pipeline, for vertices packed by VertexQuantization.
+  Microsoft::WRL::ComPtr<ID3D12PipelineState> m_quantizedPipelineState;
   Microsoft::WRL::ComPtr<ID3D12RootSignature> m_rootSignature;
 
  public:
-  ID3D12PipelineState* GetPipelineState();
+  // Where the per-instance vertex data (SceneInstances::DrawTransforms) is bound. The second slot is for tangents (see
+  // Model::m_tangentBufferView).
+  static constexpr UINT kInstanceInputSlot = 2;
+
+  ID3D12PipelineState* GetPipelineState(bool hasQuantizedVertices = false);
   ID3D12RootSignature* GetRootSignature();
 
   virtual void Initialize(ID3D12Device* device) = 0;
@@ -20,15 +28,11 @@ class ColorPass : public GraphicsPass {
  public:
   struct PerFrameData {
     DirectX::XMFLOAT4X4 projectionViewTransform;
-    DirectX::XMFLOAT4X4 shadowMapProjectionViewTransform;
+    DirectX::XMFLOAT4X4 shadowMapProjectionViewTransforms[ShadowCascades::kNumCascades];
+    DirectX::XMFLOAT4 cascadeSplitDepths;  // ShadowCascades::splitDepths.
     DirectX::XMFLOAT4 lightDirection;
   };
 
-  struct PerObjectData {
-    DirectX::XMFLOAT4X4 modelTransform;
-    DirectX::XMFLOAT4X4 modelTransformInverseTranspose;
-  };
-
   void Initialize(ID3D12Device* device) override;
 };
 
@@ -38,14 +42,27 @@ class ShadowMapPass : public GraphicsPass {
     DirectX::XMFLOAT4X4 projectionViewTransform;
   };
 
-  struct PerObjectData {
-    DirectX::XMFLOAT4X4 worldTransform;
-  };
-
   void Initialize(ID3D12Device* device) override;
 };
 
 struct TownscaperPSOs {
+  // As in Townscaper.hlsl. Townscaper models have a single shadow map, rather than cascades.
+  struct PerFrameData {
+    DirectX::XMFLOAT4X4 projectionViewTransform;
+    DirectX::XMFLOAT4X4 shadowMapProjectionViewTransform;
+    DirectX::XMFLOAT4 lightDirection;
+  };
+
+  // Townscaper models aren't instanced; they're drawn on their own, with a constant buffer for their transforms. As in
+  // Townscaper.hlsl and Townscaper_ShadowMap.hlsl.
+  struct PerObjectData {
+    DirectX::XMFLOAT4X4 modelTransform;
+    DirectX::XMFLOAT4X4 modelTransformInverseTranspose;
+  };
+  struct ShadowMapPerObjectData {
+    DirectX::XMFLOAT4X4 worldTransform;
+  };
+
   Microsoft::WRL::ComPtr<ID3D12RootSignature> m_rootSignature;
   Microsoft::WRL::ComPtr<ID3D12RootSignature> m_shadowMapPassRootSignature;
 
@@ -60,5 +77,7 @@ struct TownscaperPSOs {
   Microsoft::WRL::ComPtr<ID3D12PipelineState> m_psoShadowMap_Windows_MaxDepth;
   Microsoft::WRL::ComPtr<ID3D12PipelineState> m_psoShadowMap_Windows_MinDepth;
 
-  void Initialize(ID3D12Device* device);
+  // Townscaper models are only drawn once they've been fully loaded, so the pipelines only need to handle the vertex
+  // format that the model ends up in.
+  void Initialize(ID3D12Device* device, bool quantizedVertices);
 };
@@ -0,0 +1,418 @@
+#include "d3d12/PngDecoder.h"
+
+#include "utils/Inflate.h"
+
+#include <string.h>
+
+#include <vector>
+
+namespace {
+constexpr unsigned char kSignature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+
+enum ColorType {
+  Grayscale = 0,
+  TrueColor = 2,
+  Indexed = 3,
+  GrayscaleAlpha = 4,
+  TrueColorAlpha = 6,
+};
+
+struct Header {
+  uint32_t width;
+  uint32_t height;
+  uint8_t bitDepth;
+  uint8_t colorType;
+  bool isInterlaced;
+
+  int GetNumChannels() const {
+    switch (colorType) {
+      case Grayscale:
+      case Indexed:
+        return 1;
+      case GrayscaleAlpha:
+        return 2;
+      case TrueColor:
+        return 3;
+      default:
+        return 4;
+    }
+  }
+
+  int GetBitsPerPixel() const { return GetNumChannels() * bitDepth; }
+  size_t GetRowSize(uint32_t numPixels) const { return ((size_t)numPixels * GetBitsPerPixel() + 7) / 8; }
+};
+
+uint32_t ReadBigEndian32(const unsigned char* data) {
+  return ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) | ((uint32_t)data[2] << 8) | (uint32_t)data[3];
+}
+
+uint16_t ReadBigEndian16(const unsigned char* data) {
+  return (uint16_t)((data[0] << 8) | data[1]);
+}
+
+struct Chunk {
+  uint32_t type;
+  const unsigned char* data;
+  uint32_t size;
+};
+
+constexpr uint32_t MakeChunkType(const char (&name)[5]) {
+  return ((uint32_t)name[0] << 24) | ((uint32_t)name[1] << 16) | ((uint32_t)name[2] << 8) | (uint32_t)name[3];
+}
+
+// Walks the chunks that follow the signature. The chunks' CRCs aren't checked; a corrupt chunk will almost certainly
+// fail to decompress anyway.
+class ChunkReader {
+ private:
+  const unsigned char* m_data;
+  size_t m_size;
+  size_t m_position = sizeof(kSignature);
+
+ public:
+  ChunkReader(const unsigned char* data, size_t size) : m_data(data), m_size(size) {}
+
+  // Returns false at the end of the data, or if the next chunk is truncated.
+  bool Next(Chunk* chunk) {
+    // Length + type, then the data, then the CRC.
+    if (m_size - m_position < 12)
+      return false;
+
+    const uint32_t chunkSize = ReadBigEndian32(m_data + m_position);
+    if (chunkSize > m_size - m_position - 12)
+      return false;
+
+    chunk->type = ReadBigEndian32(m_data + m_position + 4);
+    chunk->data = m_data + m_position + 8;
+    chunk->size = chunkSize;
+    m_position += 12 + (size_t)chunkSize;
+    return true;
+  }
+};
+
+bool ReadHeader(const unsigned char* data, size_t size, Header* header) {
+  if (size < sizeof(kSignature) || memcmp(data, kSignature, sizeof(kSignature)) != 0)
+    return false;
+
+  ChunkReader reader(data, size);
+  Chunk chunk;
+  if (!reader.Next(&chunk) || chunk.type != MakeChunkType("IHDR") || chunk.size != 13)
+    return false;
+
+  header->width = ReadBigEndian32(chunk.data);
+  header->height = ReadBigEndian32(chunk.data + 4);
+  header->bitDepth = chunk.data[8];
+  header->colorType = chunk.data[9];
+  const uint8_t compressionMethod = chunk.data[10];
+  const uint8_t filterMethod = chunk.data[11];
+  const uint8_t interlaceMethod = chunk.data[12];
+  header->isInterlaced = (interlaceMethod == 1);
+
+  if (header->width == 0 || header->height == 0 || header->width > 0x7FFFFFFF || header->height > 0x7FFFFFFF ||
+      compressionMethod != 0 || filterMethod != 0 || interlaceMethod > 1)
+    return false;
+
+  const uint8_t bitDepth = header->bitDepth;
+  switch (header->colorType) {
+    case Grayscale:
+      return bitDepth == 1 || bitDepth == 2 || bitDepth == 4 || bitDepth == 8 || bitDepth == 16;
+    case Indexed:
+      return bitDepth == 1 || bitDepth == 2 || bitDepth == 4 || bitDepth == 8;
+    case TrueColor:
+    case GrayscaleAlpha:
+    case TrueColorAlpha:
+      return bitDepth == 8 || bitDepth == 16;
+    default:
+      return false;
+  }
+}
+
+int PaethPredictor(int a, int b, int c) {
+  const int p = a + b - c;
+  const int pa = p > a ? p - a : a - p;
+  const int pb = p > b ? p - b : b - p;
+  const int pc = p > c ? p - c : c - p;
+  if (pa <= pb && pa <= pc)
+    return a;
+  return (pb <= pc) ? b : c;
+}
+
+// Reverses the filter in place. |previousRow| is all zeros for the first row of an image (or of an interlace pass).
+bool UnfilterRow(uint8_t filterType,
+                 unsigned char* row,
+                 const unsigned char* previousRow,
+                 size_t rowSize,
+                 size_t bytesPerPixel) {
+  switch (filterType) {
+    case 0:  // None.
+      return true;
+
+    case 1:  // Sub.
+      for (size_t i = bytesPerPixel; i < rowSize; ++i) {
+        row[i] += row[i - bytesPerPixel];
+      }
+      return true;
+
+    case 2:  // Up.
+      for (size_t i = 0; i < rowSize; ++i) {
+        row[i] += previousRow[i];
+      }
+      return true;
+
+    case 3:  // Average.
+      for (size_t i = 0; i < bytesPerPixel; ++i) {
+        row[i] += previousRow[i] / 2;
+      }
+      for (size_t i = bytesPerPixel; i < rowSize; ++i) {
+        row[i] += (unsigned char)((row[i - bytesPerPixel] + previousRow[i]) / 2);
+      }
+      return true;
+
+    case 4:  // Paeth.
+      for (size_t i = 0; i < bytesPerPixel; ++i) {
+        row[i] += previousRow[i];
+      }
+      for (size_t i = bytesPerPixel; i < rowSize; ++i) {
+        row[i] += (unsigned char)PaethPredictor(row[i - bytesPerPixel], previousRow[i], previousRow[i - bytesPerPixel]);
+      }
+      return true;
+
+    default:
+      return false;
+  }
+}
+
+struct Palette {
+  unsigned char entries[256][4];
+  size_t numEntries = 0;
+};
+
+// For grayscale and truecolor images, the tRNS chunk specifies a single color that is fully transparent.
+struct ColorKey {
+  bool isSet = false;
+  uint16_t values[3];
+};
+
+class RowConverter {
+ private:
+  const Header& m_header;
+  const Palette& m_palette;
+  const ColorKey& m_colorKey;
+
+ public:
+  RowConverter(const Header& header, const Palette& palette, const ColorKey& colorKey)
+      : m_header(header), m_palette(palette), m_colorKey(colorKey) {}
+
+  // Writes |numPixels| RGBA pixels, |pixelStep| bytes apart (interlaced passes only fill in every few pixels).
+  bool Convert(const unsigned char* row, uint32_t numPixels, unsigned char* out, size_t pixelStep) const;
+};
+
+bool RowConverter::Convert(const unsigned char* row, uint32_t numPixels, unsigned char* out, size_t pixelStep) const {
+  const int bitDepth = m_header.bitDepth;
+  const int numChannels = m_header.GetNumChannels();
+
+  if (bitDepth < 8) {
+    // Only grayscale and indexed images have sub-byte samples. Grayscale samples are scaled up to the full range.
+    const int mask = (1 << bitDepth) - 1;
+    const int scale = 255 / mask;
+    for (uint32_t x = 0; x < numPixels; ++x, out += pixelStep) {
+      const size_t bitOffset = (size_t)x * bitDepth;
+      const int sample = (row[bitOffset / 8] >> (8 - bitDepth - bitOffset % 8)) & mask;
+      if (m_header.colorType == Indexed) {
+        if ((size_t)sample >= m_palette.numEntries)
+          return false;
+        memcpy(out, m_palette.entries[sample], 4);
+      } else {
+        out[0] = out[1] = out[2] = (unsigned char)(sample * scale);
+        out[3] = (m_colorKey.isSet && sample == m_colorKey.values[0]) ? 0 : 255;
+      }
+    }
+    return true;
+  }
+
+  // 16-bit samples keep only their high byte, except when compared against the color key.
+  const int bytesPerSample = bitDepth / 8;
+  auto readSample = [bytesPerSample](const unsigned char* sample) -> uint16_t {
+    return (bytesPerSample == 2) ? ReadBigEndian16(sample) : sample[0];
+  };
+
+  for (uint32_t x = 0; x < numPixels; ++x, out += pixelStep) {
+    const unsigned char* pixel = row + (size_t)x * numChannels * bytesPerSample;
+    switch (m_header.colorType) {
+      case Grayscale: {
+        out[0] = out[1] = out[2] = pixel[0];
+        out[3] = (m_colorKey.isSet && readSample(pixel) == m_colorKey.values[0]) ? 0 : 255;
+      } break;
+
+      case Indexed: {
+        if (pixel[0] >= m_palette.numEntries)
+          return false;
+        memcpy(out, m_palette.entries[pixel[0]], 4);
+      } break;
+
+      case GrayscaleAlpha: {
+        out[0] = out[1] = out[2] = pixel[0];
+        out[3] = pixel[bytesPerSample];
+      } break;
+
+      case TrueColor: {
+        out[0] = pixel[0];
+        out[1] = pixel[bytesPerSample];
+        out[2] = pixel[2 * bytesPerSample];
+        const bool isTransparent = m_colorKey.isSet && readSample(pixel) == m_colorKey.values[0] &&
+                                   readSample(pixel + bytesPerSample) == m_colorKey.values[1] &&
+                                   readSample(pixel + 2 * bytesPerSample) == m_colorKey.values[2];
+        out[3] = isTransparent ? 0 : 255;
+      } break;
+
+      case TrueColorAlpha: {
+        out[0] = pixel[0];
+        out[1] = pixel[bytesPerSample];
+        out[2] = pixel[2 * bytesPerSample];
+        out[3] = pixel[3 * bytesPerSample];
+      } break;
+    }
+  }
+
+  return true;
+}
+
+struct InterlacePass {
+  uint32_t xStart;
+  uint32_t yStart;
+  uint32_t xStep;
+  uint32_t yStep;
+};
+
+// Adam7. Non-interlaced images are treated as a single pass that covers every pixel.
+constexpr InterlacePass kAdam7Passes[7] = {
+  {0, 0, 8, 8}, {4, 0, 8, 8}, {0, 4, 4, 8}, {2, 0, 4, 4}, {0, 2, 2, 4}, {1, 0, 2, 2}, {0, 1, 1, 2},
+};
+constexpr InterlacePass kNonInterlacedPass = {0, 0, 1, 1};
+
+uint32_t GetPassSize(uint32_t imageSize, uint32_t start, uint32_t step) {
+  return (imageSize > start) ? (imageSize - start + step - 1) / step : 0;
+}
+}  // namespace
+
+bool PngDecoder::ReadInfo(const unsigned char* data, size_t size, Info* info) const {
+  Header header;
+  if (!ReadHeader(data, size, &header))
+    return false;
+
+  info->width = header.width;
+  info->height = header.height;
+  return true;
+}
+
+bool PngDecoder::Decode(const unsigned char* data, size_t size, unsigned char* pixels, size_t rowPitch) const {
+  Header header;
+  if (!ReadHeader(data, size, &header))
+    return false;
+
+  Palette palette;
+  ColorKey colorKey;
+  std::vector<unsigned char> compressedData;
+
+  ChunkReader reader(data, size);
+  Chunk chunk;
+  reader.Next(&chunk);  // IHDR, which has already been read.
+  bool hasReachedEnd = false;
+  while (!hasReachedEnd && reader.Next(&chunk)) {
+    switch (chunk.type) {
+      case MakeChunkType("PLTE"): {
+        if (chunk.size % 3 != 0 || chunk.size / 3 > 256)
+          return false;
+        palette.numEntries = chunk.size / 3;
+        for (size_t i = 0; i < palette.numEntries; ++i) {
+          memcpy(palette.entries[i], chunk.data + 3 * i, 3);
+          palette.entries[i][3] = 255;
+        }
+      } break;
+
+      case MakeChunkType("tRNS"): {
+        if (header.colorType == Indexed) {
+          // Alpha values for the first few palette entries; the rest stay opaque.
+          for (size_t i = 0; i < chunk.size && i < palette.numEntries; ++i) {
+            palette.entries[i][3] = chunk.data[i];
+          }
+        } else if (header.colorType == Grayscale && chunk.size >= 2) {
+          colorKey.isSet = true;
+          colorKey.values[0] = ReadBigEndian16(chunk.data);
+        } else if (header.colorType == TrueColor && chunk.size >= 6) {
+          colorKey.isSet = true;
+          for (size_t i = 0; i < 3; ++i) {
+            colorKey.values[i] = ReadBigEndian16(chunk.data + 2 * i);
+          }
+        }
+      } break;
+
+      case MakeChunkType("IDAT"):
+        compressedData.insert(compressedData.end(), chunk.data, chunk.data + chunk.size);
+        break;
+
+      case MakeChunkType("IEND"):
+        hasReachedEnd = true;
+        break;
+
+      default:
+        break;
+    }
+  }
+
+  if (header.colorType == Indexed && palette.numEntries == 0)
+    return false;
+
+  const InterlacePass* passes = header.isInterlaced ? kAdam7Passes : &kNonInterlacedPass;
+  const size_t numPasses = header.isInterlaced ? 7 : 1;
+
+  // Every row starts with a filter type byte.
+  size_t expectedSize = 0;
+  for (size_t i = 0; i < numPasses; ++i) {
+    const uint32_t passWidth = GetPassSize(header.width, passes[i].xStart, passes[i].xStep);
+    const uint32_t passHeight = GetPassSize(header.height, passes[i].yStart, passes[i].yStep);
+    if (passWidth > 0)
+      expectedSize += passHeight * (1 + header.GetRowSize(passWidth));
+  }
+
+  // Deflate can't compress by more than about 1032:1, so this catches headers with bogus dimensions before they turn
+  // into a huge allocation.
+  if (expectedSize / 1032 > compressedData.size())
+    return false;
+
+  std::vector<unsigned char> filteredData;
+  if (!ZlibDecompress(compressedData.data(), compressedData.size(), expectedSize, &filteredData) ||
+      filteredData.size() < expectedSize)
+    return false;
+
+  // Filters work on whole bytes, looking back one pixel (or one byte, for sub-byte pixels).
+  const size_t filterBytesPerPixel = (header.GetBitsPerPixel() + 7) / 8;
+  const RowConverter converter(header, palette, colorKey);
+  std::vector<unsigned char> zeroRow(header.GetRowSize(header.width));
+
+  unsigned char* row = filteredData.data();
+  for (size_t i = 0; i < numPasses; ++i) {
+    const InterlacePass& pass = passes[i];
+    const uint32_t passWidth = GetPassSize(header.width, pass.xStart, pass.xStep);
+    const uint32_t passHeight = GetPassSize(header.height, pass.yStart, pass.yStep);
+    if (passWidth == 0)
+      continue;
+
+    const size_t rowSize = header.GetRowSize(passWidth);
+    const unsigned char* previousRow = zeroRow.data();
+    for (uint32_t y = 0; y < passHeight; ++y) {
+      const uint8_t filterType = row[0];
+      unsigned char* rowData = row + 1;
+      if (!UnfilterRow(filterType, rowData, previousRow, rowSize, filterBytesPerPixel))
+        return false;
+
+      unsigned char* out = pixels + (pass.yStart + (size_t)y * pass.yStep) * rowPitch + (size_t)pass.xStart * 4;
+      if (!converter.Convert(rowData, passWidth, out, (size_t)pass.xStep * 4))
+        return false;
+
+      previousRow = rowData;
+      row += 1 + rowSize;
+    }
+  }
+
+  return true;
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include "d3d12/ImageDecoder.h"
+
+// Supports every standard png variant: all color types and bit depths, palettes, tRNS transparency and interlacing.
+// 16-bit channels are truncated to 8 bits. Ancillary chunks (gamma, color profiles, etc.) are ignored.
+class PngDecoder : public ImageDecoder {
+ public:
+  bool ReadInfo(const unsigned char* data, size_t size, Info* info) const override;
+  bool Decode(const unsigned char* data, size_t size, unsigned char* pixels, size_t rowPitch) const override;
+};
@@ -0,0 +1,128 @@
+#include "d3d12/PolygonTriangulation.h"
+
+#include <math.h>
+
+#include <utility>
+
+namespace PolygonTriangulation {
+
+namespace {
+// Twice the signed area of the triangle abc; positive if it winds counterclockwise.
+float Cross(const float* a, const float* b, const float* c) {
+  return (b[0] - a[0]) * (c[1] - a[1]) - (b[1] - a[1]) * (c[0] - a[0]);
+}
+
+bool IsSamePoint(const float* a, const float* b) {
+  return a[0] == b[0] && a[1] == b[1];
+}
+
+// Points on the triangle's edges count as inside, so that an ear is never cut off across another corner; except for
+// copies of the triangle's own corners, which polygons with holes bridged into them have.
+bool IsInTriangle(const float* p, const float* a, const float* b, const float* c) {
+  if (IsSamePoint(p, a) || IsSamePoint(p, b) || IsSamePoint(p, c))
+    return false;
+  return Cross(a, b, p) >= 0.f && Cross(b, c, p) >= 0.f && Cross(c, a, p) >= 0.f;
+}
+
+void Fan(uint32_t numCorners, /*out*/ uint32_t* triangles) {
+  for (uint32_t i = 1; i + 1 < numCorners; ++i) {
+    *triangles++ = 0;
+    *triangles++ = i;
+    *triangles++ = i + 1;
+  }
+}
+}  // namespace
+
+void Triangulate(const float* positions, uint32_t numCorners, Workspace* workspace, /*out*/ uint32_t* triangles) {
+  // Newell's method, which gives the polygon's normal even if some of its corners are concave (or collinear).
+  float normal[3] = {0.f, 0.f, 0.f};
+  for (uint32_t i = 0; i < numCorners; ++i) {
+    const float* p = positions + 3 * i;
+    const float* q = positions + 3 * ((i + 1) % numCorners);
+    normal[0] += (p[1] - q[1]) * (p[2] + q[2]);
+    normal[1] += (p[2] - q[2]) * (p[0] + q[0]);
+    normal[2] += (p[0] - q[0]) * (p[1] + q[1]);
+  }
+
+  // Flatten the polygon by dropping the normal's largest axis, swapping the other two if need be so that the polygon
+  // winds counterclockwise.
+  size_t axis = 0;
+  for (size_t i = 1; i < 3; ++i) {
+    if (fabsf(normal[i]) > fabsf(normal[axis]))
+      axis = i;
+  }
+  if (numCorners <= 3 || normal[axis] == 0.f) {
+    Fan(numCorners, triangles);
+    return;
+  }
+  size_t uAxis = (axis + 1) % 3;
+  size_t vAxis = (axis + 2) % 3;
+  if (normal[axis] < 0.f)
+    std::swap(uAxis, vAxis);
+
+  std::vector<float>& points = workspace->points;
+  points.resize(2 * numCorners);
+  for (uint32_t i = 0; i < numCorners; ++i) {
+    points[2 * i] = positions[3 * i + uAxis];
+    points[2 * i + 1] = positions[3 * i + vAxis];
+  }
+  auto point = [&points](uint32_t i) { return &points[2 * i]; };
+
+  bool isConvex = true;
+  for (uint32_t i = 0; i < numCorners && isConvex; ++i)
+    isConvex = Cross(point((i + numCorners - 1) % numCorners), point(i), point((i + 1) % numCorners)) >= 0.f;
+  if (isConvex) {
+    Fan(numCorners, triangles);
+    return;
+  }
+
+  // The corners that are left, as a circular doubly linked list.
+  std::vector<uint32_t>& previous = workspace->previous;
+  std::vector<uint32_t>& next = workspace->next;
+  previous.resize(numCorners);
+  next.resize(numCorners);
+  for (uint32_t i = 0; i < numCorners; ++i) {
+    previous[i] = (i + numCorners - 1) % numCorners;
+    next[i] = (i + 1) % numCorners;
+  }
+
+  uint32_t corner = 0;
+  uint32_t numLeft = numCorners;
+  // How many corners have been looked at since the last ear was cut off. Once every corner has been, there aren't any
+  // ears left, which only happens for degenerate or self-intersecting polygons; the next corner is cut off anyway.
+  uint32_t numSinceEar = 0;
+  while (numLeft > 3) {
+    const uint32_t a = previous[corner];
+    const uint32_t b = corner;
+    const uint32_t c = next[corner];
+
+    bool isEar = numSinceEar >= numLeft;
+    if (!isEar && Cross(point(a), point(b), point(c)) > 0.f) {
+      isEar = true;
+      for (uint32_t p = next[c]; p != a && isEar; p = next[p])
+        isEar = !IsInTriangle(point(p), point(a), point(b), point(c));
+    }
+
+    if (!isEar) {
+      corner = c;
+      ++numSinceEar;
+      continue;
+    }
+
+    *triangles++ = a;
+    *triangles++ = b;
+    *triangles++ = c;
+    next[a] = c;
+    previous[c] = a;
+    --numLeft;
+    numSinceEar = 0;
+    // The corner before the ear is the one most likely to have just become an ear itself.
+    corner = a;
+  }
+
+  *triangles++ = previous[corner];
+  *triangles++ = corner;
+  *triangles++ = next[corner];
+}
+
+}  // namespace PolygonTriangulation
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+// Splits the polygons of an obj file's faces into triangles, as they're parsed.
+//
+// Most polygons (quads, and the caps of cylinders) are convex, and are split into a fan around their first corner. The
+// rest are ear clipped: the polygon is flattened onto the plane that it's most nearly parallel to, and corners whose
+// triangle with their two neighbors is convex and has no other corner inside it are cut off one at a time. Either way,
+// the triangles are wound the same way as the polygon.
+namespace PolygonTriangulation {
+
+// Scratch space, reused from one polygon to the next so that triangulating doesn't allocate once it has grown to the
+// size of the largest polygon.
+struct Workspace {
+  std::vector<float> points;  // The corners flattened onto a plane, 2 floats each.
+  std::vector<uint32_t> previous;
+  std::vector<uint32_t> next;
+};
+
+// |positions| has 3 floats for each of the polygon's corners, in order. Writes 3 * (numCorners - 2) corner numbers
+// (0-based, into the polygon) to |triangles|.
+//
+// Degenerate and self-intersecting polygons still come out as the right number of triangles, just not necessarily
+// ones that cover the polygon exactly.
+void Triangulate(const float* positions, uint32_t numCorners, Workspace* workspace, /*out*/ uint32_t* triangles);
+
+}  // namespace PolygonTriangulation
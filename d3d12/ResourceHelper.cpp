@@ -21,7 +21,10 @@ ComPtr<ID3D12Resource> ResourceHelper::AllocateIntermediateBuffer(ID3D12Device*
                                                                   ID3D12Resource* destinationResource,
                                                                   ResourceGarbageCollector& garbageCollector,
                                                                   uint64_t nextSignalValue) {
-  const uint64_t uploadBufferSize = GetRequiredIntermediateSize(destinationResource, 0, 1);
+  // Large enough for every subresource (e.g. all of a texture's mips), as they're all uploaded at once.
+  const D3D12_RESOURCE_DESC destinationDesc = destinationResource->GetDesc();
+  const UINT numSubresources = destinationDesc.MipLevels * destinationDesc.DepthOrArraySize;
+  const uint64_t uploadBufferSize = GetRequiredIntermediateSize(destinationResource, 0, numSubresources);
   D3D12_HEAP_PROPERTIES heapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
   D3D12_RESOURCE_DESC resourceDesc = CD3DX12_RESOURCE_DESC::Buffer(uploadBufferSize);
 
@@ -2,11 +2,100 @@
 
 #include "d3d12/D3D12Renderer.h"
 
-void Scene::Initialize(const std::string& objFilename, D3D12Renderer* renderer) {
-  Model model;
-  model.InitFromObjFile(renderer, objFilename);
+#include <math.h>
 
-  const ObjFileData::AxisAlignedBounds& bounds = model.GetBounds();
+#include <iostream>
+
+namespace {
+// The models are fitted into unit boxes, so this leaves a bit of room between the instances on the grid.
+constexpr float kInstanceSpacing = 1.5f;
+}  // namespace
+
+void Scene::Initialize(const std::vector<std::string>& objFilenames,
+                       size_t numInstances,
+                       bool printLoadStatistics,
+                       D3D12Renderer* renderer) {
+  for (const std::string& objFilename : objFilenames) {
+    m_sources.push_back(std::make_unique<ObjectSource>());
+    m_sources.back()->filename = objFilename;
+    m_sources.back()->loader.Start(objFilename, renderer->UsesQuantizedVertices(),
+                                   /*mergeMeshParts*/ !renderer->IsTownscaper(), printLoadStatistics);
+
+    m_objects.push_back(std::make_unique<Object>());
+    Object& object = *m_objects.back();
+    object.position = DirectX::XMFLOAT4(0, 0, 0, 1);
+    object.rotationY = 0;
+    object.scale = 1;
+    object.MarkTransformChanged();
+  }
+
+  // A square grid around the origin, filled row by row.
+  const size_t gridSize = static_cast<size_t>(ceil(sqrt(static_cast<double>(numInstances))));
+  const float gridOffset = (static_cast<float>(gridSize) - 1.f) * kInstanceSpacing / 2;
+  for (size_t i = 0; i < numInstances && !m_objects.empty(); ++i) {
+    const DirectX::XMFLOAT3 position((i % gridSize) * kInstanceSpacing - gridOffset, 0.f,
+                                     (i / gridSize) * kInstanceSpacing - gridOffset);
+    m_instances.Add(static_cast<uint32_t>(i % m_objects.size()), position);
+  }
+
+  m_objectRotationAnimation = Animation::CreateAnimation(10000, /*repeat*/ true);
+
+  SetLightDirection(DirectX::XMFLOAT3(-0.25, 1, 1));
+
+  m_camera.m_arcballCenter = DirectX::XMFLOAT4(0.f, 0.f, 0.f, 1.f);
+  m_camera.m_rotationXInDegrees = 0.f;
+  m_camera.m_rotationYInDegrees = 90.f;
+  m_camera.m_distance = (std::max)(1.f, gridSize * kInstanceSpacing);
+}
+
+void Scene::UploadStreamedData(D3D12Renderer* renderer) {
+  for (size_t i = 0; i < m_sources.size(); ++i) {
+    ObjectSource& source = *m_sources[i];
+    Object& object = *m_objects[i];
+
+    std::vector<StreamingObjLoader::Batch> batches;
+    StreamingObjLoader::Batch nextBatch;
+    while (!source.isGeometryLoaded && source.loader.TryGetNextBatch(&nextBatch))
+      batches.push_back(std::move(nextBatch));
+
+    // When the loader has got ahead, the geometry of the batches before one that replaces it would only be uploaded
+    // to be thrown away again. Their materials are still needed, since batches only carry the new ones.
+    size_t firstUploadedBatch = 0;
+    for (size_t b = 0; b < batches.size(); ++b) {
+      if (batches[b].replacesGeometry)
+        firstUploadedBatch = b;
+    }
+    for (size_t b = 0; b < firstUploadedBatch; ++b)
+      object.model.AddMaterials(batches[b].materials);
+
+    for (size_t b = firstUploadedBatch; b < batches.size(); ++b) {
+      const StreamingObjLoader::Batch& batch = batches[b];
+      object.model.AppendStreamedBatch(renderer, batch);
+      UpdateObjectScale(&object);
+
+      if (batch.isFinal) {
+        if (!batch.succeeded) {
+          std::cerr << "Error: could not load " << source.filename << std::endl;
+        }
+        source.isGeometryLoaded = true;
+      }
+    }
+
+    object.model.UploadDecodedTextures(renderer, /*waitForAll*/ false);
+  }
+}
+
+bool Scene::IsModelLoaded() const {
+  for (size_t i = 0; i < m_sources.size(); ++i) {
+    if (!m_sources[i]->isGeometryLoaded || m_objects[i]->model.HasPendingTextures())
+      return false;
+  }
+  return true;
+}
+
+// The bounds grow as more of the model is loaded, so this is redone with every batch.
+void Scene::UpdateObjectScale(Object* object) {
+  const ObjFileData::AxisAlignedBounds& bounds = object->model.GetBounds();
   float width = std::abs(bounds.max[0] - bounds.min[0]);
   float height = std::abs(bounds.max[1] - bounds.min[1]);
   float length = std::abs(bounds.max[2] - bounds.min[2]);
@@ -14,27 +103,51 @@ void Scene::Initialize(const std::string& objFilename, D3D12Renderer* renderer)
   // TODO: This syntax is weird, but I don't want to have to deal with windows headers right now.
   // Ideally, we'd just define NOMINMAX as a compiler flag.
   float maxDimension = (std::max)(width, (std::max)(height, length));
+  if (maxDimension > 0 && object->scale != 1 / maxDimension) {
+    object->scale = 1 / maxDimension;  // Scale such that the max dimension is of height 1.
+    object->MarkTransformChanged();
+  }
+}
+
+void Scene::SetLightDirection(const DirectX::XMFLOAT3& directionToLight) {
+  // The shadow map camera is only ever moved across the light direction after this (see FitShadowMapCameras), so
+  // where along it the camera starts out doesn't matter.
+  m_shadowMapCamera.position_ = DirectX::XMFLOAT4(directionToLight.x, directionToLight.y, directionToLight.z, 1.f);
+  m_shadowMapCamera.look_at_ = DirectX::XMFLOAT4(0, 0, 0, 1);
+  ++m_lightVersion;
+}
 
-  m_object.model = std::move(model);
-  m_object.position = DirectX::XMFLOAT4(0, 0, 0, 1);
-  m_object.rotationY = 0;
-  m_object.scale = 1 / maxDimension;  // Scale such that the max dimension is of height 1.
+void Scene::UpdateInstances() {
+  // The versions only ever go up, so their sum changes whenever any of them does.
+  uint64_t instancesVersion = m_instances.version;
+  for (const std::unique_ptr<Object>& object : m_objects)
+    instancesVersion += object->transformVersion + object->model.m_geometryVersion;
+  if (instancesVersion == m_instancesVersion)
+    return;
 
-  m_objectRotationAnimation = Animation::CreateAnimation(10000, /*repeat*/ true);
+  m_instances.Update(m_objects);
+  m_instancesVersion = instancesVersion;
+}
 
-  m_shadowMapCamera.position_ = DirectX::XMFLOAT4(-0.25, 1, 1, 1.f);
-  m_shadowMapCamera.look_at_ = DirectX::XMFLOAT4(0, 0, 0, 1);
-  m_shadowMapCamera.widthInWorldCoordinates = 1.5;
-  m_shadowMapCamera.heightInWorldCoordinates = 1.5;
+void Scene::FitShadowMapCameras(float aspectRatio, unsigned int shadowMapSize) {
+  const ObjFileData::AxisAlignedBounds& bounds = m_instances.sceneBounds;
+  DirectX::XMFLOAT3 corners[8];
+  for (size_t i = 0; i < 8; ++i) {
+    corners[i] = DirectX::XMFLOAT3((i & 1) ? bounds.max[0] : bounds.min[0], (i & 2) ? bounds.max[1] : bounds.min[1],
+                                   (i & 4) ? bounds.max[2] : bounds.min[2]);
+  }
 
-  m_camera.m_arcballCenter = DirectX::XMFLOAT4(0.f, 0.f, 0.f, 1.f);
-  m_camera.m_rotationXInDegrees = 0.f;
-  m_camera.m_rotationYInDegrees = 90.f;
-  m_camera.m_distance = 1.f;
+  const PinholeCamera camera = m_camera.GetPinholeCamera();
+  m_shadowMapCamera.FitToView(camera.GenerateViewPerspectiveTransform(aspectRatio), corners, shadowMapSize);
+
+  const uint64_t shadowCasterVersion = m_lightVersion + m_instancesVersion;
+  const bool haveCastersChanged = shadowCasterVersion != m_shadowCasterVersion;
+  m_shadowCasterVersion = shadowCasterVersion;
+  m_shadowCascades.FitToView(camera, aspectRatio, m_shadowMapCamera, corners, shadowMapSize, haveCastersChanged);
 }
 
 void Scene::TickAnimations() {
   // Disable the rotating animation for now so that it doesn't conflict with mouse movement.
   //double progress = Animation::TickAnimation(m_objectRotationAnimation);
-  //m_object.rotationY = progress * 2 * 3.14159265;
+  //m_objects[0]->rotationY = progress * 2 * 3.14159265;
 }
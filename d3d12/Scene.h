@@ -5,20 +5,76 @@
 #include "d3d12/DescriptorHeapManagers.h"
 #include "d3d12/ResourceGarbageCollector.h"
 #include "d3d12/Object.h"
+#include "d3d12/SceneInstances.h"
+#include "d3d12/StreamingObjLoader.h"
 
+#include <stddef.h>
+#include <stdint.h>
+
+#include <limits>
+#include <memory>
 #include <string>
+#include <vector>
 
 class D3D12Renderer;
 
 class Scene {
+  // Where each of m_objects is streamed in from.
+  struct ObjectSource {
+    std::string filename;
+    StreamingObjLoader loader;
+    bool isGeometryLoaded = false;
+  };
+  std::vector<std::unique_ptr<ObjectSource>> m_sources;
+
+  // Goes up with every call to SetLightDirection.
+  uint64_t m_lightVersion = 0;
+  // What the instances, and the objects' transforms and geometry, were at when m_instances was last updated. Starts
+  // out as something they'll never be.
+  uint64_t m_instancesVersion = std::numeric_limits<uint64_t>::max();
+  // What the light and m_instancesVersion were at when the shadow cascades were last fitted; anything else means that
+  // they have to be drawn again.
+  uint64_t m_shadowCasterVersion = std::numeric_limits<uint64_t>::max();
+
+  void UpdateObjectScale(Object* object);
+
 public:
-  std::string m_objFilename;
-  Object m_object;
+  // The scene's models, each fitted into a unit box around the origin by its own transform. They're shared by all of
+  // their instances, and only show up where m_instances places them.
+  std::vector<std::unique_ptr<Object>> m_objects;
+  SceneInstances m_instances;
   Animation m_objectRotationAnimation;
 
+  // Covers the whole view at once. Townscaper models are drawn with this one; everything else is drawn with the
+  // cascades, which take their light direction from it.
   OrthographicCamera m_shadowMapCamera;
+  ShadowCascades m_shadowCascades;
   ArcballCameraController m_camera;
 
-  void Initialize(const std::string& objFilename, D3D12Renderer* renderer);
+  // Returns right away; the models are loaded in the background, and show up as they're uploaded by
+  // UploadStreamedData. |numInstances| instances are laid out on a grid, going through the models in turn. With
+  // |printLoadStatistics|, what loading did to each model is printed (see ObjFileData::ParseOptions::printStatistics).
+  void Initialize(const std::vector<std::string>& objFilenames,
+                  size_t numInstances,
+                  bool printLoadStatistics,
+                  D3D12Renderer* renderer);
   void TickAnimations();
+
+  // Brings m_instances up to date with the objects. Called every frame, after UploadStreamedData.
+  void UpdateInstances();
+
+  // Points the shadow map camera (and so the cascades) along |directionToLight|, which doesn't have to be normalized.
+  // The light always has to be changed through this, so that the shadows are drawn again.
+  void SetLightDirection(const DirectX::XMFLOAT3& directionToLight);
+
+  // Fits the shadow map camera, and the cascades, to what the camera can see on a viewport with |aspectRatio|, for
+  // square shadow maps that are |shadowMapSize| texels across (see OrthographicCamera::FitToView). Called every frame;
+  // the cascades that have to be drawn again are marked as such (see ShadowCascades::isUpToDate).
+  void FitShadowMapCameras(float aspectRatio, unsigned int shadowMapSize);
+
+  // Uploads whatever has been loaded since the last call. Must be called while the renderer is drawing a frame.
+  void UploadStreamedData(D3D12Renderer* renderer);
+
+  // Whether all of the models, textures included, have been uploaded (or failed to load).
+  bool IsModelLoaded() const;
 };
@@ -0,0 +1,103 @@
+#include "d3d12/SceneInstances.h"
+
+#include <assert.h>
+
+#include <limits>
+
+size_t SceneInstances::Add(uint32_t objectIndex, const DirectX::XMFLOAT3& position, float rotationY, float scale) {
+  objectIndices.push_back(objectIndex);
+  positionsX.push_back(position.x);
+  positionsY.push_back(position.y);
+  positionsZ.push_back(position.z);
+  rotationsY.push_back(rotationY);
+  scales.push_back(scale);
+  MarkChanged();
+  return objectIndices.size() - 1;
+}
+
+void SceneInstances::SetTransform(size_t instance, const DirectX::XMFLOAT3& position, float rotationY, float scale) {
+  assert(instance < GetCount());
+  positionsX[instance] = position.x;
+  positionsY[instance] = position.y;
+  positionsZ[instance] = position.z;
+  rotationsY[instance] = rotationY;
+  scales[instance] = scale;
+  MarkChanged();
+}
+
+DirectX::XMMATRIX SceneInstances::GeneratePlacementTransform(size_t instance) const {
+  return DirectX::XMMatrixScaling(scales[instance], scales[instance], scales[instance]) *
+         DirectX::XMMatrixRotationY(rotationsY[instance]) *
+         DirectX::XMMatrixTranslation(positionsX[instance], positionsY[instance], positionsZ[instance]);
+}
+
+void SceneInstances::Update(const std::vector<std::unique_ptr<Object>>& objects) {
+  // The objects' own transforms are the same for all of their instances.
+  std::vector<DirectX::XMFLOAT4X4> modelTransforms(objects.size());
+  std::vector<DirectX::XMFLOAT4X4> vertexTransforms(objects.size());
+  for (size_t i = 0; i < objects.size(); ++i) {
+    DirectX::XMStoreFloat4x4(&modelTransforms[i], objects[i]->GenerateModelTransform());
+    DirectX::XMStoreFloat4x4(&vertexTransforms[i], objects[i]->GenerateVertexTransform());
+  }
+
+  const size_t count = GetCount();
+  drawTransforms.resize(count);
+  worldBounds.resize(count);
+  const DirectX::XMVECTOR infinity = DirectX::XMVectorReplicate(std::numeric_limits<float>::infinity());
+  DirectX::XMVECTOR sceneMin = infinity;
+  DirectX::XMVECTOR sceneMax = DirectX::XMVectorNegate(infinity);
+  for (size_t i = 0; i < count; ++i) {
+    const uint32_t objectIndex = objectIndices[i];
+    assert(objectIndex < objects.size());
+    const DirectX::XMMATRIX placement = GeneratePlacementTransform(i);
+    const DirectX::XMMATRIX modelTransform = DirectX::XMLoadFloat4x4(&modelTransforms[objectIndex]) * placement;
+
+    // Transposed, so that the columns become rows.
+    DirectX::XMFLOAT4X4 columns;
+    DrawTransforms& draw = drawTransforms[i];
+    DirectX::XMStoreFloat4x4(
+        &columns, DirectX::XMMatrixTranspose(DirectX::XMLoadFloat4x4(&vertexTransforms[objectIndex]) * placement));
+    for (size_t row = 0; row < 3; ++row)
+      draw.vertexTransform[row] = DirectX::XMFLOAT4(columns.m[row]);
+    DirectX::XMStoreFloat4x4(&columns, DirectX::XMMatrixTranspose(modelTransform));
+    for (size_t row = 0; row < 3; ++row)
+      draw.normalTransform[row] = DirectX::XMFLOAT3(columns.m[row]);
+
+    // The box around the corners of the model's bounds, once they've been placed.
+    const Model& model = objects[objectIndex]->model;
+    const ObjFileData::AxisAlignedBounds& bounds = model.GetBounds();
+    DirectX::XMVECTOR boundsMin = infinity;
+    DirectX::XMVECTOR boundsMax = DirectX::XMVectorNegate(infinity);
+    for (size_t c = 0; c < 8; ++c) {
+      const DirectX::XMVECTOR corner =
+          DirectX::XMVectorSet((c & 1) ? bounds.max[0] : bounds.min[0], (c & 2) ? bounds.max[1] : bounds.min[1],
+                               (c & 4) ? bounds.max[2] : bounds.min[2], 1.f);
+      const DirectX::XMVECTOR placedCorner = DirectX::XMVector3TransformCoord(corner, modelTransform);
+      boundsMin = DirectX::XMVectorMin(boundsMin, placedCorner);
+      boundsMax = DirectX::XMVectorMax(boundsMax, placedCorner);
+    }
+
+    DirectX::XMFLOAT3 placedMin;
+    DirectX::XMFLOAT3 placedMax;
+    DirectX::XMStoreFloat3(&placedMin, boundsMin);
+    DirectX::XMStoreFloat3(&placedMax, boundsMax);
+    worldBounds[i] = {{placedMax.x, placedMax.y, placedMax.z}, {placedMin.x, placedMin.y, placedMin.z}};
+
+    // Until its first batch has been streamed in, the model's bounds don't mean anything.
+    if (!model.m_meshParts.empty()) {
+      sceneMin = DirectX::XMVectorMin(sceneMin, boundsMin);
+      sceneMax = DirectX::XMVectorMax(sceneMax, boundsMax);
+    }
+  }
+
+  sceneBounds = {};
+  if (DirectX::XMVector3LessOrEqual(sceneMin, sceneMax)) {
+    DirectX::XMFLOAT3 placedMin;
+    DirectX::XMFLOAT3 placedMax;
+    DirectX::XMStoreFloat3(&placedMin, sceneMin);
+    DirectX::XMStoreFloat3(&placedMax, sceneMax);
+    sceneBounds = {{placedMax.x, placedMax.y, placedMax.z}, {placedMin.x, placedMin.y, placedMin.z}};
+  }
+
+  hierarchy.Build(worldBounds.data(), count);
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "d3d12/FrustumCulling.h"
+#include "d3d12/ObjFileLoader.h"
+#include "d3d12/Object.h"
+
+#include <DirectXMath.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <vector>
+
+// The placed copies of a scene's objects. The instances of an object all share its model (its buffers, textures and
+// levels of detail); each only has a transform of its own, which places the object in the world after the object's
+// own transform (see Object::GenerateModelTransform) has fitted it into a unit box around the origin.
+//
+// The instances are kept as a structure of arrays, one array per field, so that passes over all of them only touch the
+// fields they need. What they're drawn and culled with is worked out from the fields by Update.
+class SceneInstances {
+ public:
+  // What an instance is drawn with, as per-instance vertex data (see GraphicsPass::kInstanceInputSlot). Each row gives
+  // one of the world coordinates, i.e. the rows are the first three columns of the row-vector transforms.
+  struct DrawTransforms {
+    // For the positions as they're stored in the vertex buffer (see Object::GenerateVertexTransform).
+    DirectX::XMFLOAT4 vertexTransform[3];
+    // For the normals. Objects and instances are only ever scaled uniformly, so this is the upper 3x3 of the model
+    // transform, which is its own inverse transpose up to scale; the shaders normalize the normals afterwards.
+    DirectX::XMFLOAT3 normalTransform[3];
+  };
+
+  // One entry for each instance. They have to be changed through Add and SetTransform, or followed by a call to
+  // MarkChanged.
+  std::vector<uint32_t> objectIndices;  // Into Scene::m_objects.
+  std::vector<float> positionsX;
+  std::vector<float> positionsY;
+  std::vector<float> positionsZ;
+  std::vector<float> rotationsY;
+  std::vector<float> scales;
+
+  // Goes up with every change to the instances, so that whatever has been drawn with them can tell that it's stale.
+  uint64_t version = 0;
+  void MarkChanged() { ++version; }
+
+  // Worked out by Update, one entry for each instance.
+  std::vector<DrawTransforms> drawTransforms;
+  std::vector<ObjFileData::AxisAlignedBounds> worldBounds;
+  // Over worldBounds, with the instances numbered by their index.
+  FrustumCulling::BoundingVolumeHierarchy hierarchy;
+  // Around all of the instances whose objects have any geometry yet; all zeros if none of them do.
+  ObjFileData::AxisAlignedBounds sceneBounds = {};
+
+  size_t GetCount() const { return objectIndices.size(); }
+
+  // Returns the new instance's index.
+  size_t Add(uint32_t objectIndex, const DirectX::XMFLOAT3& position, float rotationY = 0.f, float scale = 1.f);
+  void SetTransform(size_t instance, const DirectX::XMFLOAT3& position, float rotationY, float scale);
+
+  // Applied after the object's model transform. Only ever scales uniformly, by scales[instance].
+  DirectX::XMMATRIX GeneratePlacementTransform(size_t instance) const;
+
+  // Has to be called whenever the instances, or their objects' transforms or geometry, change (see
+  // Scene::UpdateInstances).
+  void Update(const std::vector<std::unique_ptr<Object>>& objects);
+};
@@ -0,0 +1,184 @@
+#include "d3d12/StreamingObjLoader.h"
+
+#include "d3d12/MeshCache.h"
+
+#include <iostream>
+
+StreamingObjLoader::~StreamingObjLoader() {
+  m_isCancelled = true;
+  m_batches.Close();
+  if (m_thread.joinable())
+    m_thread.join();
+}
+
+void StreamingObjLoader::Start(const std::string& fileName,
+                               bool quantizeVertices,
+                               bool mergeMeshParts,
+                               bool printStatistics) {
+  m_quantizeVertices = quantizeVertices;
+  m_mergeMeshParts = mergeMeshParts;
+  m_printStatistics = printStatistics;
+  m_thread = std::thread(&StreamingObjLoader::Load, this, fileName);
+}
+
+bool StreamingObjLoader::TryGetNextBatch(Batch* batch) {
+  return m_batches.TryPop(batch);
+}
+
+bool StreamingObjLoader::WaitForNextBatch(Batch* batch) {
+  return m_batches.Pop(batch);
+}
+
+void StreamingObjLoader::Load(const std::string& fileName) {
+  if (LoadFromCache(fileName)) {
+    m_batches.Close();
+    return;
+  }
+
+  ObjFileData::ParseOptions options;
+  options.mergeMeshParts = m_mergeMeshParts;
+  options.printStatistics = m_printStatistics;
+  options.onProgress = [this](const ObjFileData::PartialData& data) { return SendBatch(data, /*isFinal*/ false); };
+
+  ObjFileData data;
+  if (!data.ParseObjFile(fileName, options)) {
+    Batch batch;
+    batch.isFinal = true;
+    batch.succeeded = false;
+    m_batches.Push(std::move(batch));
+    m_batches.Close();
+    return;
+  }
+
+  // The final batch is sent before the cache is written, since nothing is waiting on the cache. The mesh has been
+  // reordered since the other batches were sent, so it replaces all of their geometry. Its indices are packed once,
+  // for both the batch and the cache.
+  const IndexPacking::PackedIndices packedIndices = PackIndices(data);
+  ObjFileData::PartialData finalData = {data.m_vertices, data.m_indices, data.m_meshParts, data.m_materials,
+                                        data.m_bounds, data.m_lods, data.m_tangents};
+  SendBatch(finalData, /*isFinal*/ true, /*replacesGeometry*/ true, &packedIndices);
+  m_batches.Close();
+
+  // The cache is written even if the loader is being destroyed by now (the destructor waits for it): the consumer may
+  // well let go of the loader as soon as it has the final batch, and the whole file has been parsed anyway.
+  const std::filesystem::path cachePath = MeshCache::GetCachePath(fileName);
+  if (!MeshCache::Write(cachePath, fileName, data, packedIndices, m_mergeMeshParts)) {
+    std::cerr << "Warning: could not write mesh cache " << cachePath.string() << std::endl;
+  }
+}
+
+// Cached models are already fully processed, so they're sent as a single batch. Only the materials and the small
+// per-part tables are copied out of the cache; the geometry is uploaded straight from the mapping (see Batch::cache).
+bool StreamingObjLoader::LoadFromCache(const std::string& fileName) {
+  std::shared_ptr<MeshCache> cache = std::make_shared<MeshCache>();
+  if (!cache->Open(MeshCache::GetCachePath(fileName), fileName, m_mergeMeshParts))
+    return false;
+
+  Batch batch;
+  batch.materials = cache->GetMaterials();
+  batch.meshParts.assign(cache->GetMeshParts(), cache->GetMeshParts() + cache->GetNumMeshParts());
+  batch.lods.assign(cache->GetLods(), cache->GetLods() + cache->GetNumLods());
+  batch.packedIndices.draws.assign(cache->GetDraws(), cache->GetDraws() + cache->GetNumDraws());
+  batch.packedIndices.firstDraws.assign(cache->GetFirstDraws(), cache->GetFirstDraws() + cache->GetNumFirstDraws());
+  batch.bounds = cache->GetBounds();
+  batch.replacesGeometry = true;
+  batch.isFinal = true;
+  if (m_quantizeVertices)
+    QuantizeVertices(cache->GetVertices(), cache->GetNumVertices(), &batch);
+  batch.cache = std::move(cache);
+  m_batches.Push(std::move(batch));
+  return true;
+}
+
+bool StreamingObjLoader::SendBatch(const ObjFileData::PartialData& data,
+                                   bool isFinal,
+                                   bool replacesGeometry,
+                                   const IndexPacking::PackedIndices* packedIndices) {
+  if (m_isCancelled)
+    return false;
+
+  if (replacesGeometry) {
+    m_numVerticesSent = 0;
+    m_numIndicesSent = 0;
+  }
+
+  Batch batch;
+  batch.bounds = data.bounds;
+  if (isFinal && m_quantizeVertices) {
+    QuantizeVertices(data.vertices.data() + m_numVerticesSent, data.vertices.size() - m_numVerticesSent, &batch);
+  } else {
+    batch.vertices.assign(data.vertices.begin() + m_numVerticesSent, data.vertices.end());
+  }
+  batch.tangents = data.tangents;
+  if (packedIndices) {
+    batch.packedIndices = *packedIndices;
+  } else {
+    batch.indices.assign(data.indices.begin() + m_numIndicesSent, data.indices.end());
+  }
+  batch.materials.assign(data.materials.begin() + m_numMaterialsSent, data.materials.end());
+  batch.meshParts = data.meshParts;
+  batch.lods = data.lods;
+  batch.replacesGeometry = replacesGeometry;
+  batch.isFinal = isFinal;
+
+  m_numVerticesSent = data.vertices.size();
+  m_numIndicesSent = data.indices.size();
+  m_numMaterialsSent = data.materials.size();
+
+  // Pushing only fails once the consumer has gone away.
+  return m_batches.Push(std::move(batch));
+}
+
+StreamingObjLoader::Batch::BufferData StreamingObjLoader::Batch::GetVertexData() const {
+  if (!quantizedVertices.empty())
+    return {quantizedVertices.data(), quantizedVertices.size() * sizeof(VertexQuantization::QuantizedVertex)};
+  if (cache)
+    return {cache->GetVertices(), cache->GetNumVertices() * sizeof(ObjFileData::Vertex)};
+  return {vertices.data(), vertices.size() * sizeof(ObjFileData::Vertex)};
+}
+
+StreamingObjLoader::Batch::BufferData StreamingObjLoader::Batch::GetTangentData() const {
+  if (cache)
+    return {cache->GetTangents(), cache->GetNumTangents() * sizeof(ObjFileData::Tangent)};
+  return {tangents.data(), tangents.size() * sizeof(ObjFileData::Tangent)};
+}
+
+StreamingObjLoader::Batch::BufferData StreamingObjLoader::Batch::GetIndexData() const {
+  if (cache)
+    return {cache->GetPackedIndexPool(), cache->GetPackedIndexPoolSize() * sizeof(uint16_t)};
+  if (!packedIndices.firstDraws.empty())
+    return {packedIndices.pool.data(), packedIndices.pool.size() * sizeof(uint16_t)};
+  return {indices.data(), indices.size() * sizeof(uint32_t)};
+}
+
+void StreamingObjLoader::QuantizeVertices(const ObjFileData::Vertex* vertices,
+                                          size_t numVertices,
+                                          Batch* batch) const {
+  VertexQuantization::QuantizationError error;
+  batch->quantizedVertices = VertexQuantization::Quantize(vertices, numVertices, batch->bounds, &error);
+  if (!m_printStatistics)
+    return;
+
+  std::cout << "Quantized " << batch->quantizedVertices.size() << " vertices to "
+            << sizeof(VertexQuantization::QuantizedVertex) << " bytes each: position error " << error.maxPositionError
+            << " max, " << error.meanPositionError << " mean; normal error " << error.maxNormalErrorInDegrees
+            << " degrees max; texture coordinate error " << error.maxTexCoordError << " max" << std::endl;
+}
+
+IndexPacking::PackedIndices StreamingObjLoader::PackIndices(const ObjFileData& data) const {
+  IndexPacking::PackedIndices packedIndices = IndexPacking::Pack(
+      data.m_indices.data(), data.m_meshParts.data(), data.m_meshParts.size(), data.m_lods.data(), data.m_lods.size());
+  if (!m_printStatistics)
+    return packedIndices;
+
+  size_t numShortIndexDraws = 0;
+  for (const IndexPacking::Draw& draw : packedIndices.draws)
+    numShortIndexDraws += (draw.indexSize == 2) ? 1 : 0;
+
+  std::cout << "Packed indices into " << numShortIndexDraws << " 16-bit and "
+            << packedIndices.draws.size() - numShortIndexDraws << " 32-bit draws for " << data.m_meshParts.size()
+            << " mesh parts and " << data.m_lods.size() << " levels of detail: "
+            << data.m_indices.size() * sizeof(uint32_t) << " -> " << packedIndices.pool.size() * sizeof(uint16_t)
+            << " bytes" << std::endl;
+  return packedIndices;
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "d3d12/IndexPacking.h"
+#include "d3d12/ObjFileLoader.h"
+#include "d3d12/VertexQuantization.h"
+#include "utils/BlockingQueue.h"
+
+class MeshCache;
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Loads an obj file on a background thread, handing the geometry over in batches as soon as each part of the file has
+// been parsed, so that the model can be displayed (and filled in) long before the whole file has been loaded.
+//
+// The loader has no dependencies on the renderer: the consumer polls for batches (e.g. once per frame) and decides
+// what to do with them.
+class StreamingObjLoader {
+ public:
+  struct Batch {
+    // Only the data that is new since the previous batch. The vertex indices are relative to the start of the model,
+    // not to the start of the batch.
+    std::vector<ObjFileData::Vertex> vertices;
+    std::vector<uint32_t> indices;
+
+    // When the loader quantizes vertices, the final batch has these instead of |vertices|, relative to |bounds|. It
+    // always holds all of the geometry, since the bounds aren't known until everything has been parsed.
+    std::vector<VertexQuantization::QuantizedVertex> quantizedVertices;
+
+    // The vertices' tangents, for models that have normal maps. They're only generated once the whole file has been
+    // parsed, so only the final batch has any; and they're never quantized.
+    std::vector<ObjFileData::Tangent> tangents;
+
+    // Likewise, the final batch has its indices packed into 16 bits where possible, instead of in |indices|. The mesh
+    // parts' index ranges then refer to the unpacked indices; they're drawn with |packedIndices.draws| instead.
+    IndexPacking::PackedIndices packedIndices;
+
+    std::vector<ObjFileData::Material> materials;
+
+    // All of the mesh parts so far, since the last part of the previous batch may have grown.
+    std::vector<ObjFileData::MeshPart> meshParts;
+    // The mesh parts' levels of detail. They're only built once the whole file has been parsed, so only the final
+    // batch has any.
+    std::vector<ObjFileData::MeshLod> lods;
+    ObjFileData::AxisAlignedBounds bounds = {};
+
+    // Set when the vertices and indices replace all of those sent before, rather than adding to them; e.g. once the
+    // mesh has been reordered after parsing.
+    bool replacesGeometry = false;
+
+    // Batches that are read from the mesh cache keep it mapped, and leave the unquantized vertices, the tangents and
+    // the packed indices' pool in it rather than copying them into the vectors above. GetVertexData and friends find
+    // the data wherever it is.
+    std::shared_ptr<const MeshCache> cache;
+
+    struct BufferData {
+      const void* data;
+      size_t size;  // In bytes.
+    };
+    // The quantized vertices if there are any, the vertices otherwise.
+    BufferData GetVertexData() const;
+    BufferData GetTangentData() const;
+    // The packed indices' pool if there is one, the unpacked indices otherwise.
+    BufferData GetIndexData() const;
+
+    // The final batch is always sent, even if loading failed.
+    bool isFinal = false;
+    bool succeeded = true;
+  };
+
+ private:
+  BlockingQueue<Batch> m_batches;
+  std::atomic<bool> m_isCancelled = false;
+  std::thread m_thread;
+  bool m_quantizeVertices = false;
+  bool m_mergeMeshParts = true;
+  bool m_printStatistics = false;
+
+  // Everything that has already been sent, so that only the difference has to be sent with the next batch.
+  size_t m_numVerticesSent = 0;
+  size_t m_numIndicesSent = 0;
+  size_t m_numMaterialsSent = 0;
+
+  void Load(const std::string& fileName);
+  bool LoadFromCache(const std::string& fileName);
+  // The final batch is sent with its indices already packed.
+  bool SendBatch(const ObjFileData::PartialData& data,
+                 bool isFinal,
+                 bool replacesGeometry = false,
+                 const IndexPacking::PackedIndices* packedIndices = nullptr);
+  void QuantizeVertices(const ObjFileData::Vertex* vertices, size_t numVertices, Batch* batch) const;
+  IndexPacking::PackedIndices PackIndices(const ObjFileData& data) const;
+
+ public:
+  StreamingObjLoader() = default;
+  ~StreamingObjLoader();
+
+  StreamingObjLoader(const StreamingObjLoader&) = delete;
+  StreamingObjLoader& operator=(const StreamingObjLoader&) = delete;
+
+  // With |quantizeVertices|, the final batch is packed (see VertexQuantization). The batches before it aren't, since
+  // they're only there to show something while the rest is loading. |mergeMeshParts| is passed on to the parser (see
+  // ObjFileData::ParseOptions). With |printStatistics|, what the parser and the packing did to the model is printed.
+  void Start(const std::string& fileName,
+             bool quantizeVertices = false,
+             bool mergeMeshParts = true,
+             bool printStatistics = false);
+
+  // Never blocks. Returns false if no batch is available right now, or if the final batch has already been returned.
+  bool TryGetNextBatch(Batch* batch);
+
+  // Blocks until the next batch is available. Returns false once the final batch has already been returned.
+  bool WaitForNextBatch(Batch* batch);
+};
@@ -0,0 +1,216 @@
+#include "d3d12/TangentGenerator.h"
+
+#include "utils/ThreadPool.h"
+
+#include <math.h>
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+namespace TangentGenerator {
+
+namespace {
+// The mesh parts are split into chunks of this many triangles, and the vertices into chunks of this many vertices, so
+// that a model that's all one part still gets done in parallel.
+constexpr size_t kItemsPerChunk = 16 * 1024;
+
+constexpr uint32_t kNoVertex = std::numeric_limits<uint32_t>::max();
+
+struct Corner {
+  // The triangle's tangent, projected onto the plane of the corner's normal and weighted by the corner's angle.
+  float tangent[3];
+  // Zero if the triangle has no tangent, i.e. if it's degenerate in texture space.
+  float handedness;
+};
+
+// The corners of a vertex that have the same handedness.
+struct Sum {
+  float tangent[3];
+  bool isUsed;
+};
+
+float Dot(const float a[3], const float b[3]) {
+  return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+// Returns the vector's length.
+float Normalize(float vector[3]) {
+  const float length = sqrtf(Dot(vector, vector));
+  if (length > 0.f) {
+    for (size_t i = 0; i < 3; ++i)
+      vector[i] /= length;
+  }
+  return length;
+}
+
+// Removes the part of |vector| along |normal|, which is of unit length (or zero).
+void ProjectOntoPlane(const float normal[3], float vector[3]) {
+  const float d = Dot(normal, vector);
+  for (size_t i = 0; i < 3; ++i)
+    vector[i] -= normal[i] * d;
+}
+
+void ComputeCorners(const ObjFileData::Vertex* vertices, const uint32_t* triangle, /*out*/ Corner corners[3]) {
+  const ObjFileData::Vertex* v[3] = {&vertices[triangle[0]], &vertices[triangle[1]], &vertices[triangle[2]]};
+  const float s1 = v[1]->texCoord[0] - v[0]->texCoord[0];
+  const float t1 = v[1]->texCoord[1] - v[0]->texCoord[1];
+  const float s2 = v[2]->texCoord[0] - v[0]->texCoord[0];
+  const float t2 = v[2]->texCoord[1] - v[0]->texCoord[1];
+  const float signedArea = s1 * t2 - s2 * t1;
+
+  // The direction of increasing u is (e1 * t2 - e2 * t1) / signedArea, for the triangle's edges e1 and e2 from v0.
+  float tangent[3];
+  for (size_t i = 0; i < 3; ++i) {
+    const float e1 = v[1]->pos[i] - v[0]->pos[i];
+    const float e2 = v[2]->pos[i] - v[0]->pos[i];
+    tangent[i] = (signedArea < 0.f) ? e2 * t1 - e1 * t2 : e1 * t2 - e2 * t1;
+  }
+
+  const float handedness = (signedArea < 0.f) ? -1.f : 1.f;
+  const bool hasTangent = signedArea != 0.f && Normalize(tangent) > 0.f;
+  for (size_t c = 0; c < 3; ++c) {
+    Corner& corner = corners[c];
+    corner = Corner{};
+    if (!hasTangent)
+      continue;
+    corner.handedness = handedness;
+
+    // Both the tangent and the corner's edges are taken in the plane of the vertex's normal, as MikkTSpace does.
+    const float* normal = v[c]->normal;
+    float projected[3] = {tangent[0], tangent[1], tangent[2]};
+    ProjectOntoPlane(normal, projected);
+    if (!(Normalize(projected) > 0.f))
+      continue;
+
+    float toNext[3];
+    float toPrevious[3];
+    for (size_t i = 0; i < 3; ++i) {
+      toNext[i] = v[(c + 1) % 3]->pos[i] - v[c]->pos[i];
+      toPrevious[i] = v[(c + 2) % 3]->pos[i] - v[c]->pos[i];
+    }
+    ProjectOntoPlane(normal, toNext);
+    ProjectOntoPlane(normal, toPrevious);
+    const float lengths = sqrtf(Dot(toNext, toNext) * Dot(toPrevious, toPrevious));
+    if (!(lengths > 0.f))
+      continue;
+
+    const float angle = acosf(std::clamp(Dot(toNext, toPrevious) / lengths, -1.f, 1.f));
+    for (size_t i = 0; i < 3; ++i)
+      corner.tangent[i] = projected[i] * angle;
+  }
+}
+
+// Vertices that no triangle gives a tangent (e.g. where the texture coordinates are all the same) get an arbitrary one,
+// so that there's still a valid basis to transform by.
+void FinishTangent(const float normal[3], const Sum& sum, float handedness, /*out*/ ObjFileData::Tangent* tangent) {
+  float direction[3] = {sum.tangent[0], sum.tangent[1], sum.tangent[2]};
+  ProjectOntoPlane(normal, direction);
+  if (!(Normalize(direction) > 0.f)) {
+    // The axis that's furthest from the normal.
+    size_t axis = 0;
+    for (size_t i = 1; i < 3; ++i) {
+      if (fabsf(normal[i]) < fabsf(normal[axis]))
+        axis = i;
+    }
+    direction[0] = direction[1] = direction[2] = 0.f;
+    direction[axis] = 1.f;
+    ProjectOntoPlane(normal, direction);
+    Normalize(direction);
+  }
+
+  for (size_t i = 0; i < 3; ++i)
+    tangent->tangent[i] = direction[i];
+  tangent->handedness = handedness;
+}
+}  // namespace
+
+size_t Generate(ObjFileData* data) {
+  std::vector<ObjFileData::Vertex>& vertices = data->m_vertices;
+  std::vector<uint32_t>& indices = data->m_indices;
+  const std::vector<ObjFileData::MeshPart>& meshParts = data->m_meshParts;
+  ThreadPool& threadPool = ThreadPool::GetShared();
+
+  struct Chunk {
+    uint32_t indexStart;
+    uint32_t numIndices;
+  };
+  std::vector<Chunk> chunks;
+  for (const ObjFileData::MeshPart& meshPart : meshParts) {
+    for (uint32_t offset = 0; offset < meshPart.numIndices; offset += 3 * kItemsPerChunk) {
+      const uint32_t numIndices = std::min<uint32_t>(3 * kItemsPerChunk, meshPart.numIndices - offset);
+      chunks.push_back({meshPart.indexStart + offset, numIndices});
+    }
+  }
+
+  std::vector<Corner> corners(indices.size());
+  threadPool.ParallelFor(chunks.size(), [&](size_t c) {
+    const uint32_t end = chunks[c].indexStart + chunks[c].numIndices;
+    for (uint32_t i = chunks[c].indexStart; i + 3 <= end; i += 3)
+      ComputeCorners(vertices.data(), &indices[i], &corners[i]);
+  });
+
+  // Parts can share vertices, so the corners are summed up serially; it's only a few additions each. Each vertex has
+  // a sum for either handedness: [2 * vertex] for the right-handed corners and [2 * vertex + 1] for the mirrored ones.
+  const size_t numVertices = vertices.size();
+  std::vector<Sum> sums(2 * numVertices);
+  for (const ObjFileData::MeshPart& meshPart : meshParts) {
+    for (uint32_t i = meshPart.indexStart; i < meshPart.indexStart + meshPart.numIndices; ++i) {
+      const Corner& corner = corners[i];
+      if (corner.handedness == 0.f)
+        continue;
+
+      Sum& sum = sums[2 * indices[i] + (corner.handedness < 0.f ? 1 : 0)];
+      sum.isUsed = true;
+      for (size_t axis = 0; axis < 3; ++axis)
+        sum.tangent[axis] += corner.tangent[axis];
+    }
+  }
+
+  // The vertices that have corners of both handednesses get a copy for the mirrored ones.
+  std::vector<uint32_t> mirroredVertices(numVertices, kNoVertex);
+  size_t numSplitVertices = 0;
+  for (size_t v = 0; v < numVertices; ++v) {
+    if (sums[2 * v].isUsed && sums[2 * v + 1].isUsed)
+      mirroredVertices[v] = static_cast<uint32_t>(numVertices + numSplitVertices++);
+  }
+
+  if (numSplitVertices > 0) {
+    vertices.resize(numVertices + numSplitVertices);
+    for (size_t v = 0; v < numVertices; ++v) {
+      if (mirroredVertices[v] != kNoVertex)
+        vertices[mirroredVertices[v]] = vertices[v];
+    }
+
+    for (const ObjFileData::MeshPart& meshPart : meshParts) {
+      for (uint32_t i = meshPart.indexStart; i < meshPart.indexStart + meshPart.numIndices; ++i) {
+        if (corners[i].handedness < 0.f && mirroredVertices[indices[i]] != kNoVertex)
+          indices[i] = mirroredVertices[indices[i]];
+      }
+    }
+  }
+
+  std::vector<ObjFileData::Tangent>& tangents = data->m_tangents;
+  tangents.resize(vertices.size());
+  const size_t numVertexChunks = (numVertices + kItemsPerChunk - 1) / kItemsPerChunk;
+  threadPool.ParallelFor(numVertexChunks, [&](size_t chunk) {
+    const size_t end = std::min((chunk + 1) * kItemsPerChunk, numVertices);
+    for (size_t v = chunk * kItemsPerChunk; v < end; ++v) {
+      const float* normal = vertices[v].normal;
+      const Sum& rightHanded = sums[2 * v];
+      const Sum& mirrored = sums[2 * v + 1];
+      if (mirroredVertices[v] != kNoVertex) {
+        FinishTangent(normal, rightHanded, 1.f, &tangents[v]);
+        FinishTangent(normal, mirrored, -1.f, &tangents[mirroredVertices[v]]);
+      } else if (mirrored.isUsed) {
+        FinishTangent(normal, mirrored, -1.f, &tangents[v]);
+      } else {
+        FinishTangent(normal, rightHanded, 1.f, &tangents[v]);
+      }
+    }
+  });
+
+  return numSplitVertices;
+}
+
+}  // namespace TangentGenerator
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "d3d12/ObjFileLoader.h"
+
+#include <stddef.h>
+
+// Generates per-vertex tangents for normal mapping, following the same construction as MikkTSpace, so that normal maps
+// baked by the usual tools come out right.
+//
+// Each triangle's tangent comes from how its texture coordinates change across it. At each corner, that's projected
+// onto the plane of the vertex's normal, and the corners of a vertex are averaged, weighted by their angle there. The
+// handedness is the sign of the triangle's area in texture space, so where a texture is mirrored (as is common for the
+// two halves of a symmetric model), the vertices along the mirror line are shared by triangles of both handednesses;
+// those vertices are split in two, as MikkTSpace does, instead of averaging two tangents that point opposite ways.
+namespace TangentGenerator {
+
+// Sets the data's tangents, for the triangles of all of its mesh parts, which are done in parallel on the shared thread
+// pool. Has to come before the levels of detail are built, since split vertices are renumbered in the parts' indices
+// only. Returns the number of vertices that were split (and appended to the vertices).
+size_t Generate(ObjFileData* data);
+
+}  // namespace TangentGenerator
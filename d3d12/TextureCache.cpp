@@ -0,0 +1,132 @@
+#include "d3d12/TextureCache.h"
+
+#include "utils/Checksum.h"
+#include "utils/MappedFile.h"
+#include "utils/MipGeneration.h"
+
+#include <string.h>
+
+#include <atomic>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <system_error>
+#include <thread>
+
+namespace {
+constexpr char kMagic[8] = {'M', 'V', 'W', 'T', 'E', 'X', '\0', '\0'};
+
+// Bump this whenever the layout of the cache changes, or the encoders change enough that old caches should be rebuilt.
+constexpr uint32_t kVersion = 2;
+
+// D3D12's limit for 2D textures; anything larger can only be a corrupt header.
+constexpr uint64_t kMaxDimension = 16384;
+
+struct Header {
+  char magic[8];
+  uint32_t version;
+  ImageFormat format;
+
+  uint64_t width;
+  uint64_t height;
+  uint64_t numMips;
+  uint64_t dataSize;  // The image data, all mips included, immediately follows the header.
+  uint64_t checksum;  // Of the image data.
+};
+
+// Unique to this write, so that loaders compressing the same texture at the same time each write a file of their own,
+// and the last one to finish replaces the others' caches whole.
+std::filesystem::path GetTempPath(const std::filesystem::path& cachePath) {
+  static std::atomic<uint64_t> s_numWrites = 0;
+  std::filesystem::path tempPath = cachePath;
+  tempPath += "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + "." +
+              std::to_string(s_numWrites++) + ".tmp";
+  return tempPath;
+}
+}  // namespace
+
+/*static*/
+std::filesystem::path TextureCache::GetCachePath(const std::filesystem::path& imageFilePath) {
+  std::filesystem::path cachePath = imageFilePath;
+  cachePath += ".texcache";
+  return cachePath;
+}
+
+/*static*/
+bool TextureCache::Write(const std::filesystem::path& cachePath, const Image& image) {
+  Header header = {};
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.format = image.format;
+  header.width = image.width;
+  header.height = image.height;
+  header.numMips = image.numMips;
+  header.dataSize = image.data.size();
+  header.checksum = ComputeChecksum(image.data.data(), image.data.size());
+
+  // Write to a temporary file first, so that a crash halfway through can never leave a cache behind that looks valid.
+  const std::filesystem::path tempPath = GetTempPath(cachePath);
+  bool isWritten;
+  {
+    std::ofstream file(tempPath, std::ios::out | std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(image.data.data()), image.data.size());
+    isWritten = static_cast<bool>(file);
+  }
+
+  std::error_code error;
+  if (isWritten)
+    std::filesystem::rename(tempPath, cachePath, error);
+  if (!isWritten || error) {
+    std::filesystem::remove(tempPath, error);
+    return false;
+  }
+  return true;
+}
+
+/*static*/
+bool TextureCache::Read(const std::filesystem::path& cachePath,
+                        const std::filesystem::path& imageFilePath,
+                        Image* image) {
+  std::error_code error;
+  const std::filesystem::file_time_type cacheTime = std::filesystem::last_write_time(cachePath, error);
+  if (error)
+    return false;
+
+  const std::filesystem::file_time_type imageTime = std::filesystem::last_write_time(imageFilePath, error);
+  if (error || imageTime > cacheTime)
+    return false;
+
+  MappedFile file;
+  if (!file.Open(cachePath.string()) || file.GetSize() < sizeof(Header))
+    return false;
+
+  Header header;
+  memcpy(&header, file.GetData(), sizeof(header));
+  if (memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion)
+    return false;
+
+  if (header.format > ImageFormat::BC7 || header.width > kMaxDimension || header.height > kMaxDimension ||
+      header.numMips == 0 || header.numMips > MipGeneration::GetNumMips(header.width, header.height))
+    return false;
+
+  Image cachedImage;
+  cachedImage.format = header.format;
+  cachedImage.width = header.width;
+  cachedImage.height = header.height;
+  cachedImage.numMips = header.numMips;
+  if (header.dataSize != file.GetSize() - sizeof(Header) ||
+      header.dataSize != cachedImage.GetMipOffset(cachedImage.numMips))
+    return false;
+
+  const unsigned char* data = reinterpret_cast<const unsigned char*>(file.GetData()) + sizeof(Header);
+  if (ComputeChecksum(data, header.dataSize) != header.checksum) {
+    std::cerr << "Warning: texture cache " << cachePath.string() << " is corrupt." << std::endl;
+    return false;
+  }
+
+  cachedImage.data.assign(data, data + header.dataSize);
+  *image = std::move(cachedImage);
+  return true;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "d3d12/ImageLoader.h"
+
+#include <filesystem>
+
+// A baked copy of a texture, stored next to the image file so that later loads can skip both decoding and block
+// compression. The image data is stored exactly as it gets uploaded.
+class TextureCache {
+ public:
+  // E.g. "textures/brick.png" -> "textures/brick.png.texcache".
+  static std::filesystem::path GetCachePath(const std::filesystem::path& imageFilePath);
+
+  static bool Write(const std::filesystem::path& cachePath, const Image& image);
+
+  // Fails if the cache doesn't exist, is corrupt, was written by a different version of the format, or is older than
+  // the image file.
+  static bool Read(const std::filesystem::path& cachePath, const std::filesystem::path& imageFilePath, Image* image);
+};
@@ -0,0 +1,135 @@
+#include "d3d12/TextureLoader.h"
+
+#include "d3d12/TextureCache.h"
+#include "utils/BlockCompression.h"
+#include "utils/MipGeneration.h"
+#include "utils/ThreadPool.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+#include <chrono>
+#include <iostream>
+
+namespace {
+#ifdef _WIN32
+// The WIC fallback decoder requires COM to be initialized on the thread that does the decoding. The pool threads keep
+// it initialized for as long as they're alive, rather than paying for it on every decode.
+struct ScopedComInitialization {
+  HRESULT hr = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+
+  ~ScopedComInitialization() {
+    if (SUCCEEDED(hr))
+      CoUninitialize();
+  }
+};
+#endif
+
+// The mips are generated on the CPU, rather than on the GPU after uploading, so that they can be block-compressed and
+// cached along with mip 0.
+void GenerateMips(Image* image) {
+  std::vector<unsigned char> mips = MipGeneration::GenerateMips(MipGeneration::Filter::Kaiser, image->data.data(),
+                                                                image->width, image->height, image->GetRowPitch());
+  image->data.insert(image->data.end(), mips.begin(), mips.end());
+  image->numMips = MipGeneration::GetNumMips(image->width, image->height);
+}
+
+// Opaque images go to BC1. Images with alpha go to BC7, unless the alpha is just on/off (e.g. foliage cutouts): BC7's
+// mode 6 interpolates alpha with the same indices as the colors, while BC3 gives alpha its own indices and so keeps
+// those edges sharp. Only mip 0 is looked at, as filtering blurs those edges in the lower mips.
+BlockCompression::Format ChooseBlockFormat(const Image& image) {
+  bool isOpaque = true;
+  bool hasPartialAlpha = false;
+  const size_t mip0Size = image.GetMipOffset(1);
+  for (size_t i = 3; i < mip0Size; i += 4) {
+    const unsigned char alpha = image.data[i];
+    isOpaque &= (alpha == 255);
+    hasPartialAlpha |= (alpha != 0 && alpha != 255);
+  }
+
+  if (isOpaque)
+    return BlockCompression::Format::BC1;
+  return hasPartialAlpha ? BlockCompression::Format::BC7 : BlockCompression::Format::BC3;
+}
+
+// D3D12 only allows block-compressed textures whose size is a multiple of the block size, so other images are left
+// uncompressed. That only applies to mip 0, though: the lower mips are padded out to whole blocks.
+void CompressImage(Image* image) {
+  if (image->width % 4 != 0 || image->height % 4 != 0)
+    return;
+
+  const BlockCompression::Format blockFormat = ChooseBlockFormat(*image);
+  std::vector<unsigned char> blocks;
+  for (size_t mip = 0; mip < image->numMips; ++mip) {
+    const std::vector<unsigned char> mipBlocks = BlockCompression::CompressImage(
+        blockFormat, image->data.data() + image->GetMipOffset(mip), MipGeneration::GetMipSize(image->width, mip),
+        MipGeneration::GetMipSize(image->height, mip), image->GetRowPitch(mip));
+    blocks.insert(blocks.end(), mipBlocks.begin(), mipBlocks.end());
+  }
+
+  image->data = std::move(blocks);
+  switch (blockFormat) {
+    case BlockCompression::Format::BC1:
+      image->format = ImageFormat::BC1;
+      break;
+    case BlockCompression::Format::BC3:
+      image->format = ImageFormat::BC3;
+      break;
+    case BlockCompression::Format::BC7:
+      image->format = ImageFormat::BC7;
+      break;
+  }
+}
+
+// Mips are generated and images block-compressed once, and then baked into a cache file that later loads use instead.
+std::unique_ptr<Image> DecodeImage(const std::filesystem::path& file) {
+#ifdef _WIN32
+  thread_local ScopedComInitialization comInitialization;
+#endif
+
+  std::unique_ptr<Image> image = std::make_unique<Image>();
+  const std::filesystem::path cachePath = TextureCache::GetCachePath(file);
+  if (TextureCache::Read(cachePath, file, image.get()))
+    return image;
+
+  if (!Image::LoadImageFile(file, image.get())) {
+    std::cerr << "Warning: could not decode image " << file.string() << std::endl;
+    return nullptr;
+  }
+
+  GenerateMips(image.get());
+  CompressImage(image.get());
+  if (!TextureCache::Write(cachePath, *image))
+    std::cerr << "Warning: could not write texture cache " << cachePath.string() << std::endl;
+
+  return image;
+}
+}  // namespace
+
+TextureLoader::TextureId TextureLoader::Request(const std::filesystem::path& file) {
+  // Materials in different mtl files can refer to the same texture through different relative paths.
+  const std::filesystem::path normalizedFile = file.lexically_normal();
+
+  auto it = m_idsByFile.find(normalizedFile.native());
+  if (it != m_idsByFile.end())
+    return it->second;
+
+  const TextureId id = m_images.size();
+  m_images.push_back(ThreadPool::GetShared().Submit([normalizedFile]() { return DecodeImage(normalizedFile); }));
+  m_idsByFile.emplace(normalizedFile.native(), id);
+  return id;
+}
+
+bool TextureLoader::IsDecoded(TextureId id) const {
+  const std::future<std::unique_ptr<Image>>& image = m_images[id];
+  return !image.valid() || image.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+std::unique_ptr<Image> TextureLoader::TakeImage(TextureId id) {
+  std::future<std::unique_ptr<Image>>& image = m_images[id];
+  if (!image.valid())
+    return nullptr;
+
+  return image.get();
+}
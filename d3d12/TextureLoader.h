@@ -0,0 +1,36 @@
+#pragma once
+
+#include "d3d12/ImageLoader.h"
+
+#include <filesystem>
+#include <future>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// Decodes image files on the shared thread pool, so that all of a model's textures are decoded in parallel (and while
+// the rest of the model is still being loaded), rather than one at a time on the render thread.
+//
+// Decoded images are block-compressed (when their size allows it) and baked into a TextureCache, so later runs load
+// the compressed data directly.
+//
+// Each file is only decoded once, no matter how many materials request it; requesting the same file again returns
+// the same id. Not thread-safe: all calls are expected to come from the same thread.
+class TextureLoader {
+ public:
+  using TextureId = size_t;
+
+ private:
+  std::vector<std::future<std::unique_ptr<Image>>> m_images;
+  std::unordered_map<std::filesystem::path::string_type, TextureId> m_idsByFile;
+
+ public:
+  TextureId Request(const std::filesystem::path& file);
+
+  // Never blocks.
+  bool IsDecoded(TextureId id) const;
+
+  // Blocks until the image has been decoded, and hands it over to the caller; the loader doesn't keep a copy. Returns
+  // nullptr if the image could not be decoded, or if it has already been taken.
+  std::unique_ptr<Image> TakeImage(TextureId id);
+};
@@ -97,40 +97,70 @@ void DepthStencilTexture::InitializeWithSRV(ID3D12Device* device,
                                             DXGI_FORMAT format,
                                             unsigned int width,
                                             unsigned int height) {
-  m_dsvDescriptor = dsvDescriptorDestination;
+  InitializeArrayWithSRV(device, {dsvDescriptorDestination}, srvDescriptorDestination, format, width, height);
+}
+
+void DepthStencilTexture::InitializeArrayWithSRV(ID3D12Device* device,
+                                                 const std::vector<DescriptorAllocation>& dsvDescriptorDestinations,
+                                                 const DescriptorAllocation& srvDescriptorDestination,
+                                                 DXGI_FORMAT format,
+                                                 unsigned int width,
+                                                 unsigned int height) {
+  assert(!dsvDescriptorDestinations.empty());
+  m_dsvDescriptors = dsvDescriptorDestinations;
   m_srvDescriptor = srvDescriptorDestination;
   m_width = width;
   m_height = height;
   m_format = format;
+  const UINT16 arraySize = static_cast<UINT16>(m_dsvDescriptors.size());
 
   D3D12_HEAP_PROPERTIES heapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
   DXGI_FORMAT depthBufferFormat =
       (srvDescriptorDestination.cpuStart.ptr == 0) ? format : ConvertDSVFormatToTypeless(format);
   D3D12_RESOURCE_DESC depthBufferDesc = CD3DX12_RESOURCE_DESC::Tex2D(
-    depthBufferFormat, width, height, /*arraySize*/ 1, /*mipLevels*/ 1, /*sampleCount*/ 1,
+    depthBufferFormat, width, height, arraySize, /*mipLevels*/ 1, /*sampleCount*/ 1,
       /*sampleQuality*/ 0, D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL);
   D3D12_CLEAR_VALUE clearValue = CD3DX12_CLEAR_VALUE(format, 1.0f, 0);
   HR(device->CreateCommittedResource(&heapProperties, D3D12_HEAP_FLAG_NONE, &depthBufferDesc,
                                      D3D12_RESOURCE_STATE_DEPTH_WRITE, &clearValue, IID_PPV_ARGS(&m_resource)));
 
-  D3D12_DEPTH_STENCIL_VIEW_DESC dsvDesc;
-  dsvDesc.Format = format;
-  dsvDesc.Flags = D3D12_DSV_FLAG_NONE;
-  dsvDesc.ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2D;
-  dsvDesc.Texture2D.MipSlice = 0;
-  device->CreateDepthStencilView(m_resource.Get(), &dsvDesc, dsvDescriptorDestination.cpuStart);
+  for (UINT16 slice = 0; slice < arraySize; ++slice) {
+    D3D12_DEPTH_STENCIL_VIEW_DESC dsvDesc;
+    dsvDesc.Format = format;
+    dsvDesc.Flags = D3D12_DSV_FLAG_NONE;
+    if (arraySize == 1) {
+      dsvDesc.ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2D;
+      dsvDesc.Texture2D.MipSlice = 0;
+    } else {
+      dsvDesc.ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2DARRAY;
+      dsvDesc.Texture2DArray.MipSlice = 0;
+      dsvDesc.Texture2DArray.FirstArraySlice = slice;
+      dsvDesc.Texture2DArray.ArraySize = 1;
+    }
+    device->CreateDepthStencilView(m_resource.Get(), &dsvDesc, m_dsvDescriptors[slice].cpuStart);
+  }
 
   if (srvDescriptorDestination.cpuStart.ptr != 0) {
     DXGI_FORMAT srvFormat = ConvertDSVFormatToSRV(format);
 
     D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc;
     srvDesc.Format = srvFormat;
-    srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
     srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-    srvDesc.Texture2D.MipLevels = 1;
-    srvDesc.Texture2D.MostDetailedMip = 0;
-    srvDesc.Texture2D.PlaneSlice = 0;
-    srvDesc.Texture2D.ResourceMinLODClamp = 0;
+    if (arraySize == 1) {
+      srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+      srvDesc.Texture2D.MipLevels = 1;
+      srvDesc.Texture2D.MostDetailedMip = 0;
+      srvDesc.Texture2D.PlaneSlice = 0;
+      srvDesc.Texture2D.ResourceMinLODClamp = 0;
+    } else {
+      srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2DARRAY;
+      srvDesc.Texture2DArray.MipLevels = 1;
+      srvDesc.Texture2DArray.MostDetailedMip = 0;
+      srvDesc.Texture2DArray.FirstArraySlice = 0;
+      srvDesc.Texture2DArray.ArraySize = arraySize;
+      srvDesc.Texture2DArray.PlaneSlice = 0;
+      srvDesc.Texture2DArray.ResourceMinLODClamp = 0;
+    }
     device->CreateShaderResourceView(m_resource.Get(), &srvDesc, srvDescriptorDestination.cpuStart);
   }
 }
@@ -147,12 +177,17 @@ void DepthStencilTexture::Initialize(ID3D12Device* device,
 
 void DepthStencilTexture::Resize(ID3D12Device* device, unsigned int width, unsigned int height) {
   if (m_width != width || m_height != height) {
-    InitializeWithSRV(device, m_dsvDescriptor, m_srvDescriptor, m_format, width, height);
+    InitializeArrayWithSRV(device, m_dsvDescriptors, m_srvDescriptor, m_format, width, height);
   }
 }
 
-D3D12_CPU_DESCRIPTOR_HANDLE DepthStencilTexture::GetDSVDescriptorHandle() const {
-  return m_dsvDescriptor.cpuStart;
+unsigned int DepthStencilTexture::GetArraySize() const {
+  return static_cast<unsigned int>(m_dsvDescriptors.size());
+}
+
+D3D12_CPU_DESCRIPTOR_HANDLE DepthStencilTexture::GetDSVDescriptorHandle(unsigned int slice) const {
+  assert(slice < m_dsvDescriptors.size());
+  return m_dsvDescriptors[slice].cpuStart;
 }
 
 D3D12_CPU_DESCRIPTOR_HANDLE DepthStencilTexture::GetSRVDescriptorHandle() const {
@@ -5,6 +5,8 @@
 #include <d3d12.h>
 #include <wrl/client.h>  // For ComPtr
 
+#include <vector>
+
 class TextureResource {
  protected:
   Microsoft::WRL::ComPtr<ID3D12Resource> m_resource;
@@ -31,7 +33,8 @@ class RenderTargetTexture : public TextureResource {
 };
 
 class DepthStencilTexture : public TextureResource {
-  DescriptorAllocation m_dsvDescriptor;
+  // One for each slice of the texture array.
+  std::vector<DescriptorAllocation> m_dsvDescriptors;
   DescriptorAllocation m_srvDescriptor;
   DXGI_FORMAT m_format;
 
@@ -47,9 +50,19 @@ class DepthStencilTexture : public TextureResource {
                          DXGI_FORMAT format,
                          unsigned int width,
                          unsigned int height);
+  // A texture array with a slice for each of |dsvDescriptorDestinations|, each of which gets a view of its own slice to
+  // draw into. The SRV, if there is one, views all of the slices at once, as a Texture2DArray. (With a single slice,
+  // this is the same as InitializeWithSRV.)
+  void InitializeArrayWithSRV(ID3D12Device* device,
+                              const std::vector<DescriptorAllocation>& dsvDescriptorDestinations,
+                              const DescriptorAllocation& srvDescriptorDestination,
+                              DXGI_FORMAT format,
+                              unsigned int width,
+                              unsigned int height);
 
   void Resize(ID3D12Device* device, unsigned int width, unsigned int height);
 
-  D3D12_CPU_DESCRIPTOR_HANDLE GetDSVDescriptorHandle() const;
+  unsigned int GetArraySize() const;
+  D3D12_CPU_DESCRIPTOR_HANDLE GetDSVDescriptorHandle(unsigned int slice = 0) const;
   D3D12_CPU_DESCRIPTOR_HANDLE GetSRVDescriptorHandle() const;
 };
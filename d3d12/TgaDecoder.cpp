@@ -0,0 +1,224 @@
+#include "d3d12/TgaDecoder.h"
+
+namespace {
+enum ImageType {
+  ColorMapped = 1,
+  TrueColor = 2,
+  Grayscale = 3,
+  RleColorMapped = 9,
+  RleTrueColor = 10,
+  RleGrayscale = 11,
+};
+
+constexpr size_t kHeaderSize = 18;
+
+struct Header {
+  uint8_t idLength;
+  uint8_t colorMapType;
+  uint8_t imageType;
+  uint16_t colorMapStart;
+  uint16_t colorMapLength;
+  uint8_t colorMapBitsPerEntry;
+  uint16_t width;
+  uint16_t height;
+  uint8_t bitsPerPixel;
+  uint8_t descriptor;
+
+  bool IsRunLengthEncoded() const { return imageType >= RleColorMapped; }
+  uint8_t GetBaseType() const { return IsRunLengthEncoded() ? imageType - 8 : imageType; }
+  bool IsRightToLeft() const { return (descriptor & 0x10) != 0; }
+  bool IsTopToBottom() const { return (descriptor & 0x20) != 0; }
+  size_t GetBytesPerPixel() const { return (bitsPerPixel + 7) / 8; }
+  size_t GetColorMapEntrySize() const { return (colorMapBitsPerEntry + 7) / 8; }
+  size_t GetColorMapOffset() const { return kHeaderSize + idLength; }
+  size_t GetPixelDataOffset() const { return GetColorMapOffset() + (size_t)colorMapLength * GetColorMapEntrySize(); }
+};
+
+uint16_t ReadLittleEndian16(const unsigned char* data) {
+  return (uint16_t)(data[0] | (data[1] << 8));
+}
+
+bool IsValidColorDepth(uint8_t bitsPerPixel) {
+  return bitsPerPixel == 15 || bitsPerPixel == 16 || bitsPerPixel == 24 || bitsPerPixel == 32;
+}
+
+// Since there is no signature, the header is checked fairly strictly so that random files are turned down.
+bool ReadHeader(const unsigned char* data, size_t size, Header* header) {
+  if (size < kHeaderSize)
+    return false;
+
+  header->idLength = data[0];
+  header->colorMapType = data[1];
+  header->imageType = data[2];
+  header->colorMapStart = ReadLittleEndian16(data + 3);
+  header->colorMapLength = ReadLittleEndian16(data + 5);
+  header->colorMapBitsPerEntry = data[7];
+  header->width = ReadLittleEndian16(data + 12);
+  header->height = ReadLittleEndian16(data + 14);
+  header->bitsPerPixel = data[16];
+  header->descriptor = data[17];
+
+  if (header->width == 0 || header->height == 0 || header->colorMapType > 1 || (header->descriptor & 0xC0) != 0)
+    return false;
+
+  switch (header->GetBaseType()) {
+    case ColorMapped:
+      if (header->colorMapType != 1 || header->bitsPerPixel != 8 || header->colorMapLength == 0 ||
+          !IsValidColorDepth(header->colorMapBitsPerEntry))
+        return false;
+      break;
+    case TrueColor:
+      if (!IsValidColorDepth(header->bitsPerPixel))
+        return false;
+      break;
+    case Grayscale:
+      if (header->bitsPerPixel != 8 && header->bitsPerPixel != 16)
+        return false;
+      break;
+    default:
+      return false;
+  }
+
+  return header->GetPixelDataOffset() <= size;
+}
+
+// Converts a single truecolor value (stored as little-endian BGR(A)) to RGBA.
+void ConvertColor(const unsigned char* color, size_t bytesPerColor, unsigned char* out) {
+  switch (bytesPerColor) {
+    case 2: {
+      // A1R5G5B5. The attribute bit is unreliable in practice, so 15/16-bit images are treated as opaque.
+      const uint16_t value = ReadLittleEndian16(color);
+      const int r = (value >> 10) & 0x1F;
+      const int g = (value >> 5) & 0x1F;
+      const int b = value & 0x1F;
+      out[0] = (unsigned char)((r << 3) | (r >> 2));
+      out[1] = (unsigned char)((g << 3) | (g >> 2));
+      out[2] = (unsigned char)((b << 3) | (b >> 2));
+      out[3] = 255;
+    } break;
+
+    case 3:
+      out[0] = color[2];
+      out[1] = color[1];
+      out[2] = color[0];
+      out[3] = 255;
+      break;
+
+    case 4:
+      out[0] = color[2];
+      out[1] = color[1];
+      out[2] = color[0];
+      out[3] = color[3];
+      break;
+  }
+}
+
+class PixelConverter {
+ private:
+  const Header& m_header;
+  const unsigned char* m_colorMap;
+
+ public:
+  // The alpha channel of 32-bit (and 16-bit grayscale) pixels is always used, even though the descriptor's count of
+  // attribute bits is supposed to say whether there is one. Plenty of exporters leave it at zero.
+  PixelConverter(const Header& header, const unsigned char* colorMap) : m_header(header), m_colorMap(colorMap) {}
+
+  bool Convert(const unsigned char* pixel, unsigned char* out) const {
+    switch (m_header.GetBaseType()) {
+      case ColorMapped: {
+        const int index = pixel[0] - m_header.colorMapStart;
+        if (index < 0 || index >= m_header.colorMapLength)
+          return false;
+        const size_t entrySize = m_header.GetColorMapEntrySize();
+        ConvertColor(m_colorMap + index * entrySize, entrySize, out);
+      } break;
+
+      case TrueColor:
+        ConvertColor(pixel, m_header.GetBytesPerPixel(), out);
+        break;
+
+      case Grayscale:
+        out[0] = out[1] = out[2] = pixel[0];
+        out[3] = (m_header.bitsPerPixel == 16) ? pixel[1] : 255;
+        break;
+    }
+    return true;
+  }
+};
+}  // namespace
+
+bool TgaDecoder::ReadInfo(const unsigned char* data, size_t size, Info* info) const {
+  Header header;
+  if (!ReadHeader(data, size, &header))
+    return false;
+
+  info->width = header.width;
+  info->height = header.height;
+  return true;
+}
+
+bool TgaDecoder::Decode(const unsigned char* data, size_t size, unsigned char* pixels, size_t rowPitch) const {
+  Header header;
+  if (!ReadHeader(data, size, &header))
+    return false;
+
+  const PixelConverter converter(header, data + header.GetColorMapOffset());
+  const size_t bytesPerPixel = header.GetBytesPerPixel();
+  const unsigned char* input = data + header.GetPixelDataOffset();
+  const unsigned char* const inputEnd = data + size;
+
+  // Pixels are stored bottom-up and left-to-right unless the descriptor says otherwise. Run-length packets may cross
+  // row boundaries, so the pixels are just walked in file order and mapped to their place in the image.
+  const size_t numPixels = (size_t)header.width * header.height;
+  size_t pixelIndex = 0;
+  auto writePixel = [&](const unsigned char* pixel) {
+    const size_t fileRow = pixelIndex / header.width;
+    const size_t fileColumn = pixelIndex % header.width;
+    const size_t y = header.IsTopToBottom() ? fileRow : header.height - 1 - fileRow;
+    const size_t x = header.IsRightToLeft() ? header.width - 1 - fileColumn : fileColumn;
+    ++pixelIndex;
+    return converter.Convert(pixel, pixels + y * rowPitch + x * 4);
+  };
+
+  if (!header.IsRunLengthEncoded()) {
+    if ((size_t)(inputEnd - input) / bytesPerPixel < numPixels)
+      return false;
+
+    for (size_t i = 0; i < numPixels; ++i, input += bytesPerPixel) {
+      if (!writePixel(input))
+        return false;
+    }
+    return true;
+  }
+
+  while (pixelIndex < numPixels) {
+    if (input >= inputEnd)
+      return false;
+
+    const uint8_t packetHeader = *input++;
+    const size_t count = (packetHeader & 0x7F) + 1;
+    if (count > numPixels - pixelIndex)
+      return false;
+
+    if (packetHeader & 0x80) {
+      // A run of a single repeated pixel.
+      if ((size_t)(inputEnd - input) < bytesPerPixel)
+        return false;
+      for (size_t i = 0; i < count; ++i) {
+        if (!writePixel(input))
+          return false;
+      }
+      input += bytesPerPixel;
+    } else {
+      // A run of raw pixels.
+      if ((size_t)(inputEnd - input) / bytesPerPixel < count)
+        return false;
+      for (size_t i = 0; i < count; ++i, input += bytesPerPixel) {
+        if (!writePixel(input))
+          return false;
+      }
+    }
+  }
+
+  return true;
+}
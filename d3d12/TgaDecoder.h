@@ -0,0 +1,13 @@
+#pragma once
+
+#include "d3d12/ImageDecoder.h"
+
+// Supports uncompressed and run-length encoded color-mapped, truecolor and grayscale images at 8, 15, 16, 24 and
+// 32 bits per pixel, in either vertical or horizontal orientation.
+//
+// Tga files don't have a signature, so this decoder should be registered after the ones for formats that do.
+class TgaDecoder : public ImageDecoder {
+ public:
+  bool ReadInfo(const unsigned char* data, size_t size, Info* info) const override;
+  bool Decode(const unsigned char* data, size_t size, unsigned char* pixels, size_t rowPitch) const override;
+};
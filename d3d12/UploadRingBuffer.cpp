@@ -0,0 +1,95 @@
+#include "d3d12/UploadRingBuffer.h"
+
+#include "d3d12/d3dx12.h"
+#include "utils/comhelper.h"
+
+#include <assert.h>
+#include <string.h>
+
+#include <algorithm>
+
+constexpr size_t c_bufferSizeGranularity = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+
+static size_t AlignUp(size_t value, size_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+void UploadRingBuffer::Initialize(ID3D12Device* device, size_t initialSizeInBytes) {
+  m_device = device;
+  Grow(initialSizeInBytes, /*nextSignalValue*/ 0);
+}
+
+void UploadRingBuffer::Grow(size_t minimumSize, uint64_t nextSignalValue) {
+  // Whatever is still in flight stays where it is, so the old buffer can only go once all of it is done.
+  if (m_buffer)
+    m_outgrownBuffers.push({std::move(m_buffer), nextSignalValue});
+  m_currentAllocation.reset();
+  std::queue<InFlightRange>().swap(m_inFlightRanges);
+
+  m_bufferSize = (std::max)(2 * m_bufferSize, AlignUp(minimumSize, c_bufferSizeGranularity));
+  m_firstFreeOffset = 0;
+  m_numFreeBytes = m_bufferSize;
+
+  D3D12_HEAP_PROPERTIES heapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
+  D3D12_RESOURCE_DESC resourceDesc = CD3DX12_RESOURCE_DESC::Buffer(m_bufferSize);
+  HR(m_device->CreateCommittedResource(&heapProperties, D3D12_HEAP_FLAG_NONE, &resourceDesc,
+                                       D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&m_buffer)));
+
+  // Upload heap resources can stay mapped while the GPU reads from them. The CPU never reads from this one.
+  CD3DX12_RANGE readRange(/*begin*/ 0, /*end*/ 0);
+  HR(m_buffer->Map(/*subresource*/ 0, &readRange, reinterpret_cast<void**>(&m_mappedAddress)));
+}
+
+D3D12_GPU_VIRTUAL_ADDRESS UploadRingBuffer::AllocateAndUpload(size_t dataSizeInBytes,
+                                                              const void* data,
+                                                              size_t alignment,
+                                                              uint64_t nextSignalValue) {
+  assert(dataSizeInBytes > 0);
+  assert(c_bufferSizeGranularity % alignment == 0);
+  if (m_currentAllocation.has_value()) {
+    // Assume that the signal value is monotonically increasing.
+    assert(m_currentAllocation->signalValue <= nextSignalValue);
+  }
+
+  if (m_currentAllocation.has_value() && m_currentAllocation->signalValue < nextSignalValue) {
+    m_inFlightRanges.push(*m_currentAllocation);
+    m_currentAllocation.reset();
+  }
+
+  // An allocation that doesn't fit before the end of the buffer starts over at the beginning, and the end is skipped.
+  size_t padding = AlignUp(m_firstFreeOffset, alignment) - m_firstFreeOffset;
+  if (m_firstFreeOffset + padding + dataSizeInBytes > m_bufferSize)
+    padding = m_bufferSize - m_firstFreeOffset;
+  if (padding + dataSizeInBytes > m_numFreeBytes) {
+    Grow(dataSizeInBytes, nextSignalValue);
+    padding = 0;
+  }
+
+  if (!m_currentAllocation)
+    m_currentAllocation = InFlightRange{m_firstFreeOffset, 0, nextSignalValue};
+
+  const size_t offset = (m_firstFreeOffset + padding) % m_bufferSize;
+  m_currentAllocation->size += padding + dataSizeInBytes;
+  m_firstFreeOffset = (offset + dataSizeInBytes) % m_bufferSize;
+  m_numFreeBytes -= padding + dataSizeInBytes;
+
+  memcpy(m_mappedAddress + offset, data, dataSizeInBytes);
+  return m_buffer->GetGPUVirtualAddress() + offset;
+}
+
+void UploadRingBuffer::Cleanup(uint64_t signalValue) {
+  if (m_currentAllocation.has_value() && m_currentAllocation->signalValue <= signalValue) {
+    m_inFlightRanges.push(*m_currentAllocation);
+    m_currentAllocation.reset();
+  }
+
+  while (m_inFlightRanges.size() > 0 && m_inFlightRanges.front().signalValue <= signalValue) {
+    assert(m_inFlightRanges.front().startOffset == (m_firstFreeOffset + m_numFreeBytes) % m_bufferSize);
+
+    m_numFreeBytes += m_inFlightRanges.front().size;
+    m_inFlightRanges.pop();
+  }
+
+  while (m_outgrownBuffers.size() > 0 && m_outgrownBuffers.front().signalValue <= signalValue)
+    m_outgrownBuffers.pop();
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <d3d12.h>
+#include <wrl/client.h>  // For ComPtr
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <optional>
+#include <queue>
+
+// A single upload heap buffer that stays mapped, for data that's written every frame and read by the GPU straight from
+// the upload heap (e.g. per-instance vertex data). Allocations are handed out one after the other, wrapping around at
+// the end of the buffer, and their space comes free again once the GPU has passed the signal value that they were
+// allocated with.
+//
+// If the data that's still in flight leaves no room for an allocation, the buffer is replaced with one of at least
+// twice the size. The old buffer is kept alive until the GPU is done with it.
+class UploadRingBuffer {
+ private:
+  ID3D12Device* m_device = nullptr;
+
+  Microsoft::WRL::ComPtr<ID3D12Resource> m_buffer;
+  uint8_t* m_mappedAddress = nullptr;
+  size_t m_bufferSize = 0;
+  size_t m_firstFreeOffset = 0;
+  size_t m_numFreeBytes = 0;
+
+  struct InFlightRange {
+    size_t startOffset;
+    size_t size;  // Including any padding.
+    uint64_t signalValue;
+  };
+  std::optional<InFlightRange> m_currentAllocation = std::nullopt;
+  std::queue<InFlightRange> m_inFlightRanges;
+
+  struct OutgrownBuffer {
+    Microsoft::WRL::ComPtr<ID3D12Resource> buffer;
+    uint64_t signalValue;
+  };
+  std::queue<OutgrownBuffer> m_outgrownBuffers;
+
+  void Grow(size_t minimumSize, uint64_t nextSignalValue);
+
+ public:
+  void Initialize(ID3D12Device* device, size_t initialSizeInBytes);
+
+  // Copies |data| into the buffer, at an offset that's a multiple of |alignment| (which has to divide 64KB), and
+  // returns its GPU address.
+  D3D12_GPU_VIRTUAL_ADDRESS AllocateAndUpload(size_t dataSizeInBytes,
+                                              const void* data,
+                                              size_t alignment,
+                                              uint64_t nextSignalValue);
+  void Cleanup(uint64_t signalValue);
+};
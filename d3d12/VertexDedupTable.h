@@ -0,0 +1,137 @@
+#pragma once
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+// Maps each unique combination of an obj face corner's (1-based) position, texture coordinate and normal indices to
+// the vertex that was created for it.
+//
+// This is a flat, open-addressing table with linear probing, since a node-based map would allocate for every unique
+// vertex and chase a pointer on every lookup. The indices are stored as |IndexType|, so that in the common case (every
+// count fits in 32 bits) a slot is only 16 bytes. A posIndex of 0 marks an empty slot, which is safe since the indices
+// are 1-based.
+template <class IndexType>
+class VertexDedupTable {
+  struct Slot {
+    IndexType posIndex;
+    IndexType texCoordIndex;
+    IndexType normalIndex;
+    uint32_t vertexIndex;
+  };
+
+  std::vector<Slot> m_slots;  // The size is always 0 or a power of 2.
+  size_t m_numEntries = 0;
+
+  static size_t Hash(unsigned long long posIndex, unsigned long long texCoordIndex, unsigned long long normalIndex);
+  void Rehash(size_t numSlots);
+
+ public:
+  static constexpr unsigned long long kMaxIndex = std::numeric_limits<IndexType>::max();
+
+  void Reserve(size_t numEntries);
+
+  // If the indices are already in the table, returns the vertex index stored for them. Otherwise, stores and returns
+  // |newVertexIndex|. A texCoordIndex or normalIndex of 0 means that the corner doesn't have one.
+  uint32_t FindOrInsert(unsigned long long posIndex,
+                        unsigned long long texCoordIndex,
+                        unsigned long long normalIndex,
+                        uint32_t newVertexIndex);
+
+  template <class OtherIndexType>
+  void MoveTo(VertexDedupTable<OtherIndexType>* other);
+};
+
+template <class IndexType>
+/*static*/ size_t VertexDedupTable<IndexType>::Hash(unsigned long long posIndex,
+                                                    unsigned long long texCoordIndex,
+                                                    unsigned long long normalIndex) {
+  uint64_t hash = (posIndex * 0x9E3779B97F4A7C15) ^ (texCoordIndex * 0xC2B2AE3D27D4EB4F) ^
+                  (normalIndex * 0x165667B19E3779F9);
+
+  // The finalizer from MurmurHash3, so that every bit of the key affects the low bits that pick the slot.
+  hash ^= hash >> 33;
+  hash *= 0xFF51AFD7ED558CCD;
+  hash ^= hash >> 33;
+  hash *= 0xC4CEB9FE1A85EC53;
+  hash ^= hash >> 33;
+  return (size_t)hash;
+}
+
+template <class IndexType>
+void VertexDedupTable<IndexType>::Rehash(size_t numSlots) {
+  std::vector<Slot> oldSlots = std::move(m_slots);
+  m_slots.assign(numSlots, Slot{});
+
+  const size_t mask = numSlots - 1;
+  for (const Slot& oldSlot : oldSlots) {
+    if (oldSlot.posIndex == 0)
+      continue;
+
+    size_t i = Hash(oldSlot.posIndex, oldSlot.texCoordIndex, oldSlot.normalIndex) & mask;
+    while (m_slots[i].posIndex != 0) {
+      i = (i + 1) & mask;
+    }
+    m_slots[i] = oldSlot;
+  }
+}
+
+template <class IndexType>
+void VertexDedupTable<IndexType>::Reserve(size_t numEntries) {
+  // Keep the load factor under 3/4, so that probe sequences stay short.
+  size_t numSlots = std::max<size_t>(m_slots.size(), 16);
+  while (numEntries > numSlots / 4 * 3) {
+    numSlots *= 2;
+  }
+
+  if (numSlots != m_slots.size())
+    Rehash(numSlots);
+}
+
+template <class IndexType>
+uint32_t VertexDedupTable<IndexType>::FindOrInsert(unsigned long long posIndex,
+                                                   unsigned long long texCoordIndex,
+                                                   unsigned long long normalIndex,
+                                                   uint32_t newVertexIndex) {
+  assert(posIndex > 0);
+  assert(posIndex <= kMaxIndex && texCoordIndex <= kMaxIndex && normalIndex <= kMaxIndex);
+
+  if (m_numEntries + 1 > m_slots.size() / 4 * 3)
+    Reserve(m_numEntries + 1);
+
+  const size_t mask = m_slots.size() - 1;
+  size_t i = Hash(posIndex, texCoordIndex, normalIndex) & mask;
+  while (true) {
+    Slot& slot = m_slots[i];
+    if (slot.posIndex == 0) {
+      slot.posIndex = (IndexType)posIndex;
+      slot.texCoordIndex = (IndexType)texCoordIndex;
+      slot.normalIndex = (IndexType)normalIndex;
+      slot.vertexIndex = newVertexIndex;
+      m_numEntries++;
+      return newVertexIndex;
+    }
+
+    if (slot.posIndex == posIndex && slot.texCoordIndex == texCoordIndex && slot.normalIndex == normalIndex)
+      return slot.vertexIndex;
+
+    i = (i + 1) & mask;
+  }
+}
+
+template <class IndexType>
+template <class OtherIndexType>
+void VertexDedupTable<IndexType>::MoveTo(VertexDedupTable<OtherIndexType>* other) {
+  other->Reserve(m_numEntries);
+  for (const Slot& slot : m_slots) {
+    if (slot.posIndex != 0)
+      (void)other->FindOrInsert(slot.posIndex, slot.texCoordIndex, slot.normalIndex, slot.vertexIndex);
+  }
+
+  m_slots = std::vector<Slot>();
+  m_numEntries = 0;
+}
@@ -0,0 +1,257 @@
+#include "d3d12/VertexQuantization.h"
+
+#include "utils/ThreadPool.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+
+namespace VertexQuantization {
+
+namespace {
+constexpr float kMaxUnorm16 = 65535.f;
+constexpr float kMaxSnorm16 = 32767.f;
+constexpr float kRadiansToDegrees = 57.29577951f;
+
+// Quantizing is cheap per vertex, so the work is handed out in chunks to keep the thread pool's overhead down.
+constexpr size_t kVerticesPerChunk = 16 * 1024;
+
+uint16_t FloatToHalf(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  const uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+  bits &= 0x7fffffff;
+
+  // NaNs stay NaNs. Everything that would round up to infinity is clamped to the largest half instead, since a
+  // texture coordinate of infinity is of no use to anyone.
+  if (bits > 0x7f800000)
+    return sign | 0x7e00;
+  if (bits >= 0x477ff000)
+    return sign | 0x7bff;
+
+  // Normal halves: rebias the exponent, and round the mantissa to nearest even.
+  if (bits >= 0x38800000) {
+    bits += 0xfff + ((bits >> 13) & 1);
+    return sign | static_cast<uint16_t>((bits - 0x38000000) >> 13);
+  }
+
+  // Subnormal halves: adding 0.5 lines the half's mantissa up with the bottom bits of the float's, and lets the FPU
+  // do the rounding.
+  float magnitude;
+  memcpy(&magnitude, &bits, sizeof(magnitude));
+  magnitude += 0.5f;
+  memcpy(&bits, &magnitude, sizeof(bits));
+  return sign | static_cast<uint16_t>(bits - 0x3f000000);
+}
+
+float HalfToFloat(uint16_t half) {
+  const uint32_t sign = static_cast<uint32_t>(half & 0x8000) << 16;
+  const uint32_t exponent = (half >> 10) & 0x1f;
+  const uint32_t mantissa = half & 0x3ff;
+
+  uint32_t bits;
+  if (exponent == 0x1f) {
+    bits = sign | 0x7f800000 | (mantissa << 13);
+  } else if (exponent == 0) {
+    // Zero or subnormal, which are exact as floats.
+    const float magnitude = mantissa * (1.f / (1 << 24));
+    memcpy(&bits, &magnitude, sizeof(bits));
+    bits |= sign;
+  } else {
+    bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+  }
+
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+uint16_t ToUnorm16(float value) {
+  return static_cast<uint16_t>(lroundf(std::clamp(value, 0.f, 1.f) * kMaxUnorm16));
+}
+
+float FromSnorm16(int16_t value) {
+  return std::max(value / kMaxSnorm16, -1.f);
+}
+
+float SignNotZero(float value) {
+  return (value >= 0.f) ? 1.f : -1.f;
+}
+
+void OctahedralDecode(const int16_t encoded[2], /*out*/ float normal[3]) {
+  float x = FromSnorm16(encoded[0]);
+  float y = FromSnorm16(encoded[1]);
+  const float z = 1.f - fabsf(x) - fabsf(y);
+  if (z < 0.f) {
+    const float foldedX = (1.f - fabsf(y)) * SignNotZero(x);
+    y = (1.f - fabsf(x)) * SignNotZero(y);
+    x = foldedX;
+  }
+
+  const float length = sqrtf(x * x + y * y + z * z);
+  normal[0] = x / length;
+  normal[1] = y / length;
+  normal[2] = z / length;
+}
+
+float Dot(const float a[3], const float b[3]) {
+  return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+// Returns false for zero-length normals, which have no direction to keep.
+bool Normalize(const float vector[3], /*out*/ float normalized[3]) {
+  const float length = sqrtf(Dot(vector, vector));
+  if (!(length > 0.f))
+    return false;
+
+  for (size_t i = 0; i < 3; ++i)
+    normalized[i] = vector[i] / length;
+  return true;
+}
+
+void OctahedralEncode(const float vector[3], /*out*/ int16_t encoded[2]) {
+  float normal[3];
+  if (!Normalize(vector, normal)) {
+    encoded[0] = 0;
+    encoded[1] = 0;
+    return;
+  }
+
+  // Project onto the octahedron, and fold the lower half over the upper one.
+  const float l1Norm = fabsf(normal[0]) + fabsf(normal[1]) + fabsf(normal[2]);
+  float x = normal[0] / l1Norm;
+  float y = normal[1] / l1Norm;
+  if (normal[2] < 0.f) {
+    const float foldedX = (1.f - fabsf(y)) * SignNotZero(x);
+    y = (1.f - fabsf(x)) * SignNotZero(y);
+    x = foldedX;
+  }
+
+  // Rounding each component to the nearest SNORM isn't necessarily nearest on the sphere, so try all four neighbors.
+  const float scaledX = x * kMaxSnorm16;
+  const float scaledY = y * kMaxSnorm16;
+  float bestDot = -2.f;
+  for (float candidateX : {floorf(scaledX), ceilf(scaledX)}) {
+    for (float candidateY : {floorf(scaledY), ceilf(scaledY)}) {
+      const int16_t candidate[2] = {static_cast<int16_t>(candidateX), static_cast<int16_t>(candidateY)};
+      float decoded[3];
+      OctahedralDecode(candidate, decoded);
+      const float dot = Dot(normal, decoded);
+      if (dot > bestDot) {
+        bestDot = dot;
+        encoded[0] = candidate[0];
+        encoded[1] = candidate[1];
+      }
+    }
+  }
+}
+
+struct ChunkError {
+  float maxPositionError = 0.f;
+  double sumPositionError = 0.0;
+  float maxNormalError = 0.f;
+  float maxTexCoordError = 0.f;
+};
+}  // namespace
+
+PositionTransform GetPositionTransform(const ObjFileData::AxisAlignedBounds& bounds) {
+  PositionTransform transform;
+  for (size_t i = 0; i < 3; ++i) {
+    transform.scale[i] = std::max(bounds.max[i] - bounds.min[i], 0.f);
+    transform.offset[i] = bounds.min[i];
+  }
+  return transform;
+}
+
+QuantizedVertex Encode(const ObjFileData::Vertex& vertex, const PositionTransform& transform) {
+  QuantizedVertex quantized;
+  for (size_t i = 0; i < 3; ++i) {
+    // Flat models have no extent along one of the axes; everything decodes to the offset there.
+    const float relativePosition =
+        (transform.scale[i] > 0.f) ? (vertex.pos[i] - transform.offset[i]) / transform.scale[i] : 0.f;
+    quantized.pos[i] = ToUnorm16(relativePosition);
+  }
+  quantized.pos[3] = 0;
+
+  quantized.texCoord[0] = FloatToHalf(vertex.texCoord[0]);
+  quantized.texCoord[1] = FloatToHalf(vertex.texCoord[1]);
+  OctahedralEncode(vertex.normal, quantized.normal);
+  return quantized;
+}
+
+ObjFileData::Vertex Decode(const QuantizedVertex& vertex, const PositionTransform& transform) {
+  ObjFileData::Vertex decoded;
+  for (size_t i = 0; i < 3; ++i)
+    decoded.pos[i] = (vertex.pos[i] / kMaxUnorm16) * transform.scale[i] + transform.offset[i];
+
+  decoded.texCoord[0] = HalfToFloat(vertex.texCoord[0]);
+  decoded.texCoord[1] = HalfToFloat(vertex.texCoord[1]);
+  OctahedralDecode(vertex.normal, decoded.normal);
+  return decoded;
+}
+
+std::vector<QuantizedVertex> Quantize(const ObjFileData::Vertex* vertices,
+                                      size_t numVertices,
+                                      const ObjFileData::AxisAlignedBounds& bounds,
+                                      /*out*/ QuantizationError* error) {
+  const PositionTransform transform = GetPositionTransform(bounds);
+  std::vector<QuantizedVertex> quantized(numVertices);
+
+  const size_t numChunks = (numVertices + kVerticesPerChunk - 1) / kVerticesPerChunk;
+  std::vector<ChunkError> chunkErrors(numChunks);
+  ThreadPool::GetShared().ParallelFor(numChunks, [&](size_t chunk) {
+    const size_t start = chunk * kVerticesPerChunk;
+    const size_t end = std::min(start + kVerticesPerChunk, numVertices);
+    ChunkError& chunkError = chunkErrors[chunk];
+    for (size_t v = start; v < end; ++v) {
+      quantized[v] = Encode(vertices[v], transform);
+      if (!error)
+        continue;
+
+      const ObjFileData::Vertex& original = vertices[v];
+      const ObjFileData::Vertex decoded = Decode(quantized[v], transform);
+
+      float offset[3];
+      for (size_t i = 0; i < 3; ++i)
+        offset[i] = decoded.pos[i] - original.pos[i];
+      const float positionError = sqrtf(Dot(offset, offset));
+      chunkError.maxPositionError = std::max(chunkError.maxPositionError, positionError);
+      chunkError.sumPositionError += positionError;
+
+      // The angle between the normals, measured with atan2 since acos loses most of its precision near 0.
+      float originalNormal[3];
+      if (Normalize(original.normal, originalNormal)) {
+        const float* n = decoded.normal;
+        const float cross[3] = {originalNormal[1] * n[2] - originalNormal[2] * n[1],
+                                originalNormal[2] * n[0] - originalNormal[0] * n[2],
+                                originalNormal[0] * n[1] - originalNormal[1] * n[0]};
+        const float angle = atan2f(sqrtf(Dot(cross, cross)), Dot(originalNormal, n));
+        chunkError.maxNormalError = std::max(chunkError.maxNormalError, angle);
+      }
+
+      for (size_t i = 0; i < 2; ++i) {
+        chunkError.maxTexCoordError =
+            std::max(chunkError.maxTexCoordError, fabsf(decoded.texCoord[i] - original.texCoord[i]));
+      }
+    }
+  });
+
+  if (error) {
+    *error = {};
+    double sumPositionError = 0.0;
+    for (const ChunkError& chunkError : chunkErrors) {
+      error->maxPositionError = std::max(error->maxPositionError, chunkError.maxPositionError);
+      error->maxNormalErrorInDegrees = std::max(error->maxNormalErrorInDegrees, chunkError.maxNormalError);
+      error->maxTexCoordError = std::max(error->maxTexCoordError, chunkError.maxTexCoordError);
+      sumPositionError += chunkError.sumPositionError;
+    }
+    if (numVertices > 0)
+      error->meanPositionError = static_cast<float>(sumPositionError / numVertices);
+    error->maxNormalErrorInDegrees *= kRadiansToDegrees;
+  }
+
+  return quantized;
+}
+
+}  // namespace VertexQuantization
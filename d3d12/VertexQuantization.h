@@ -0,0 +1,63 @@
+#pragma once
+
+#include "d3d12/ObjFileLoader.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+// A packed alternative to ObjFileData::Vertex, at half the size (16 bytes rather than 32), for models where vertex
+// memory and fetch bandwidth matter more than the last bits of precision:
+//  - Positions are 16-bit UNORM, relative to the model's bounds. There's no 3-component 16-bit format, so the fourth
+//    component is padding.
+//  - Texture coordinates are half floats.
+//  - Normals are octahedral encoded (Cigolle et al., "A Survey of Efficient Representations for Independent Unit
+//    Vectors", 2014) into two 16-bit SNORMs, choosing whichever of the neighboring encodings decodes closest to the
+//    original.
+//
+// The input assembler does most of the decoding. What's left is mapping the positions back from the bounds, which is
+// folded into the model transform (see PositionTransform), and unfolding the normals, which the vertex shaders do when
+// they're compiled with QUANTIZED_VERTICES.
+namespace VertexQuantization {
+
+struct QuantizedVertex {
+  uint16_t pos[4];
+  uint16_t texCoord[2];
+  int16_t normal[2];
+};
+static_assert(sizeof(QuantizedVertex) == 16, "QuantizedVertex should be tightly packed");
+
+// Maps the positions, as the input assembler reads them (in [0, 1]), back to model space: pos * scale + offset.
+struct PositionTransform {
+  float scale[3];
+  float offset[3];
+};
+
+// How far the vertices move when they're encoded and decoded again.
+struct QuantizationError {
+  // In model units.
+  float maxPositionError = 0.f;
+  float meanPositionError = 0.f;
+
+  float maxNormalErrorInDegrees = 0.f;
+  float maxTexCoordError = 0.f;
+};
+
+PositionTransform GetPositionTransform(const ObjFileData::AxisAlignedBounds& bounds);
+
+// Positions outside of the bounds that |transform| was made from are clamped to them, and texture coordinates beyond
+// the range of half floats are clamped to it.
+QuantizedVertex Encode(const ObjFileData::Vertex& vertex, const PositionTransform& transform);
+
+// Decodes the vertex the same way the GPU does.
+ObjFileData::Vertex Decode(const QuantizedVertex& vertex, const PositionTransform& transform);
+
+// Encodes all of the vertices relative to |bounds|, in parallel on the shared thread pool. If |error| is given, it's
+// filled in with how far the vertices moved.
+std::vector<QuantizedVertex> Quantize(const ObjFileData::Vertex* vertices,
+                                      size_t numVertices,
+                                      const ObjFileData::AxisAlignedBounds& bounds,
+                                      /*out*/ QuantizationError* error = nullptr);
+
+}  // namespace VertexQuantization
@@ -0,0 +1,83 @@
+#include "d3d12/WicImageDecoder.h"
+
+#include "utils/comhelper.h"
+
+#include <Windows.h>
+#include <wincodec.h>
+#include <wrl/client.h>  // For ComPtr
+
+using namespace Microsoft::WRL;
+
+namespace {
+HRESULT CreateFrame(const unsigned char* data,
+                    size_t size,
+                    /*out*/ ComPtr<IWICImagingFactory>* factory,
+                    /*out*/ ComPtr<IWICBitmapFrameDecode>* frame) {
+  HRESULT hr = S_OK;
+
+  if (size > MAXDWORD)
+    return E_INVALIDARG;
+
+  RETURN_IF_FAILED(
+      CoCreateInstance(CLSID_WICImagingFactory, NULL, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(factory->GetAddressOf())));
+
+  ComPtr<IWICStream> stream;
+  RETURN_IF_FAILED((*factory)->CreateStream(&stream));
+  RETURN_IF_FAILED(stream->InitializeFromMemory(const_cast<BYTE*>(data), (DWORD)size));
+
+  ComPtr<IWICBitmapDecoder> decoder;
+  RETURN_IF_FAILED((*factory)->CreateDecoderFromStream(stream.Get(),
+                                                       NULL,  // Do not prefer a particular vendor
+                                                       WICDecodeMetadataCacheOnDemand, &decoder));
+
+  // Retrieve the first frame of the image from the decoder
+  RETURN_IF_FAILED(decoder->GetFrame(0, frame->GetAddressOf()));
+  return S_OK;
+}
+}  // namespace
+
+bool WicImageDecoder::ReadInfo(const unsigned char* data, size_t size, Info* info) const {
+  ComPtr<IWICImagingFactory> factory;
+  ComPtr<IWICBitmapFrameDecode> frame;
+  if (FAILED(CreateFrame(data, size, &factory, &frame)))
+    return false;
+
+  UINT width;
+  UINT height;
+  if (FAILED(frame->GetSize(&width, &height)))
+    return false;
+
+  info->width = width;
+  info->height = height;
+  return true;
+}
+
+bool WicImageDecoder::Decode(const unsigned char* data, size_t size, unsigned char* pixels, size_t rowPitch) const {
+  ComPtr<IWICImagingFactory> factory;
+  ComPtr<IWICBitmapFrameDecode> frame;
+  if (FAILED(CreateFrame(data, size, &factory, &frame)))
+    return false;
+
+  // Make sure the image is in (or can be converted to) R8G8B8A format.
+  ComPtr<IWICFormatConverter> converter;
+  if (FAILED(factory->CreateFormatConverter(&converter)))
+    return false;
+
+  WICPixelFormatGUID format;
+  BOOL canConvert;
+  if (FAILED(frame->GetPixelFormat(&format)) ||
+      FAILED(converter->CanConvert(format, GUID_WICPixelFormat32bppRGBA, &canConvert)) || !canConvert)
+    return false;
+
+  // No dithering: this only ever converts to a format that is at least as precise as the source.
+  if (FAILED(converter->Initialize(frame.Get(), GUID_WICPixelFormat32bppRGBA, WICBitmapDitherTypeNone, nullptr, 0,
+                                   WICBitmapPaletteTypeCustom)))
+    return false;
+
+  UINT width;
+  UINT height;
+  if (FAILED(converter->GetSize(&width, &height)))
+    return false;
+
+  return SUCCEEDED(converter->CopyPixels(nullptr, (UINT)rowPitch, (UINT)(rowPitch * height), pixels));
+}
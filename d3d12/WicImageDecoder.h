@@ -0,0 +1,11 @@
+#pragma once
+
+#include "d3d12/ImageDecoder.h"
+
+// Decodes anything that the Windows Imaging Component has a codec for. COM has to be initialized on the calling
+// thread.
+class WicImageDecoder : public ImageDecoder {
+ public:
+  bool ReadInfo(const unsigned char* data, size_t size, Info* info) const override;
+  bool Decode(const unsigned char* data, size_t size, unsigned char* pixels, size_t rowPitch) const override;
+};
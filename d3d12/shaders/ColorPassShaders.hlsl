@@ -1,38 +1,74 @@
+// As in ShadowCascades.
+#define NUM_SHADOW_CASCADES 4
+
 cbuffer PerFrameData : register(b0) {
   float4x4 projectionViewTransform;
-  float4x4 shadowMapProjectionViewTransform;
+  float4x4 shadowMapProjectionViewTransforms[NUM_SHADOW_CASCADES];
+  // The view depth that each cascade reaches out to. Anything beyond the last split is in the last cascade.
+  float4 cascadeSplitDepths;
   float4 lightDirection;
 }
 
-cbuffer PerObjectData : register(b1) {
-  float4x4 worldTransform;
-  float4x4 worldTransformInverseTranspose;
-}
-
-Texture2D shadowMap : register(t0);
+Texture2DArray shadowMap : register(t0);  // One slice for each cascade.
 Texture2D objectTexture : register(t1);
 SamplerState aniSampler : register(s0);
 SamplerComparisonState pointClampComp : register(s1);
 
+#ifdef QUANTIZED_VERTICES
+// Vertices packed by VertexQuantization. The positions are in [0, 1] within the model's bounds, which the instance's
+// vertex transform maps back from; the normals are octahedral encoded.
+#define VertexPosition float4
+#define VertexNormal float2
+
+float3 DecodeNormal(float2 encoded) {
+  float3 normal = float3(encoded, 1.f - abs(encoded.x) - abs(encoded.y));
+  if (normal.z < 0.f) {
+    normal.xy = (1.f - abs(normal.yx)) * (normal.xy >= 0.f ? 1.f : -1.f);
+  }
+  return normalize(normal);
+}
+#else
+#define VertexPosition float3
+#define VertexNormal float3
+
+float3 DecodeNormal(float3 normal) {
+  return normal;
+}
+#endif
+
+// One for each instance; see SceneInstances::DrawTransforms. Each row gives one of the world coordinates.
+struct InstanceInput {
+  float4 vertexTransform0 : INSTANCE_VERTEX_TRANSFORM0;
+  float4 vertexTransform1 : INSTANCE_VERTEX_TRANSFORM1;
+  float4 vertexTransform2 : INSTANCE_VERTEX_TRANSFORM2;
+  float3 normalTransform0 : INSTANCE_NORMAL_TRANSFORM0;
+  float3 normalTransform1 : INSTANCE_NORMAL_TRANSFORM1;
+  float3 normalTransform2 : INSTANCE_NORMAL_TRANSFORM2;
+};
+
 struct PSInput {
   float4 position : SV_POSITION;
   float2 tex : TEXCOORD;
   float4 normal : NORMAL;
-  float4 shadowMapPos : TEXCOORD1;
+  // The cascade is only picked per pixel, so the shadow map position is worked out from this in the pixel shader.
+  float4 worldPos : TEXCOORD1;
 };
 
-PSInput VSMain(float3 pos : POSITION, float2 tex : TEXCOORD, float3 normal : NORMAL) {
-  float4x4 modelViewProjection = mul(projectionViewTransform, worldTransform);
-  float4x4 shadowCameraModelViewProjection = mul(shadowMapProjectionViewTransform, worldTransform);
+PSInput VSMain(VertexPosition pos : POSITION,
+               float2 tex : TEXCOORD,
+               VertexNormal normal : NORMAL,
+               InstanceInput instance) {
+  float3x4 vertexTransform = float3x4(instance.vertexTransform0, instance.vertexTransform1, instance.vertexTransform2);
+  float3x3 normalTransform = float3x3(instance.normalTransform0, instance.normalTransform1, instance.normalTransform2);
 
   PSInput result;
-  result.position = mul(modelViewProjection, float4(pos, 1.f));
+  result.worldPos = float4(mul(vertexTransform, float4(pos.xyz, 1.f)), 1.f);
+  result.position = mul(projectionViewTransform, result.worldPos);
   result.tex = tex;
-  result.shadowMapPos = mul(shadowCameraModelViewProjection, float4(pos, 1.f));
 
-  // Normals shouldn't be used as homogeneous since they don't have a position. We therefore use 0 as the w component.
-  // We can simplify this further by instead just using a 3x3 matrix.
-  result.normal = normalize(mul(worldTransformInverseTranspose, float4(normal, 0)));
+  // Normals don't have a position, so they only go through the 3x3 part of the transform; as that may scale them, they
+  // have to be normalized again.
+  result.normal = float4(normalize(mul(normalTransform, DecodeNormal(normal))), 0.f);
 
   return result;
 }
@@ -45,9 +81,15 @@ float4 PSMain(PSInput input) : SV_TARGET{
 
   float lambertFactor = dot(normalize(input.normal.xyz), normalize(lightDirection.xyz));
 
-  float2 shadowMapTexCoord =
-      float2((input.shadowMapPos.x + 1) / 2, 1 - ((input.shadowMapPos.y + 1) / 2));
-  float depthInShadowMap = input.shadowMapPos.z;
+  // The w of SV_POSITION is the view depth. The splits go up from one cascade to the next, so the cascade is the
+  // number of them that the pixel is beyond.
+  float viewDepth = input.position.w;
+  uint cascade = (uint)dot(float3(viewDepth > cascadeSplitDepths.xyz), float3(1.f, 1.f, 1.f));
+  float4 shadowMapPos = mul(shadowMapProjectionViewTransforms[cascade], input.worldPos);
+
+  float3 shadowMapTexCoord =
+      float3((shadowMapPos.x + 1) / 2, 1 - ((shadowMapPos.y + 1) / 2), cascade);
+  float depthInShadowMap = shadowMapPos.z;
   float visibility =
       shadowMap.SampleCmpLevelZero(pointClampComp, shadowMapTexCoord, depthInShadowMap);
 
@@ -2,22 +2,33 @@ cbuffer PerFrameData : register(b0) {
   float4x4 projectionViewTransform;
 }
 
-cbuffer PerObjectData : register(b1) {
-  float4x4 worldTransform;
-}
-
 SamplerState pointClamp : register(s0);
 
+#ifdef QUANTIZED_VERTICES
+// Vertices packed by VertexQuantization. The positions are in [0, 1] within the model's bounds, which the instance's
+// vertex transform maps back from.
+#define VertexPosition float4
+#else
+#define VertexPosition float3
+#endif
+
+// One for each instance; see SceneInstances::DrawTransforms. Each row gives one of the world coordinates.
+struct InstanceInput {
+  float4 vertexTransform0 : INSTANCE_VERTEX_TRANSFORM0;
+  float4 vertexTransform1 : INSTANCE_VERTEX_TRANSFORM1;
+  float4 vertexTransform2 : INSTANCE_VERTEX_TRANSFORM2;
+};
+
 struct PSInput {
   float4 position : SV_POSITION;
   float2 tex : TEXCOORD;
 };
 
-PSInput VSMain(float3 pos : POSITION) {
-  float4x4 modelViewProjection = mul(projectionViewTransform, worldTransform);
+PSInput VSMain(VertexPosition pos : POSITION, InstanceInput instance) {
+  float3x4 vertexTransform = float3x4(instance.vertexTransform0, instance.vertexTransform1, instance.vertexTransform2);
 
   PSInput result;
-  result.position = mul(modelViewProjection, float4(pos, 1.f));
+  result.position = mul(projectionViewTransform, float4(mul(vertexTransform, float4(pos.xyz, 1.f)), 1.f));
   return result;
 }
 
@@ -14,6 +14,28 @@ Texture2D objectTexture : register(t1);
 SamplerState texSampler : register(s0);
 SamplerComparisonState pointClampComp : register(s1);
 
+#ifdef QUANTIZED_VERTICES
+// Vertices packed by VertexQuantization. The positions are in [0, 1] within the model's bounds, which worldTransform
+// maps back from; the normals are octahedral encoded.
+#define VertexPosition float4
+#define VertexNormal float2
+
+float3 DecodeNormal(float2 encoded) {
+  float3 normal = float3(encoded, 1.f - abs(encoded.x) - abs(encoded.y));
+  if (normal.z < 0.f) {
+    normal.xy = (1.f - abs(normal.yx)) * (normal.xy >= 0.f ? 1.f : -1.f);
+  }
+  return normalize(normal);
+}
+#else
+#define VertexPosition float3
+#define VertexNormal float3
+
+float3 DecodeNormal(float3 normal) {
+  return normal;
+}
+#endif
+
 struct PSInput {
   float4 position : SV_POSITION;
   float2 tex : TEXCOORD;
@@ -21,18 +43,18 @@ struct PSInput {
   float4 shadowMapPos : TEXCOORD1;
 };
 
-PSInput VSMain(float3 pos : POSITION, float2 tex : TEXCOORD, float3 normal : NORMAL) {
+PSInput VSMain(VertexPosition pos : POSITION, float2 tex : TEXCOORD, VertexNormal normal : NORMAL) {
   float4x4 modelViewProjection = mul(projectionViewTransform, worldTransform);
   float4x4 shadowCameraModelViewProjection = mul(shadowMapProjectionViewTransform, worldTransform);
 
   PSInput result;
-  result.position = mul(modelViewProjection, float4(pos, 1.f));
+  result.position = mul(modelViewProjection, float4(pos.xyz, 1.f));
   result.tex = tex;
-  result.shadowMapPos = mul(shadowCameraModelViewProjection, float4(pos, 1.f));
+  result.shadowMapPos = mul(shadowCameraModelViewProjection, float4(pos.xyz, 1.f));
 
   // Normals shouldn't be used as homogeneous since they don't have a position. We therefore use 0 as the w component.
   // We can simplify this further by instead just using a 3x3 matrix.
-  result.normal = normalize(mul(worldTransformInverseTranspose, float4(normal, 0)));
+  result.normal = normalize(mul(worldTransformInverseTranspose, float4(DecodeNormal(normal), 0)));
 
   return result;
 }
@@ -9,16 +9,24 @@ cbuffer PerObjectData : register(b1) {
 Texture2D objectTexture : register(t0);
 SamplerState texSampler : register(s0);
 
+#ifdef QUANTIZED_VERTICES
+// Vertices packed by VertexQuantization. The positions are in [0, 1] within the model's bounds, which worldTransform
+// maps back from.
+#define VertexPosition float4
+#else
+#define VertexPosition float3
+#endif
+
 struct PSInput {
   float4 position : SV_POSITION;
   float2 tex : TEXCOORD;
 };
 
-PSInput VSMain(float3 pos : POSITION, float2 tex : TEXCOORD) {
+PSInput VSMain(VertexPosition pos : POSITION, float2 tex : TEXCOORD) {
   float4x4 modelViewProjection = mul(projectionViewTransform, worldTransform);
 
   PSInput result;
-  result.position = mul(modelViewProjection, float4(pos, 1.f));
+  result.position = mul(modelViewProjection, float4(pos.xyz, 1.f));
   result.tex = tex;
   return result;
 }
@@ -0,0 +1,254 @@
+// Checks FrustumCulling::BoundingVolumeHierarchy::Cull against testing every box on its own, and compares how long
+// the two take, on random boxes seen from random cameras.
+//
+// Usage: frustum_culling_benchmark [box count]
+
+#include "d3d12/FrustumCulling.h"
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace {
+constexpr int kNumRuns = 5;
+constexpr size_t kDefaultNumBoxes = 100000;
+constexpr size_t kNumViews = 64;
+
+// The boxes are spread over a cube of this half-size around the origin, and the cameras are placed inside it.
+constexpr float kSceneExtent = 100.f;
+constexpr float kMinBoxSize = 0.1f;
+constexpr float kMaxBoxSize = 2.f;
+constexpr float kVerticalFieldOfView = 1.f;
+constexpr float kAspectRatio = 16.f / 9.f;
+constexpr float kNearZ = 0.1f;
+constexpr float kFarZ = 80.f;
+
+struct Vector3 {
+  float x;
+  float y;
+  float z;
+};
+
+Vector3 Normalize(const Vector3& v) {
+  const float length = sqrtf(v.x * v.x + v.y * v.y + v.z * v.z);
+  return {v.x / length, v.y / length, v.z / length};
+}
+
+Vector3 Cross(const Vector3& a, const Vector3& b) {
+  return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x};
+}
+
+float Dot(const Vector3& a, const Vector3& b) {
+  return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+// The same left-handed, row-vector view-projection transform as DirectX::XMMatrixLookToLH times
+// DirectX::XMMatrixPerspectiveFovLH, written out so that this doesn't need DirectXMath.
+void GenerateViewProjection(const Vector3& eye, const Vector3& direction, /*out*/ float transform[4][4]) {
+  const Vector3 zAxis = Normalize(direction);
+  const Vector3 up = fabsf(zAxis.y) < 0.99f ? Vector3{0.f, 1.f, 0.f} : Vector3{1.f, 0.f, 0.f};
+  const Vector3 xAxis = Normalize(Cross(up, zAxis));
+  const Vector3 yAxis = Cross(zAxis, xAxis);
+  const float view[4][4] = {
+      {xAxis.x, yAxis.x, zAxis.x, 0.f},
+      {xAxis.y, yAxis.y, zAxis.y, 0.f},
+      {xAxis.z, yAxis.z, zAxis.z, 0.f},
+      {-Dot(xAxis, eye), -Dot(yAxis, eye), -Dot(zAxis, eye), 1.f},
+  };
+
+  const float yScale = 1.f / tanf(0.5f * kVerticalFieldOfView);
+  const float xScale = yScale / kAspectRatio;
+  const float zRange = kFarZ / (kFarZ - kNearZ);
+  const float projection[4][4] = {
+      {xScale, 0.f, 0.f, 0.f},
+      {0.f, yScale, 0.f, 0.f},
+      {0.f, 0.f, zRange, 1.f},
+      {0.f, 0.f, -kNearZ * zRange, 0.f},
+  };
+
+  for (size_t row = 0; row < 4; ++row) {
+    for (size_t column = 0; column < 4; ++column) {
+      transform[row][column] = 0.f;
+      for (size_t i = 0; i < 4; ++i)
+        transform[row][column] += view[row][i] * projection[i][column];
+    }
+  }
+}
+
+// The distance of the box's corner that's furthest along the plane's normal, computed in double precision, along with
+// how far off the hierarchy's single-precision result could be.
+double GetFurthestCornerDistance(const float plane[4], const ObjFileData::AxisAlignedBounds& box, double* error) {
+  double distance = plane[3];
+  double magnitude = fabs(plane[3]);
+  for (size_t i = 0; i < 3; ++i) {
+    const double term = static_cast<double>(plane[i]) * (plane[i] >= 0.f ? box.max[i] : box.min[i]);
+    distance += term;
+    magnitude += fabs(term);
+  }
+  *error = 1e-5 * magnitude;
+  return distance;
+}
+
+enum class Visibility { kOutside, kInside, kBorderline };
+
+// The same test as the hierarchy's, on a single box: it's out of view if its furthest corner is behind any plane.
+// Boxes that are too close to a plane for the two to be sure to agree, given rounding, are borderline.
+Visibility TestBox(const FrustumCulling::Frustum& frustum, const ObjFileData::AxisAlignedBounds& box) {
+  bool isBorderline = false;
+  for (const float* plane : frustum.planes) {
+    double error;
+    const double distance = GetFurthestCornerDistance(plane, box, &error);
+    if (distance < -error)
+      return Visibility::kOutside;
+    if (distance < error)
+      isBorderline = true;
+  }
+  return isBorderline ? Visibility::kBorderline : Visibility::kInside;
+}
+
+// Like TestBox, but only as precise as the hierarchy, for timing.
+void CullEachBox(const FrustumCulling::Frustum& frustum,
+                 const std::vector<ObjFileData::AxisAlignedBounds>& boxes,
+                 /*out*/ std::vector<uint32_t>* visibleItems) {
+  for (size_t b = 0; b < boxes.size(); ++b) {
+    const ObjFileData::AxisAlignedBounds& box = boxes[b];
+    bool isOutside = false;
+    for (const float* plane : frustum.planes) {
+      const float distance = plane[0] * (plane[0] >= 0.f ? box.max[0] : box.min[0]) +
+                             plane[1] * (plane[1] >= 0.f ? box.max[1] : box.min[1]) +
+                             plane[2] * (plane[2] >= 0.f ? box.max[2] : box.min[2]) + plane[3];
+      if (distance < 0.f) {
+        isOutside = true;
+        break;
+      }
+    }
+    if (!isOutside)
+      visibleItems->push_back(static_cast<uint32_t>(b));
+  }
+}
+
+// Returns the fastest of kNumRuns runs, in milliseconds.
+double TimeRuns(const std::function<void()>& run) {
+  double bestMilliseconds = 0.0;
+  for (int i = 0; i < kNumRuns; ++i) {
+    const auto start = std::chrono::steady_clock::now();
+    run();
+    const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    if (i == 0 || elapsed.count() < bestMilliseconds)
+      bestMilliseconds = elapsed.count();
+  }
+  return bestMilliseconds;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  size_t numBoxes = kDefaultNumBoxes;
+  if (argc > 2 || (argc == 2 && (numBoxes = strtoul(argv[1], nullptr, 10)) == 0)) {
+    std::cerr << "Usage: " << argv[0] << " [box count]" << std::endl;
+    return 1;
+  }
+
+  // Seeded, so that every run sees the same scene.
+  std::mt19937 random(1);
+  std::uniform_real_distribution<float> position(-kSceneExtent, kSceneExtent);
+  std::uniform_real_distribution<float> size(kMinBoxSize, kMaxBoxSize);
+  std::uniform_real_distribution<float> direction(-1.f, 1.f);
+
+  std::vector<ObjFileData::AxisAlignedBounds> boxes(numBoxes);
+  for (ObjFileData::AxisAlignedBounds& box : boxes) {
+    for (size_t i = 0; i < 3; ++i) {
+      box.min[i] = position(random);
+      box.max[i] = box.min[i] + size(random);
+    }
+  }
+
+  std::vector<FrustumCulling::Frustum> frusta(kNumViews);
+  for (FrustumCulling::Frustum& frustum : frusta) {
+    const Vector3 eye = {position(random), position(random), position(random)};
+    Vector3 viewDirection;
+    do {
+      viewDirection = {direction(random), direction(random), direction(random)};
+    } while (Dot(viewDirection, viewDirection) < 1e-3f);
+
+    float transform[4][4];
+    GenerateViewProjection(eye, viewDirection, transform);
+    frustum = FrustumCulling::ExtractFrustum(transform);
+  }
+
+  FrustumCulling::BoundingVolumeHierarchy hierarchy;
+  const double buildMilliseconds = TimeRuns([&]() { hierarchy.Build(boxes.data(), boxes.size()); });
+
+  // Check every view, and count what the hierarchy leaves in view.
+  size_t numVisible = 0;
+  size_t numMismatches = 0;
+  size_t numBorderline = 0;
+  std::vector<uint32_t> visibleItems;
+  std::vector<bool> isVisible(numBoxes);
+  for (const FrustumCulling::Frustum& frustum : frusta) {
+    visibleItems.clear();
+    hierarchy.Cull(frustum, &visibleItems);
+    numVisible += visibleItems.size();
+
+    std::fill(isVisible.begin(), isVisible.end(), false);
+    for (uint32_t item : visibleItems) {
+      if (item >= numBoxes || isVisible[item]) {
+        std::cerr << "Error: the hierarchy returned item " << item << " more than once, or out of range." << std::endl;
+        return 1;
+      }
+      isVisible[item] = true;
+    }
+
+    for (size_t b = 0; b < numBoxes; ++b) {
+      switch (TestBox(frustum, boxes[b])) {
+        case Visibility::kOutside:
+          numMismatches += isVisible[b] ? 1 : 0;
+          break;
+        case Visibility::kInside:
+          numMismatches += isVisible[b] ? 0 : 1;
+          break;
+        case Visibility::kBorderline:
+          ++numBorderline;
+          break;
+      }
+    }
+  }
+
+  std::vector<uint32_t> bruteForceItems;
+  bruteForceItems.reserve(numBoxes);
+  const double hierarchyMilliseconds = TimeRuns([&]() {
+    for (const FrustumCulling::Frustum& frustum : frusta) {
+      visibleItems.clear();
+      hierarchy.Cull(frustum, &visibleItems);
+    }
+  });
+  const double bruteForceMilliseconds = TimeRuns([&]() {
+    for (const FrustumCulling::Frustum& frustum : frusta) {
+      bruteForceItems.clear();
+      CullEachBox(frustum, boxes, &bruteForceItems);
+    }
+  });
+
+  const double numTests = static_cast<double>(numBoxes) * kNumViews;
+  std::cout << numBoxes << " boxes, " << kNumViews << " views (best of " << kNumRuns << " runs)" << std::endl;
+  std::cout << "  culled " << 100.0 * (1.0 - numVisible / numTests) << "% of the boxes, " << numBorderline
+            << " tests were too close to a plane to check" << std::endl;
+  std::cout << "  built the hierarchy in " << buildMilliseconds << " ms" << std::endl;
+  std::cout << "  hierarchy: " << 1e3 * hierarchyMilliseconds / kNumViews << " us per view" << std::endl;
+  std::cout << "  each box on its own: " << 1e3 * bruteForceMilliseconds / kNumViews << " us per view" << std::endl;
+  std::cout << "  speedup: " << bruteForceMilliseconds / hierarchyMilliseconds << "x" << std::endl;
+  if (numMismatches > 0) {
+    std::cerr << "Error: the hierarchy disagreed with testing each box on its own " << numMismatches << " times."
+              << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,114 @@
+// Decodes the small PNG, JPEG and TGA files in tests/data with the portable decoders (through Image::LoadImageFile),
+// and compares their pixels with what they were made from.
+//
+// The lossless files all hold the image that ExpectedPixel describes, 17x13 so that nothing lines up with the formats'
+// blocks. The JPEGs were made from the same image's colors, so they're compared with the .rgba file next to each,
+// which libjpeg decoded them to with its default settings; the decoder is meant to match it exactly.
+//
+// Usage: image_decoder_test <tests/data directory>
+
+#include "d3d12/ImageLoader.h"
+#include "utils/MappedFile.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+constexpr size_t kWidth = 17;
+constexpr size_t kHeight = 13;
+
+// Three columns at a time share a color, so that the run-length encoded files have runs in them.
+void ExpectedPixel(size_t x, size_t y, bool hasAlpha, unsigned char pixel[4]) {
+  const size_t column = x / 3;
+  pixel[0] = static_cast<unsigned char>(column * 40);
+  pixel[1] = static_cast<unsigned char>(y * 20);
+  pixel[2] = static_cast<unsigned char>((column * y * 7) & 255);
+  pixel[3] = hasAlpha ? static_cast<unsigned char>(255 - (column + y) * 10) : 255;
+}
+
+std::vector<unsigned char> GenerateExpectedPixels(bool hasAlpha) {
+  std::vector<unsigned char> pixels(kWidth * kHeight * 4);
+  for (size_t y = 0; y < kHeight; ++y) {
+    for (size_t x = 0; x < kWidth; ++x)
+      ExpectedPixel(x, y, hasAlpha, &pixels[(y * kWidth + x) * 4]);
+  }
+  return pixels;
+}
+
+bool ReadExpectedPixels(const std::filesystem::path& file, std::vector<unsigned char>* pixels) {
+  MappedFile mappedFile;
+  if (!mappedFile.Open(file.string()) || mappedFile.GetSize() != kWidth * kHeight * 4)
+    return false;
+
+  pixels->assign(mappedFile.GetData(), mappedFile.GetData() + mappedFile.GetSize());
+  return true;
+}
+
+bool CheckImage(const std::filesystem::path& file, const std::vector<unsigned char>& expectedPixels) {
+  Image image;
+  if (!Image::LoadImageFile(file, &image)) {
+    std::cerr << "Error: could not decode " << file.string() << std::endl;
+    return false;
+  }
+
+  if (image.width != kWidth || image.height != kHeight || image.format != ImageFormat::R8G8B8A8 ||
+      image.data.size() != expectedPixels.size()) {
+    std::cerr << "Error: " << file.string() << " decoded to a " << image.width << "x" << image.height
+              << " image, rather than " << kWidth << "x" << kHeight << std::endl;
+    return false;
+  }
+
+  size_t numMismatches = 0;
+  int maxDifference = 0;
+  for (size_t i = 0; i < expectedPixels.size(); ++i) {
+    const int difference = abs(image.data[i] - expectedPixels[i]);
+    numMismatches += difference != 0 ? 1 : 0;
+    maxDifference = std::max(maxDifference, difference);
+  }
+
+  std::cout << "  " << file.filename().string() << ": ";
+  if (numMismatches == 0) {
+    std::cout << "matches" << std::endl;
+    return true;
+  }
+  std::cout << numMismatches << " channels differ, by up to " << maxDifference << std::endl;
+  return false;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc != 2) {
+    std::cerr << "Usage: " << argv[0] << " <tests/data directory>" << std::endl;
+    return 1;
+  }
+
+  const std::filesystem::path directory = argv[1];
+  const std::vector<unsigned char> pixelsWithAlpha = GenerateExpectedPixels(/*hasAlpha*/ true);
+  const std::vector<unsigned char> opaquePixels = GenerateExpectedPixels(/*hasAlpha*/ false);
+
+  bool allMatch = true;
+  std::cout << "Decoding the images in " << directory.string() << ":" << std::endl;
+  allMatch &= CheckImage(directory / "rgba.png", pixelsWithAlpha);
+  allMatch &= CheckImage(directory / "palette_interlaced.png", pixelsWithAlpha);
+  allMatch &= CheckImage(directory / "rle_bottom_up.tga", pixelsWithAlpha);
+  allMatch &= CheckImage(directory / "truecolor_top_down.tga", opaquePixels);
+
+  for (const char* name : {"baseline_444", "baseline_420"}) {
+    std::vector<unsigned char> libjpegPixels;
+    if (!ReadExpectedPixels(directory / (std::string(name) + ".rgba"), &libjpegPixels)) {
+      std::cerr << "Error: could not read " << name << ".rgba" << std::endl;
+      allMatch = false;
+      continue;
+    }
+    allMatch &= CheckImage(directory / (std::string(name) + ".jpg"), libjpegPixels);
+  }
+
+  return allMatch ? 0 : 1;
+}
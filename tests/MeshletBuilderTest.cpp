@@ -0,0 +1,254 @@
+// Builds meshlets for generated meshes with MeshletBuilder and checks them: that each stays within the size limits,
+// that a part's meshlets cover each of its triangles exactly once, and that their bounding spheres and normal cones
+// hold for every triangle in them.
+//
+// Usage: meshlet_builder_test
+
+#include "d3d12/MeshletBuilder.h"
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+constexpr size_t kNumViews = 256;
+
+bool g_failed = false;
+
+void Check(bool condition, const std::string& description) {
+  if (!condition) {
+    std::cerr << "Error: " << description << std::endl;
+    g_failed = true;
+  }
+}
+
+struct Mesh {
+  std::vector<ObjFileData::Vertex> vertices;
+  std::vector<uint32_t> indices;
+};
+
+// A UV sphere, its triangles wound counterclockwise seen from outside, in rows from pole to pole.
+Mesh GenerateSphere(size_t numSegments, size_t numRings, float radius) {
+  Mesh mesh;
+  for (size_t ring = 0; ring <= numRings; ++ring) {
+    const float polar = 3.14159265f * ring / numRings;
+    for (size_t segment = 0; segment <= numSegments; ++segment) {
+      const float azimuth = 2.f * 3.14159265f * segment / numSegments;
+      ObjFileData::Vertex vertex = {};
+      vertex.pos[0] = radius * sinf(polar) * cosf(azimuth);
+      vertex.pos[1] = radius * cosf(polar);
+      vertex.pos[2] = -radius * sinf(polar) * sinf(azimuth);
+      mesh.vertices.push_back(vertex);
+    }
+  }
+
+  const uint32_t rowSize = static_cast<uint32_t>(numSegments + 1);
+  for (uint32_t ring = 0; ring < numRings; ++ring) {
+    for (uint32_t segment = 0; segment < numSegments; ++segment) {
+      const uint32_t topLeft = ring * rowSize + segment;
+      const uint32_t bottomLeft = topLeft + rowSize;
+      // The triangles at the poles come out degenerate, which the meshlets have to cope with too.
+      mesh.indices.insert(mesh.indices.end(), {topLeft, bottomLeft, bottomLeft + 1, topLeft, bottomLeft + 1,
+                                               topLeft + 1});
+    }
+  }
+  return mesh;
+}
+
+// Scatters the triangles, so that hardly any of them share vertices with the ones before and the meshlets fill up on
+// vertices long before they do on triangles.
+void ShuffleTriangles(Mesh* mesh) {
+  std::vector<uint32_t> triangles(mesh->indices.size() / 3);
+  for (size_t t = 0; t < triangles.size(); ++t)
+    triangles[t] = static_cast<uint32_t>(t);
+  std::shuffle(triangles.begin(), triangles.end(), std::mt19937(1));
+
+  std::vector<uint32_t> indices;
+  indices.reserve(mesh->indices.size());
+  for (uint32_t t : triangles)
+    indices.insert(indices.end(), &mesh->indices[3 * t], &mesh->indices[3 * t + 3]);
+  mesh->indices.swap(indices);
+}
+
+// The normal of a triangle that isn't degenerate, unnormalized.
+bool GetTriangleNormal(const Mesh& mesh, const uint32_t* triangle, /*out*/ double normal[3]) {
+  const float* p0 = mesh.vertices[triangle[0]].pos;
+  const float* p1 = mesh.vertices[triangle[1]].pos;
+  const float* p2 = mesh.vertices[triangle[2]].pos;
+  const double e1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+  const double e2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+  normal[0] = e1[1] * e2[2] - e1[2] * e2[1];
+  normal[1] = e1[2] * e2[0] - e1[0] * e2[2];
+  normal[2] = e1[0] * e2[1] - e1[1] * e2[0];
+  return normal[0] != 0.0 || normal[1] != 0.0 || normal[2] != 0.0;
+}
+
+// Checks the meshlets of the part with the given range of indices, and returns how many of them were found to be
+// backfacing from random views around the mesh.
+size_t CheckMeshlets(const std::string& name,
+                     const Mesh& mesh,
+                     uint32_t indexStart,
+                     uint32_t numIndices,
+                     const ObjFileData::Meshlet* meshlets,
+                     size_t numMeshlets) {
+  // Each meshlet has to pick up where the one before it left off, and the last one has to end with the part, so that
+  // every triangle is in exactly one of them.
+  uint32_t nextIndex = indexStart;
+  size_t numOutsideSphere = 0;
+  for (size_t m = 0; m < numMeshlets; ++m) {
+    const ObjFileData::Meshlet& meshlet = meshlets[m];
+    const std::string description = name + ", meshlet " + std::to_string(m);
+    Check(meshlet.indexStart == nextIndex, description + ": doesn't start where the one before it ends");
+    Check(meshlet.numIndices > 0 && meshlet.numIndices % 3 == 0,
+          description + ": should have a whole number of triangles, and at least one");
+    Check(meshlet.numIndices / 3 <= MeshletBuilder::kMaxTriangles, description + ": has too many triangles");
+    nextIndex = meshlet.indexStart + meshlet.numIndices;
+    if (nextIndex > indexStart + numIndices) {
+      Check(false, description + ": runs past the end of its part");
+      return 0;
+    }
+
+    std::unordered_set<uint32_t> distinctVertices;
+    for (uint32_t i = meshlet.indexStart; i < nextIndex; ++i) {
+      const uint32_t v = mesh.indices[i];
+      if (v >= mesh.vertices.size()) {
+        Check(false, description + ": has a vertex index out of range");
+        return 0;
+      }
+      distinctVertices.insert(v);
+    }
+    Check(meshlet.numVertices == distinctVertices.size(), description + ": has the wrong number of vertices");
+    Check(distinctVertices.size() <= MeshletBuilder::kMaxVertices, description + ": has too many vertices");
+
+    for (uint32_t v : distinctVertices) {
+      const float* pos = mesh.vertices[v].pos;
+      const double d[3] = {pos[0] - meshlet.center[0], pos[1] - meshlet.center[1], pos[2] - meshlet.center[2]};
+      numOutsideSphere += sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]) > meshlet.radius ? 1 : 0;
+    }
+  }
+  Check(nextIndex == indexStart + numIndices, name + ": the meshlets don't cover the whole part");
+  Check(numOutsideSphere == 0, name + ": " + std::to_string(numOutsideSphere) + " vertices are outside their sphere");
+
+  // Wherever a meshlet's cone says that it's backfacing, each of its triangles really has to be seen from behind (or
+  // edge on, give or take rounding, which grows with the mesh's distance from the origin). The views are spread
+  // around the mesh.
+  float min[3] = {INFINITY, INFINITY, INFINITY};
+  float max[3] = {-INFINITY, -INFINITY, -INFINITY};
+  for (const ObjFileData::Vertex& vertex : mesh.vertices) {
+    for (size_t axis = 0; axis < 3; ++axis) {
+      min[axis] = std::min(min[axis], vertex.pos[axis]);
+      max[axis] = std::max(max[axis], vertex.pos[axis]);
+    }
+  }
+  float extent = 0.f;
+  std::uniform_real_distribution<float> coordinates[3];
+  for (size_t axis = 0; axis < 3; ++axis) {
+    extent = std::max({extent, fabsf(min[axis]), fabsf(max[axis])});
+    const float center = (min[axis] + max[axis]) * 0.5f;
+    const float size = max[axis] - min[axis];
+    coordinates[axis] = std::uniform_real_distribution<float>(center - 3.f * size, center + 3.f * size);
+  }
+
+  std::mt19937 random(2);
+  size_t numBackfacing = 0;
+  size_t numFrontFacing = 0;
+  for (size_t view = 0; view < kNumViews; ++view) {
+    const float viewPosition[3] = {coordinates[0](random), coordinates[1](random), coordinates[2](random)};
+    for (size_t m = 0; m < numMeshlets; ++m) {
+      if (!MeshletBuilder::IsBackfacing(meshlets[m], viewPosition))
+        continue;
+
+      ++numBackfacing;
+      for (uint32_t i = meshlets[m].indexStart; i < meshlets[m].indexStart + meshlets[m].numIndices; i += 3) {
+        double normal[3];
+        if (!GetTriangleNormal(mesh, &mesh.indices[i], normal))
+          continue;
+        const float* corner = mesh.vertices[mesh.indices[i]].pos;
+        const double toView[3] = {viewPosition[0] - corner[0], viewPosition[1] - corner[1],
+                                  viewPosition[2] - corner[2]};
+        const double length = sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        const double distance = (normal[0] * toView[0] + normal[1] * toView[1] + normal[2] * toView[2]) / length;
+        numFrontFacing += distance > 1e-5 * extent ? 1 : 0;
+      }
+    }
+  }
+  Check(numFrontFacing == 0,
+        name + ": " + std::to_string(numFrontFacing) + " triangles face the view in meshlets culled as backfacing");
+  return numBackfacing;
+}
+
+void CheckMesh(const std::string& name, const Mesh& mesh) {
+  std::vector<ObjFileData::Meshlet> meshlets;
+  MeshletBuilder::BuildMeshlets(mesh.vertices.data(), mesh.vertices.size(), mesh.indices.data(), 0,
+                                static_cast<uint32_t>(mesh.indices.size()), &meshlets);
+  const size_t numBackfacing =
+      CheckMeshlets(name, mesh, 0, static_cast<uint32_t>(mesh.indices.size()), meshlets.data(), meshlets.size());
+
+  std::cout << "  " << name << ": " << mesh.indices.size() / 3 << " triangles in " << meshlets.size()
+            << " meshlets, " << 100.0 * numBackfacing / (meshlets.size() * kNumViews)
+            << "% backfacing from random views" << std::endl;
+}
+
+// Splits the mesh into parts of different sizes, some smaller than a meshlet, and checks that Build gives each its
+// own meshlets.
+void CheckParts(const Mesh& mesh) {
+  ObjFileData data;
+  data.m_vertices = mesh.vertices;
+  data.m_indices = mesh.indices;
+  const uint32_t numTriangles = static_cast<uint32_t>(mesh.indices.size() / 3);
+  const uint32_t partSizes[] = {1, 7, MeshletBuilder::kMaxTriangles, MeshletBuilder::kMaxTriangles + 1, 500};
+  uint32_t triangle = 0;
+  for (size_t p = 0; triangle < numTriangles; ++p) {
+    const uint32_t size = std::min(partSizes[p % 5], numTriangles - triangle);
+    ObjFileData::MeshPart part = {};
+    part.indexStart = 3 * triangle;
+    part.numIndices = 3 * size;
+    data.m_meshParts.push_back(part);
+    triangle += size;
+  }
+
+  MeshletBuilder::Build(&data);
+  uint32_t nextMeshlet = 0;
+  for (size_t p = 0; p < data.m_meshParts.size(); ++p) {
+    const ObjFileData::MeshPart& part = data.m_meshParts[p];
+    const std::string name = "part " + std::to_string(p);
+    Check(part.meshletStart == nextMeshlet, name + ": its meshlets don't follow the last part's");
+    nextMeshlet = part.meshletStart + part.numMeshlets;
+    if (nextMeshlet > data.m_meshlets.size()) {
+      Check(false, name + ": its meshlets run past the end");
+      return;
+    }
+    CheckMeshlets(name, mesh, part.indexStart, part.numIndices,
+                  &data.m_meshlets[part.meshletStart], part.numMeshlets);
+  }
+  Check(nextMeshlet == data.m_meshlets.size(), "there are meshlets that belong to no part");
+  std::cout << "  " << data.m_meshParts.size() << " parts: " << data.m_meshlets.size() << " meshlets" << std::endl;
+}
+}  // namespace
+
+int main() {
+  std::cout << "Building meshlets:" << std::endl;
+  const Mesh sphere = GenerateSphere(/*numSegments*/ 96, /*numRings*/ 48, /*radius*/ 10.f);
+  CheckMesh("sphere", sphere);
+
+  Mesh shuffledSphere = sphere;
+  ShuffleTriangles(&shuffledSphere);
+  CheckMesh("shuffled sphere", shuffledSphere);
+
+  // Far from the origin, where the rounding in the sphere's and the cone's computations is at its worst.
+  Mesh farSphere = GenerateSphere(/*numSegments*/ 40, /*numRings*/ 20, /*radius*/ 0.5f);
+  for (ObjFileData::Vertex& vertex : farSphere.vertices)
+    vertex.pos[0] += 1000.f;
+  CheckMesh("sphere far from the origin", farSphere);
+
+  CheckParts(sphere);
+
+  return g_failed ? 1 : 0;
+}
@@ -0,0 +1,209 @@
+// Checks MipGeneration::GenerateMips against a reduction worked out by hand and against a mip chain computed
+// independently, in double precision, and times both filters on a large image.
+//
+// Usage: mip_generation_test
+
+#include "utils/MipGeneration.h"
+
+#include <math.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace {
+constexpr size_t kTimedImageSize = 2048;
+
+bool g_failed = false;
+
+void Check(bool condition, const char* description) {
+  if (!condition) {
+    std::cerr << "Error: " << description << std::endl;
+    g_failed = true;
+  }
+}
+
+double SrgbToLinear(double value) {
+  return value <= 0.04045 ? value / 12.92 : pow((value + 0.055) / 1.055, 2.4);
+}
+
+double LinearToSrgb(double value) {
+  return value <= 0.0031308 ? value * 12.92 : 1.055 * pow(value, 1.0 / 2.4) - 0.055;
+}
+
+// Box filters |source| down to the next level straight from the definition: each texel of the smaller level averages
+// the area of the larger level that it covers, with the color channels in linear space.
+std::vector<unsigned char> ReferenceDownsample(const std::vector<unsigned char>& source,
+                                               size_t sourceWidth,
+                                               size_t sourceHeight,
+                                               size_t destinationWidth,
+                                               size_t destinationHeight) {
+  const double scaleX = static_cast<double>(sourceWidth) / destinationWidth;
+  const double scaleY = static_cast<double>(sourceHeight) / destinationHeight;
+  auto overlap = [](double begin, double end, size_t texel) {
+    return std::max(0.0, std::min(end, texel + 1.0) - std::max(begin, static_cast<double>(texel)));
+  };
+
+  std::vector<unsigned char> destination(destinationWidth * destinationHeight * 4);
+  for (size_t y = 0; y < destinationHeight; ++y) {
+    for (size_t x = 0; x < destinationWidth; ++x) {
+      double sums[4] = {0.0, 0.0, 0.0, 0.0};
+      double totalWeight = 0.0;
+      for (size_t sy = 0; sy < sourceHeight; ++sy) {
+        const double weightY = overlap(y * scaleY, (y + 1) * scaleY, sy);
+        for (size_t sx = 0; sx < sourceWidth && weightY > 0.0; ++sx) {
+          const double weight = weightY * overlap(x * scaleX, (x + 1) * scaleX, sx);
+          const unsigned char* texel = &source[(sy * sourceWidth + sx) * 4];
+          for (size_t c = 0; c < 3; ++c)
+            sums[c] += weight * SrgbToLinear(texel[c] / 255.0);
+          sums[3] += weight * (texel[3] / 255.0);
+          totalWeight += weight;
+        }
+      }
+
+      unsigned char* texel = &destination[(y * destinationWidth + x) * 4];
+      for (size_t c = 0; c < 3; ++c)
+        texel[c] = static_cast<unsigned char>(lround(255.0 * LinearToSrgb(sums[c] / totalWeight)));
+      texel[3] = static_cast<unsigned char>(lround(255.0 * sums[3] / totalWeight));
+    }
+  }
+  return destination;
+}
+
+// With |rowPitch| bytes to each row, including any padding.
+std::vector<unsigned char> GenerateRandomImage(size_t height, size_t rowPitch) {
+  std::mt19937 random(1);
+  std::uniform_int_distribution<int> byte(0, 255);
+  std::vector<unsigned char> image(rowPitch * height);
+  for (unsigned char& value : image)
+    value = static_cast<unsigned char>(byte(random));
+  return image;
+}
+
+// Both for a color channel and for alpha, averaging black and white has to land halfway in linear terms: 188 in sRGB
+// (not the 128 that averaging the codes would give), and 128 for alpha.
+void CheckTwoByTwo() {
+  const unsigned char pixels[2 * 2 * 4] = {
+      0,   0,   0,   0,    255, 255, 255, 255,  // First row.
+      255, 255, 255, 255,  0,   0,   0,   0,    // Second row.
+  };
+  for (MipGeneration::Filter filter : {MipGeneration::Filter::Box, MipGeneration::Filter::Kaiser}) {
+    const std::vector<unsigned char> mips = MipGeneration::GenerateMips(filter, pixels, 2, 2, 2 * 4);
+    Check(mips.size() == 4, "a 2x2 image should have a single 1x1 mip below it");
+    if (mips.size() != 4)
+      continue;
+    Check(mips[0] == 188 && mips[1] == 188 && mips[2] == 188, "black and white should average to sRGB 188");
+    Check(mips[3] == 128, "alpha 0 and 255 should average to 128");
+  }
+}
+
+// Compares the whole box-filtered chain with ReferenceDownsample, starting each level from GenerateMips's own previous
+// level so that rounding differences don't build up. The rows of the image are padded, to check that |rowPitch| is
+// honored.
+void CheckChain(size_t width, size_t height) {
+  const size_t rowPitch = width * 4 + 12;
+  const std::vector<unsigned char> image = GenerateRandomImage(height, rowPitch);
+  const std::vector<unsigned char> mips =
+      MipGeneration::GenerateMips(MipGeneration::Filter::Box, image.data(), width, height, rowPitch);
+
+  std::vector<unsigned char> source(width * height * 4);
+  for (size_t y = 0; y < height; ++y)
+    std::copy_n(&image[y * rowPitch], width * 4, &source[y * width * 4]);
+
+  const size_t numMips = MipGeneration::GetNumMips(width, height);
+  size_t offset = 0;
+  int maxDifference = 0;
+  for (size_t mip = 1; mip < numMips; ++mip) {
+    const size_t sourceWidth = MipGeneration::GetMipSize(width, mip - 1);
+    const size_t sourceHeight = MipGeneration::GetMipSize(height, mip - 1);
+    const size_t mipWidth = MipGeneration::GetMipSize(width, mip);
+    const size_t mipHeight = MipGeneration::GetMipSize(height, mip);
+    const size_t mipSize = mipWidth * mipHeight * 4;
+    if (offset + mipSize > mips.size()) {
+      Check(false, "the mip chain is too short");
+      return;
+    }
+
+    const std::vector<unsigned char> reference =
+        ReferenceDownsample(source, sourceWidth, sourceHeight, mipWidth, mipHeight);
+    for (size_t i = 0; i < mipSize; ++i)
+      maxDifference = std::max(maxDifference, abs(mips[offset + i] - reference[i]));
+
+    source.assign(mips.begin() + offset, mips.begin() + offset + mipSize);
+    offset += mipSize;
+  }
+  Check(offset == mips.size(), "the mip chain is too long");
+
+  // GenerateMips filters in single precision, so a value that falls right between two codes can round either way.
+  std::cout << "  " << width << "x" << height << ": " << numMips - 1 << " mips, off by at most " << maxDifference
+            << std::endl;
+  Check(maxDifference <= 1, "the box-filtered chain differs from the reference by more than one code");
+}
+
+// A filter whose weights add up to one leaves a flat image as it is, however far its taps reach past the edges.
+void CheckFlatImage(MipGeneration::Filter filter) {
+  const size_t width = 37;
+  const size_t height = 12;
+  std::vector<unsigned char> image(width * height * 4);
+  for (size_t i = 0; i < image.size(); i += 4) {
+    image[i + 0] = 200;
+    image[i + 1] = 90;
+    image[i + 2] = 3;
+    image[i + 3] = 77;
+  }
+
+  const std::vector<unsigned char> mips = MipGeneration::GenerateMips(filter, image.data(), width, height, width * 4);
+  bool isFlat = true;
+  for (size_t i = 0; i < mips.size(); ++i)
+    isFlat &= abs(mips[i] - image[i % 4]) <= 1;
+  Check(isFlat, "a flat image should stay flat");
+}
+
+void CheckSizes() {
+  Check(MipGeneration::GetNumMips(1, 1) == 1, "a 1x1 image has a single level");
+  Check(MipGeneration::GetNumMips(256, 256) == 9, "a 256x256 image has 9 levels");
+  Check(MipGeneration::GetNumMips(5, 3) == 3, "a 5x3 image has 3 levels");
+  Check(MipGeneration::GetNumMips(1, 8) == 4, "a 1x8 image has 4 levels");
+  Check(MipGeneration::GetMipSize(5, 1) == 2 && MipGeneration::GetMipSize(5, 2) == 1 &&
+            MipGeneration::GetMipSize(5, 7) == 1,
+        "mip sizes should halve, rounding down, to no less than 1");
+}
+
+void TimeFilter(MipGeneration::Filter filter, const char* name, const std::vector<unsigned char>& image) {
+  double bestMilliseconds = 0.0;
+  for (int run = 0; run < 3; ++run) {
+    const auto start = std::chrono::steady_clock::now();
+    const std::vector<unsigned char> mips =
+        MipGeneration::GenerateMips(filter, image.data(), kTimedImageSize, kTimedImageSize, kTimedImageSize * 4);
+    const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    if (run == 0 || elapsed.count() < bestMilliseconds)
+      bestMilliseconds = elapsed.count();
+  }
+  std::cout << "  " << name << ": " << bestMilliseconds << " ms" << std::endl;
+}
+}  // namespace
+
+int main() {
+  CheckSizes();
+  CheckTwoByTwo();
+
+  std::cout << "Box filter against the reference:" << std::endl;
+  // Square and not, with and without odd sizes along the way.
+  const size_t sizes[][2] = {{64, 64}, {256, 32}, {37, 12}, {1, 9}, {5, 3}};
+  for (const size_t* size : sizes)
+    CheckChain(size[0], size[1]);
+  CheckFlatImage(MipGeneration::Filter::Box);
+  CheckFlatImage(MipGeneration::Filter::Kaiser);
+
+  std::cout << "Generating the mips of a " << kTimedImageSize << "x" << kTimedImageSize << " image (best of 3 runs):"
+            << std::endl;
+  const std::vector<unsigned char> image = GenerateRandomImage(kTimedImageSize, kTimedImageSize * 4);
+  TimeFilter(MipGeneration::Filter::Box, "box", image);
+  TimeFilter(MipGeneration::Filter::Kaiser, "Kaiser", image);
+
+  return g_failed ? 1 : 0;
+}
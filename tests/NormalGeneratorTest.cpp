@@ -0,0 +1,80 @@
+// Parses small obj files without normals and checks the vertices that NormalGenerator leaves behind: flat faces should
+// get exactly the same normal at every corner, so that the corners they share end up as one vertex.
+//
+// Usage: normal_generator_test
+
+#include "d3d12/ObjFileLoader.h"
+
+#include <math.h>
+#include <stddef.h>
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+namespace {
+bool g_failed = false;
+
+void Check(bool condition, const std::string& description) {
+  if (!condition) {
+    std::cerr << "Error: " << description << std::endl;
+    g_failed = true;
+  }
+}
+
+bool ParseObjText(const std::string& text, /*out*/ ObjFileData* data) {
+  const std::filesystem::path file = std::filesystem::temp_directory_path() / "normal_generator_test.obj";
+  {
+    std::ofstream stream(file, std::ios::binary);
+    stream << text;
+  }
+  const bool succeeded = data->ParseObjFile(file.string());
+  std::filesystem::remove(file);
+  return succeeded;
+}
+
+// Every vertex of a model that lies in the y = 0 plane, facing up, should have a normal of exactly (+0, 1, +0).
+void CheckFlatModel(const std::string& name, const std::string& text, size_t expectedNumVertices) {
+  ObjFileData data;
+  if (!ParseObjText(text, &data)) {
+    Check(false, name + ": could not parse the model");
+    return;
+  }
+
+  size_t numUpright = 0;
+  for (const ObjFileData::Vertex& vertex : data.m_vertices) {
+    const bool isUpright = vertex.normal[0] == 0.f && !signbit(vertex.normal[0]) && vertex.normal[1] == 1.f &&
+                           vertex.normal[2] == 0.f && !signbit(vertex.normal[2]);
+    numUpright += isUpright ? 1 : 0;
+  }
+
+  std::cout << "  " << name << ": " << data.m_vertices.size() << " vertices, " << data.m_indices.size() / 3
+            << " triangles" << std::endl;
+  Check(numUpright == data.m_vertices.size(), name + ": every normal should be exactly (+0, 1, +0)");
+  Check(data.m_vertices.size() == expectedNumVertices,
+        name + ": expected " + std::to_string(expectedNumVertices) + " vertices");
+}
+}  // namespace
+
+int main() {
+  // The quads start at different corners, so that the cross products of their triangles come out with zeros of
+  // both signs: one of the second quad's triangles gets a normal of (-0, 1, 0). Every corner has the same texture
+  // coordinates, as the parser needs some.
+  const std::string separateQuads =
+      "v 0 0 0\nv 0 0 1\nv 1 0 1\nv 1 0 0\n"
+      "v 2 0 1\nv 3 0 1\nv 3 0 0\nv 2 0 0\n"
+      "vt 0 0\n";
+  const std::string sharedEdgeQuads =
+      "v 0 0 0\nv 0 0 1\nv 1 0 1\nv 1 0 0\nv 2 0 1\nv 2 0 0\n"
+      "vt 0 0\n"
+      "f 1/1 2/1 3/1 4/1\nf 3/1 5/1 6/1 4/1\n";
+
+  std::cout << "Generating normals:" << std::endl;
+  CheckFlatModel("separate quads, s off", separateQuads + "s off\nf 1/1 2/1 3/1 4/1\nf 5/1 6/1 7/1 8/1\n", 8);
+  CheckFlatModel("separate quads, smoothed", separateQuads + "f 1/1 2/1 3/1 4/1\nf 5/1 6/1 7/1 8/1\n", 8);
+  CheckFlatModel("shared edge, s off", "s off\n" + sharedEdgeQuads, 6);
+  CheckFlatModel("shared edge, smoothed", sharedEdgeQuads, 6);
+
+  return g_failed ? 1 : 0;
+}
@@ -0,0 +1,242 @@
+// Streams generated obj files through StreamingObjLoader, and checks the batches against what ObjFileData::ParseObjFile
+// makes of the same files: that the progress batches add up to the file as parsed, that the final batch comes last and
+// replaces them with the finished model, and that loading the model again from its mesh cache gives the same result.
+//
+// Usage: streaming_obj_loader_test
+
+#include "d3d12/MeshCache.h"
+#include "d3d12/StreamingObjLoader.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+bool g_failed = false;
+
+void Check(bool condition, const std::string& description) {
+  if (!condition) {
+    std::cerr << "Error: " << description << std::endl;
+    g_failed = true;
+  }
+}
+
+// A square grid of |size| by |size| quads, in two halves with different materials. Files are parsed in chunks of a few
+// megabytes, and each chunk is a progress batch of its own, so a large enough grid is streamed in several batches.
+void WriteGrid(const std::filesystem::path& file, size_t size) {
+  std::filesystem::path materialFile = file;
+  materialFile.replace_extension(".mtl");
+  {
+    std::ofstream stream(materialFile, std::ios::binary);
+    stream << "newmtl red\nKd 1 0 0\n\nnewmtl green\nKd 0 1 0\n";
+  }
+
+  std::ofstream stream(file, std::ios::binary);
+  stream << "mtllib " << materialFile.filename().string() << "\nvn 0 1 0\n";
+  for (size_t z = 0; z <= size; ++z) {
+    for (size_t x = 0; x <= size; ++x) {
+      stream << "v " << x << " " << (x * z) % 7 << " " << z << "\n";
+      stream << "vt " << static_cast<float>(x) / size << " " << static_cast<float>(z) / size << "\n";
+    }
+  }
+  for (size_t z = 0; z < size; ++z) {
+    if (z == 0 || z == size / 2)
+      stream << "usemtl " << (z == 0 ? "red" : "green") << "\n";
+    for (size_t x = 0; x < size; ++x) {
+      const size_t corners[4] = {z * (size + 1) + x + 1, (z + 1) * (size + 1) + x + 1, (z + 1) * (size + 1) + x + 2,
+                                 z * (size + 1) + x + 2};
+      stream << "f";
+      for (size_t corner : corners)
+        stream << " " << corner << "/" << corner << "/1";
+      stream << "\n";
+    }
+  }
+}
+
+struct StreamedModel {
+  size_t numBatches = 0;
+  size_t numMaterials = 0;
+  // The geometry of the progress batches, put together.
+  std::vector<ObjFileData::Vertex> vertices;
+  std::vector<uint32_t> indices;
+  StreamingObjLoader::Batch finalBatch;
+  bool hasFinalBatch = false;
+};
+
+void StreamModel(const std::string& name, const std::filesystem::path& file, /*out*/ StreamedModel* model) {
+  // The loader writes the mesh cache on its thread after the final batch, and is done with it once it's destroyed.
+  StreamingObjLoader loader;
+  loader.Start(file.string());
+  StreamingObjLoader::Batch batch;
+  while (loader.WaitForNextBatch(&batch)) {
+    ++model->numBatches;
+    Check(!model->hasFinalBatch, name + ": a batch came after the final one");
+    model->numMaterials += batch.materials.size();
+    if (batch.isFinal) {
+      model->hasFinalBatch = true;
+      model->finalBatch = std::move(batch);
+      continue;
+    }
+
+    Check(!batch.replacesGeometry, name + ": only the final batch should replace the geometry");
+    Check(batch.quantizedVertices.empty() && batch.tangents.empty() && batch.lods.empty() &&
+              batch.packedIndices.firstDraws.empty(),
+          name + ": a progress batch has data that should only come with the final batch");
+    model->vertices.insert(model->vertices.end(), batch.vertices.begin(), batch.vertices.end());
+    model->indices.insert(model->indices.end(), batch.indices.begin(), batch.indices.end());
+
+    size_t numIndicesOutOfRange = 0;
+    for (uint32_t index : model->indices)
+      numIndicesOutOfRange += index >= model->vertices.size() ? 1 : 0;
+    Check(numIndicesOutOfRange == 0, name + ": a progress batch uses vertices that haven't been sent yet");
+    for (const ObjFileData::MeshPart& part : batch.meshParts) {
+      Check(part.indexStart + part.numIndices <= model->indices.size(),
+            name + ": a progress batch has a mesh part past the indices sent so far");
+    }
+  }
+  Check(model->hasFinalBatch, name + ": there was no final batch");
+}
+
+// The indices of the draws [firstDraw, endDraw) of the batch's packed indices, as 32-bit indices into the vertices.
+bool UnpackDraws(const StreamingObjLoader::Batch& batch,
+                 uint32_t firstDraw,
+                 uint32_t endDraw,
+                 /*out*/ std::vector<uint32_t>* indices) {
+  const StreamingObjLoader::Batch::BufferData pool = batch.GetIndexData();
+  const uint16_t* elements = static_cast<const uint16_t*>(pool.data);
+  indices->clear();
+  for (uint32_t d = firstDraw; d < endDraw; ++d) {
+    const IndexPacking::Draw& draw = batch.packedIndices.draws[d];
+    if ((draw.indexSize != 2 && draw.indexSize != 4) ||
+        (static_cast<size_t>(draw.indexStart) + draw.numIndices) * draw.indexSize > pool.size) {
+      return false;
+    }
+
+    for (uint32_t i = 0; i < draw.numIndices; ++i) {
+      uint32_t index = 0;
+      if (draw.indexSize == 2) {
+        index = elements[draw.indexStart + i];
+      } else {
+        memcpy(&index, &elements[2 * (static_cast<size_t>(draw.indexStart) + i)], sizeof(index));
+      }
+      indices->push_back(index + draw.baseVertex);
+    }
+  }
+  return true;
+}
+
+// The final batch has to hold all of the parsed model, whether it came from the parser or from the cache.
+void CheckFinalBatch(const std::string& name, const StreamingObjLoader::Batch& batch, const ObjFileData& data) {
+  Check(batch.succeeded, name + ": the final batch says that loading failed");
+  Check(batch.replacesGeometry, name + ": the final batch should replace the geometry of the batches before it");
+  Check(batch.indices.empty(), name + ": the final batch should only have packed indices");
+
+  const StreamingObjLoader::Batch::BufferData vertexData = batch.GetVertexData();
+  Check(vertexData.size == data.m_vertices.size() * sizeof(ObjFileData::Vertex) &&
+            memcmp(vertexData.data, data.m_vertices.data(), vertexData.size) == 0,
+        name + ": the final batch's vertices differ from the parsed ones");
+  Check(batch.GetTangentData().size == data.m_tangents.size() * sizeof(ObjFileData::Tangent),
+        name + ": the final batch has the wrong number of tangents");
+  Check(memcmp(&batch.bounds, &data.m_bounds, sizeof(batch.bounds)) == 0, name + ": the bounds differ");
+
+  const std::vector<ObjFileData::MeshPart>& parts = batch.meshParts;
+  const std::vector<ObjFileData::MeshLod>& lods = batch.lods;
+  const std::vector<uint32_t>& firstDraws = batch.packedIndices.firstDraws;
+  if (parts.size() != data.m_meshParts.size() || lods.size() != data.m_lods.size() ||
+      firstDraws.size() != parts.size() + lods.size() + 1 || firstDraws.back() != batch.packedIndices.draws.size()) {
+    Check(false, name + ": the final batch has the wrong number of mesh parts, levels of detail or draws");
+    return;
+  }
+
+  // Each mesh part's draws, then each level of detail's, unpack to the same indices as the parser's.
+  std::vector<uint32_t> indices;
+  size_t numMismatches = 0;
+  for (size_t i = 0; i + 1 < firstDraws.size(); ++i) {
+    const bool isPart = i < parts.size();
+    const uint32_t indexStart = isPart ? parts[i].indexStart : lods[i - parts.size()].indexStart;
+    const uint32_t numIndices = isPart ? parts[i].numIndices : lods[i - parts.size()].numIndices;
+    const uint32_t expectedStart = isPart ? data.m_meshParts[i].indexStart : data.m_lods[i - parts.size()].indexStart;
+    const uint32_t expectedCount = isPart ? data.m_meshParts[i].numIndices : data.m_lods[i - parts.size()].numIndices;
+    if (isPart)
+      numMismatches += parts[i].materialIndex != data.m_meshParts[i].materialIndex ? 1 : 0;
+    if (indexStart != expectedStart || numIndices != expectedCount ||
+        !UnpackDraws(batch, firstDraws[i], firstDraws[i + 1], &indices) || indices.size() != numIndices ||
+        !std::equal(indices.begin(), indices.end(), data.m_indices.begin() + indexStart)) {
+      ++numMismatches;
+    }
+  }
+  Check(numMismatches == 0, name + ": " + std::to_string(numMismatches) +
+                                " mesh parts or levels of detail differ from the parsed ones");
+}
+
+void CheckModel(const std::string& name, const std::filesystem::path& file) {
+  std::filesystem::remove(MeshCache::GetCachePath(file));
+
+  ObjFileData data;
+  ObjFileData::ParseOptions unprocessed;
+  unprocessed.mergeMeshParts = false;
+  unprocessed.optimizeMesh = false;
+  unprocessed.generateTangents = false;
+  unprocessed.buildLods = false;
+  unprocessed.buildMeshlets = false;
+  ObjFileData unprocessedData;
+  if (!data.ParseObjFile(file.string()) || !unprocessedData.ParseObjFile(file.string(), unprocessed)) {
+    Check(false, name + ": could not parse the model");
+    return;
+  }
+
+  StreamedModel streamed;
+  StreamModel(name, file, &streamed);
+  std::cout << "  " << name << ": " << streamed.numBatches << " batches, " << data.m_vertices.size() << " vertices, "
+            << unprocessedData.m_indices.size() / 3 << " triangles" << std::endl;
+  Check(streamed.numBatches >= 2, name + ": there should be progress batches before the final one");
+  Check(streamed.numMaterials == data.m_materials.size(), name + ": the batches have the wrong number of materials");
+
+  // The progress batches are the file as it's parsed, before any of the processing that comes after. The file has
+  // normals, so none are generated and merged.
+  Check(streamed.vertices.size() == unprocessedData.m_vertices.size() &&
+            memcmp(streamed.vertices.data(), unprocessedData.m_vertices.data(),
+                   streamed.vertices.size() * sizeof(ObjFileData::Vertex)) == 0,
+        name + ": the progress batches' vertices differ from the parsed ones");
+  Check(streamed.indices == unprocessedData.m_indices,
+        name + ": the progress batches' indices differ from the parsed ones");
+  if (streamed.hasFinalBatch)
+    CheckFinalBatch(name, streamed.finalBatch, data);
+
+  // Now that the cache has been written, the model comes from it in a single batch.
+  StreamedModel cached;
+  StreamModel(name + " (cached)", file, &cached);
+  Check(cached.numBatches == 1 && cached.finalBatch.cache != nullptr,
+        name + ": the second load should be a single batch from the mesh cache");
+  Check(cached.numMaterials == data.m_materials.size(), name + ": the cached batch has the wrong number of materials");
+  if (cached.hasFinalBatch)
+    CheckFinalBatch(name + " (cached)", cached.finalBatch, data);
+}
+}  // namespace
+
+int main() {
+  const std::filesystem::path directory = std::filesystem::temp_directory_path() / "streaming_obj_loader_test";
+  std::filesystem::create_directories(directory);
+
+  std::cout << "Streaming models:" << std::endl;
+  WriteGrid(directory / "small_grid.obj", 4);
+  CheckModel("small grid", directory / "small_grid.obj");
+  WriteGrid(directory / "large_grid.obj", 300);
+  CheckModel("large grid", directory / "large_grid.obj");
+
+  // Even a file that can't be loaded gets its final batch.
+  StreamedModel missing;
+  StreamModel("missing file", directory / "missing.obj", &missing);
+  Check(missing.numBatches == 1 && !missing.finalBatch.succeeded,
+        "missing file: there should be a single final batch, saying that loading failed");
+
+  std::filesystem::remove_all(directory);
+  return g_failed ? 1 : 0;
+}
@@ -0,0 +1,220 @@
+// Compares VertexDedupTable with the std::unordered_map that ObjFileParser used before it, on the face corners of
+// real obj files.
+//
+// Usage: vertex_dedup_benchmark <obj file>...
+
+#include "d3d12/VertexDedupTable.h"
+#include "utils/MappedFile.h"
+#include "utils/TextScanning.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+constexpr int kNumRuns = 5;
+
+// Like the parser's, 1-based, with 0 for an index that isn't given.
+struct Corner {
+  unsigned long long posIndex;
+  unsigned long long texCoordIndex;
+  unsigned long long normalIndex;
+
+  bool operator==(const Corner& other) const {
+    return posIndex == other.posIndex && texCoordIndex == other.texCoordIndex && normalIndex == other.normalIndex;
+  }
+};
+
+// hash_combine over the three indices, which is what the parser's map was keyed with.
+struct CornerHash {
+  size_t operator()(const Corner& corner) const {
+    size_t hash = 0;
+    for (unsigned long long index : {corner.posIndex, corner.texCoordIndex, corner.normalIndex})
+      hash ^= std::hash<unsigned long long>()(index) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+    return hash;
+  }
+};
+
+struct ObjCorners {
+  std::vector<Corner> corners;
+  size_t numPositions = 0;
+  size_t numTexCoords = 0;
+  size_t numNormals = 0;
+  size_t numFaces = 0;
+};
+
+// Relative (negative) indices count back from the elements declared so far.
+bool ResolveIndex(long long index, size_t numDeclared, unsigned long long* resolvedIndex) {
+  if (index < 0)
+    index += static_cast<long long>(numDeclared) + 1;
+  if (index <= 0 || static_cast<unsigned long long>(index) > numDeclared)
+    return false;
+  *resolvedIndex = static_cast<unsigned long long>(index);
+  return true;
+}
+
+// Only reads what the dedup table sees: the element counts and the face corners, in file order.
+bool ReadCorners(const std::string& fileName, ObjCorners* obj) {
+  MappedFile file;
+  if (!file.Open(fileName))
+    return false;
+
+  const char* data = file.GetData();
+  const size_t size = file.GetSize();
+  for (size_t lineStart = 0; lineStart < size;) {
+    const size_t lineEnd = TextScanning::FindNewLine(data, size, lineStart);
+    size_t i = TextScanning::SkipWhitespace(data, lineEnd, lineStart);
+    const size_t keywordEnd = TextScanning::FindTokenEnd(data, lineEnd, i);
+    const std::string keyword(data + i, keywordEnd - i);
+    i = keywordEnd;
+
+    if (keyword == "v") {
+      ++obj->numPositions;
+    } else if (keyword == "vt") {
+      ++obj->numTexCoords;
+    } else if (keyword == "vn") {
+      ++obj->numNormals;
+    } else if (keyword == "f") {
+      ++obj->numFaces;
+      while (true) {
+        i = TextScanning::SkipWhitespace(data, lineEnd, i);
+        long long indices[3] = {0, 0, 0};
+        for (size_t k = 0; k < 3; ++k) {
+          i += TextScanning::ParseInteger(data + i, lineEnd - i, &indices[k]);
+          if (i == lineEnd || data[i] != '/')
+            break;
+          ++i;
+        }
+        if (indices[0] == 0)
+          break;
+
+        Corner corner = {0, 0, 0};
+        if (!ResolveIndex(indices[0], obj->numPositions, &corner.posIndex) ||
+            (indices[1] != 0 && !ResolveIndex(indices[1], obj->numTexCoords, &corner.texCoordIndex)) ||
+            (indices[2] != 0 && !ResolveIndex(indices[2], obj->numNormals, &corner.normalIndex))) {
+          std::cerr << fileName << ": face refers to an element that hasn't been declared." << std::endl;
+          return false;
+        }
+        obj->corners.push_back(corner);
+      }
+    }
+
+    lineStart = lineEnd + 1;
+  }
+
+  return true;
+}
+
+// Fills |vertexIndices| with the vertex that each corner maps to, handing out new ones in order.
+void DedupWithUnorderedMap(const ObjCorners& obj, bool reserve, std::vector<uint32_t>* vertexIndices) {
+  std::unordered_map<Corner, uint32_t, CornerHash> map;
+  if (reserve)
+    map.reserve(std::max(obj.numPositions, obj.numFaces / 2));
+
+  uint32_t numVertices = 0;
+  for (size_t i = 0; i < obj.corners.size(); ++i) {
+    auto iter = map.find(obj.corners[i]);
+    if (iter == map.end()) {
+      map[obj.corners[i]] = numVertices;
+      (*vertexIndices)[i] = numVertices++;
+    } else {
+      (*vertexIndices)[i] = iter->second;
+    }
+  }
+}
+
+template <class IndexType>
+void DedupWithTable(const ObjCorners& obj, std::vector<uint32_t>* vertexIndices) {
+  // Sized up front the same way as the parser does.
+  VertexDedupTable<IndexType> table;
+  table.Reserve(std::max(obj.numPositions, obj.numFaces / 2));
+
+  uint32_t numVertices = 0;
+  for (size_t i = 0; i < obj.corners.size(); ++i) {
+    const Corner& corner = obj.corners[i];
+    const uint32_t vertexIndex =
+        table.FindOrInsert(corner.posIndex, corner.texCoordIndex, corner.normalIndex, numVertices);
+    if (vertexIndex == numVertices)
+      ++numVertices;
+    (*vertexIndices)[i] = vertexIndex;
+  }
+}
+
+// Returns the fastest of kNumRuns runs, in milliseconds.
+double TimeRuns(const std::function<void(std::vector<uint32_t>*)>& dedup, std::vector<uint32_t>* vertexIndices) {
+  double bestMilliseconds = 0.0;
+  for (int run = 0; run < kNumRuns; ++run) {
+    const auto start = std::chrono::steady_clock::now();
+    dedup(vertexIndices);
+    const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    if (run == 0 || elapsed.count() < bestMilliseconds)
+      bestMilliseconds = elapsed.count();
+  }
+  return bestMilliseconds;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0] << " <obj file>..." << std::endl;
+    return 1;
+  }
+
+  bool allMatch = true;
+  for (int arg = 1; arg < argc; ++arg) {
+    const std::string fileName = argv[arg];
+    ObjCorners obj;
+    if (!ReadCorners(fileName, &obj)) {
+      std::cerr << "Error: could not read " << fileName << std::endl;
+      return 1;
+    }
+
+    const size_t numCorners = obj.corners.size();
+    const bool needsWideTable =
+        std::max({obj.numPositions, obj.numTexCoords, obj.numNormals}) > VertexDedupTable<uint32_t>::kMaxIndex;
+
+    std::vector<uint32_t> mapIndices(numCorners);
+    std::vector<uint32_t> reservedMapIndices(numCorners);
+    std::vector<uint32_t> tableIndices(numCorners);
+    const double mapMilliseconds =
+        TimeRuns([&](std::vector<uint32_t>* out) { DedupWithUnorderedMap(obj, /*reserve*/ false, out); }, &mapIndices);
+    const double reservedMapMilliseconds = TimeRuns(
+        [&](std::vector<uint32_t>* out) { DedupWithUnorderedMap(obj, /*reserve*/ true, out); }, &reservedMapIndices);
+    const double tableMilliseconds = TimeRuns(
+        [&](std::vector<uint32_t>* out) {
+          if (needsWideTable) {
+            DedupWithTable<unsigned long long>(obj, out);
+          } else {
+            DedupWithTable<uint32_t>(obj, out);
+          }
+        },
+        &tableIndices);
+
+    const bool matches = (tableIndices == mapIndices && reservedMapIndices == mapIndices);
+    allMatch &= matches;
+    const uint32_t numVertices = numCorners > 0 ? *std::max_element(mapIndices.begin(), mapIndices.end()) + 1 : 0;
+
+    auto printResult = [&](const char* name, double milliseconds) {
+      std::cout << "  " << name << ": " << milliseconds << " ms ("
+                << (numCorners > 0 ? milliseconds * 1e6 / numCorners : 0.0) << " ns per corner)" << std::endl;
+    };
+    std::cout << fileName << ": " << numCorners << " face corners, " << numVertices << " unique vertices (best of "
+              << kNumRuns << " runs)" << std::endl;
+    printResult("std::unordered_map", mapMilliseconds);
+    printResult("std::unordered_map, reserved", reservedMapMilliseconds);
+    printResult(needsWideTable ? "VertexDedupTable<unsigned long long>" : "VertexDedupTable<uint32_t>",
+                tableMilliseconds);
+    std::cout << "  speedup over std::unordered_map: " << mapMilliseconds / tableMilliseconds << "x" << std::endl;
+    if (!matches)
+      std::cerr << "Error: the tables disagree on the vertex indices for " << fileName << std::endl;
+  }
+
+  return allMatch ? 0 : 1;
+}
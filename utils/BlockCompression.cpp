@@ -0,0 +1,612 @@
+#include "utils/BlockCompression.h"
+
+#include "utils/ThreadPool.h"
+
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BLOCK_COMPRESSION_USE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace BlockCompression {
+
+namespace {
+// ------------------------------------------------------------------------------------------------
+// Four floats that are processed together: one row of a block.
+
+#ifdef BLOCK_COMPRESSION_USE_SSE2
+struct Float4 {
+  __m128 v;
+
+  static Float4 Splat(float x) { return {_mm_set1_ps(x)}; }
+  static Float4 Load(const float* data) { return {_mm_loadu_ps(data)}; }
+  void Store(float* data) const { _mm_storeu_ps(data, v); }
+};
+
+Float4 operator+(Float4 a, Float4 b) {
+  return {_mm_add_ps(a.v, b.v)};
+}
+
+Float4 operator-(Float4 a, Float4 b) {
+  return {_mm_sub_ps(a.v, b.v)};
+}
+
+Float4 operator*(Float4 a, Float4 b) {
+  return {_mm_mul_ps(a.v, b.v)};
+}
+
+Float4 Min(Float4 a, Float4 b) {
+  return {_mm_min_ps(a.v, b.v)};
+}
+
+// Per lane: (x < y) ? a : b.
+Float4 SelectIfLess(Float4 x, Float4 y, Float4 a, Float4 b) {
+  const __m128 mask = _mm_cmplt_ps(x.v, y.v);
+  return {_mm_or_ps(_mm_and_ps(mask, a.v), _mm_andnot_ps(mask, b.v))};
+}
+#else
+struct Float4 {
+  float v[4];
+
+  static Float4 Splat(float x) { return {{x, x, x, x}}; }
+  static Float4 Load(const float* data) { return {{data[0], data[1], data[2], data[3]}}; }
+  void Store(float* data) const { memcpy(data, v, sizeof(v)); }
+};
+
+template <typename Op>
+Float4 PerLane(Float4 a, Float4 b, Op op) {
+  return {{op(a.v[0], b.v[0]), op(a.v[1], b.v[1]), op(a.v[2], b.v[2]), op(a.v[3], b.v[3])}};
+}
+
+Float4 operator+(Float4 a, Float4 b) {
+  return PerLane(a, b, [](float x, float y) { return x + y; });
+}
+
+Float4 operator-(Float4 a, Float4 b) {
+  return PerLane(a, b, [](float x, float y) { return x - y; });
+}
+
+Float4 operator*(Float4 a, Float4 b) {
+  return PerLane(a, b, [](float x, float y) { return x * y; });
+}
+
+Float4 Min(Float4 a, Float4 b) {
+  return PerLane(a, b, [](float x, float y) { return std::min(x, y); });
+}
+
+Float4 SelectIfLess(Float4 x, Float4 y, Float4 a, Float4 b) {
+  Float4 result;
+  for (int i = 0; i < 4; ++i) {
+    result.v[i] = (x.v[i] < y.v[i]) ? a.v[i] : b.v[i];
+  }
+  return result;
+}
+#endif
+
+// ------------------------------------------------------------------------------------------------
+// Shared by all of the formats.
+
+constexpr int kNumPixels = 16;
+constexpr int kNumChannels = 4;
+
+struct Block {
+  float pixels[kNumPixels][kNumChannels];
+
+  // The same values, transposed so that rows[c][y] holds channel c of the 4 pixels in row y.
+  Float4 rows[kNumChannels][4];
+};
+
+void LoadBlock(const unsigned char* pixels, size_t rowPitch, Block* block) {
+  for (int y = 0; y < 4; ++y) {
+    const unsigned char* row = pixels + y * rowPitch;
+    for (int x = 0; x < 4; ++x) {
+      for (int c = 0; c < kNumChannels; ++c) {
+        block->pixels[y * 4 + x][c] = row[x * 4 + c];
+      }
+    }
+
+    for (int c = 0; c < kNumChannels; ++c) {
+      const float values[4] = {block->pixels[y * 4][c], block->pixels[y * 4 + 1][c], block->pixels[y * 4 + 2][c],
+                               block->pixels[y * 4 + 3][c]};
+      block->rows[c][y] = Float4::Load(values);
+    }
+  }
+}
+
+// The channels [first, last) that a palette covers.
+struct ChannelRange {
+  int first;
+  int last;
+};
+
+constexpr ChannelRange kColorChannels = {0, 3};
+constexpr ChannelRange kAlphaChannel = {3, 4};
+constexpr ChannelRange kAllChannels = {0, 4};
+
+// Picks the closest palette entry for every pixel. Returns the total squared error.
+float FindIndices(const Block& block,
+                  const float (*palette)[kNumChannels],
+                  int paletteSize,
+                  ChannelRange channels,
+                  uint8_t indices[kNumPixels]) {
+  Float4 totalError = Float4::Splat(0.0f);
+  for (int y = 0; y < 4; ++y) {
+    Float4 bestError = Float4::Splat(FLT_MAX);
+    Float4 bestIndex = Float4::Splat(0.0f);
+    for (int i = 0; i < paletteSize; ++i) {
+      Float4 error = Float4::Splat(0.0f);
+      for (int c = channels.first; c < channels.last; ++c) {
+        const Float4 difference = block.rows[c][y] - Float4::Splat(palette[i][c]);
+        error = error + difference * difference;
+      }
+      bestIndex = SelectIfLess(error, bestError, Float4::Splat((float)i), bestIndex);
+      bestError = Min(error, bestError);
+    }
+
+    float rowIndices[4];
+    bestIndex.Store(rowIndices);
+    for (int x = 0; x < 4; ++x) {
+      indices[y * 4 + x] = (uint8_t)rowIndices[x];
+    }
+    totalError = totalError + bestError;
+  }
+
+  float errors[4];
+  totalError.Store(errors);
+  return errors[0] + errors[1] + errors[2] + errors[3];
+}
+
+struct Endpoints {
+  float start[kNumChannels];
+  float end[kNumChannels];
+};
+
+float Clamp255(float value) {
+  return std::min(std::max(value, 0.0f), 255.0f);
+}
+
+// Puts the endpoints at the extremes of the block's colors along their principal axis, which is found by power
+// iteration on the covariance matrix.
+void FitPrincipalAxis(const Block& block, ChannelRange channels, Endpoints* endpoints) {
+  float mean[kNumChannels] = {};
+  for (int i = 0; i < kNumPixels; ++i) {
+    for (int c = channels.first; c < channels.last; ++c) {
+      mean[c] += block.pixels[i][c];
+    }
+  }
+  for (int c = channels.first; c < channels.last; ++c) {
+    mean[c] /= kNumPixels;
+  }
+
+  float covariance[kNumChannels][kNumChannels] = {};
+  for (int i = 0; i < kNumPixels; ++i) {
+    for (int c = channels.first; c < channels.last; ++c) {
+      for (int d = channels.first; d < channels.last; ++d) {
+        covariance[c][d] += (block.pixels[i][c] - mean[c]) * (block.pixels[i][d] - mean[d]);
+      }
+    }
+  }
+
+  // The covariance row of the channel with the largest variance is a much better start than a fixed vector, which
+  // could be (nearly) orthogonal to the principal axis.
+  int largestVarianceChannel = channels.first;
+  for (int c = channels.first; c < channels.last; ++c) {
+    if (covariance[c][c] > covariance[largestVarianceChannel][largestVarianceChannel])
+      largestVarianceChannel = c;
+  }
+
+  float axis[kNumChannels] = {};
+  for (int c = channels.first; c < channels.last; ++c) {
+    axis[c] = covariance[largestVarianceChannel][c];
+  }
+
+  bool isUniform = (covariance[largestVarianceChannel][largestVarianceChannel] < 1e-3f);
+  for (int iteration = 0; iteration < 8 && !isUniform; ++iteration) {
+    float next[kNumChannels] = {};
+    float largest = 0.0f;
+    for (int c = channels.first; c < channels.last; ++c) {
+      for (int d = channels.first; d < channels.last; ++d) {
+        next[c] += covariance[c][d] * axis[d];
+      }
+      largest = std::max(largest, fabsf(next[c]));
+    }
+
+    if (largest < 1e-6f) {
+      isUniform = true;
+      break;
+    }
+    for (int c = channels.first; c < channels.last; ++c) {
+      axis[c] = next[c] / largest;
+    }
+  }
+
+  if (isUniform) {
+    for (int c = channels.first; c < channels.last; ++c) {
+      endpoints->start[c] = endpoints->end[c] = mean[c];
+    }
+    return;
+  }
+
+  float axisLengthSquared = 0.0f;
+  for (int c = channels.first; c < channels.last; ++c) {
+    axisLengthSquared += axis[c] * axis[c];
+  }
+
+  float minProjection = FLT_MAX;
+  float maxProjection = -FLT_MAX;
+  for (int i = 0; i < kNumPixels; ++i) {
+    float projection = 0.0f;
+    for (int c = channels.first; c < channels.last; ++c) {
+      projection += (block.pixels[i][c] - mean[c]) * axis[c];
+    }
+    minProjection = std::min(minProjection, projection / axisLengthSquared);
+    maxProjection = std::max(maxProjection, projection / axisLengthSquared);
+  }
+
+  for (int c = channels.first; c < channels.last; ++c) {
+    endpoints->start[c] = Clamp255(mean[c] + minProjection * axis[c]);
+    endpoints->end[c] = Clamp255(mean[c] + maxProjection * axis[c]);
+  }
+}
+
+// Solves for the endpoints that minimize the squared error, given the indices that were picked for the pixels.
+// |weights| maps each index to how far along the way from start to end it is. Returns false if the indices don't
+// pin down the endpoints (e.g. if they're all the same).
+bool FitLeastSquares(const Block& block,
+                     const float* weights,
+                     const uint8_t indices[kNumPixels],
+                     ChannelRange channels,
+                     Endpoints* endpoints) {
+  float startStart = 0.0f;
+  float startEnd = 0.0f;
+  float endEnd = 0.0f;
+  float startPixel[kNumChannels] = {};
+  float endPixel[kNumChannels] = {};
+  for (int i = 0; i < kNumPixels; ++i) {
+    const float endWeight = weights[indices[i]];
+    const float startWeight = 1.0f - endWeight;
+    startStart += startWeight * startWeight;
+    startEnd += startWeight * endWeight;
+    endEnd += endWeight * endWeight;
+    for (int c = channels.first; c < channels.last; ++c) {
+      startPixel[c] += startWeight * block.pixels[i][c];
+      endPixel[c] += endWeight * block.pixels[i][c];
+    }
+  }
+
+  const float determinant = startStart * endEnd - startEnd * startEnd;
+  if (fabsf(determinant) < 1e-6f)
+    return false;
+
+  for (int c = channels.first; c < channels.last; ++c) {
+    endpoints->start[c] = Clamp255((endEnd * startPixel[c] - startEnd * endPixel[c]) / determinant);
+    endpoints->end[c] = Clamp255((startStart * endPixel[c] - startEnd * startPixel[c]) / determinant);
+  }
+  return true;
+}
+
+// Fits the endpoints along the principal axis first, and then keeps refining them for as long as that helps.
+// |evaluate| quantizes a set of endpoints and returns the resulting error (and remembers the best encoding so far).
+template <typename Evaluate>
+void FitEndpoints(const Block& block,
+                  const float* weights,
+                  ChannelRange channels,
+                  const uint8_t* bestIndices,
+                  Evaluate&& evaluate) {
+  constexpr int kMaxRefinements = 2;
+
+  Endpoints endpoints;
+  FitPrincipalAxis(block, channels, &endpoints);
+  float bestError = evaluate(endpoints);
+  for (int i = 0; i < kMaxRefinements && bestError > 0.0f; ++i) {
+    if (!FitLeastSquares(block, weights, bestIndices, channels, &endpoints))
+      break;
+
+    const float error = evaluate(endpoints);
+    if (error >= bestError)
+      break;
+    bestError = error;
+  }
+}
+
+void StoreLittleEndian16(uint16_t value, unsigned char* out) {
+  out[0] = (unsigned char)value;
+  out[1] = (unsigned char)(value >> 8);
+}
+
+// ------------------------------------------------------------------------------------------------
+// BC1 colors (also used by BC3).
+
+// Index order in the palette is start, end, then the two colors in between.
+constexpr float kColorWeights[4] = {0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f};
+
+uint16_t QuantizeTo565(const float color[kNumChannels]) {
+  const int r = (int)lroundf(color[0] * 31.0f / 255.0f);
+  const int g = (int)lroundf(color[1] * 63.0f / 255.0f);
+  const int b = (int)lroundf(color[2] * 31.0f / 255.0f);
+  return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+void ExpandFrom565(uint16_t packed, float color[kNumChannels]) {
+  const int r = (packed >> 11) & 0x1F;
+  const int g = (packed >> 5) & 0x3F;
+  const int b = packed & 0x1F;
+  color[0] = (float)((r << 3) | (r >> 2));
+  color[1] = (float)((g << 2) | (g >> 4));
+  color[2] = (float)((b << 3) | (b >> 2));
+  color[3] = 255.0f;
+}
+
+struct ColorEncoding {
+  uint16_t start;
+  uint16_t end;
+  uint8_t indices[kNumPixels];
+};
+
+float EvaluateColorEndpoints(const Block& block, const Endpoints& endpoints, ColorEncoding* encoding) {
+  uint16_t start = QuantizeTo565(endpoints.start);
+  uint16_t end = QuantizeTo565(endpoints.end);
+
+  // The 4-color mode is only used if start > end; otherwise it's the 3-color mode with transparent black. If both
+  // quantize to the same color, the block is just that color with all indices 0.
+  if (start < end)
+    std::swap(start, end);
+
+  float palette[4][kNumChannels];
+  ExpandFrom565(start, palette[0]);
+  ExpandFrom565(end, palette[1]);
+  for (int c = 0; c < kNumChannels; ++c) {
+    palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+    palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+  }
+
+  encoding->start = start;
+  encoding->end = end;
+  return FindIndices(block, palette, (start == end) ? 1 : 4, kColorChannels, encoding->indices);
+}
+
+void EncodeColorBlock(const Block& block, unsigned char* out) {
+  ColorEncoding best;
+  float bestError = FLT_MAX;
+  FitEndpoints(block, kColorWeights, kColorChannels, best.indices, [&](const Endpoints& endpoints) {
+    ColorEncoding encoding;
+    const float error = EvaluateColorEndpoints(block, endpoints, &encoding);
+    if (error < bestError) {
+      bestError = error;
+      best = encoding;
+    }
+    return error;
+  });
+
+  uint32_t indices = 0;
+  for (int i = 0; i < kNumPixels; ++i) {
+    indices |= (uint32_t)best.indices[i] << (2 * i);
+  }
+
+  StoreLittleEndian16(best.start, out);
+  StoreLittleEndian16(best.end, out + 2);
+  StoreLittleEndian16((uint16_t)indices, out + 4);
+  StoreLittleEndian16((uint16_t)(indices >> 16), out + 6);
+}
+
+// ------------------------------------------------------------------------------------------------
+// BC3 alpha.
+
+void EncodeAlphaBlock(const Block& block, unsigned char* out) {
+  float minAlpha = 255.0f;
+  float maxAlpha = 0.0f;
+  for (int i = 0; i < kNumPixels; ++i) {
+    minAlpha = std::min(minAlpha, block.pixels[i][3]);
+    maxAlpha = std::max(maxAlpha, block.pixels[i][3]);
+  }
+
+  // With start > end, there are 6 interpolated values in between (the other mode has 4, plus 0 and 255).
+  const int start = (int)maxAlpha;
+  const int end = (int)minAlpha;
+  float palette[8][kNumChannels] = {};
+  palette[0][3] = (float)start;
+  palette[1][3] = (float)end;
+  for (int i = 1; i < 7; ++i) {
+    palette[i + 1][3] = (float)(((7 - i) * start + i * end) / 7);
+  }
+
+  uint8_t indices[kNumPixels];
+  FindIndices(block, palette, (start == end) ? 1 : 8, kAlphaChannel, indices);
+
+  uint64_t packedIndices = 0;
+  for (int i = 0; i < kNumPixels; ++i) {
+    packedIndices |= (uint64_t)indices[i] << (3 * i);
+  }
+
+  out[0] = (unsigned char)start;
+  out[1] = (unsigned char)end;
+  for (int i = 0; i < 6; ++i) {
+    out[2 + i] = (unsigned char)(packedIndices >> (8 * i));
+  }
+}
+
+// ------------------------------------------------------------------------------------------------
+// BC7 mode 6.
+
+constexpr int kBC7IndexWeights[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+constexpr float kBC7Weights[16] = {
+  0.0f / 64, 4.0f / 64,  9.0f / 64,  13.0f / 64, 17.0f / 64, 21.0f / 64, 26.0f / 64, 30.0f / 64,
+  34.0f / 64, 38.0f / 64, 43.0f / 64, 47.0f / 64, 51.0f / 64, 55.0f / 64, 60.0f / 64, 64.0f / 64,
+};
+
+// Each endpoint is 7 bits per channel plus a "p-bit" that is shared by its channels as the lowest bit.
+struct BC7Endpoint {
+  uint8_t values[kNumChannels];
+  uint8_t pBit;
+
+  int GetExpanded(int channel) const { return (values[channel] << 1) | pBit; }
+};
+
+BC7Endpoint QuantizeBC7Endpoint(const float color[kNumChannels]) {
+  BC7Endpoint best = {};
+  float bestError = FLT_MAX;
+  for (uint8_t pBit = 0; pBit < 2; ++pBit) {
+    BC7Endpoint endpoint;
+    endpoint.pBit = pBit;
+    float error = 0.0f;
+    for (int c = 0; c < kNumChannels; ++c) {
+      endpoint.values[c] = (uint8_t)std::clamp((int)lroundf((color[c] - pBit) / 2.0f), 0, 127);
+      const float difference = (float)endpoint.GetExpanded(c) - color[c];
+      error += difference * difference;
+    }
+    if (error < bestError) {
+      bestError = error;
+      best = endpoint;
+    }
+  }
+  return best;
+}
+
+struct BC7Encoding {
+  BC7Endpoint start;
+  BC7Endpoint end;
+  uint8_t indices[kNumPixels];
+};
+
+float EvaluateBC7Endpoints(const Block& block, const Endpoints& endpoints, BC7Encoding* encoding) {
+  encoding->start = QuantizeBC7Endpoint(endpoints.start);
+  encoding->end = QuantizeBC7Endpoint(endpoints.end);
+
+  float palette[16][kNumChannels];
+  for (int i = 0; i < 16; ++i) {
+    const int weight = kBC7IndexWeights[i];
+    for (int c = 0; c < kNumChannels; ++c) {
+      palette[i][c] =
+          (float)(((64 - weight) * encoding->start.GetExpanded(c) + weight * encoding->end.GetExpanded(c) + 32) >> 6);
+    }
+  }
+
+  return FindIndices(block, palette, 16, kAllChannels, encoding->indices);
+}
+
+// Writes fields into a 128-bit block, starting at the least significant bit.
+class BitWriter {
+ private:
+  uint64_t m_words[2] = {};
+  int m_position = 0;
+
+ public:
+  void Write(uint64_t value, int numBits) {
+    const int word = m_position / 64;
+    const int offset = m_position % 64;
+    m_words[word] |= value << offset;
+    if (offset + numBits > 64)
+      m_words[word + 1] |= value >> (64 - offset);
+    m_position += numBits;
+  }
+
+  void Store(unsigned char* out) const {
+    for (int i = 0; i < 16; ++i) {
+      out[i] = (unsigned char)(m_words[i / 8] >> (8 * (i % 8)));
+    }
+  }
+};
+
+void EncodeBC7Block(const Block& block, unsigned char* out) {
+  BC7Encoding best;
+  float bestError = FLT_MAX;
+  FitEndpoints(block, kBC7Weights, kAllChannels, best.indices, [&](const Endpoints& endpoints) {
+    BC7Encoding encoding;
+    const float error = EvaluateBC7Endpoints(block, endpoints, &encoding);
+    if (error < bestError) {
+      bestError = error;
+      best = encoding;
+    }
+    return error;
+  });
+
+  // The first pixel's index is stored with one bit less, so its top bit has to be 0. Swapping the endpoints (and
+  // mirroring the indices) makes it so.
+  if (best.indices[0] >= 8) {
+    std::swap(best.start, best.end);
+    for (int i = 0; i < kNumPixels; ++i) {
+      best.indices[i] = 15 - best.indices[i];
+    }
+  }
+
+  BitWriter writer;
+  writer.Write(1 << 6, 7);  // Mode 6.
+  for (int c = 0; c < kNumChannels; ++c) {
+    writer.Write(best.start.values[c], 7);
+    writer.Write(best.end.values[c], 7);
+  }
+  writer.Write(best.start.pBit, 1);
+  writer.Write(best.end.pBit, 1);
+  writer.Write(best.indices[0], 3);
+  for (int i = 1; i < kNumPixels; ++i) {
+    writer.Write(best.indices[i], 4);
+  }
+  writer.Store(out);
+}
+}  // namespace
+
+size_t GetBlockSize(Format format) {
+  return (format == Format::BC1) ? 8 : 16;
+}
+
+void CompressBlock(Format format, const unsigned char* pixels, size_t rowPitch, unsigned char* block) {
+  Block loadedBlock;
+  LoadBlock(pixels, rowPitch, &loadedBlock);
+
+  switch (format) {
+    case Format::BC1:
+      EncodeColorBlock(loadedBlock, block);
+      break;
+    case Format::BC3:
+      EncodeAlphaBlock(loadedBlock, block);
+      EncodeColorBlock(loadedBlock, block + 8);
+      break;
+    case Format::BC7:
+      EncodeBC7Block(loadedBlock, block);
+      break;
+  }
+}
+
+std::vector<unsigned char> CompressImage(Format format,
+                                         const unsigned char* pixels,
+                                         size_t width,
+                                         size_t height,
+                                         size_t rowPitch) {
+  const size_t blockSize = GetBlockSize(format);
+  const size_t numBlocksX = (width + 3) / 4;
+  const size_t numBlocksY = (height + 3) / 4;
+  std::vector<unsigned char> blocks(numBlocksX * numBlocksY * blockSize);
+
+  ThreadPool::GetShared().ParallelFor(numBlocksY, [&](size_t blockY) {
+    const unsigned char* blockRow = pixels + blockY * 4 * rowPitch;
+    unsigned char* out = blocks.data() + blockY * numBlocksX * blockSize;
+    for (size_t blockX = 0; blockX < numBlocksX; ++blockX) {
+      if ((blockX + 1) * 4 <= width && (blockY + 1) * 4 <= height) {
+        CompressBlock(format, blockRow + blockX * 16, rowPitch, out + blockX * blockSize);
+        continue;
+      }
+
+      // A partial block along the right or bottom edge. The missing pixels repeat the last row and column, so that
+      // they don't pull the endpoints away from the pixels that are actually visible.
+      unsigned char padded[4 * 4 * 4];
+      for (size_t y = 0; y < 4; ++y) {
+        const size_t sourceY = std::min(blockY * 4 + y, height - 1);
+        for (size_t x = 0; x < 4; ++x) {
+          const size_t sourceX = std::min(blockX * 4 + x, width - 1);
+          memcpy(padded + (y * 4 + x) * 4, pixels + sourceY * rowPitch + sourceX * 4, 4);
+        }
+      }
+      CompressBlock(format, padded, /*rowPitch*/ 16, out + blockX * blockSize);
+    }
+  });
+
+  return blocks;
+}
+
+}  // namespace BlockCompression
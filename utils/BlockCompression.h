@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+// Encoders for the block-compressed texture formats. Each 4x4 block of RGBA8 pixels is packed into 8 (BC1) or 16
+// (BC3, BC7) bytes, which the GPU decodes on the fly.
+//
+// The endpoints of each block are fitted along the principal axis of its colors and then refined with a least-squares
+// fit to the chosen indices. The per-pixel palette searches are vectorized with SSE2, and fall back to scalar loops
+// elsewhere. BC7 only uses mode 6 (a single subset with RGBA endpoints and 4-bit indices), which handles smooth
+// gradients and alpha well but isn't as good as a full BC7 encoder at blocks with several distinct colors.
+namespace BlockCompression {
+
+enum class Format {
+  BC1,  // RGB, 4 bits per pixel. Alpha is dropped.
+  BC3,  // RGBA, 8 bits per pixel: BC1 color plus a separate alpha block.
+  BC7,  // RGBA, 8 bits per pixel, at a higher quality than BC3.
+};
+
+size_t GetBlockSize(Format format);
+
+// |pixels| points to the top-left pixel of the block, with rows |rowPitch| bytes apart. |block| receives
+// GetBlockSize(format) bytes.
+void CompressBlock(Format format, const unsigned char* pixels, size_t rowPitch, unsigned char* block);
+
+// Compresses an entire image. If its width or height isn't a multiple of 4, the blocks along the right and bottom edges
+// are padded with copies of the edge pixels. The rows of blocks are spread across the shared thread pool. The result
+// is laid out row of blocks by row of blocks, with no padding in between.
+std::vector<unsigned char> CompressImage(Format format,
+                                         const unsigned char* pixels,
+                                         size_t width,
+                                         size_t height,
+                                         size_t rowPitch);
+
+}  // namespace BlockCompression
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <queue>
+
+// A thread-safe FIFO queue for handing work from producer threads to consumer threads.
+//
+// Once the queue is closed, no more items can be pushed, and consumers will drain whatever is left before being told
+// that the queue is finished.
+template <class T>
+class BlockingQueue {
+ private:
+  std::queue<T> m_items;
+  std::mutex m_mutex;
+  std::condition_variable m_itemAvailable;
+  bool m_isClosed = false;
+
+ public:
+  // Returns false (and drops the item) if the queue has already been closed.
+  bool Push(T item);
+
+  // Blocks until an item is available. Returns false if the queue was closed and there is nothing left to pop.
+  bool Pop(T* item);
+
+  // Never blocks. Returns false if there is nothing to pop right now.
+  bool TryPop(T* item);
+
+  void Close();
+  bool IsClosed();
+};
+
+template <class T>
+bool BlockingQueue<T>::Push(T item) {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_isClosed)
+      return false;
+
+    m_items.push(std::move(item));
+  }
+  m_itemAvailable.notify_one();
+  return true;
+}
+
+template <class T>
+bool BlockingQueue<T>::Pop(T* item) {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_itemAvailable.wait(lock, [this]() { return m_isClosed || !m_items.empty(); });
+  if (m_items.empty())
+    return false;
+
+  *item = std::move(m_items.front());
+  m_items.pop();
+  return true;
+}
+
+template <class T>
+bool BlockingQueue<T>::TryPop(T* item) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (m_items.empty())
+    return false;
+
+  *item = std::move(m_items.front());
+  m_items.pop();
+  return true;
+}
+
+template <class T>
+void BlockingQueue<T>::Close() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_isClosed = true;
+  }
+  m_itemAvailable.notify_all();
+}
+
+template <class T>
+bool BlockingQueue<T>::IsClosed() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_isClosed;
+}
@@ -0,0 +1,93 @@
+#include "utils/Checksum.h"
+
+#include "utils/ThreadPool.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+// The round & mixing functions are the ones used by xxHash64.
+static constexpr uint64_t kPrime1 = 0x9E3779B185EBCA87;
+static constexpr uint64_t kPrime2 = 0xC2B2AE3D27D4EB4F;
+static constexpr uint64_t kPrime3 = 0x165667B19E3779F9;
+static constexpr uint64_t kPrime4 = 0x85EBCA77C2B2AE63;
+static constexpr uint64_t kPrime5 = 0x27D4EB2F165667C5;
+
+static uint64_t RotateLeft(uint64_t value, int bits) {
+  return (value << bits) | (value >> (64 - bits));
+}
+
+static uint64_t Load64(const unsigned char* data) {
+  uint64_t value;
+  memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+static uint64_t Round(uint64_t accumulator, uint64_t input) {
+  accumulator += input * kPrime2;
+  return RotateLeft(accumulator, 31) * kPrime1;
+}
+
+static uint64_t MergeRound(uint64_t hash, uint64_t accumulator) {
+  hash ^= Round(0, accumulator);
+  return hash * kPrime1 + kPrime4;
+}
+
+static uint64_t HashBlock(const unsigned char* data, size_t size) {
+  const unsigned char* end = data + size;
+  uint64_t hash;
+
+  if (size >= 32) {
+    // 4 independent lanes, so that the multiplies can overlap.
+    uint64_t lanes[4] = {kPrime1 + kPrime2, kPrime2, 0, 0 - kPrime1};
+    for (; data + 32 <= end; data += 32) {
+      for (size_t i = 0; i < 4; ++i) {
+        lanes[i] = Round(lanes[i], Load64(data + i * 8));
+      }
+    }
+
+    hash = RotateLeft(lanes[0], 1) + RotateLeft(lanes[1], 7) + RotateLeft(lanes[2], 12) + RotateLeft(lanes[3], 18);
+    for (size_t i = 0; i < 4; ++i) {
+      hash = MergeRound(hash, lanes[i]);
+    }
+  } else {
+    hash = kPrime5;
+  }
+
+  hash += (uint64_t)size;
+  for (; data + 8 <= end; data += 8) {
+    hash ^= Round(0, Load64(data));
+    hash = RotateLeft(hash, 27) * kPrime1 + kPrime4;
+  }
+
+  for (; data < end; ++data) {
+    hash ^= (*data) * kPrime5;
+    hash = RotateLeft(hash, 11) * kPrime1;
+  }
+
+  // Final avalanche.
+  hash ^= hash >> 33;
+  hash *= kPrime2;
+  hash ^= hash >> 29;
+  hash *= kPrime3;
+  hash ^= hash >> 32;
+  return hash;
+}
+
+uint64_t ComputeChecksum(const void* data, size_t size) {
+  const unsigned char* bytes = static_cast<const unsigned char*>(data);
+
+  const size_t kBlockSize = 1024 * 1024;
+  if (size <= kBlockSize)
+    return HashBlock(bytes, size);
+
+  const size_t numBlocks = (size + kBlockSize - 1) / kBlockSize;
+  std::vector<uint64_t> blockHashes(numBlocks);
+  ThreadPool::GetShared().ParallelFor(numBlocks, [&](size_t i) {
+    size_t blockStart = i * kBlockSize;
+    blockHashes[i] = HashBlock(bytes + blockStart, std::min(kBlockSize, size - blockStart));
+  });
+
+  return HashBlock(reinterpret_cast<const unsigned char*>(blockHashes.data()), blockHashes.size() * sizeof(uint64_t));
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// A fast, non-cryptographic 64-bit checksum, meant for detecting corrupt or truncated cache files.
+//
+// Large inputs are hashed in fixed-size blocks on the shared thread pool, and the block hashes are then hashed
+// together. The result only depends on the data, not on the number of threads.
+uint64_t ComputeChecksum(const void* data, size_t size);
@@ -0,0 +1,437 @@
+#include "utils/Inflate.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+
+namespace {
+// Reads the stream LSB-first, as deflate requires. Reading past the end yields zeros; IsOverrun reports whether any
+// of those were actually consumed.
+class BitReader {
+ private:
+  const unsigned char* m_data;
+  size_t m_size;
+  size_t m_position = 0;
+  uint64_t m_bits = 0;
+  int m_numBits = 0;
+  size_t m_numPaddingBytes = 0;
+
+ public:
+  BitReader(const unsigned char* data, size_t size) : m_data(data), m_size(size) {}
+
+  // Makes sure that there are at least 56 bits available.
+  void Refill() {
+    while (m_numBits <= 56) {
+      uint64_t byte = 0;
+      if (m_position < m_size) {
+        byte = m_data[m_position++];
+      } else {
+        ++m_numPaddingBytes;
+      }
+      m_bits |= byte << m_numBits;
+      m_numBits += 8;
+    }
+  }
+
+  uint32_t Peek(int numBits) const { return (uint32_t)(m_bits & ((1ull << numBits) - 1)); }
+
+  void Consume(int numBits) {
+    m_bits >>= numBits;
+    m_numBits -= numBits;
+  }
+
+  uint32_t Read(int numBits) {
+    if (m_numBits < numBits)
+      Refill();
+    uint32_t value = Peek(numBits);
+    Consume(numBits);
+    return value;
+  }
+
+  void AlignToByte() { Consume(m_numBits % 8); }
+
+  bool IsOverrun() const { return (size_t)m_numBits < m_numPaddingBytes * 8; }
+
+  const unsigned char* GetData() const { return m_data; }
+  size_t GetSize() const { return m_size; }
+
+  // The position of the next unread byte. Only valid when aligned to a byte boundary, and not overrun.
+  size_t GetBytePosition() const { return m_position - (m_numBits / 8 - m_numPaddingBytes); }
+
+  // Skips ahead to a byte position, e.g. after reading the bytes directly.
+  void SetBytePosition(size_t position) {
+    m_position = position;
+    m_bits = 0;
+    m_numBits = 0;
+    m_numPaddingBytes = 0;
+  }
+};
+
+constexpr int kMaxCodeLength = 15;
+constexpr int kNumLiteralLengthSymbols = 288;
+constexpr int kNumDistanceSymbols = 32;
+
+class HuffmanTable {
+ private:
+  // Codes of up to kFastBits bits are decoded with a single lookup. Each entry is (symbol << 4) | codeLength, or 0 if
+  // the code is longer than that.
+  static constexpr int kFastBits = 10;
+  uint16_t m_fastTable[1 << kFastBits];
+
+  // For the canonical decoding of the longer codes.
+  uint16_t m_counts[kMaxCodeLength + 1];
+  uint16_t m_symbols[kNumLiteralLengthSymbols];
+
+  int DecodeSlow(BitReader* reader) const {
+    const uint32_t bits = reader->Peek(kMaxCodeLength);
+    int code = 0;
+    int first = 0;
+    int index = 0;
+    for (int length = 1; length <= kMaxCodeLength; ++length) {
+      code |= (bits >> (length - 1)) & 1;
+      const int count = m_counts[length];
+      if (code - count < first) {
+        reader->Consume(length);
+        return m_symbols[index + (code - first)];
+      }
+      index += count;
+      first = (first + count) << 1;
+      code <<= 1;
+    }
+
+    return -1;
+  }
+
+ public:
+  bool Build(const uint8_t* codeLengths, int numSymbols) {
+    memset(m_counts, 0, sizeof(m_counts));
+    for (int i = 0; i < numSymbols; ++i) {
+      ++m_counts[codeLengths[i]];
+    }
+    m_counts[0] = 0;
+
+    // Over-subscribed codes are invalid. Incomplete ones are allowed (e.g. a single distance code); decoding one of
+    // the missing codes fails instead.
+    int numCodesLeft = 1;
+    for (int length = 1; length <= kMaxCodeLength; ++length) {
+      numCodesLeft = (numCodesLeft << 1) - m_counts[length];
+      if (numCodesLeft < 0)
+        return false;
+    }
+
+    uint16_t offsets[kMaxCodeLength + 1];
+    offsets[1] = 0;
+    for (int length = 1; length < kMaxCodeLength; ++length) {
+      offsets[length + 1] = offsets[length] + m_counts[length];
+    }
+
+    memset(m_fastTable, 0, sizeof(m_fastTable));
+    uint16_t nextCode[kMaxCodeLength + 1];
+    int code = 0;
+    for (int length = 1; length <= kMaxCodeLength; ++length) {
+      code = (code + m_counts[length - 1]) << 1;
+      nextCode[length] = (uint16_t)code;
+    }
+
+    for (int symbol = 0; symbol < numSymbols; ++symbol) {
+      const int length = codeLengths[symbol];
+      if (length == 0)
+        continue;
+
+      m_symbols[offsets[length]++] = (uint16_t)symbol;
+
+      const int symbolCode = nextCode[length]++;
+      if (length <= kFastBits) {
+        // The codes are stored MSB-first, but the stream is read LSB-first.
+        int reversedCode = 0;
+        for (int i = 0; i < length; ++i) {
+          reversedCode |= ((symbolCode >> i) & 1) << (length - 1 - i);
+        }
+        for (int i = reversedCode; i < (1 << kFastBits); i += (1 << length)) {
+          m_fastTable[i] = (uint16_t)((symbol << 4) | length);
+        }
+      }
+    }
+
+    return true;
+  }
+
+  // Returns -1 for an invalid code. Expects that at least kMaxCodeLength bits are available.
+  int Decode(BitReader* reader) const {
+    const uint16_t entry = m_fastTable[reader->Peek(kFastBits)];
+    if (entry != 0) {
+      reader->Consume(entry & 15);
+      return entry >> 4;
+    }
+
+    return DecodeSlow(reader);
+  }
+};
+
+constexpr uint16_t kLengthBases[29] = {3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+                                       31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+constexpr uint8_t kLengthExtraBits[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                                          2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+constexpr uint16_t kDistanceBases[30] = {
+  1,   2,   3,   4,   5,   7,    9,    13,   17,   25,   33,   49,   65,    97,    129,
+  193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577,
+};
+constexpr uint8_t kDistanceExtraBits[30] = {0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
+                                            6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+// The order in which the code length code lengths are stored in a dynamic block's header.
+constexpr uint8_t kCodeLengthOrder[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+class Inflater {
+ private:
+  BitReader m_reader;
+  std::vector<unsigned char>* m_output;
+  size_t m_outputStart;
+  size_t m_outputSize;
+
+  HuffmanTable m_literalLengthTable;
+  HuffmanTable m_distanceTable;
+
+  void EnsureCapacity(size_t numBytes) {
+    if (m_outputSize + numBytes > m_output->size()) {
+      m_output->resize(std::max(m_outputSize + numBytes, 2 * m_output->size()));
+    }
+  }
+
+  bool InflateStoredBlock();
+  bool ReadDynamicTables();
+  void BuildFixedTables();
+  bool InflateCompressedBlock();
+
+ public:
+  Inflater(const unsigned char* data, size_t size, std::vector<unsigned char>* output)
+      : m_reader(data, size), m_output(output), m_outputStart(output->size()), m_outputSize(output->size()) {}
+
+  bool Inflate(size_t expectedSize);
+  size_t GetNumBytesConsumed() const { return m_reader.GetBytePosition(); }
+};
+
+bool Inflater::InflateStoredBlock() {
+  m_reader.AlignToByte();
+  const uint32_t length = m_reader.Read(16);
+  const uint32_t inverseLength = m_reader.Read(16);
+  if (m_reader.IsOverrun() || (length ^ 0xFFFF) != inverseLength)
+    return false;
+
+  // The data is copied straight out of the stream, rather than going through the bit buffer.
+  const size_t position = m_reader.GetBytePosition();
+  if (length > m_reader.GetSize() - position)
+    return false;
+
+  EnsureCapacity(length);
+  memcpy(m_output->data() + m_outputSize, m_reader.GetData() + position, length);
+  m_outputSize += length;
+  m_reader.SetBytePosition(position + length);
+  return true;
+}
+
+bool Inflater::ReadDynamicTables() {
+  const int numLiteralLengthCodes = m_reader.Read(5) + 257;
+  const int numDistanceCodes = m_reader.Read(5) + 1;
+  const int numCodeLengthCodes = m_reader.Read(4) + 4;
+  if (numLiteralLengthCodes > 286 || numDistanceCodes > 30)
+    return false;
+
+  uint8_t codeLengthCodeLengths[19] = {};
+  for (int i = 0; i < numCodeLengthCodes; ++i) {
+    codeLengthCodeLengths[kCodeLengthOrder[i]] = (uint8_t)m_reader.Read(3);
+  }
+
+  HuffmanTable codeLengthTable;
+  if (!codeLengthTable.Build(codeLengthCodeLengths, 19))
+    return false;
+
+  // The literal/length and distance code lengths are run-length encoded as a single sequence.
+  uint8_t codeLengths[kNumLiteralLengthSymbols + kNumDistanceSymbols] = {};
+  const int numCodeLengths = numLiteralLengthCodes + numDistanceCodes;
+  for (int i = 0; i < numCodeLengths;) {
+    m_reader.Refill();
+    const int symbol = codeLengthTable.Decode(&m_reader);
+    if (symbol < 0)
+      return false;
+
+    if (symbol < 16) {
+      codeLengths[i++] = (uint8_t)symbol;
+      continue;
+    }
+
+    uint8_t repeatedLength = 0;
+    int repeatCount;
+    if (symbol == 16) {
+      if (i == 0)
+        return false;
+      repeatedLength = codeLengths[i - 1];
+      repeatCount = 3 + m_reader.Read(2);
+    } else if (symbol == 17) {
+      repeatCount = 3 + m_reader.Read(3);
+    } else {
+      repeatCount = 11 + m_reader.Read(7);
+    }
+
+    if (i + repeatCount > numCodeLengths)
+      return false;
+    memset(codeLengths + i, repeatedLength, repeatCount);
+    i += repeatCount;
+  }
+
+  // The end-of-block code has to be there, otherwise the block can never end.
+  if (codeLengths[256] == 0)
+    return false;
+
+  return m_literalLengthTable.Build(codeLengths, numLiteralLengthCodes) &&
+         m_distanceTable.Build(codeLengths + numLiteralLengthCodes, numDistanceCodes) && !m_reader.IsOverrun();
+}
+
+void Inflater::BuildFixedTables() {
+  uint8_t codeLengths[kNumLiteralLengthSymbols];
+  memset(codeLengths, 8, 144);
+  memset(codeLengths + 144, 9, 256 - 144);
+  memset(codeLengths + 256, 7, 280 - 256);
+  memset(codeLengths + 280, 8, kNumLiteralLengthSymbols - 280);
+  m_literalLengthTable.Build(codeLengths, kNumLiteralLengthSymbols);
+
+  uint8_t distanceCodeLengths[kNumDistanceSymbols];
+  memset(distanceCodeLengths, 5, kNumDistanceSymbols);
+  m_distanceTable.Build(distanceCodeLengths, kNumDistanceSymbols);
+}
+
+bool Inflater::InflateCompressedBlock() {
+  while (true) {
+    // A literal/length code, its extra bits, a distance code and its extra bits take at most 48 bits.
+    m_reader.Refill();
+    const int symbol = m_literalLengthTable.Decode(&m_reader);
+    if (symbol < 256) {
+      // Past the end of the data, the zeros could otherwise decode as literals forever.
+      if (symbol < 0 || m_reader.IsOverrun())
+        return false;
+
+      EnsureCapacity(1);
+      (*m_output)[m_outputSize++] = (unsigned char)symbol;
+      continue;
+    }
+
+    if (symbol == 256)
+      return !m_reader.IsOverrun();
+
+    const int lengthIndex = symbol - 257;
+    if (lengthIndex >= 29)
+      return false;
+    const size_t length = kLengthBases[lengthIndex] + m_reader.Read(kLengthExtraBits[lengthIndex]);
+
+    const int distanceIndex = m_distanceTable.Decode(&m_reader);
+    if (distanceIndex < 0 || distanceIndex >= 30)
+      return false;
+    const size_t distance = kDistanceBases[distanceIndex] + m_reader.Read(kDistanceExtraBits[distanceIndex]);
+
+    if (distance > m_outputSize - m_outputStart || m_reader.IsOverrun())
+      return false;
+
+    EnsureCapacity(length);
+    unsigned char* out = m_output->data() + m_outputSize;
+    const unsigned char* in = out - distance;
+    // The ranges can overlap (when the distance is less than the length), in which case the copy has to repeat the
+    // bytes that it has just written, so this can't be a memcpy.
+    for (size_t i = 0; i < length; ++i) {
+      out[i] = in[i];
+    }
+    m_outputSize += length;
+  }
+}
+
+bool Inflater::Inflate(size_t expectedSize) {
+  m_output->resize(m_outputSize + expectedSize);
+
+  bool isFinalBlock = false;
+  while (!isFinalBlock) {
+    isFinalBlock = m_reader.Read(1);
+    const uint32_t blockType = m_reader.Read(2);
+
+    bool succeeded = false;
+    switch (blockType) {
+      case 0:
+        succeeded = InflateStoredBlock();
+        break;
+      case 1:
+        BuildFixedTables();
+        succeeded = InflateCompressedBlock();
+        break;
+      case 2:
+        succeeded = ReadDynamicTables() && InflateCompressedBlock();
+        break;
+      default:
+        break;
+    }
+
+    if (!succeeded) {
+      m_output->resize(m_outputStart);
+      return false;
+    }
+  }
+
+  m_output->resize(m_outputSize);
+  m_reader.AlignToByte();
+  return true;
+}
+
+uint32_t ComputeAdler32(const unsigned char* data, size_t size) {
+  const uint32_t kModulus = 65521;
+  // The largest number of bytes that can be summed before the sums have to be reduced, to avoid overflowing.
+  const size_t kMaxBlockSize = 5552;
+
+  uint32_t a = 1;
+  uint32_t b = 0;
+  while (size > 0) {
+    const size_t blockSize = std::min(size, kMaxBlockSize);
+    for (size_t i = 0; i < blockSize; ++i) {
+      a += data[i];
+      b += a;
+    }
+    a %= kModulus;
+    b %= kModulus;
+    data += blockSize;
+    size -= blockSize;
+  }
+
+  return (b << 16) | a;
+}
+}  // namespace
+
+bool ZlibDecompress(const unsigned char* data, size_t size, size_t expectedSize, std::vector<unsigned char>* output) {
+  // The 2-byte header: the compression method has to be deflate, and no preset dictionary is allowed.
+  if (size < 2)
+    return false;
+
+  const unsigned char compressionMethodAndFlags = data[0];
+  const unsigned char flags = data[1];
+  if ((compressionMethodAndFlags & 0x0F) != 8 || (compressionMethodAndFlags >> 4) > 7 ||
+      ((compressionMethodAndFlags << 8) | flags) % 31 != 0 || (flags & 0x20) != 0)
+    return false;
+
+  const size_t outputStart = output->size();
+  Inflater inflater(data + 2, size - 2, output);
+  if (!inflater.Inflate(expectedSize))
+    return false;
+
+  // The stream ends with a big-endian Adler-32 checksum of the uncompressed data.
+  const size_t checksumPosition = 2 + inflater.GetNumBytesConsumed();
+  if (checksumPosition + 4 > size) {
+    output->resize(outputStart);
+    return false;
+  }
+
+  const unsigned char* checksum = data + checksumPosition;
+  const uint32_t expectedChecksum = ((uint32_t)checksum[0] << 24) | ((uint32_t)checksum[1] << 16) |
+                                    ((uint32_t)checksum[2] << 8) | (uint32_t)checksum[3];
+  if (ComputeAdler32(output->data() + outputStart, output->size() - outputStart) != expectedChecksum) {
+    output->resize(outputStart);
+    return false;
+  }
+
+  return true;
+}
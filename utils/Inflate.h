@@ -0,0 +1,11 @@
+#pragma once
+
+#include <stddef.h>
+
+#include <vector>
+
+// Decompresses a zlib stream (RFC 1950 wrapping RFC 1951 deflate data), as used by e.g. png files. The decompressed
+// data is appended to |output|. Returns false if the stream is malformed or truncated.
+//
+// |expectedSize| is only a hint for how much to reserve up front; the output may end up being larger or smaller.
+bool ZlibDecompress(const unsigned char* data, size_t size, size_t expectedSize, std::vector<unsigned char>* output);
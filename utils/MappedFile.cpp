@@ -0,0 +1,154 @@
+#include "utils/MappedFile.h"
+
+#include <fstream>
+#include <utility>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile() {
+  Close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept {
+  *this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+  if (this != &other) {
+    Close();
+    m_data = std::exchange(other.m_data, nullptr);
+    m_size = std::exchange(other.m_size, 0);
+#ifdef _WIN32
+    m_fileHandle = std::exchange(other.m_fileHandle, nullptr);
+    m_mappingHandle = std::exchange(other.m_mappingHandle, nullptr);
+#else
+    m_fileDescriptor = std::exchange(other.m_fileDescriptor, -1);
+#endif
+    m_isMapped = std::exchange(other.m_isMapped, false);
+    m_fallbackContents = std::move(other.m_fallbackContents);
+  }
+
+  return *this;
+}
+
+bool MappedFile::Open(const std::string& fileName) {
+  Close();
+  if (Map(fileName.c_str()))
+    return true;
+
+  // Mapping can legitimately fail (e.g. zero-length files can't be mapped), so fall back to just reading it in.
+  Close();
+  return ReadIntoBuffer(fileName.c_str());
+}
+
+#ifdef _WIN32
+bool MappedFile::Map(const char* fileName) {
+  HANDLE file = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, /*lpSecurityAttributes*/ nullptr, OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, /*hTemplateFile*/ nullptr);
+  if (file == INVALID_HANDLE_VALUE)
+    return false;
+  m_fileHandle = file;
+
+  LARGE_INTEGER fileSize;
+  if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+    return false;
+
+  HANDLE mapping = CreateFileMappingA(file, /*lpFileMappingAttributes*/ nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (mapping == nullptr)
+    return false;
+  m_mappingHandle = mapping;
+
+  void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if (view == nullptr)
+    return false;
+
+  m_data = static_cast<const char*>(view);
+  m_size = static_cast<size_t>(fileSize.QuadPart);
+  m_isMapped = true;
+  return true;
+}
+
+void MappedFile::Close() {
+  if (m_isMapped)
+    UnmapViewOfFile(m_data);
+  if (m_mappingHandle != nullptr)
+    CloseHandle(m_mappingHandle);
+  if (m_fileHandle != nullptr)
+    CloseHandle(m_fileHandle);
+
+  m_mappingHandle = nullptr;
+  m_fileHandle = nullptr;
+  m_isMapped = false;
+  m_data = nullptr;
+  m_size = 0;
+  m_fallbackContents = std::vector<char>();
+}
+#else
+bool MappedFile::Map(const char* fileName) {
+  int fd = open(fileName, O_RDONLY);
+  if (fd < 0)
+    return false;
+  m_fileDescriptor = fd;
+
+  struct stat fileStat;
+  if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0)
+    return false;
+
+  void* view = mmap(nullptr, fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (view == MAP_FAILED)
+    return false;
+
+  // The file is almost always scanned front to back, so let the OS read ahead aggressively.
+  (void)madvise(view, fileStat.st_size, MADV_SEQUENTIAL);
+
+  m_data = static_cast<const char*>(view);
+  m_size = static_cast<size_t>(fileStat.st_size);
+  m_isMapped = true;
+  return true;
+}
+
+void MappedFile::Close() {
+  if (m_isMapped)
+    munmap(const_cast<char*>(m_data), m_size);
+  if (m_fileDescriptor >= 0)
+    close(m_fileDescriptor);
+
+  m_fileDescriptor = -1;
+  m_isMapped = false;
+  m_data = nullptr;
+  m_size = 0;
+  m_fallbackContents = std::vector<char>();
+}
+#endif
+
+bool MappedFile::ReadIntoBuffer(const char* fileName) {
+  std::ifstream file(fileName, std::ios::in | std::ios::binary | std::ios::ate);
+  if (!file.is_open())
+    return false;
+
+  // tellg reports failure as -1.
+  const std::streamoff fileSize = file.tellg();
+  if (fileSize < 0)
+    return false;
+  file.seekg(0, std::ios::beg);
+
+  std::vector<char> contents(static_cast<size_t>(fileSize));
+  file.read(contents.data(), fileSize);
+  const std::streamsize bytesRead = file.gcount();
+  file.close();
+
+  if (bytesRead != fileSize)
+    return false;
+
+  m_fallbackContents = std::move(contents);
+  m_data = m_fallbackContents.data();
+  m_size = m_fallbackContents.size();
+  return true;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+// A read-only view of a file's contents.
+//
+// Where possible, the file is memory-mapped so that its contents are paged in by the OS on demand instead of being
+// copied into a heap allocation up front. If mapping isn't available (or fails, e.g. for empty files), the contents
+// are read into an owned buffer instead. Either way, consumers just see a contiguous range of bytes.
+//
+// NOTE: The contents are *not* null-terminated. Anything that scans the data must respect the end of the view.
+class MappedFile {
+ private:
+  const char* m_data = nullptr;
+  size_t m_size = 0;
+
+#ifdef _WIN32
+  void* m_fileHandle = nullptr;
+  void* m_mappingHandle = nullptr;
+#else
+  int m_fileDescriptor = -1;
+#endif
+  bool m_isMapped = false;
+
+  // Only used when the file could not be mapped.
+  std::vector<char> m_fallbackContents;
+
+  bool Map(const char* fileName);
+  bool ReadIntoBuffer(const char* fileName);
+
+ public:
+  MappedFile() = default;
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  MappedFile(MappedFile&& other) noexcept;
+  MappedFile& operator=(MappedFile&& other) noexcept;
+
+  bool Open(const std::string& fileName);
+  void Close();
+
+  std::string_view GetView() const { return std::string_view(m_data, m_size); }
+  const char* GetData() const { return m_data; }
+  size_t GetSize() const { return m_size; }
+  bool IsMapped() const { return m_isMapped; }
+};
@@ -0,0 +1,258 @@
+#include "utils/MipGeneration.h"
+
+#include "utils/ThreadPool.h"
+
+#include <math.h>
+#include <stdint.h>
+
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MIP_GENERATION_USE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace MipGeneration {
+
+namespace {
+constexpr double kPi = 3.14159265358979323846;
+
+// The Kaiser filter reaches this many texels of the smaller level out on either side, and kKaiserAlpha sets the shape
+// of its window: higher values trade sharpness for less ringing.
+constexpr double kKaiserWidth = 3.0;
+constexpr double kKaiserAlpha = 4.0;
+
+double SrgbToLinear(double value) {
+  return value <= 0.04045 ? value / 12.92 : pow((value + 0.055) / 1.055, 2.4);
+}
+
+// Conversions between RGBA8 texels and linear floats.
+struct ConversionTables {
+  float toLinear[256][2];  // Indexed by the byte; [0] for the sRGB color channels, [1] for alpha.
+
+  // The linear values halfway (in sRGB space) between neighboring codes. Rounding a value to the nearest code is the
+  // same as counting the midpoints at or below it, which gives exactly what converting with the formula would.
+  float srgbMidpoints[255];
+
+  // The code of the lowest value in each of kNumSrgbBins equal slices of [0, 1]. The bins are narrow enough that a
+  // value is at most one code above its bin's, even where the sRGB curve is at its steepest.
+  static constexpr size_t kNumSrgbBins = 4096;
+  unsigned char srgbBins[kNumSrgbBins];
+
+  ConversionTables() {
+    for (int i = 0; i < 256; ++i) {
+      toLinear[i][0] = static_cast<float>(SrgbToLinear(i / 255.0));
+      toLinear[i][1] = static_cast<float>(i / 255.0);
+    }
+    for (int i = 0; i < 255; ++i)
+      srgbMidpoints[i] = static_cast<float>(SrgbToLinear((i + 0.5) / 255.0));
+
+    int code = 0;
+    for (size_t i = 0; i < kNumSrgbBins; ++i) {
+      const float binStart = static_cast<float>(i) / kNumSrgbBins;
+      while (code < 255 && srgbMidpoints[code] <= binStart)
+        ++code;
+      srgbBins[i] = static_cast<unsigned char>(code);
+    }
+  }
+
+  // |value| is expected to be within [0, 1].
+  unsigned char ToSrgb(float value) const {
+    const size_t bin = std::min(static_cast<size_t>(value * kNumSrgbBins), kNumSrgbBins - 1);
+    const int code = srgbBins[bin];
+    return static_cast<unsigned char>((code < 255 && srgbMidpoints[code] <= value) ? code + 1 : code);
+  }
+};
+
+const ConversionTables& GetConversionTables() {
+  static const ConversionTables tables;
+  return tables;
+}
+
+// The texels of the larger level that one texel of the smaller level is made of, along one axis.
+struct Tap {
+  uint32_t source;
+  float weight;
+};
+
+struct Taps {
+  std::vector<Tap> taps;
+  std::vector<size_t> offsets;  // The taps of texel i are [offsets[i], offsets[i + 1]).
+};
+
+double BesselI0(double x) {
+  // The power series converges quickly for the small arguments the window uses.
+  double sum = 1.0;
+  double term = 1.0;
+  for (int k = 1; k < 32; ++k) {
+    term *= (x * 0.5 / k) * (x * 0.5 / k);
+    sum += term;
+    if (term < sum * 1e-12)
+      break;
+  }
+  return sum;
+}
+
+// |x| is the distance between the texel centers, in texels of the smaller level.
+double KaiserWeight(double x) {
+  if (fabs(x) >= kKaiserWidth)
+    return 0.0;
+
+  const double sinc = (x == 0.0) ? 1.0 : sin(kPi * x) / (kPi * x);
+  const double t = x / kKaiserWidth;
+  return sinc * BesselI0(kKaiserAlpha * sqrt(1.0 - t * t)) / BesselI0(kKaiserAlpha);
+}
+
+Taps ComputeTaps(Filter filter, size_t sourceSize, size_t destinationSize) {
+  const double scale = static_cast<double>(sourceSize) / destinationSize;
+
+  Taps result;
+  result.offsets.push_back(0);
+  std::vector<double> weights;
+  for (size_t i = 0; i < destinationSize; ++i) {
+    // The weights of source texels [first, first + weights.size()).
+    size_t first;
+    if (filter == Filter::Box) {
+      // The overlap of each source texel with the span the destination texel covers.
+      const double begin = i * scale;
+      const double end = (i + 1) * scale;
+      first = static_cast<size_t>(begin);
+      weights.assign(std::min(static_cast<size_t>(ceil(end)), sourceSize) - first, 0.0);
+      for (size_t j = 0; j < weights.size(); ++j)
+        weights[j] = std::min(end, first + j + 1.0) - std::max(begin, static_cast<double>(first + j));
+    } else {
+      // Texels past the edges repeat the edge texel, rather than wrapping around: not every texture tiles.
+      const double center = (i + 0.5) * scale;
+      const double radius = kKaiserWidth * scale;
+      const ptrdiff_t begin = static_cast<ptrdiff_t>(floor(center - radius));
+      const ptrdiff_t end = static_cast<ptrdiff_t>(ceil(center + radius));
+      const ptrdiff_t lastTexel = static_cast<ptrdiff_t>(sourceSize) - 1;
+      first = static_cast<size_t>(std::clamp<ptrdiff_t>(begin, 0, lastTexel));
+      weights.assign(static_cast<size_t>(std::clamp<ptrdiff_t>(end, 0, lastTexel)) - first + 1, 0.0);
+      for (ptrdiff_t j = begin; j <= end; ++j) {
+        const size_t clamped = static_cast<size_t>(std::clamp<ptrdiff_t>(j, 0, lastTexel));
+        weights[clamped - first] += KaiserWeight((j + 0.5 - center) / scale);
+      }
+    }
+
+    double totalWeight = 0.0;
+    for (double weight : weights)
+      totalWeight += weight;
+    for (size_t j = 0; j < weights.size(); ++j) {
+      if (weights[j] != 0.0)
+        result.taps.push_back({static_cast<uint32_t>(first + j), static_cast<float>(weights[j] / totalWeight)});
+    }
+    result.offsets.push_back(result.taps.size());
+  }
+  return result;
+}
+
+// Filters one level down to the next. Each destination row first sums the source rows it covers into a single row of
+// linear floats, and then filters that row horizontally; so only a row's worth of floats is ever held at once.
+void Downsample(const Taps& horizontalTaps,
+                const Taps& verticalTaps,
+                const unsigned char* source,
+                size_t sourceWidth,
+                size_t sourceRowPitch,
+                unsigned char* destination,
+                size_t destinationWidth,
+                size_t destinationHeight) {
+  const ConversionTables& tables = GetConversionTables();
+
+  ThreadPool::GetShared().ParallelFor(destinationHeight, [&](size_t y) {
+    std::vector<float> row(sourceWidth * 4, 0.0f);
+    for (size_t t = verticalTaps.offsets[y]; t < verticalTaps.offsets[y + 1]; ++t) {
+      const Tap& tap = verticalTaps.taps[t];
+      const unsigned char* sourceRow = source + tap.source * sourceRowPitch;
+#if defined(MIP_GENERATION_USE_SSE2)
+      const __m128 weight = _mm_set1_ps(tap.weight);
+      for (size_t x = 0; x < sourceWidth; ++x) {
+        const unsigned char* texel = sourceRow + x * 4;
+        const __m128 linear = _mm_setr_ps(tables.toLinear[texel[0]][0], tables.toLinear[texel[1]][0],
+                                          tables.toLinear[texel[2]][0], tables.toLinear[texel[3]][1]);
+        _mm_storeu_ps(&row[x * 4], _mm_add_ps(_mm_loadu_ps(&row[x * 4]), _mm_mul_ps(weight, linear)));
+      }
+#else
+      for (size_t x = 0; x < sourceWidth * 4; x += 4) {
+        row[x + 0] += tap.weight * tables.toLinear[sourceRow[x + 0]][0];
+        row[x + 1] += tap.weight * tables.toLinear[sourceRow[x + 1]][0];
+        row[x + 2] += tap.weight * tables.toLinear[sourceRow[x + 2]][0];
+        row[x + 3] += tap.weight * tables.toLinear[sourceRow[x + 3]][1];
+      }
+#endif
+    }
+
+    unsigned char* destinationRow = destination + y * destinationWidth * 4;
+    for (size_t x = 0; x < destinationWidth; ++x) {
+      float texel[4];
+#if defined(MIP_GENERATION_USE_SSE2)
+      __m128 sum = _mm_setzero_ps();
+      for (size_t t = horizontalTaps.offsets[x]; t < horizontalTaps.offsets[x + 1]; ++t) {
+        const Tap& tap = horizontalTaps.taps[t];
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(tap.weight), _mm_loadu_ps(&row[tap.source * 4])));
+      }
+      _mm_storeu_ps(texel, _mm_min_ps(_mm_max_ps(sum, _mm_setzero_ps()), _mm_set1_ps(1.0f)));
+#else
+      texel[0] = texel[1] = texel[2] = texel[3] = 0.0f;
+      for (size_t t = horizontalTaps.offsets[x]; t < horizontalTaps.offsets[x + 1]; ++t) {
+        const Tap& tap = horizontalTaps.taps[t];
+        for (size_t c = 0; c < 4; ++c)
+          texel[c] += tap.weight * row[tap.source * 4 + c];
+      }
+      for (size_t c = 0; c < 4; ++c)
+        texel[c] = std::clamp(texel[c], 0.0f, 1.0f);
+#endif
+      destinationRow[x * 4 + 0] = tables.ToSrgb(texel[0]);
+      destinationRow[x * 4 + 1] = tables.ToSrgb(texel[1]);
+      destinationRow[x * 4 + 2] = tables.ToSrgb(texel[2]);
+      destinationRow[x * 4 + 3] = static_cast<unsigned char>(texel[3] * 255.0f + 0.5f);
+    }
+  });
+}
+}  // namespace
+
+size_t GetNumMips(size_t width, size_t height) {
+  size_t numMips = 1;
+  for (size_t size = std::max(width, height); size > 1; size >>= 1)
+    ++numMips;
+  return numMips;
+}
+
+size_t GetMipSize(size_t size, size_t mip) {
+  return std::max(size >> mip, static_cast<size_t>(1));
+}
+
+std::vector<unsigned char> GenerateMips(Filter filter,
+                                        const unsigned char* pixels,
+                                        size_t width,
+                                        size_t height,
+                                        size_t rowPitch) {
+  const size_t numMips = GetNumMips(width, height);
+  size_t totalSize = 0;
+  for (size_t mip = 1; mip < numMips; ++mip)
+    totalSize += GetMipSize(width, mip) * GetMipSize(height, mip) * 4;
+  std::vector<unsigned char> mips(totalSize);
+
+  const unsigned char* source = pixels;
+  size_t sourceRowPitch = rowPitch;
+  unsigned char* destination = mips.data();
+  for (size_t mip = 1; mip < numMips; ++mip) {
+    const size_t sourceWidth = GetMipSize(width, mip - 1);
+    const size_t sourceHeight = GetMipSize(height, mip - 1);
+    const size_t destinationWidth = GetMipSize(width, mip);
+    const size_t destinationHeight = GetMipSize(height, mip);
+
+    const Taps horizontalTaps = ComputeTaps(filter, sourceWidth, destinationWidth);
+    const Taps verticalTaps = ComputeTaps(filter, sourceHeight, destinationHeight);
+    Downsample(horizontalTaps, verticalTaps, source, sourceWidth, sourceRowPitch, destination, destinationWidth,
+               destinationHeight);
+
+    source = destination;
+    sourceRowPitch = destinationWidth * 4;
+    destination += destinationWidth * destinationHeight * 4;
+  }
+
+  return mips;
+}
+
+}  // namespace MipGeneration
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stddef.h>
+
+#include <vector>
+
+// Builds the chain of mip levels below an RGBA8 image, so that minified textures are sampled from a properly filtered
+// copy instead of aliasing (and thrashing the texture cache) by skipping over texels of the full-size image.
+//
+// The color channels are treated as sRGB-encoded and filtered in linear space; otherwise the lower levels come out
+// darker than the image they were made from. Alpha is filtered as is. Each level is filtered from the one above it,
+// one output row at a time, with the rows spread across the shared thread pool.
+namespace MipGeneration {
+
+enum class Filter {
+  Box,     // Averages the texels that each texel of the next level covers. Cheap, but a little blurry.
+  Kaiser,  // A Kaiser-windowed sinc, which keeps the lower levels sharper. Its negative lobes can overshoot, so the
+           // results are clamped.
+};
+
+// The number of levels in a full chain, down to and including 1x1.
+size_t GetNumMips(size_t width, size_t height);
+
+// The width (or height) of level |mip|: half of the level above it, rounded down, but never less than 1. These are
+// the sizes D3D expects.
+size_t GetMipSize(size_t size, size_t mip);
+
+// Returns levels 1 to GetNumMips() - 1 of the image at |pixels|, whose rows are |rowPitch| bytes apart. The levels
+// are stored one after another, largest first, each with tightly packed rows of 4 * GetMipSize(width, mip) bytes.
+std::vector<unsigned char> GenerateMips(Filter filter,
+                                        const unsigned char* pixels,
+                                        size_t width,
+                                        size_t height,
+                                        size_t rowPitch);
+
+}  // namespace MipGeneration
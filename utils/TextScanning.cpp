@@ -0,0 +1,381 @@
+#include "utils/TextScanning.h"
+
+#include <float.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+#if defined(__AVX2__)
+#define TEXT_SCANNING_USE_AVX2 1
+#include <immintrin.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TEXT_SCANNING_USE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace TextScanning {
+
+// ------------------------------------------------------------------------------------------------
+// Character scans.
+
+#if defined(TEXT_SCANNING_USE_SSE2) || defined(TEXT_SCANNING_USE_AVX2)
+static unsigned CountTrailingZeros(uint32_t mask) {
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanForward(&index, mask);
+  return index;
+#else
+  return __builtin_ctz(mask);
+#endif
+}
+#endif
+
+// Each matcher describes a set of characters, both as a scalar test and as a bitmask over a block of characters
+// (bit i set if character i is in the set).
+struct WhitespaceMatcher {
+  static bool Matches(char c) { return IsWhitespace(c); }
+
+#ifdef TEXT_SCANNING_USE_SSE2
+  static uint32_t Mask(__m128i chars) {
+    __m128i spaceOrTab =
+        _mm_or_si128(_mm_cmpeq_epi8(chars, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(chars, _mm_set1_epi8('\t')));
+    __m128i returnOrVerticalTab =
+        _mm_or_si128(_mm_cmpeq_epi8(chars, _mm_set1_epi8('\r')), _mm_cmpeq_epi8(chars, _mm_set1_epi8('\v')));
+    return (uint32_t)_mm_movemask_epi8(_mm_or_si128(spaceOrTab, returnOrVerticalTab));
+  }
+#endif
+
+#ifdef TEXT_SCANNING_USE_AVX2
+  static uint32_t Mask(__m256i chars) {
+    __m256i spaceOrTab = _mm256_or_si256(_mm256_cmpeq_epi8(chars, _mm256_set1_epi8(' ')),
+                                         _mm256_cmpeq_epi8(chars, _mm256_set1_epi8('\t')));
+    __m256i returnOrVerticalTab = _mm256_or_si256(_mm256_cmpeq_epi8(chars, _mm256_set1_epi8('\r')),
+                                                  _mm256_cmpeq_epi8(chars, _mm256_set1_epi8('\v')));
+    return (uint32_t)_mm256_movemask_epi8(_mm256_or_si256(spaceOrTab, returnOrVerticalTab));
+  }
+#endif
+};
+
+struct WhitespaceOrNewLineMatcher {
+  static bool Matches(char c) { return IsWhitespace(c) || c == '\n'; }
+
+#ifdef TEXT_SCANNING_USE_SSE2
+  static uint32_t Mask(__m128i chars) {
+    return WhitespaceMatcher::Mask(chars) | (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(chars, _mm_set1_epi8('\n')));
+  }
+#endif
+
+#ifdef TEXT_SCANNING_USE_AVX2
+  static uint32_t Mask(__m256i chars) {
+    return WhitespaceMatcher::Mask(chars) |
+           (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chars, _mm256_set1_epi8('\n')));
+  }
+#endif
+};
+
+// Returns the index of the first character at or after |index| for which Matcher::Matches(c) == |matchValue|.
+template <class Matcher, bool matchValue>
+static size_t FindFirst(const char* data, size_t size, size_t index) {
+  // Tokens and the whitespace between them are usually only a few characters long, so check the first couple of
+  // characters one at a time before paying for any vector setup.
+  for (size_t end = std::min(size, index + 4); index < end; ++index) {
+    if (Matcher::Matches(data[index]) == matchValue)
+      return index;
+  }
+
+#ifdef TEXT_SCANNING_USE_AVX2
+  for (; index + 32 <= size; index += 32) {
+    __m256i chars = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + index));
+    uint32_t mask = Matcher::Mask(chars);
+    if (!matchValue)
+      mask = ~mask;
+
+    if (mask != 0)
+      return index + CountTrailingZeros(mask);
+  }
+#endif
+
+#ifdef TEXT_SCANNING_USE_SSE2
+  for (; index + 16 <= size; index += 16) {
+    __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + index));
+    uint32_t mask = Matcher::Mask(chars);
+    if (!matchValue)
+      mask = ~mask & 0xFFFF;
+
+    if (mask != 0)
+      return index + CountTrailingZeros(mask);
+  }
+#endif
+
+  for (; index < size; ++index) {
+    if (Matcher::Matches(data[index]) == matchValue)
+      return index;
+  }
+
+  return size;
+}
+
+size_t SkipWhitespace(const char* data, size_t size, size_t index) {
+  return FindFirst<WhitespaceMatcher, /*matchValue*/ false>(data, size, index);
+}
+
+size_t FindTokenEnd(const char* data, size_t size, size_t index) {
+  return FindFirst<WhitespaceOrNewLineMatcher, /*matchValue*/ true>(data, size, index);
+}
+
+size_t FindNewLine(const char* data, size_t size, size_t index) {
+  if (index >= size)
+    return size;
+
+  // memchr is already vectorized by every C runtime that we care about.
+  const void* newLine = memchr(data + index, '\n', size - index);
+  return newLine ? static_cast<const char*>(newLine) - data : size;
+}
+
+// ------------------------------------------------------------------------------------------------
+// Number parsing.
+
+static bool IsDigit(char c) {
+  return c >= '0' && c <= '9';
+}
+
+// Reads 8 characters at once into a little-endian word, so that they can be checked & converted in parallel (SWAR).
+static uint64_t LoadEightChars(const char* data) {
+  uint64_t chars;
+  memcpy(&chars, data, sizeof(chars));
+  return chars;
+}
+
+static bool AreEightDigits(uint64_t chars) {
+  // Adding 6 to each byte carries into the high nibble iff it was above '9'.
+  return (((chars & 0xF0F0F0F0F0F0F0F0) | (((chars + 0x0606060606060606) & 0xF0F0F0F0F0F0F0F0) >> 4)) ==
+          0x3333333333333333);
+}
+
+static uint32_t ParseEightDigits(uint64_t chars) {
+  const uint64_t mask = 0x000000FF000000FF;
+  const uint64_t mul1 = 0x000F424000000064;  // 100 + (1000000 << 32)
+  const uint64_t mul2 = 0x0000271000000001;  // 1 + (10000 << 32)
+  chars -= 0x3030303030303030;
+  chars = (chars * 10) + (chars >> 8);  // Pairs of digits.
+  chars = (((chars & mask) * mul1) + (((chars >> 16) & mask) * mul2)) >> 32;
+  return (uint32_t)chars;
+}
+
+// Accumulates a run of digits into |value| (which silently wraps if there are too many; callers are expected to check
+// the number of digits). Returns the index just past the run.
+static size_t AccumulateDigits(const char* data, size_t size, size_t index, uint64_t* value) {
+  uint64_t result = *value;
+  while (index + 8 <= size) {
+    uint64_t chars = LoadEightChars(data + index);
+    if (!AreEightDigits(chars))
+      break;
+
+    result = result * 100000000 + ParseEightDigits(chars);
+    index += 8;
+  }
+
+  for (; index < size && IsDigit(data[index]); ++index) {
+    result = result * 10 + (data[index] - '0');
+  }
+
+  *value = result;
+  return index;
+}
+
+// The C runtime functions require null-terminated strings, but the data we're scanning isn't (and, when it's
+// memory-mapped, reading past the end isn't even safe). So copy the token into a small null-terminated buffer first.
+// Anything that is a valid number will comfortably fit.
+static constexpr size_t kMaxNumberLength = 128;
+static void CopyNumberToken(const char* data, size_t size, char (&buffer)[kMaxNumberLength]) {
+  size_t length = std::min(size, kMaxNumberLength - 1);
+  memcpy(buffer, data, length);
+  buffer[length] = '\0';
+}
+
+static size_t ParseIntegerWithRuntime(const char* data, size_t size, long long* value) {
+  char buffer[kMaxNumberLength];
+  CopyNumberToken(data, size, buffer);
+
+  char* endPtr;
+  long long parsedValue = strtoll(buffer, &endPtr, /*radix*/ 10);
+
+  size_t lengthConsumed = endPtr - buffer;
+  if (lengthConsumed > 0)
+    *value = parsedValue;
+
+  return lengthConsumed;
+}
+
+static size_t ParseFloatWithRuntime(const char* data, size_t size, float* value) {
+  char buffer[kMaxNumberLength];
+  CopyNumberToken(data, size, buffer);
+
+  char* endPtr;
+  float parsedValue = strtof(buffer, &endPtr);
+
+  size_t lengthConsumed = endPtr - buffer;
+  if (lengthConsumed > 0)
+    *value = parsedValue;
+
+  return lengthConsumed;
+}
+
+size_t ParseInteger(const char* data, size_t size, long long* value) {
+  size_t index = 0;
+  bool isNegative = false;
+  if (index < size && (data[index] == '+' || data[index] == '-')) {
+    isNegative = (data[index] == '-');
+    index++;
+  }
+
+  uint64_t magnitude = 0;
+  size_t digitsStart = index;
+  index = AccumulateDigits(data, size, index, &magnitude);
+
+  size_t numDigits = index - digitsStart;
+  if (numDigits == 0)
+    return 0;
+
+  // Anything with 19+ digits could overflow, which strtoll has very specific behavior for.
+  if (numDigits > 18)
+    return ParseIntegerWithRuntime(data, size, value);
+
+  *value = isNegative ? -(long long)magnitude : (long long)magnitude;
+  return index;
+}
+
+// Every power of 10 up to 10^22 is exactly representable as a double.
+static constexpr double kExactPowersOf10[] = {
+  1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+static constexpr int kMaxExactPowerOf10 = 22;
+
+// Returns whether |value| lies exactly halfway between two adjacent floats. Only valid for doubles within the normal
+// float range.
+static bool IsHalfwayBetweenFloats(double value) {
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+
+  // A double's mantissa has 29 more bits than a float's.
+  const uint64_t kDroppedBitsMask = (1ull << 29) - 1;
+  return (bits & kDroppedBitsMask) == (1ull << 28);
+}
+
+size_t ParseFloat(const char* data, size_t size, float* value) {
+  size_t index = 0;
+  bool isNegative = false;
+  if (index < size && (data[index] == '+' || data[index] == '-')) {
+    isNegative = (data[index] == '-');
+    index++;
+  }
+
+  if (index == size)
+    return 0;
+
+  if (!IsDigit(data[index]) && data[index] != '.') {
+    // Infinities and NaNs are rare enough that it's not worth handling them here.
+    char c = data[index];
+    if (c == 'i' || c == 'I' || c == 'n' || c == 'N')
+      return ParseFloatWithRuntime(data, size, value);
+
+    return 0;
+  }
+
+  // Hex floats are also left to the runtime.
+  if (data[index] == '0' && index + 1 < size && (data[index + 1] == 'x' || data[index + 1] == 'X'))
+    return ParseFloatWithRuntime(data, size, value);
+
+  // Gather all of the digits into a single integer mantissa, and keep track of where the decimal point was.
+  uint64_t mantissa = 0;
+  size_t integerStart = index;
+  index = AccumulateDigits(data, size, index, &mantissa);
+  size_t numIntegerDigits = index - integerStart;
+
+  size_t numFractionDigits = 0;
+  if (index < size && data[index] == '.') {
+    size_t fractionStart = ++index;
+    index = AccumulateDigits(data, size, index, &mantissa);
+    numFractionDigits = index - fractionStart;
+  }
+
+  if (numIntegerDigits == 0 && numFractionDigits == 0)
+    return 0;
+
+  // The exponent is optional, and only consumed if it's well-formed (e.g. "1e" is just "1").
+  long long explicitExponent = 0;
+  if (index < size && (data[index] == 'e' || data[index] == 'E')) {
+    size_t exponentIndex = index + 1;
+    bool isExponentNegative = false;
+    if (exponentIndex < size && (data[exponentIndex] == '+' || data[exponentIndex] == '-')) {
+      isExponentNegative = (data[exponentIndex] == '-');
+      exponentIndex++;
+    }
+
+    if (exponentIndex < size && IsDigit(data[exponentIndex])) {
+      for (; exponentIndex < size && IsDigit(data[exponentIndex]); ++exponentIndex) {
+        // Clamp absurdly large exponents; they're far outside the range of a float either way.
+        if (explicitExponent < 100000)
+          explicitExponent = explicitExponent * 10 + (data[exponentIndex] - '0');
+      }
+
+      if (isExponentNegative)
+        explicitExponent = -explicitExponent;
+
+      index = exponentIndex;
+    }
+  }
+
+  const size_t numberLength = index;
+
+  // Leading zeros don't contribute to the mantissa, so only the significant digits count towards the limit of what
+  // fits into 64 bits.
+  size_t numSignificantDigits = numIntegerDigits + numFractionDigits;
+  if (numSignificantDigits > 19) {
+    numSignificantDigits = 0;
+    for (size_t i = integerStart; i < numberLength && (IsDigit(data[i]) || data[i] == '.'); ++i) {
+      if (data[i] != '.' && (numSignificantDigits > 0 || data[i] != '0'))
+        numSignificantDigits++;
+    }
+
+    if (numSignificantDigits > 19)
+      return ParseFloatWithRuntime(data, size, value);
+  }
+
+  if (mantissa == 0) {
+    *value = isNegative ? -0.f : 0.f;
+    return numberLength;
+  }
+
+  // Clinger's fast path: if both the mantissa and the power of 10 are exactly representable as doubles, a single
+  // multiplication or division gives the correctly rounded double. Rounding that to a float is then only wrong if the
+  // double landed exactly halfway between two floats (since the true value may have been slightly off to one side).
+  long long exponent10 = explicitExponent - (long long)numFractionDigits;
+  if (mantissa <= (1ull << 53) && exponent10 >= -kMaxExactPowerOf10 && exponent10 <= kMaxExactPowerOf10) {
+    double result = (double)mantissa;
+    if (exponent10 < 0) {
+      result /= kExactPowersOf10[-exponent10];
+    } else {
+      result *= kExactPowersOf10[exponent10];
+    }
+
+    // Overflow, underflow & denormals are left to the runtime, which knows exactly how to handle them.
+    if (result >= FLT_MIN && result <= FLT_MAX && !IsHalfwayBetweenFloats(result)) {
+      *value = (float)(isNegative ? -result : result);
+      return numberLength;
+    }
+  }
+
+  return ParseFloatWithRuntime(data, size, value);
+}
+
+}  // namespace TextScanning
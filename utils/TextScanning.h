@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stddef.h>
+
+// Low-level helpers for scanning text that is *not* null-terminated (e.g. a MappedFile). Every function takes the
+// data's size and never reads past it.
+//
+// The character scans are vectorized with SSE2 (or AVX2, when the compiler targets it) and fall back to scalar loops
+// elsewhere. The number parsers produce exactly what strtoll/strtof would for the same token, but skip the locale
+// handling and only fall back to the C runtime for the rare inputs that the fast paths can't prove correct.
+namespace TextScanning {
+
+// NOTE: Newlines are deliberately *not* whitespace here, since they are used to denote the end of a statement.
+inline bool IsWhitespace(char c) {
+  return (c == ' ' || c == '\t' || c == '\r' || c == '\v');
+}
+
+// Returns the index of the first character at or after |index| that isn't whitespace, or |size| if there is none.
+size_t SkipWhitespace(const char* data, size_t size, size_t index);
+
+// Returns the index of the first whitespace or newline character at or after |index|, or |size| if there is none.
+size_t FindTokenEnd(const char* data, size_t size, size_t index);
+
+// Returns the index of the first newline at or after |index|, or |size| if there is none.
+size_t FindNewLine(const char* data, size_t size, size_t index);
+
+// Parse a base-10 integer or a floating point number from the start of the data. Returns the number of characters
+// consumed, or 0 if the data doesn't start with a number (in which case |value| is left untouched).
+//
+// Unlike strtoll/strtof, leading whitespace is not skipped; the caller is expected to have done that already (and
+// this way a number can never be picked up from the next line).
+size_t ParseInteger(const char* data, size_t size, long long* value);
+size_t ParseFloat(const char* data, size_t size, float* value);
+
+}  // namespace TextScanning
@@ -0,0 +1,111 @@
+#include "utils/ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+
+ThreadPool::ThreadPool(size_t numThreads) {
+  numThreads = std::max<size_t>(numThreads, 1);
+  m_threads.reserve(numThreads);
+  for (size_t i = 0; i < numThreads; ++i) {
+    m_threads.emplace_back(&ThreadPool::WorkerLoop, this);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_isShuttingDown = true;
+  }
+  m_taskAvailable.notify_all();
+
+  for (std::thread& thread : m_threads) {
+    thread.join();
+  }
+}
+
+void ThreadPool::WorkerLoop() {
+  while (true) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_taskAvailable.wait(lock, [this]() { return m_isShuttingDown || !m_tasks.empty(); });
+
+      // Drain any remaining work before shutting down, so that no outstanding future is left broken.
+      if (m_tasks.empty())
+        return;
+
+      task = std::move(m_tasks.front());
+      m_tasks.pop();
+    }
+
+    task();
+  }
+}
+
+void ThreadPool::Enqueue(std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_tasks.push(std::move(task));
+  }
+  m_taskAvailable.notify_one();
+}
+
+namespace {
+struct ParallelForState {
+  std::function<void(size_t)> func;
+  size_t count;
+  std::atomic<size_t> nextIndex = 0;
+
+  std::atomic<size_t> numActiveHelpers = 0;
+  std::mutex mutex;
+  std::condition_variable helpersFinished;
+
+  void RunUntilExhausted() {
+    for (size_t i = nextIndex++; i < count; i = nextIndex++) {
+      func(i);
+    }
+  }
+};
+}  // namespace
+
+void ThreadPool::ParallelFor(size_t count, const std::function<void(size_t)>& func) {
+  if (count == 0)
+    return;
+
+  if (count == 1) {
+    func(0);
+    return;
+  }
+
+  // The state is shared with the helpers, since a helper may only get scheduled after all of the work is already done
+  // (and therefore after this function has returned).
+  auto state = std::make_shared<ParallelForState>();
+  state->func = func;
+  state->count = count;
+
+  const size_t numHelpers = std::min(count - 1, m_threads.size());
+  for (size_t i = 0; i < numHelpers; ++i) {
+    Enqueue([state]() {
+      // Register as active *before* grabbing any work, so that the calling thread can't miss us.
+      state->numActiveHelpers++;
+      state->RunUntilExhausted();
+      if (--state->numActiveHelpers == 0) {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->helpersFinished.notify_all();
+      }
+    });
+  }
+
+  state->RunUntilExhausted();
+
+  // All of the work has been handed out at this point. Helpers that start from here on won't find anything to do, so
+  // only wait for the ones that are still in the middle of a call.
+  std::unique_lock<std::mutex> lock(state->mutex);
+  state->helpersFinished.wait(lock, [&state]() { return state->numActiveHelpers == 0; });
+}
+
+/*static*/
+ThreadPool& ThreadPool::GetShared() {
+  static ThreadPool sharedPool(std::thread::hardware_concurrency());
+  return sharedPool;
+}
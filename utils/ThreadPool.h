@@ -0,0 +1,58 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// A fixed-size pool of worker threads that runs submitted tasks in FIFO order.
+//
+// NOTE: Tasks running on the pool should not block on the results of other tasks submitted to the same pool (e.g. by
+// waiting on a future from Submit). If every worker ends up waiting, nothing is left to run the tasks being waited
+// on. ParallelFor is safe to call from anywhere, since the calling thread does the work itself if no worker is free.
+class ThreadPool {
+ private:
+  std::vector<std::thread> m_threads;
+  std::queue<std::function<void()>> m_tasks;
+  std::mutex m_mutex;
+  std::condition_variable m_taskAvailable;
+  bool m_isShuttingDown = false;
+
+  void WorkerLoop();
+  void Enqueue(std::function<void()> task);
+
+ public:
+  explicit ThreadPool(size_t numThreads);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  size_t GetNumThreads() const { return m_threads.size(); }
+
+  template <class Func>
+  std::future<std::invoke_result_t<Func>> Submit(Func&& func);
+
+  // Calls func(i) for every i in [0, count), spread across the pool and the calling thread. Returns once all calls
+  // have completed.
+  void ParallelFor(size_t count, const std::function<void(size_t)>& func);
+
+  // A process-wide pool with one thread per hardware thread.
+  static ThreadPool& GetShared();
+};
+
+template <class Func>
+std::future<std::invoke_result_t<Func>> ThreadPool::Submit(Func&& func) {
+  using Result = std::invoke_result_t<Func>;
+
+  // std::function requires copyable callables, but packaged_task is move-only. So share it instead.
+  auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<Func>(func));
+  std::future<Result> result = task->get_future();
+  Enqueue([task]() { (*task)(); });
+  return result;
+}